@@ -0,0 +1,44 @@
+#pragma once
+
+/* Tiny benchmark harness for the host build.
+ *
+ * Each case runs one operation repeatedly; the harness reports the best
+ * ns/op over several timed repetitions plus heap allocations and bytes
+ * requested per op (counted by interposing malloc/calloc/realloc). Cases
+ * that persist data also report the bytes it occupies on flash, and cases
+ * that scan data the rate they get through it. */
+
+#include <stddef.h>
+#include <stdint.h>
+
+typedef struct bench_case {
+    const char *name;                           /* "group/variant" */
+    void (*setup)(struct bench_case *bc);       /* optional, not timed */
+    void (*run)(struct bench_case *bc);         /* one operation */
+    void (*teardown)(struct bench_case *bc);    /* optional, not timed */
+    int count;                                  /* corpus size knob */
+    size_t bytes;                               /* corpus size knob */
+    int variant;                                /* case-specific selector */
+    size_t footprint;                           /* bytes at rest, set by setup (0 = n/a) */
+    size_t scanned;                             /* bytes processed per op, set by setup (0 = n/a) */
+    void *ctx;                                  /* owned by setup/teardown */
+} bench_case_t;
+
+/** Register a case; the struct must outlive the run. */
+void bench_add(bench_case_t *bc);
+
+/** Keep the optimiser from discarding a result. */
+static inline void bench_consume(const void *p)
+{
+    __asm__ volatile("" : : "g"(p) : "memory");
+}
+
+/* Registration hooks, one per hot path */
+void bench_register_session(void);
+void bench_register_llm(void);
+void bench_register_telegram(void);
+void bench_register_search(void);
+void bench_register_memory(void);
+void bench_register_storage(void);
+void bench_register_grep(void);
+void bench_register_bus(void);
@@ -0,0 +1,175 @@
+/* Message bus throughput: the lock-free ring (bus_ring.c) against a FreeRTOS
+ * queue of the same mimi_msg_t, which is what message_bus.c used to be.
+ *
+ * "1 thread" cases push 16 messages and pop them again on the bench
+ * thread, so they time the uncontended path. "N producers" cases start N
+ * pthreads that push as fast as the queue takes messages while the bench
+ * thread pops 64 per op; the queue stays full and every push contends.
+ * Messages carry no payload, so only the bus is timed.
+ *
+ * The "stalled consumer" case pushes 16 messages a op into a message_bus
+ * queue that is full and never popped, with the drop-oldest policy: each
+ * push replaces its chat's oldest queued message (one of 4 chats, so a
+ * push moves a quarter of the ring up a slot) and none waits. Under the
+ * block policy every one of those pushes would be refused after
+ * MIMI_BUS_PUSH_TIMEOUT_MS; a refusal here is reported on stderr. The
+ * bus's per-drop warning is muted for the case, so the console is not timed.
+ *
+ * On the host the xQueue is the shim's mutex + condition variable, not the
+ * FreeRTOS kernel queue; on the device a queue operation is a critical
+ * section plus a copy, which makes the uncontended gap narrower there. The
+ * contended cases are the ones that carry over. */
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bench.h"
+#include "bus/bus_ring.h"
+#include "bus/message_bus.h"
+#include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "mimi_config.h"
+
+#define BUS_VARIANT_RING 0
+#define BUS_VARIANT_QUEUE 1
+#define BUS_VARIANT_MODULE 2    /* message_bus_push/pop_inbound on the ring */
+#define BUS_VARIANT_STALLED 3   /* message_bus_push_inbound, full, drop-oldest, no consumer */
+
+#define BUS_BENCH_CAP 32
+#define BUS_BATCH_1T 16
+#define BUS_BATCH_MT 64
+#define BUS_MAX_PRODUCERS 4
+#define BUS_STALLED_CHATS 4
+
+typedef struct {
+    int variant;
+    bus_ring_t ring;
+    QueueHandle_t queue;
+    pthread_t producers[BUS_MAX_PRODUCERS];
+    int nproducers;
+    atomic_bool stop;
+    mimi_msg_t chats[BUS_STALLED_CHATS];    /* addresses for the stalled case */
+    int refused;
+} bus_ctx_t;
+
+static void *producer_main(void *arg)
+{
+    bus_ctx_t *b = arg;
+    mimi_msg_t msg = { .chan = MIMI_CHAN_ID_TELEGRAM, .chat = MIMI_CHAT_EMPTY };
+    while (!atomic_load_explicit(&b->stop, memory_order_relaxed)) {
+        if (b->variant == BUS_VARIANT_QUEUE) {
+            xQueueSend(b->queue, &msg, pdMS_TO_TICKS(10));
+        } else if (!bus_ring_try_push(&b->ring, &msg)) {
+            bus_ring_wait_space(&b->ring, pdMS_TO_TICKS(10));
+        }
+    }
+    return NULL;
+}
+
+static void bus_setup(bench_case_t *bc)
+{
+    bus_ctx_t *b = calloc(1, sizeof(*b));
+    b->variant = bc->variant;
+    if (b->variant == BUS_VARIANT_QUEUE) b->queue = xQueueCreate(BUS_BENCH_CAP, sizeof(mimi_msg_t));
+    else if (b->variant == BUS_VARIANT_RING) bus_ring_init(&b->ring, BUS_BENCH_CAP);
+    b->nproducers = bc->count;
+    for (int i = 0; i < b->nproducers; i++) pthread_create(&b->producers[i], NULL, producer_main, b);
+
+    if (b->variant == BUS_VARIANT_STALLED) {
+        for (int i = 0; i < BUS_STALLED_CHATS; i++) {
+            char id[16];
+            snprintf(id, sizeof(id), "stalled%d", i);
+            mimi_msg_init(&b->chats[i], MIMI_CHAN_TELEGRAM, id, NULL);
+        }
+        esp_log_level_set("bus", ESP_LOG_ERROR);
+        message_bus_set_policy(MIMI_BUS_INBOUND, BUS_POLICY_DROP_OLDEST);
+        for (int i = 0; i < MIMI_BUS_INBOUND_LEN; i++) {
+            mimi_msg_t msg;
+            mimi_msg_reply(&msg, &b->chats[i % BUS_STALLED_CHATS], NULL);
+            if (message_bus_push_inbound(&msg) != ESP_OK) mimi_msg_release(&msg);
+        }
+    }
+    bc->ctx = b;
+}
+
+static void pop_one(bus_ctx_t *b, mimi_msg_t *msg)
+{
+    if (b->variant == BUS_VARIANT_QUEUE) {
+        xQueueReceive(b->queue, msg, portMAX_DELAY);
+    } else {
+        while (!bus_ring_try_pop(&b->ring, msg)) bus_ring_wait_items(&b->ring, portMAX_DELAY);
+    }
+}
+
+static void bus_run(bench_case_t *bc)
+{
+    bus_ctx_t *b = bc->ctx;
+    mimi_msg_t msg = { .chan = MIMI_CHAN_ID_TELEGRAM, .chat = MIMI_CHAT_EMPTY };
+
+    if (b->nproducers) {
+        for (int i = 0; i < BUS_BATCH_MT; i++) pop_one(b, &msg);
+    } else if (b->variant == BUS_VARIANT_STALLED) {
+        for (int i = 0; i < BUS_BATCH_1T; i++) {
+            mimi_msg_reply(&msg, &b->chats[i % BUS_STALLED_CHATS], NULL);
+            if (message_bus_push_inbound(&msg) != ESP_OK) {
+                mimi_msg_release(&msg);
+                b->refused++;
+            }
+        }
+    } else {
+        for (int i = 0; i < BUS_BATCH_1T; i++) {
+            if (b->variant == BUS_VARIANT_QUEUE) xQueueSend(b->queue, &msg, 0);
+            else if (b->variant == BUS_VARIANT_MODULE) message_bus_push_inbound(&msg);
+            else bus_ring_try_push(&b->ring, &msg);
+        }
+        for (int i = 0; i < BUS_BATCH_1T; i++) {
+            if (b->variant == BUS_VARIANT_MODULE) message_bus_pop_inbound(&msg, 0);
+            else pop_one(b, &msg);
+        }
+    }
+    bench_consume(&msg);
+}
+
+static void bus_teardown(bench_case_t *bc)
+{
+    bus_ctx_t *b = bc->ctx;
+    atomic_store(&b->stop, true);
+    for (int i = 0; i < b->nproducers; i++) pthread_join(b->producers[i], NULL);
+    if (b->queue) vQueueDelete(b->queue);
+    if (b->variant == BUS_VARIANT_RING) bus_ring_deinit(&b->ring);
+    if (b->variant == BUS_VARIANT_STALLED) {
+        mimi_msg_t msg;
+        while (message_bus_pop_inbound(&msg, 0) == ESP_OK) mimi_msg_release(&msg);
+        message_bus_set_policy(MIMI_BUS_INBOUND, MIMI_BUS_INBOUND_POLICY);
+        esp_log_level_set("bus", ESP_LOG_WARN);
+        for (int i = 0; i < BUS_STALLED_CHATS; i++) mimi_msg_release(&b->chats[i]);
+        if (b->refused) fprintf(stderr, "%s: %d pushes refused\n", bc->name, b->refused);
+    }
+    free(b);
+    bc->ctx = NULL;
+}
+
+#define BUS_CASE(n, producers, v) \
+    { .name = n, .setup = bus_setup, .run = bus_run, .teardown = bus_teardown, \
+      .count = producers, .variant = v }
+
+static bench_case_t s_cases[] = {
+    BUS_CASE("bus/xqueue,1 thread,16 msgs",       0, BUS_VARIANT_QUEUE),
+    BUS_CASE("bus/ring,1 thread,16 msgs",         0, BUS_VARIANT_RING),
+    BUS_CASE("bus/message_bus,1 thread,16 msgs",  0, BUS_VARIANT_MODULE),
+    BUS_CASE("bus/drop-oldest,stalled consumer,16 msgs", 0, BUS_VARIANT_STALLED),
+    BUS_CASE("bus/xqueue,1 producer,64 msgs",     1, BUS_VARIANT_QUEUE),
+    BUS_CASE("bus/ring,1 producer,64 msgs",       1, BUS_VARIANT_RING),
+    BUS_CASE("bus/xqueue,4 producers,64 msgs",    4, BUS_VARIANT_QUEUE),
+    BUS_CASE("bus/ring,4 producers,64 msgs",      4, BUS_VARIANT_RING),
+};
+
+void bench_register_bus(void)
+{
+    for (size_t i = 0; i < sizeof(s_cases) / sizeof(s_cases[0]); i++) bench_add(&s_cases[i]);
+}
@@ -0,0 +1,150 @@
+#include "bench_corpus.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const char *s_words[] = {
+    "the", "device", "memory", "agent", "reply", "weather", "tomorrow", "please",
+    "remind", "me", "about", "meeting", "at", "noon", "search", "for", "news",
+    "ESP32", "flash", "budget", "and", "a", "quick", "summary", "of", "today",
+    "with", "links", "\"quoted\"", "caf\xC3\xA9", "\xE4\xBD\xA0\xE5\xA5\xBD", "line\nbreak",
+};
+
+void corpus_text(char *buf, size_t len, unsigned seed)
+{
+    size_t n = 0;
+    size_t nwords = sizeof(s_words) / sizeof(s_words[0]);
+    while (n < len) {
+        seed = seed * 1103515245u + 12345u;
+        const char *w = s_words[(seed >> 16) % nwords];
+        size_t wl = strlen(w);
+        if (n + wl + 1 > len) {
+            memset(buf + n, 'x', len - n);
+            n = len;
+            break;
+        }
+        memcpy(buf + n, w, wl);
+        n += wl;
+        buf[n++] = ' ';
+    }
+    buf[len] = '\0';
+}
+
+char *corpus_text_alloc(size_t len, unsigned seed)
+{
+    char *buf = malloc(len + 1);
+    if (buf) corpus_text(buf, len, seed);
+    return buf;
+}
+
+cJSON *corpus_messages(int turns, size_t text_bytes)
+{
+    cJSON *arr = cJSON_CreateArray();
+    char *text = malloc(text_bytes + 1);
+    char id[32];
+
+    for (int t = 0; t < turns; t++) {
+        corpus_text(text, text_bytes, (unsigned)t * 2u + 1u);
+        cJSON *user = cJSON_CreateObject();
+        cJSON_AddStringToObject(user, "role", "user");
+        cJSON_AddStringToObject(user, "content", text);
+        cJSON_AddItemToArray(arr, user);
+
+        corpus_text(text, text_bytes, (unsigned)t * 2u + 2u);
+        cJSON *asst = cJSON_CreateObject();
+        cJSON_AddStringToObject(asst, "role", "assistant");
+        if (t % 3 != 2) {
+            cJSON_AddStringToObject(asst, "content", text);
+            cJSON_AddItemToArray(arr, asst);
+            continue;
+        }
+
+        /* ReAct exchange: assistant text + tool_use, user tool_result */
+        snprintf(id, sizeof(id), "toolu_%08d", t);
+        cJSON *blocks = cJSON_CreateArray();
+        cJSON *tb = cJSON_CreateObject();
+        cJSON_AddStringToObject(tb, "type", "text");
+        cJSON_AddStringToObject(tb, "text", "Let me look that up.");
+        cJSON_AddItemToArray(blocks, tb);
+        cJSON *tu = cJSON_CreateObject();
+        cJSON_AddStringToObject(tu, "type", "tool_use");
+        cJSON_AddStringToObject(tu, "id", id);
+        cJSON_AddStringToObject(tu, "name", "web_search");
+        cJSON *input = cJSON_CreateObject();
+        cJSON_AddStringToObject(input, "query", "weather tomorrow in San Francisco");
+        cJSON_AddItemToObject(tu, "input", input);
+        cJSON_AddItemToArray(blocks, tu);
+        cJSON_AddItemToObject(asst, "content", blocks);
+        cJSON_AddItemToArray(arr, asst);
+
+        cJSON *res = cJSON_CreateObject();
+        cJSON_AddStringToObject(res, "role", "user");
+        cJSON *rblocks = cJSON_CreateArray();
+        cJSON *tr = cJSON_CreateObject();
+        cJSON_AddStringToObject(tr, "type", "tool_result");
+        cJSON_AddStringToObject(tr, "tool_use_id", id);
+        cJSON_AddStringToObject(tr, "content", text);
+        cJSON_AddItemToArray(rblocks, tr);
+        cJSON_AddItemToObject(res, "content", rblocks);
+        cJSON_AddItemToArray(arr, res);
+    }
+    free(text);
+    return arr;
+}
+
+static void add_tool(cJSON *arr, const char *name, const char *desc, const char *schema)
+{
+    cJSON *t = cJSON_CreateObject();
+    cJSON_AddStringToObject(t, "name", name);
+    cJSON_AddStringToObject(t, "description", desc);
+    cJSON_AddItemToObject(t, "input_schema", cJSON_Parse(schema));
+    cJSON_AddItemToArray(arr, t);
+}
+
+char *corpus_tools_json(void)
+{
+    static const char *path_schema =
+        "{\"type\":\"object\",\"properties\":{\"path\":{\"type\":\"string\","
+        "\"description\":\"Absolute path starting with /spiffs/\"}},\"required\":[\"path\"]}";
+    static const char *write_schema =
+        "{\"type\":\"object\",\"properties\":{\"path\":{\"type\":\"string\"},"
+        "\"content\":{\"type\":\"string\",\"description\":\"File content to write\"}},"
+        "\"required\":[\"path\",\"content\"]}";
+    static const char *edit_schema =
+        "{\"type\":\"object\",\"properties\":{\"path\":{\"type\":\"string\"},"
+        "\"old_string\":{\"type\":\"string\"},\"new_string\":{\"type\":\"string\"}},"
+        "\"required\":[\"path\",\"old_string\",\"new_string\"]}";
+    static const char *cron_schema =
+        "{\"type\":\"object\",\"properties\":{\"name\":{\"type\":\"string\"},"
+        "\"schedule_type\":{\"type\":\"string\",\"enum\":[\"every\",\"at\"]},"
+        "\"interval_s\":{\"type\":\"integer\"},\"at_epoch\":{\"type\":\"integer\"},"
+        "\"message\":{\"type\":\"string\"},\"channel\":{\"type\":\"string\"},"
+        "\"chat_id\":{\"type\":\"string\"}},\"required\":[\"name\",\"schedule_type\",\"message\"]}";
+
+    cJSON *arr = cJSON_CreateArray();
+    add_tool(arr, "web_search", "Search the web for current information. Use this when you need "
+             "up-to-date facts, news, weather, or anything beyond your training data.",
+             "{\"type\":\"object\",\"properties\":{\"query\":{\"type\":\"string\","
+             "\"description\":\"The search query\"}},\"required\":[\"query\"]}");
+    add_tool(arr, "get_current_time", "Get the current date and time. You do NOT have an "
+             "internal clock - always use this tool when you need to know the time or date.",
+             "{\"type\":\"object\",\"properties\":{},\"required\":[]}");
+    add_tool(arr, "read_file", "Read a file from SPIFFS storage. Path must start with /spiffs/.",
+             path_schema);
+    add_tool(arr, "write_file", "Write or overwrite a file on SPIFFS storage.", write_schema);
+    add_tool(arr, "edit_file", "Find and replace text in a file on SPIFFS. Replaces first "
+             "occurrence of old_string with new_string.", edit_schema);
+    add_tool(arr, "list_dir", "List files on SPIFFS storage, optionally filtered by path prefix.",
+             "{\"type\":\"object\",\"properties\":{\"prefix\":{\"type\":\"string\"}},\"required\":[]}");
+    add_tool(arr, "cron_add", "Schedule a recurring or one-shot task.", cron_schema);
+    add_tool(arr, "cron_list", "List all scheduled cron jobs.",
+             "{\"type\":\"object\",\"properties\":{},\"required\":[]}");
+    add_tool(arr, "cron_remove", "Remove a scheduled cron job by its ID.",
+             "{\"type\":\"object\",\"properties\":{\"job_id\":{\"type\":\"string\"}},"
+             "\"required\":[\"job_id\"]}");
+
+    char *json = cJSON_PrintUnformatted(arr);
+    cJSON_Delete(arr);
+    return json;
+}
@@ -0,0 +1,22 @@
+#pragma once
+
+/* Deterministic payload corpora shaped like real MimiClaw traffic. */
+
+#include <stddef.h>
+#include "cJSON.h"
+
+/** Fill buf with len bytes of word-like text (plus NUL); same seed, same text. */
+void corpus_text(char *buf, size_t len, unsigned seed);
+
+/** Newly allocated text of len bytes; caller frees. */
+char *corpus_text_alloc(size_t len, unsigned seed);
+
+/**
+ * Anthropic-format message array of `turns` user/assistant exchanges with
+ * text_bytes of text per message. Every third exchange carries a tool_use
+ * block and a matching tool_result, as a ReAct turn does.
+ */
+cJSON *corpus_messages(int turns, size_t text_bytes);
+
+/** Tool schema array shaped like tool_registry_get_tools_json(); caller frees. */
+char *corpus_tools_json(void);
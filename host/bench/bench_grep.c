@@ -0,0 +1,192 @@
+/* search_files over a SPIFFS partition shaped like a device after some
+ * weeks of use: MEMORY.md, 30 daily notes, 8 session files, a few skills
+ * and the config files, about 160 KB in 45 files. Each op walks the
+ * partition and searches every file, as the tool does, minus formatting
+ * its output. The "in memory" cases search the same bytes held in one
+ * buffer, without the file system, to time the search alone.
+ *
+ * memmem is libc's substring search over the same windows, for scale.
+ * The 6-byte pattern occurs in two files and goes through Horspool; the
+ * 2-byte one, through the word-at-a-time scan, also hits every "device".
+ * The throughput table divides the bytes searched by the time per op. */
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bench.h"
+#include "bench_corpus.h"
+#include "mimi_config.h"
+#include "storage/storage_cache.h"
+#include "storage/storage_fs.h"
+#include "storage/storage_log.h"
+#include "tools/text_search.h"
+
+/* variant bits */
+#define GREP_ICASE      0x1
+#define GREP_MEMMEM     0x2
+#define GREP_IN_MEMORY 0x4
+#define GREP_CONTEXT(n) ((n) << 4)
+
+typedef struct {
+    text_search_t ts;
+    const char *pattern;
+    int context;
+    char *window;           /* memmem variant */
+    char *all;              /* in-memory variants: every file, back to back */
+    size_t all_len;
+    size_t matches;
+} grep_ctx_t;
+
+static size_t s_corpus_bytes;
+
+static void write_lines(const char *path, size_t bytes, unsigned seed, const char *insert)
+{
+    char *text = malloc(bytes + 1);
+    corpus_text(text, bytes, seed);
+    /* Lines of about 60 bytes, as notes and JSONL records run */
+    for (size_t i = 0, col = 0; i < bytes; i++, col++) {
+        if (text[i] == ' ' && col >= 56) {
+            text[i] = '\n';
+            col = 0;
+        }
+    }
+    if (insert) memcpy(text + bytes / 2, insert, strlen(insert));
+    FILE *f = storage_open(path, "w");
+    if (f) {
+        fwrite(text, 1, bytes, f);
+        fclose(f);
+    }
+    free(text);
+    s_corpus_bytes += bytes;
+}
+
+static bool load_file(const char *path, void *arg)
+{
+    grep_ctx_t *g = arg;
+    FILE *f = storage_fopen(path);
+    if (!f) return true;
+    g->all_len += fread(g->all + g->all_len, 1, s_corpus_bytes - g->all_len, f);
+    fclose(f);
+    return true;
+}
+
+static void grep_setup(bench_case_t *bc)
+{
+    storage_cache_init();
+    s_corpus_bytes = 0;
+    char path[96];
+    write_lines(MIMI_MEMORY_FILE, 8 * 1024, 1, NULL);
+    write_lines(MIMI_SOUL_FILE, 1024, 2, NULL);
+    write_lines(MIMI_USER_FILE, 512, 3, NULL);
+    write_lines(MIMI_HEARTBEAT_FILE, 512, 4, NULL);
+    for (int d = 1; d <= 30; d++) {
+        snprintf(path, sizeof(path), MIMI_SPIFFS_MEMORY_DIR "/2026-01-%02d.md", d);
+        write_lines(path, 1536, 10 + d, d == 17 ? " dentist at 4pm " : NULL);
+    }
+    for (int s = 0; s < 8; s++) {
+        snprintf(path, sizeof(path), MIMI_SPIFFS_SESSION_DIR "/tg_%d.jsonl", 1000 + s);
+        write_lines(path, 12 * 1024, 50 + s, s == 5 ? " the dentist moved " : NULL);
+    }
+    for (int k = 0; k < 5; k++) {
+        snprintf(path, sizeof(path), MIMI_SKILLS_DIR "/skill_%d.md", k);
+        write_lines(path, 2048, 70 + k, NULL);
+    }
+    storage_checkpoint();
+    storage_cache_reset();
+
+    grep_ctx_t *g = calloc(1, sizeof(*g));
+    g->pattern = bc->count == 2 ? "de" : "dentis";
+    g->context = bc->variant >> 4;
+    text_search_compile(&g->ts, g->pattern, bc->variant & GREP_ICASE, false);
+    if (bc->variant & GREP_MEMMEM) g->window = malloc(MIMI_SEARCH_WINDOW);
+    if (bc->variant & GREP_IN_MEMORY) {
+        g->all = malloc(s_corpus_bytes);
+        storage_walk(MIMI_SPIFFS_BASE "/", load_file, g);
+    }
+    bc->ctx = g;
+    bc->footprint = s_corpus_bytes;
+    bc->scanned = s_corpus_bytes;
+}
+
+static bool count_line(uint32_t line, const char *text, size_t len, long match, void *arg)
+{
+    (void)line;
+    (void)text;
+    (void)len;
+    if (match >= 0) ((grep_ctx_t *)arg)->matches++;
+    return true;
+}
+
+static bool grep_file(const char *path, void *arg)
+{
+    grep_ctx_t *g = arg;
+    FILE *f = storage_fopen(path);
+    if (!f) return true;
+    if (g->window) {
+        size_t n, plen = strlen(g->pattern);
+        while ((n = fread(g->window, 1, MIMI_SEARCH_WINDOW, f)) > 0) {
+            for (const char *p = g->window, *end = g->window + n;
+                 (p = memmem(p, end - p, g->pattern, plen)) != NULL; p++) {
+                g->matches++;
+            }
+        }
+    } else {
+        text_search_file(&g->ts, f, g->context, count_line, g);
+    }
+    fclose(f);
+    return true;
+}
+
+static void grep_run(bench_case_t *bc)
+{
+    grep_ctx_t *g = bc->ctx;
+    g->matches = 0;
+    if (g->all && g->window) {
+        size_t plen = strlen(g->pattern);
+        for (const char *p = g->all, *end = g->all + g->all_len;
+             (p = memmem(p, end - p, g->pattern, plen)) != NULL; p++) {
+            g->matches++;
+        }
+    } else if (g->all) {
+        for (long at = 0; (at = text_search_find(&g->ts, g->all, g->all_len, (size_t)at)) >= 0; at++) {
+            g->matches++;
+        }
+    } else {
+        storage_walk(MIMI_SPIFFS_BASE "/", grep_file, g);
+    }
+    bench_consume(&g->matches);
+}
+
+static void grep_teardown(bench_case_t *bc)
+{
+    grep_ctx_t *g = bc->ctx;
+    free(g->window);
+    free(g->all);
+    free(g);
+    bc->ctx = NULL;
+}
+
+#define GREP_CASE(n, len, v) \
+    { .name = n, .setup = grep_setup, .run = grep_run, .teardown = grep_teardown, \
+      .count = len, .variant = v }
+
+static bench_case_t s_cases[] = {
+    GREP_CASE("fs_grep/memmem,6B,45 files",         6, GREP_MEMMEM),
+    GREP_CASE("fs_grep/horspool,6B,45 files",       6, 0),
+    GREP_CASE("fs_grep/horspool,6B,icase,45 files", 6, GREP_ICASE),
+    GREP_CASE("fs_grep/horspool,6B,context=2",      6, GREP_CONTEXT(2)),
+    GREP_CASE("fs_grep/word-scan,2B,45 files",      2, 0),
+    GREP_CASE("fs_grep/memmem,6B,in memory",        6, GREP_MEMMEM | GREP_IN_MEMORY),
+    GREP_CASE("fs_grep/horspool,6B,in memory",      6, GREP_IN_MEMORY),
+    GREP_CASE("fs_grep/word-scan,2B,in memory",     2, GREP_IN_MEMORY),
+};
+
+void bench_register_grep(void)
+{
+    for (size_t i = 0; i < sizeof(s_cases) / sizeof(s_cases[0]); i++) bench_add(&s_cases[i]);
+}
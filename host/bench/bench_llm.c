@@ -0,0 +1,148 @@
+/* llm_proxy.c hot paths: request body build + print, OpenAI message
+ * conversion and response parsing. The module source is included so its
+ * static helpers can be driven directly; HTTP is answered in-process. */
+
+#include "llm/llm_proxy.c"
+
+#include "bench.h"
+#include "bench_corpus.h"
+#include "host_http.h"
+
+#define BENCH_SYSTEM_PROMPT_BYTES   6000
+#define BENCH_MSG_TEXT_BYTES        200
+#define BENCH_REPLY_TEXT_BYTES      600
+
+enum { VARIANT_ANTHROPIC, VARIANT_OPENAI };
+
+typedef struct {
+    char *system_prompt;
+    cJSON *messages;
+    char *tools_json;
+    char *response;
+    int response_len;
+} llm_ctx_t;
+
+static int canned_responder(const host_http_request_t *req, const char **resp,
+                            int *resp_len, void *ctx)
+{
+    (void)req;
+    llm_ctx_t *c = ctx;
+    *resp = c->response;
+    *resp_len = c->response_len;
+    return 200;
+}
+
+static char *build_response(int variant)
+{
+    char *text = corpus_text_alloc(BENCH_REPLY_TEXT_BYTES, 7);
+    cJSON *root = cJSON_CreateObject();
+
+    if (variant == VARIANT_OPENAI) {
+        cJSON *choices = cJSON_AddArrayToObject(root, "choices");
+        cJSON *c0 = cJSON_CreateObject();
+        cJSON_AddStringToObject(c0, "finish_reason", "tool_calls");
+        cJSON *msg = cJSON_AddObjectToObject(c0, "message");
+        cJSON_AddStringToObject(msg, "role", "assistant");
+        cJSON_AddStringToObject(msg, "content", text);
+        cJSON *calls = cJSON_AddArrayToObject(msg, "tool_calls");
+        cJSON *tc = cJSON_CreateObject();
+        cJSON_AddStringToObject(tc, "id", "call_0001");
+        cJSON_AddStringToObject(tc, "type", "function");
+        cJSON *fn = cJSON_AddObjectToObject(tc, "function");
+        cJSON_AddStringToObject(fn, "name", "web_search");
+        cJSON_AddStringToObject(fn, "arguments", "{\"query\":\"weather tomorrow\"}");
+        cJSON_AddItemToArray(calls, tc);
+        cJSON_AddItemToArray(choices, c0);
+    } else {
+        cJSON_AddStringToObject(root, "id", "msg_0001");
+        cJSON_AddStringToObject(root, "type", "message");
+        cJSON_AddStringToObject(root, "role", "assistant");
+        cJSON_AddStringToObject(root, "stop_reason", "tool_use");
+        cJSON *content = cJSON_AddArrayToObject(root, "content");
+        cJSON *tb = cJSON_CreateObject();
+        cJSON_AddStringToObject(tb, "type", "text");
+        cJSON_AddStringToObject(tb, "text", text);
+        cJSON_AddItemToArray(content, tb);
+        cJSON *tu = cJSON_CreateObject();
+        cJSON_AddStringToObject(tu, "type", "tool_use");
+        cJSON_AddStringToObject(tu, "id", "toolu_0001");
+        cJSON_AddStringToObject(tu, "name", "web_search");
+        cJSON *input = cJSON_AddObjectToObject(tu, "input");
+        cJSON_AddStringToObject(input, "query", "weather tomorrow");
+        cJSON_AddItemToArray(content, tu);
+    }
+    cJSON *usage = cJSON_AddObjectToObject(root, "usage");
+    cJSON_AddNumberToObject(usage, "input_tokens", 3100);
+    cJSON_AddNumberToObject(usage, "output_tokens", 160);
+
+    char *json = cJSON_PrintUnformatted(root);
+    cJSON_Delete(root);
+    free(text);
+    return json;
+}
+
+static void llm_setup(bench_case_t *bc)
+{
+    llm_ctx_t *ctx = calloc(1, sizeof(*ctx));
+    ctx->system_prompt = corpus_text_alloc(BENCH_SYSTEM_PROMPT_BYTES, 3);
+    ctx->messages = corpus_messages(bc->count, BENCH_MSG_TEXT_BYTES);
+    ctx->tools_json = corpus_tools_json();
+    ctx->response = build_response(bc->variant);
+    ctx->response_len = (int)strlen(ctx->response);
+
+    safe_copy(s_api_key, sizeof(s_api_key), "bench-key");
+    safe_copy(s_provider, sizeof(s_provider),
+              bc->variant == VARIANT_OPENAI ? "openai" : "anthropic");
+    host_http_set_responder(canned_responder, ctx);
+    bc->ctx = ctx;
+}
+
+static void llm_teardown(bench_case_t *bc)
+{
+    llm_ctx_t *ctx = bc->ctx;
+    host_http_set_responder(NULL, NULL);
+    free(ctx->system_prompt);
+    cJSON_Delete(ctx->messages);
+    free(ctx->tools_json);
+    free(ctx->response);
+    free(ctx);
+}
+
+static void chat_tools_run(bench_case_t *bc)
+{
+    llm_ctx_t *ctx = bc->ctx;
+    llm_response_t resp;
+    llm_chat_tools(ctx->system_prompt, ctx->messages, ctx->tools_json, &resp);
+    bench_consume(resp.text);
+    llm_response_free(&resp);
+}
+
+static void convert_openai_run(bench_case_t *bc)
+{
+    llm_ctx_t *ctx = bc->ctx;
+    cJSON *out = convert_messages_openai(ctx->system_prompt, ctx->messages);
+    bench_consume(out);
+    cJSON_Delete(out);
+}
+
+#define CHAT_CASE(n, turns, v) \
+    { .name = n, .setup = llm_setup, .run = chat_tools_run, \
+      .teardown = llm_teardown, .count = turns, .variant = v }
+#define CONVERT_CASE(n, turns) \
+    { .name = n, .setup = llm_setup, .run = convert_openai_run, \
+      .teardown = llm_teardown, .count = turns, .variant = VARIANT_OPENAI }
+
+static bench_case_t s_cases[] = {
+    CHAT_CASE("llm_chat_tools/anthropic,turns=1",  1,  VARIANT_ANTHROPIC),
+    CHAT_CASE("llm_chat_tools/anthropic,turns=10", 10, VARIANT_ANTHROPIC),
+    CHAT_CASE("llm_chat_tools/openai,turns=1",     1,  VARIANT_OPENAI),
+    CHAT_CASE("llm_chat_tools/openai,turns=10",    10, VARIANT_OPENAI),
+    CONVERT_CASE("convert_messages_openai/turns=1",  1),
+    CONVERT_CASE("convert_messages_openai/turns=10", 10),
+    CONVERT_CASE("convert_messages_openai/turns=30", 30),
+};
+
+void bench_register_llm(void)
+{
+    for (size_t i = 0; i < sizeof(s_cases) / sizeof(s_cases[0]); i++) bench_add(&s_cases[i]);
+}
@@ -0,0 +1,238 @@
+/* memory_index_search(): BM25 ranking of memory paragraphs against a user
+ * message, over a growing archive of daily notes. The prompt gets at most
+ * MIMI_CONTEXT_MEMORY_BUDGET bytes whatever the archive size; this shows
+ * what the lookup costs as it grows. Footprint is the notes on flash.
+ *
+ * memory_vec_scan(): the linear int8 scan behind vector recall, one
+ * paragraph per row. Footprint is the row storage in PSRAM and on flash.
+ *
+ * memory_read_recent(): the tiered daily-note block, served from its cache
+ * (variant 0) or re-assembled after a note changed (variant 1), over two
+ * months of notes with their rollups. Footprint is notes plus rollups. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <dirent.h>
+#include <sys/stat.h>
+
+#include "bench.h"
+#include "bench_corpus.h"
+#include "mimi_config.h"
+#include "memory/memory_index.h"
+#include "memory/memory_vec.h"
+#include "memory/memory_store.h"
+
+#define NOTE_PARAGRAPHS 6
+
+typedef struct {
+    char *query;
+    char *buf;
+} memsearch_ctx_t;
+
+static void note_path(char *buf, size_t size, int i)
+{
+    snprintf(buf, size, MIMI_SPIFFS_MEMORY_DIR "/bench_%04d.md", i);
+}
+
+static void memsearch_setup(bench_case_t *bc)
+{
+    memsearch_ctx_t *ctx = calloc(1, sizeof(*ctx));
+    char *text = malloc(bc->bytes + 1);
+    char path[96];
+    size_t total = 0;
+
+    for (int i = 0; i < bc->count; i++) {
+        note_path(path, sizeof(path), i);
+        FILE *f = fopen(path, "w");
+        if (!f) continue;
+        total += (size_t)fprintf(f, "# Note %d\n\n", i);
+        for (int p = 0; p < NOTE_PARAGRAPHS; p++) {
+            corpus_text(text, bc->bytes, (unsigned)(i * NOTE_PARAGRAPHS + p));
+            total += (size_t)fprintf(f, "%s\n\n", text);
+        }
+        fclose(f);
+    }
+    free(text);
+    memory_index_init();
+
+    ctx->query = corpus_text_alloc(120, 7);
+    ctx->buf = malloc(MIMI_CONTEXT_MEMORY_BUDGET);
+    bc->footprint = total;
+    bc->ctx = ctx;
+}
+
+static void memsearch_run(bench_case_t *bc)
+{
+    memsearch_ctx_t *ctx = bc->ctx;
+    memory_index_search(ctx->query, ctx->buf, MIMI_CONTEXT_MEMORY_BUDGET, MIMI_INDEX_TOP_K);
+    bench_consume(ctx->buf);
+}
+
+static void memsearch_teardown(bench_case_t *bc)
+{
+    memsearch_ctx_t *ctx = bc->ctx;
+    char path[96];
+    for (int i = 0; i < bc->count; i++) {
+        note_path(path, sizeof(path), i);
+        remove(path);
+    }
+    memory_index_init();
+    free(ctx->query);
+    free(ctx->buf);
+    free(ctx);
+}
+
+#define MEMSEARCH_CASE(n, c, b) \
+    { .name = n, .setup = memsearch_setup, .run = memsearch_run, \
+      .teardown = memsearch_teardown, .count = c, .bytes = b }
+
+typedef struct {
+    int8_t query[MIMI_VEC_DIM] __attribute__((aligned(16)));
+    float  scale;
+    memory_vec_hit_t hits[MIMI_VEC_CANDIDATES];
+} vecscan_ctx_t;
+
+static float random_row(int8_t *row, unsigned *seed)
+{
+    float norm = 0;
+    for (int d = 0; d < MIMI_VEC_DIM; d++) {
+        *seed = *seed * 1103515245u + 12345u;
+        row[d] = (int8_t)((int)((*seed >> 16) % 255) - 127);
+        norm += (float)row[d] * row[d];
+    }
+    return norm > 0 ? 1.0f / sqrtf(norm) : 0;
+}
+
+static void vecscan_setup(bench_case_t *bc)
+{
+    vecscan_ctx_t *ctx = aligned_alloc(16, sizeof(*ctx));
+    int8_t row[MIMI_VEC_DIM];
+    unsigned seed = 42;
+
+    for (int i = 0; i < bc->count; i++) {
+        float scale = random_row(row, &seed);
+        memory_vec_put(0x80000000u | (uint32_t)i, row, scale);
+    }
+    ctx->scale = random_row(ctx->query, &seed);
+    bc->footprint = (size_t)bc->count * (MIMI_VEC_DIM + sizeof(uint32_t) + sizeof(float));
+    bc->ctx = ctx;
+}
+
+static void vecscan_run(bench_case_t *bc)
+{
+    vecscan_ctx_t *ctx = bc->ctx;
+    int n = memory_vec_scan(ctx->query, ctx->scale, ctx->hits, MIMI_VEC_CANDIDATES);
+    bench_consume(&n);
+}
+
+static void vecscan_teardown(bench_case_t *bc)
+{
+    /* The rows were never flushed; reloading from flash drops them */
+    memory_vec_init();
+    free(bc->ctx);
+}
+
+typedef struct {
+    char today[96];
+    char *buf;
+} recent_ctx_t;
+
+static void daily_path(char *buf, size_t size, int days_ago)
+{
+    time_t t = time(NULL) - (time_t)days_ago * 86400;
+    struct tm tm;
+    char date[16];
+    localtime_r(&t, &tm);
+    strftime(date, sizeof(date), "%Y-%m-%d", &tm);
+    snprintf(buf, size, MIMI_SPIFFS_MEMORY_DIR "/%s.md", date);
+}
+
+static void recent_setup(bench_case_t *bc)
+{
+    recent_ctx_t *ctx = calloc(1, sizeof(*ctx));
+    char *text = malloc(bc->bytes + 1);
+    char path[96];
+    size_t total = 0;
+
+    for (int i = 0; i < bc->count; i++) {
+        daily_path(path, sizeof(path), i);
+        FILE *f = fopen(path, "w");
+        if (!f) continue;
+        for (int p = 0; p < NOTE_PARAGRAPHS; p++) {
+            corpus_text(text, bc->bytes, (unsigned)(i * NOTE_PARAGRAPHS + p));
+            total += (size_t)fprintf(f, "- %s\n", text);
+        }
+        fclose(f);
+    }
+    free(text);
+    memory_store_init();
+    memory_rollup_run(NULL);
+
+    struct stat st;
+    DIR *dir = opendir(MIMI_NOTES_ROLLUP_DIR);
+    struct dirent *e;
+    while (dir && (e = readdir(dir)) != NULL) {
+        if (snprintf(path, sizeof(path), MIMI_NOTES_ROLLUP_DIR "/%s", e->d_name) >= (int)sizeof(path)) continue;
+        if (stat(path, &st) == 0 && S_ISREG(st.st_mode)) total += (size_t)st.st_size;
+    }
+    if (dir) closedir(dir);
+
+    daily_path(ctx->today, sizeof(ctx->today), 0);
+    ctx->buf = malloc(MIMI_NOTES_RECENT_BUDGET);
+    memory_read_recent(ctx->buf, MIMI_NOTES_RECENT_BUDGET);
+    bc->footprint = total;
+    bc->ctx = ctx;
+}
+
+static void recent_run(bench_case_t *bc)
+{
+    recent_ctx_t *ctx = bc->ctx;
+    if (bc->variant) memory_notes_changed(ctx->today);
+    memory_read_recent(ctx->buf, MIMI_NOTES_RECENT_BUDGET);
+    bench_consume(ctx->buf);
+}
+
+static void recent_teardown(bench_case_t *bc)
+{
+    recent_ctx_t *ctx = bc->ctx;
+    char path[96];
+    for (int i = 0; i < bc->count; i++) {
+        daily_path(path, sizeof(path), i);
+        remove(path);
+    }
+    DIR *dir = opendir(MIMI_NOTES_ROLLUP_DIR);
+    struct dirent *e;
+    while (dir && (e = readdir(dir)) != NULL) {
+        if (snprintf(path, sizeof(path), MIMI_NOTES_ROLLUP_DIR "/%s", e->d_name) >= (int)sizeof(path)) continue;
+        remove(path);
+    }
+    if (dir) closedir(dir);
+    free(ctx->buf);
+    free(ctx);
+}
+
+#define RECENT_CASE(n, v) \
+    { .name = n, .setup = recent_setup, .run = recent_run, \
+      .teardown = recent_teardown, .count = 60, .bytes = 120, .variant = v }
+
+#define VECSCAN_CASE(n, c) \
+    { .name = n, .setup = vecscan_setup, .run = vecscan_run, \
+      .teardown = vecscan_teardown, .count = c }
+
+static bench_case_t s_cases[] = {
+    MEMSEARCH_CASE("memory_search/notes=30,para=300B",  30,  300),
+    MEMSEARCH_CASE("memory_search/notes=365,para=300B", 365, 300),
+    VECSCAN_CASE("memory_vec_scan/vectors=1000",  1000),
+    VECSCAN_CASE("memory_vec_scan/vectors=4000",  4000),
+    VECSCAN_CASE("memory_vec_scan/vectors=16000", 16000),
+    RECENT_CASE("recent_notes/cached,days=60",  0),
+    RECENT_CASE("recent_notes/rebuild,days=60", 1),
+};
+
+void bench_register_memory(void)
+{
+    for (size_t i = 0; i < sizeof(s_cases) / sizeof(s_cases[0]); i++) bench_add(&s_cases[i]);
+}
@@ -0,0 +1,98 @@
+/* tool_web_search.c: response parse + format_results / format_tavily_results */
+
+#include "tools/tool_web_search.c"
+
+#include "bench.h"
+#include "bench_corpus.h"
+
+#define BENCH_TOOL_OUTPUT_SIZE  (8 * 1024)
+
+enum { VARIANT_BRAVE, VARIANT_TAVILY };
+
+typedef struct {
+    char *raw;
+    char *output;
+} search_ctx_t;
+
+static void search_setup(bench_case_t *bc)
+{
+    search_ctx_t *ctx = calloc(1, sizeof(*ctx));
+    char *text = malloc(bc->bytes + 1);
+    cJSON *root = cJSON_CreateObject();
+    cJSON *results;
+
+    if (bc->variant == VARIANT_BRAVE) {
+        cJSON_AddStringToObject(root, "type", "search");
+        cJSON *web = cJSON_AddObjectToObject(root, "web");
+        cJSON_AddStringToObject(web, "type", "search");
+        results = cJSON_AddArrayToObject(web, "results");
+    } else {
+        cJSON_AddStringToObject(root, "query", "weather tomorrow");
+        cJSON_AddNumberToObject(root, "response_time", 1.42);
+        results = cJSON_AddArrayToObject(root, "results");
+    }
+
+    for (int i = 0; i < SEARCH_RESULT_COUNT; i++) {
+        char title[64], url[96];
+        snprintf(title, sizeof(title), "Result %d - Weather forecast and conditions", i);
+        snprintf(url, sizeof(url), "https://www.example.com/weather/forecast/%d?units=metric", i);
+        corpus_text(text, bc->bytes, (unsigned)i + 11u);
+
+        cJSON *r = cJSON_CreateObject();
+        cJSON_AddStringToObject(r, "title", title);
+        cJSON_AddStringToObject(r, "url", url);
+        if (bc->variant == VARIANT_BRAVE) {
+            cJSON_AddStringToObject(r, "description", text);
+            cJSON_AddStringToObject(r, "page_age", "2025-02-01T10:00:00");
+            cJSON_AddStringToObject(r, "language", "en");
+            cJSON_AddBoolToObject(r, "family_friendly", true);
+        } else {
+            cJSON_AddStringToObject(r, "content", text);
+            cJSON_AddNumberToObject(r, "score", 0.93 - i * 0.05);
+        }
+        cJSON_AddItemToArray(results, r);
+    }
+
+    ctx->raw = cJSON_PrintUnformatted(root);
+    ctx->output = malloc(BENCH_TOOL_OUTPUT_SIZE);
+    cJSON_Delete(root);
+    free(text);
+    bc->ctx = ctx;
+}
+
+static void search_run(bench_case_t *bc)
+{
+    search_ctx_t *ctx = bc->ctx;
+    cJSON *root = cJSON_Parse(ctx->raw);
+    if (bc->variant == VARIANT_TAVILY) {
+        format_tavily_results(root, ctx->output, BENCH_TOOL_OUTPUT_SIZE);
+    } else {
+        format_results(root, ctx->output, BENCH_TOOL_OUTPUT_SIZE);
+    }
+    cJSON_Delete(root);
+    bench_consume(ctx->output);
+}
+
+static void search_teardown(bench_case_t *bc)
+{
+    search_ctx_t *ctx = bc->ctx;
+    free(ctx->raw);
+    free(ctx->output);
+    free(ctx);
+}
+
+#define SEARCH_CASE(n, v, b) \
+    { .name = n, .setup = search_setup, .run = search_run, \
+      .teardown = search_teardown, .variant = v, .bytes = b }
+
+static bench_case_t s_cases[] = {
+    SEARCH_CASE("search_format/brave,snippet=200B",   VARIANT_BRAVE,  200),
+    SEARCH_CASE("search_format/brave,snippet=1000B",  VARIANT_BRAVE,  1000),
+    SEARCH_CASE("search_format/tavily,snippet=200B",  VARIANT_TAVILY, 200),
+    SEARCH_CASE("search_format/tavily,snippet=1000B", VARIANT_TAVILY, 1000),
+};
+
+void bench_register_search(void)
+{
+    for (size_t i = 0; i < sizeof(s_cases) / sizeof(s_cases[0]); i++) bench_add(&s_cases[i]);
+}
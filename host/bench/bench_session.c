@@ -0,0 +1,137 @@
+/* session_get_history_json(): cold (reverse tail scan + record splice, per
+ * storage format) and hot (PSRAM history cache hit), plus the flash
+ * footprint of each corpus. session_append(): one flush window of turns
+ * across several chats under each sync mode. */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "bench.h"
+#include "bench_corpus.h"
+#include "mimi_config.h"
+#include "memory/session_mgr.h"
+
+/* variant: bit 0 = served from the cache, bits 1-2 = session_format_t */
+#define SESSION_CACHED               0x1
+#define SESSION_FMT(f)               ((f) << 1)
+#define SESSION_VARIANT_FORMAT(v)    ((session_format_t)((v) >> 1))
+#define SESSION_COLD                 0
+
+typedef struct {
+    char chat_id[32];
+    char *buf;
+} session_ctx_t;
+
+static void session_setup(bench_case_t *bc)
+{
+    session_ctx_t *ctx = calloc(1, sizeof(*ctx));
+    snprintf(ctx->chat_id, sizeof(ctx->chat_id), "bench_%d_%zu", bc->count, bc->bytes);
+    ctx->buf = malloc(MIMI_LLM_STREAM_BUF_SIZE);
+
+    session_clear(ctx->chat_id);
+    session_set_format(SESSION_VARIANT_FORMAT(bc->variant));
+    char *text = malloc(bc->bytes + 1);
+    for (int i = 0; i < bc->count; i++) {
+        corpus_text(text, bc->bytes, (unsigned)i);
+        session_append(ctx->chat_id, (i % 2) ? "assistant" : "user", text);
+    }
+    free(text);
+    bc->footprint = session_footprint(ctx->chat_id);
+    bc->ctx = ctx;
+}
+
+static void session_run(bench_case_t *bc)
+{
+    session_ctx_t *ctx = bc->ctx;
+    if (!(bc->variant & SESSION_CACHED)) session_cache_flush();
+    session_get_history_json(ctx->chat_id, ctx->buf, MIMI_LLM_STREAM_BUF_SIZE,
+                             MIMI_AGENT_HISTORY_RECORDS);
+    bench_consume(ctx->buf);
+}
+
+static void session_teardown(bench_case_t *bc)
+{
+    session_ctx_t *ctx = bc->ctx;
+    session_clear(ctx->chat_id);
+    session_set_format(SESSION_FORMAT_JSONL);
+    free(ctx->buf);
+    free(ctx);
+}
+
+/* One op: APPEND_TURNS turns in each of count chats, then the window's flush */
+#define APPEND_TURNS 4
+
+typedef struct {
+    char chat_ids[MIMI_SESSION_WB_CHATS][32];
+    char *user;
+    char *assistant;
+} append_ctx_t;
+
+static void append_setup(bench_case_t *bc)
+{
+    append_ctx_t *ctx = calloc(1, sizeof(*ctx));
+    for (int i = 0; i < bc->count; i++) {
+        snprintf(ctx->chat_ids[i], sizeof(ctx->chat_ids[i]), "append_%d", i);
+        session_clear(ctx->chat_ids[i]);
+    }
+    ctx->user = corpus_text_alloc(bc->bytes, 1);
+    ctx->assistant = corpus_text_alloc(bc->bytes, 2);
+    session_set_sync((session_sync_t)bc->variant);
+    bc->ctx = ctx;
+}
+
+static void append_run(bench_case_t *bc)
+{
+    append_ctx_t *ctx = bc->ctx;
+    for (int t = 0; t < APPEND_TURNS; t++) {
+        for (int i = 0; i < bc->count; i++) {
+            session_append(ctx->chat_ids[i], "user", ctx->user);
+            session_append(ctx->chat_ids[i], "assistant", ctx->assistant);
+            session_commit(ctx->chat_ids[i]);
+        }
+    }
+    session_flush();
+}
+
+static void append_teardown(bench_case_t *bc)
+{
+    append_ctx_t *ctx = bc->ctx;
+    session_set_sync(MIMI_SESSION_SYNC_DEFAULT);
+    for (int i = 0; i < bc->count; i++) session_clear(ctx->chat_ids[i]);
+    free(ctx->user);
+    free(ctx->assistant);
+    free(ctx);
+}
+
+#define APPEND_CASE(n, c, b, v) \
+    { .name = n, .setup = append_setup, .run = append_run, \
+      .teardown = append_teardown, .count = c, .bytes = b, .variant = v }
+
+#define SESSION_CASE(n, c, b, v) \
+    { .name = n, .setup = session_setup, .run = session_run, \
+      .teardown = session_teardown, .count = c, .bytes = b, .variant = v }
+
+static bench_case_t s_cases[] = {
+    SESSION_CASE("session_history/lines=20,msg=120B",    20,   120,  SESSION_COLD),
+    SESSION_CASE("session_history/lines=200,msg=120B",   200,  120,  SESSION_COLD),
+    SESSION_CASE("session_history/lines=2000,msg=120B",  2000, 120,  SESSION_COLD),
+    SESSION_CASE("session_history/lines=20,msg=1500B",   20,   1500, SESSION_COLD),
+    SESSION_CASE("session_history_bin/lines=200,msg=120B", 200, 120,
+                 SESSION_COLD | SESSION_FMT(SESSION_FORMAT_BIN)),
+    SESSION_CASE("session_history_bin/lines=20,msg=1500B", 20,  1500,
+                 SESSION_COLD | SESSION_FMT(SESSION_FORMAT_BIN)),
+    SESSION_CASE("session_history_lz/lines=200,msg=120B",  200, 120,
+                 SESSION_COLD | SESSION_FMT(SESSION_FORMAT_BIN_LZ)),
+    SESSION_CASE("session_history_lz/lines=20,msg=1500B",  20,  1500,
+                 SESSION_COLD | SESSION_FMT(SESSION_FORMAT_BIN_LZ)),
+    SESSION_CASE("session_history_cached/lines=200,msg=120B", 200, 120,  SESSION_CACHED),
+    SESSION_CASE("session_history_cached/lines=20,msg=1500B", 20,  1500, SESSION_CACHED),
+    APPEND_CASE("session_append_always/chats=8,msg=120B",    8, 120, SESSION_SYNC_ALWAYS),
+    APPEND_CASE("session_append_turn/chats=8,msg=120B",      8, 120, SESSION_SYNC_TURN),
+    APPEND_CASE("session_append_interval/chats=8,msg=120B",  8, 120, SESSION_SYNC_INTERVAL),
+};
+
+void bench_register_session(void)
+{
+    for (size_t i = 0; i < sizeof(s_cases) / sizeof(s_cases[0]); i++) bench_add(&s_cases[i]);
+}
@@ -0,0 +1,326 @@
+/* Whole-file rewrites of a MEMORY.md-sized file, as memory_write_long_term()
+ * and the write_file / edit_file tools do. Variant 0 rewrites the file in
+ * place with fopen("w"), as before the write-ahead log; variant N logs each
+ * version with storage_write_file() and checkpoints every N writes, so the
+ * checkpoint cost is spread over the writes it covers. The flash wear
+ * table shows what each costs in pages programmed and blocks erased.
+ *
+ * fs_list lists the skills directory, as the skills summary does every
+ * turn, on a partition that also holds many session segments: cold on
+ * SPIFFS (every file on the partition is visited), cold on LittleFS (only
+ * the directory) and from the directory cache.
+ *
+ * fs_read reads the files a turn reads (SOUL.md, USER.md, MEMORY.md,
+ * HEARTBEAT.md, cron.json, today's note) through storage_fopen(), with the
+ * read cache dropped before every pass (cold) or warm.
+ *
+ * fs_edit streams a MEMORY.md-sized file through edit_file's engine with
+ * a replace-all and an anchored edit; its heap use stays one window
+ * whatever the file size.
+ *
+ * fs_page finds the start of line 1500 of a 64KB, 1800-line note, as
+ * read_file does for a page given by start_line: by counting newlines from
+ * the top (scan) or from the nearest mark of the line index (indexed). */
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bench.h"
+#include "bench_corpus.h"
+#include "mimi_config.h"
+#include "storage/storage_cache.h"
+#include "storage/storage_fs.h"
+#include "storage/storage_log.h"
+#include "tools/file_edit.h"
+#include "tools/line_index.h"
+
+typedef struct {
+    char *text;
+    unsigned seq;
+} rewrite_ctx_t;
+
+static void rewrite_setup(bench_case_t *bc)
+{
+    rewrite_ctx_t *ctx = calloc(1, sizeof(*ctx));
+    ctx->text = malloc(bc->bytes + 1);
+    corpus_text(ctx->text, bc->bytes, 7);
+    if (bc->variant) storage_log_init();
+
+    FILE *f = fopen(MIMI_MEMORY_FILE, "w");
+    if (f) {
+        fwrite(ctx->text, 1, bc->bytes, f);
+        fclose(f);
+    }
+    bc->footprint = bc->bytes;
+    bc->ctx = ctx;
+}
+
+static void rewrite_run(bench_case_t *bc)
+{
+    rewrite_ctx_t *ctx = bc->ctx;
+
+    /* A small edit per version, like an agent updating one fact */
+    ctx->seq++;
+    ctx->text[ctx->seq % bc->bytes] = (char)('a' + ctx->seq % 26);
+
+    if (bc->variant == 0) {
+        FILE *f = fopen(MIMI_MEMORY_FILE, "w");
+        if (!f) return;
+        fwrite(ctx->text, 1, bc->bytes, f);
+        fclose(f);
+        return;
+    }
+    storage_write_file(MIMI_MEMORY_FILE, ctx->text, bc->bytes);
+    if (ctx->seq % (unsigned)bc->variant == 0) storage_checkpoint();
+}
+
+static void rewrite_teardown(bench_case_t *bc)
+{
+    rewrite_ctx_t *ctx = bc->ctx;
+    if (bc->variant) storage_checkpoint();
+    remove(MIMI_MEMORY_FILE);
+    free(ctx->text);
+    free(ctx);
+}
+
+/* ── Directory listing ───────────────────────────────────────── */
+
+#define LIST_SKILLS 10
+#define LIST_NOTES  30
+
+enum { LIST_COLD = 1 << 1 };    /* | storage_fs_backend_t */
+
+static void list_create(const char *path)
+{
+    FILE *f = storage_open(path, "w");
+    if (f) {
+        fputs("# x\n", f);
+        fclose(f);
+    }
+}
+
+static void list_files(bench_case_t *bc, bool create)
+{
+    char path[96];
+    for (int i = 0; i < bc->count; i++) {
+        snprintf(path, sizeof(path), "%s/tg_%d.%d.jsonl", MIMI_SPIFFS_SESSION_DIR, 900000 + i / 4, i % 4);
+        create ? list_create(path) : (void)storage_remove(path);
+    }
+    for (int i = 0; i < LIST_NOTES; i++) {
+        snprintf(path, sizeof(path), "%s/2026-01-%02d.md", MIMI_SPIFFS_MEMORY_DIR, i + 1);
+        create ? list_create(path) : (void)storage_remove(path);
+    }
+    for (int i = 0; i < LIST_SKILLS; i++) {
+        snprintf(path, sizeof(path), "%sbench-%d.md", MIMI_SKILLS_PREFIX, i);
+        create ? list_create(path) : (void)storage_remove(path);
+    }
+}
+
+static void list_setup(bench_case_t *bc)
+{
+    storage_fs_backend_t backend = (storage_fs_backend_t)(bc->variant & 1);
+    if (storage_fs_backend() != backend) storage_fs_migrate(backend, NULL, NULL);
+    list_files(bc, true);
+    storage_fs_cache_reset();
+}
+
+static void list_run(bench_case_t *bc)
+{
+    if (bc->variant & LIST_COLD) storage_fs_cache_reset();
+    storage_dir_t *dir = storage_opendir(MIMI_SKILLS_DIR);
+    int n = 0;
+    while (storage_readdir(dir)) n++;
+    storage_closedir(dir);
+    bench_consume(&n);
+}
+
+static void list_teardown(bench_case_t *bc)
+{
+    list_files(bc, false);
+    if (storage_fs_backend() != STORAGE_FS_SPIFFS) storage_fs_migrate(STORAGE_FS_SPIFFS, NULL, NULL);
+}
+
+/* ── Hot file reads ──────────────────────────────────────────── */
+
+static const char *const s_hot_files[] = {
+    MIMI_SOUL_FILE, MIMI_USER_FILE, MIMI_MEMORY_FILE, MIMI_HEARTBEAT_FILE, MIMI_CRON_FILE,
+    MIMI_SPIFFS_MEMORY_DIR "/2026-01-15.md",
+};
+#define HOT_FILES (sizeof(s_hot_files) / sizeof(s_hot_files[0]))
+
+static void read_setup(bench_case_t *bc)
+{
+    storage_cache_init();
+    char *text = malloc(bc->bytes + 1);
+    corpus_text(text, bc->bytes, 11);
+    for (size_t i = 0; i < HOT_FILES; i++) {
+        FILE *f = storage_open(s_hot_files[i], "w");
+        if (!f) continue;
+        fwrite(text, 1, bc->bytes, f);
+        fclose(f);
+    }
+    free(text);
+    storage_cache_reset();
+    bc->footprint = bc->bytes * HOT_FILES;
+    bc->ctx = malloc(bc->bytes);
+}
+
+static void read_run(bench_case_t *bc)
+{
+    if (bc->variant == 0) storage_cache_reset();
+    size_t total = 0;
+    for (size_t i = 0; i < HOT_FILES; i++) {
+        FILE *f = storage_fopen(s_hot_files[i]);
+        if (!f) continue;
+        total += fread(bc->ctx, 1, bc->bytes, f);
+        fclose(f);
+    }
+    bench_consume(&total);
+}
+
+static void read_teardown(bench_case_t *bc)
+{
+    for (size_t i = 0; i < HOT_FILES; i++) storage_remove(s_hot_files[i]);
+    storage_cache_reset();
+    free(bc->ctx);
+}
+
+#define READ_CASE(n, b, v) \
+    { .name = n, .setup = read_setup, .run = read_run, \
+      .teardown = read_teardown, .bytes = b, .variant = v }
+
+/* ── Streamed edits ──────────────────────────────────────────── */
+
+static void edit_setup(bench_case_t *bc)
+{
+    char *text = malloc(bc->bytes + 1);
+    corpus_text(text, bc->bytes, 13);
+    FILE *f = storage_open(MIMI_MEMORY_FILE, "w");
+    if (f) {
+        fwrite(text, 1, bc->bytes, f);
+        fclose(f);
+    }
+    free(text);
+    bc->footprint = bc->bytes;
+}
+
+static bool edit_count(const char *data, size_t len, void *arg)
+{
+    (void)data;
+    *(size_t *)arg += len;
+    return true;
+}
+
+static void edit_run(bench_case_t *bc)
+{
+    (void)bc;
+    file_edit_op_t ops[] = {
+        { .find = "the ", .replace = "a ", .all = true },
+        { .find = "and", .replace = "&", .after = "\n\n" },
+    };
+    size_t out = 0;
+    FILE *f = storage_fopen(MIMI_MEMORY_FILE);
+    if (!f) return;
+    file_edit_run(f, ops, 2, edit_count, &out);
+    fclose(f);
+    bench_consume(&out);
+}
+
+static void edit_teardown(bench_case_t *bc)
+{
+    (void)bc;
+    storage_remove(MIMI_MEMORY_FILE);
+}
+
+/* ── Paged reads ─────────────────────────────────────────────── */
+
+#define PAGE_LINE 1500
+
+static void page_setup(bench_case_t *bc)
+{
+    storage_cache_init();
+    line_index_init();
+    char *text = malloc(bc->bytes + 1);
+    corpus_text(text, bc->bytes, 17);
+    /* Break the text into lines of about 36 bytes */
+    for (size_t i = 0, col = 0; i < bc->bytes; i++, col++) {
+        if (text[i] == ' ' && col >= 32) {
+            text[i] = '\n';
+            col = 0;
+        }
+    }
+    FILE *f = storage_open(MIMI_MEMORY_FILE, "w");
+    if (f) {
+        fwrite(text, 1, bc->bytes, f);
+        fclose(f);
+    }
+    free(text);
+    bc->footprint = bc->bytes;
+    bc->ctx = malloc(1024);
+}
+
+static void page_run(bench_case_t *bc)
+{
+    char *buf = bc->ctx;
+    uint32_t line = 1;
+    size_t offset = 0;
+    if (bc->variant) {
+        line_index_pos_t pos;
+        if (line_index_from_line(MIMI_MEMORY_FILE, PAGE_LINE, &pos) != ESP_OK) return;
+        line = pos.line;
+        offset = pos.offset;
+    }
+    FILE *f = storage_fopen(MIMI_MEMORY_FILE);
+    if (!f) return;
+    fseek(f, (long)offset, SEEK_SET);
+    size_t n, base = offset;
+    while (line < PAGE_LINE && (n = fread(buf, 1, 1024, f)) > 0) {
+        for (const char *p = buf; line < PAGE_LINE && (p = memchr(p, '\n', buf + n - p)) != NULL; p++) {
+            line++;
+            offset = base + (size_t)(p - buf) + 1;
+        }
+        base += n;
+    }
+    fclose(f);
+    bench_consume(&offset);
+}
+
+static void page_teardown(bench_case_t *bc)
+{
+    free(bc->ctx);
+    storage_remove(MIMI_MEMORY_FILE);
+}
+
+#define LIST_CASE(n, c, v) \
+    { .name = n, .setup = list_setup, .run = list_run, \
+      .teardown = list_teardown, .count = c, .variant = v }
+
+#define PAGE_CASE(n, b, v) \
+    { .name = n, .setup = page_setup, .run = page_run, \
+      .teardown = page_teardown, .bytes = b, .variant = v }
+
+#define REWRITE_CASE(n, b, v) \
+    { .name = n, .setup = rewrite_setup, .run = rewrite_run, \
+      .teardown = rewrite_teardown, .bytes = b, .variant = v }
+
+static bench_case_t s_cases[] = {
+    REWRITE_CASE("fs_rewrite/direct,4KB",       4096, 0),
+    REWRITE_CASE("fs_rewrite/journal,4KB,ckpt=1", 4096, 1),
+    REWRITE_CASE("fs_rewrite/journal,4KB,ckpt=6", 4096, 6),
+    LIST_CASE("fs_list/spiffs,cold,files=240",   200, STORAGE_FS_SPIFFS | LIST_COLD),
+    LIST_CASE("fs_list/littlefs,cold,files=240", 200, STORAGE_FS_LITTLEFS | LIST_COLD),
+    LIST_CASE("fs_list/cached,files=240",        200, STORAGE_FS_SPIFFS),
+    READ_CASE("fs_read/cold,6x2KB",              2048, 0),
+    READ_CASE("fs_read/cached,6x2KB",            2048, 1),
+    { .name = "fs_edit/stream,2 edits,64KB", .setup = edit_setup, .run = edit_run,
+      .teardown = edit_teardown, .bytes = 64 * 1024 },
+    PAGE_CASE("fs_page/scan,line 1500,64KB",     64 * 1024, 0),
+    PAGE_CASE("fs_page/indexed,line 1500,64KB",  64 * 1024, 1),
+};
+
+void bench_register_storage(void)
+{
+    for (size_t i = 0; i < sizeof(s_cases) / sizeof(s_cases[0]); i++) bench_add(&s_cases[i]);
+}
@@ -0,0 +1,106 @@
+/* telegram_bot.c process_updates(): getUpdates parse + dedup + bus push.
+ *
+ * The tg_e2e cases follow each message on through the bus the way a turn
+ * does: the agent pops it, replies with a buffer the LLM client allocated,
+ * and the dispatcher pops and releases the reply. Their allocs and bytes
+ * per op are the bus's cost per message end to end, plus the parse and
+ * the reply buffer. */
+
+#include "channels/telegram/telegram_bot.c"
+
+#include "bench.h"
+#include "bench_corpus.h"
+
+static void updates_setup(bench_case_t *bc)
+{
+    cJSON *root = cJSON_CreateObject();
+    cJSON_AddBoolToObject(root, "ok", true);
+    cJSON *result = cJSON_AddArrayToObject(root, "result");
+    char *text = malloc(bc->bytes + 1);
+
+    for (int i = 0; i < bc->count; i++) {
+        corpus_text(text, bc->bytes, (unsigned)i);
+        cJSON *u = cJSON_CreateObject();
+        cJSON_AddNumberToObject(u, "update_id", 500000000 + i);
+        cJSON *m = cJSON_AddObjectToObject(u, "message");
+        cJSON_AddNumberToObject(m, "message_id", 1000 + i);
+        cJSON *from = cJSON_AddObjectToObject(m, "from");
+        cJSON_AddNumberToObject(from, "id", 123456789);
+        cJSON_AddBoolToObject(from, "is_bot", false);
+        cJSON_AddStringToObject(from, "first_name", "Mimi");
+        cJSON_AddStringToObject(from, "language_code", "en");
+        cJSON *chat = cJSON_AddObjectToObject(m, "chat");
+        cJSON_AddNumberToObject(chat, "id", 123456789);
+        cJSON_AddStringToObject(chat, "first_name", "Mimi");
+        cJSON_AddStringToObject(chat, "type", "private");
+        cJSON_AddNumberToObject(m, "date", 1739000000 + i);
+        cJSON_AddStringToObject(m, "text", text);
+        cJSON_AddItemToArray(result, u);
+    }
+    free(text);
+    bc->ctx = cJSON_PrintUnformatted(root);
+    cJSON_Delete(root);
+}
+
+static void updates_run(bench_case_t *bc)
+{
+    /* Fresh poll state so every op processes the whole batch; the offset
+     * bookkeeping is pinned so no NVS write happens inside the loop. */
+    s_update_offset = 0;
+    s_last_saved_offset = INT64_MAX / 2;
+    s_last_offset_save_us = INT64_MAX / 2;
+    memset(s_seen_msg_keys, 0, sizeof(s_seen_msg_keys));
+    s_seen_msg_idx = 0;
+
+    process_updates(bc->ctx);
+
+    mimi_msg_t msg;
+    while (message_bus_pop_inbound(&msg, 0) == ESP_OK) mimi_msg_release(&msg);
+}
+
+static void e2e_run(bench_case_t *bc)
+{
+    s_update_offset = 0;
+    s_last_saved_offset = INT64_MAX / 2;
+    s_last_offset_save_us = INT64_MAX / 2;
+    memset(s_seen_msg_keys, 0, sizeof(s_seen_msg_keys));
+    s_seen_msg_idx = 0;
+
+    process_updates(bc->ctx);
+
+    mimi_msg_t in, out;
+    while (message_bus_pop_inbound(&in, 0) == ESP_OK) {
+        char *reply = malloc(mimi_msg_len(&in) + 1);
+        memcpy(reply, mimi_msg_text(&in), mimi_msg_len(&in) + 1);
+        mimi_msg_reply(&out, &in, mimi_payload_adopt(reply));
+        message_bus_push_outbound(&out);
+        mimi_msg_release(&in);
+    }
+    while (message_bus_pop_outbound(&out, 0) == ESP_OK) mimi_msg_release(&out);
+}
+
+static void updates_teardown(bench_case_t *bc)
+{
+    free(bc->ctx);
+}
+
+#define UPDATES_CASE(n, c, b) \
+    { .name = n, .setup = updates_setup, .run = updates_run, \
+      .teardown = updates_teardown, .count = c, .bytes = b }
+
+/* Batches stay within MIMI_BUS_INBOUND_LEN so pushes never block */
+static bench_case_t s_cases[] = {
+    UPDATES_CASE("tg_process_updates/updates=1,text=100B",   1,  100),
+    UPDATES_CASE("tg_process_updates/updates=8,text=100B",   8,  100),
+    UPDATES_CASE("tg_process_updates/updates=16,text=100B",  16, 100),
+    UPDATES_CASE("tg_process_updates/updates=16,text=2000B", 16, 2000),
+    { .name = "tg_e2e/update to reply,text=100B", .setup = updates_setup, .run = e2e_run,
+      .teardown = updates_teardown, .count = 1, .bytes = 100 },
+    { .name = "tg_e2e/update to reply,text=2000B", .setup = updates_setup, .run = e2e_run,
+      .teardown = updates_teardown, .count = 1, .bytes = 2000 },
+};
+
+void bench_register_telegram(void)
+{
+    for (size_t i = 0; i < sizeof(s_cases) / sizeof(s_cases[0]); i++) bench_add(&s_cases[i]);
+}
@@ -0,0 +1,516 @@
+/* JSON hot-path microbenchmarks for the host build.
+ *
+ *   mimi_json_bench [--filter SUBSTR] [--min-time-ms N] [--reps N]
+ *                   [--baseline FILE] [--write-baseline FILE] [--json FILE]
+ *                   [--time-threshold F] [--alloc-threshold F]
+ *
+ * With --baseline, exits non-zero when any case is slower than
+ * baseline * (1 + time-threshold), with time normalised against a fixed
+ * calibration workload, or allocates more (count or bytes) than
+ * baseline * (1 + alloc-threshold). Allocation checks only apply when the
+ * baseline was recorded against the same cJSON version, since allocation
+ * patterns are a property of the library. Flash footprint, where a case
+ * reports one, is held to the allocation threshold as well, and so are
+ * modeled flash erases (host_flash.h) for cases that write to SPIFFS. */
+
+#include <errno.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "bench.h"
+#include "cJSON.h"
+#include "esp_log.h"
+#include "host_flash.h"
+#include "nvs_flash.h"
+#include "mimi_config.h"
+#include "bus/message_bus.h"
+#include "memory/session_mgr.h"
+#include "storage/storage_stats.h"
+
+/* ── Allocation counting ───────────────────────────────────────── */
+
+/* The counters replace malloc and friends over glibc's __libc_* entry
+   points, which bypasses the sanitizer's allocator and makes an ASan
+   build (MIMI_HOST_ASAN) abort in free(); such a build counts nothing. */
+#if defined(__SANITIZE_ADDRESS__)
+#define BENCH_COUNT_ALLOCS 0
+#elif defined(__has_feature)
+#if __has_feature(address_sanitizer)
+#define BENCH_COUNT_ALLOCS 0
+#endif
+#endif
+#ifndef BENCH_COUNT_ALLOCS
+#define BENCH_COUNT_ALLOCS 1
+#endif
+
+static __thread bool t_counting;
+static __thread uint64_t t_allocs;
+static __thread uint64_t t_alloc_bytes;
+
+#if BENCH_COUNT_ALLOCS
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t n, size_t size);
+extern void *__libc_realloc(void *ptr, size_t size);
+extern void __libc_free(void *ptr);
+
+void *malloc(size_t size)
+{
+    if (t_counting) {
+        t_allocs++;
+        t_alloc_bytes += size;
+    }
+    return __libc_malloc(size);
+}
+
+void *calloc(size_t n, size_t size)
+{
+    if (t_counting) {
+        t_allocs++;
+        t_alloc_bytes += n * size;
+    }
+    return __libc_calloc(n, size);
+}
+
+void *realloc(void *ptr, size_t size)
+{
+    if (t_counting) {
+        t_allocs++;
+        t_alloc_bytes += size;
+    }
+    return __libc_realloc(ptr, size);
+}
+
+void free(void *ptr)
+{
+    __libc_free(ptr);
+}
+#endif
+
+/* ── Registry ──────────────────────────────────────────────────── */
+
+#define BENCH_MAX_CASES 64
+
+typedef struct {
+    bench_case_t *bc;
+    double ns_per_op;
+    double calib_ns;        /* reference workload timed alongside the case */
+    double allocs_per_op;
+    double bytes_per_op;
+    double pages_per_op;    /* modeled flash pages programmed */
+    double erases_per_op;   /* modeled 4 KB block erases */
+    uint64_t iters;
+    bool ran;
+} bench_result_t;
+
+static bench_result_t s_results[BENCH_MAX_CASES];
+static int s_case_count = 0;
+
+void bench_add(bench_case_t *bc)
+{
+    if (s_case_count < BENCH_MAX_CASES) {
+        s_results[s_case_count++].bc = bc;
+    }
+}
+
+/* ── Runner ────────────────────────────────────────────────────── */
+
+typedef struct {
+    const char *filter;
+    double min_time_ms;
+    int reps;
+    const char *baseline;
+    const char *write_baseline;
+    const char *json_out;
+    double time_threshold;
+    double alloc_threshold;
+} bench_opts_t;
+
+/* Thread CPU time: immune to preemption on shared CI runners */
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static uint64_t time_iters(bench_case_t *bc, uint64_t iters)
+{
+    uint64_t t0 = now_ns();
+    for (uint64_t i = 0; i < iters; i++) bc->run(bc);
+    return now_ns() - t0;
+}
+
+/* Fixed reference workload. Regression checks compare ns_per_op / calib_ns
+ * so machine speed and frequency drift during a run cancel out. */
+#define CALIB_BUF_SIZE  (64 * 1024)
+
+static uint64_t calib_unit(void)
+{
+    static uint8_t buf[CALIB_BUF_SIZE];
+    uint64_t h = 1469598103934665603ULL;
+    for (size_t i = 0; i < CALIB_BUF_SIZE; i++) {
+        buf[i] = (uint8_t)(buf[i] + i + (h >> 56));
+        h = (h ^ buf[i]) * 1099511628211ULL;
+    }
+    return h;
+}
+
+static double calib_ns(void)
+{
+    double best = 0;
+    for (int i = 0; i < 8; i++) {
+        uint64_t t0 = now_ns();
+        bench_consume((void *)(uintptr_t)calib_unit());
+        double ns = (double)(now_ns() - t0);
+        if (i == 0 || ns < best) best = ns;
+    }
+    return best;
+}
+
+static void run_case(bench_result_t *r, const bench_opts_t *opts)
+{
+    bench_case_t *bc = r->bc;
+    if (bc->setup) bc->setup(bc);
+
+    /* Warm caches and lazy init, then size a repetition to min_time/reps */
+    bc->run(bc);
+    uint64_t iters = 1;
+    uint64_t target_ns = (uint64_t)(opts->min_time_ms * 1e6 / opts->reps);
+    for (;;) {
+        uint64_t ns = time_iters(bc, iters);
+        if (ns >= target_ns / 4 || iters >= (1u << 24)) {
+            double per_op = (double)ns / (double)iters;
+            uint64_t want = per_op > 0 ? (uint64_t)((double)target_ns / per_op) : iters;
+            iters = want > 0 ? want : 1;
+            break;
+        }
+        iters *= 4;
+    }
+
+    double best = 0, calib = 0;
+    for (int rep = 0; rep < opts->reps; rep++) {
+        double c = calib_ns();
+        double per_op = (double)time_iters(bc, iters) / (double)iters;
+        if (rep == 0 || per_op < best) best = per_op;
+        if (rep == 0 || c < calib) calib = c;
+    }
+
+    /* Separate counted pass so interposer bookkeeping stays out of timing */
+    uint64_t counted = iters < 64 ? iters : 64;
+    t_allocs = 0;
+    t_alloc_bytes = 0;
+    host_flash_wear_t w0, w1;
+    host_flash_get_wear(&w0);
+    t_counting = true;
+    for (uint64_t i = 0; i < counted; i++) bc->run(bc);
+    t_counting = false;
+    host_flash_get_wear(&w1);
+
+    r->ns_per_op = best;
+    r->calib_ns = calib;
+    r->allocs_per_op = (double)t_allocs / (double)counted;
+    r->bytes_per_op = (double)t_alloc_bytes / (double)counted;
+    r->pages_per_op = (double)(w1.pages_programmed - w0.pages_programmed) / (double)counted;
+    r->erases_per_op = (double)(w1.pages_obsoleted - w0.pages_obsoleted) /
+                       HOST_FLASH_PAGES_PER_BLOCK / (double)counted;
+    r->iters = iters;
+    r->ran = true;
+
+    if (bc->teardown) bc->teardown(bc);
+}
+
+static const char *cjson_version(void)
+{
+#ifdef CJSON_VERSION_MAJOR
+    static char ver[32];
+    snprintf(ver, sizeof(ver), "%d.%d.%d",
+             CJSON_VERSION_MAJOR, CJSON_VERSION_MINOR, CJSON_VERSION_PATCH);
+    return ver;
+#else
+    return "unknown";
+#endif
+}
+
+/* ── Baseline I/O ──────────────────────────────────────────────── */
+
+static char *read_file(const char *path)
+{
+    FILE *f = fopen(path, "rb");
+    if (!f) return NULL;
+    fseek(f, 0, SEEK_END);
+    long len = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    char *buf = malloc((size_t)len + 1);
+    if (buf && fread(buf, 1, (size_t)len, f) == (size_t)len) {
+        buf[len] = '\0';
+    } else {
+        free(buf);
+        buf = NULL;
+    }
+    fclose(f);
+    return buf;
+}
+
+static int write_results(const char *path)
+{
+    cJSON *root = cJSON_CreateObject();
+    cJSON_AddStringToObject(root, "cjson_version", cjson_version());
+    cJSON *benches = cJSON_AddObjectToObject(root, "benchmarks");
+    for (int i = 0; i < s_case_count; i++) {
+        bench_result_t *r = &s_results[i];
+        if (!r->ran) continue;
+        cJSON *b = cJSON_AddObjectToObject(benches, r->bc->name);
+        cJSON_AddNumberToObject(b, "ns_per_op", (double)(int64_t)(r->ns_per_op + 0.5));
+        cJSON_AddNumberToObject(b, "calib_ns", (double)(int64_t)(r->calib_ns + 0.5));
+        cJSON_AddNumberToObject(b, "allocs_per_op", (double)(int64_t)(r->allocs_per_op * 10 + 0.5) / 10);
+        cJSON_AddNumberToObject(b, "bytes_per_op", (double)(int64_t)(r->bytes_per_op + 0.5));
+        if (r->bc->footprint) {
+            cJSON_AddNumberToObject(b, "footprint_bytes", (double)r->bc->footprint);
+        }
+        if (r->pages_per_op > 0) {
+            cJSON_AddNumberToObject(b, "erases_per_op", (double)(int64_t)(r->erases_per_op * 1000 + 0.5) / 1000);
+        }
+    }
+    char *json = cJSON_Print(root);
+    cJSON_Delete(root);
+
+    FILE *f = fopen(path, "w");
+    if (!f || !json) {
+        fprintf(stderr, "cannot write %s\n", path);
+        if (f) fclose(f);
+        free(json);
+        return -1;
+    }
+    fprintf(f, "%s\n", json);
+    fclose(f);
+    free(json);
+    return 0;
+}
+
+static double number_field(cJSON *obj, const char *name)
+{
+    cJSON *v = cJSON_GetObjectItem(obj, name);
+    return cJSON_IsNumber(v) ? v->valuedouble : -1;
+}
+
+/* Returns the number of regressions, or -1 if the baseline is unreadable */
+static int compare_baseline(const bench_opts_t *opts)
+{
+    char *raw = read_file(opts->baseline);
+    cJSON *root = raw ? cJSON_Parse(raw) : NULL;
+    free(raw);
+    cJSON *benches = root ? cJSON_GetObjectItem(root, "benchmarks") : NULL;
+    if (!benches) {
+        fprintf(stderr, "cannot read baseline %s\n", opts->baseline);
+        cJSON_Delete(root);
+        return -1;
+    }
+
+    cJSON *ver = cJSON_GetObjectItem(root, "cjson_version");
+    bool check_allocs = cJSON_IsString(ver) && strcmp(ver->valuestring, cjson_version()) == 0;
+    if (!check_allocs) {
+        printf("\nnote: baseline cJSON %s != linked %s, allocation checks skipped\n",
+               cJSON_IsString(ver) ? ver->valuestring : "?", cjson_version());
+    }
+
+    int regressions = 0;
+    printf("\n%-44s %10s %10s %10s %10s\n", "vs baseline", "time*", "allocs", "bytes", "flash");
+    for (int i = 0; i < s_case_count; i++) {
+        bench_result_t *r = &s_results[i];
+        if (!r->ran) continue;
+        cJSON *b = cJSON_GetObjectItem(benches, r->bc->name);
+        if (!b) {
+            printf("%-44s %10s\n", r->bc->name, "(new)");
+            continue;
+        }
+
+        double base_ns = number_field(b, "ns_per_op");
+        double base_calib = number_field(b, "calib_ns");
+        double base_allocs = number_field(b, "allocs_per_op");
+        double base_bytes = number_field(b, "bytes_per_op");
+        double base_flash = number_field(b, "footprint_bytes");
+        double base_erases = number_field(b, "erases_per_op");
+        double dt = 0;
+        if (base_ns > 0 && base_calib > 0 && r->calib_ns > 0) {
+            dt = (r->ns_per_op / r->calib_ns) / (base_ns / base_calib) - 1;
+        }
+        double da = base_allocs > 0 ? r->allocs_per_op / base_allocs - 1 : 0;
+        double db = base_bytes > 0 ? r->bytes_per_op / base_bytes - 1 : 0;
+
+        bool slow = dt > opts->time_threshold;
+        bool fat = check_allocs &&
+                   (r->allocs_per_op > base_allocs * (1 + opts->alloc_threshold) + 0.5 ||
+                    r->bytes_per_op > base_bytes * (1 + opts->alloc_threshold) + 16);
+        char flash[16] = "";
+        if (base_flash > 0 && r->bc->footprint) {
+            double df = (double)r->bc->footprint / base_flash - 1;
+            snprintf(flash, sizeof(flash), "%+9.1f%%", df * 100);
+            if (df > opts->alloc_threshold) fat = true;
+        }
+        if (base_erases > 0 && r->erases_per_op > base_erases * (1 + opts->alloc_threshold) + 0.01) {
+            fat = true;
+        }
+        printf("%-44s %+9.1f%% %+9.1f%% %+9.1f%% %10s%s\n", r->bc->name,
+               dt * 100, da * 100, db * 100, flash, (slow || fat) ? "  REGRESSION" : "");
+        if (slow || fat) regressions++;
+    }
+    printf("* time relative to the calibration workload timed with each case\n");
+    cJSON_Delete(root);
+    return regressions;
+}
+
+/* ── Main ──────────────────────────────────────────────────────── */
+
+static void usage(const char *argv0)
+{
+    fprintf(stderr,
+            "usage: %s [--filter SUBSTR] [--min-time-ms N] [--reps N]\n"
+            "          [--baseline FILE] [--write-baseline FILE] [--json FILE]\n"
+            "          [--time-threshold F] [--alloc-threshold F]\n", argv0);
+}
+
+static char *absolute(const char *path)
+{
+    if (!path || path[0] == '/') return path ? strdup(path) : NULL;
+    char cwd[1024];
+    if (!getcwd(cwd, sizeof(cwd))) return strdup(path);
+    size_t len = strlen(cwd) + strlen(path) + 2;
+    char *out = malloc(len);
+    snprintf(out, len, "%s/%s", cwd, path);
+    return out;
+}
+
+int main(int argc, char **argv)
+{
+    bench_opts_t opts = {
+        .min_time_ms = 300,
+        .reps = 5,
+        .time_threshold = 0.50,
+        .alloc_threshold = 0.05,
+    };
+    if (!BENCH_COUNT_ALLOCS) fprintf(stderr, "ASan build: allocations are not counted\n");
+
+    for (int i = 1; i < argc; i++) {
+        const char *a = argv[i];
+        const char *v = i + 1 < argc ? argv[i + 1] : NULL;
+        if (strcmp(a, "--filter") == 0 && v) { opts.filter = v; i++; }
+        else if (strcmp(a, "--min-time-ms") == 0 && v) { opts.min_time_ms = atof(v); i++; }
+        else if (strcmp(a, "--reps") == 0 && v) { opts.reps = atoi(v); i++; }
+        else if (strcmp(a, "--baseline") == 0 && v) { opts.baseline = absolute(v); i++; }
+        else if (strcmp(a, "--write-baseline") == 0 && v) { opts.write_baseline = absolute(v); i++; }
+        else if (strcmp(a, "--json") == 0 && v) { opts.json_out = absolute(v); i++; }
+        else if (strcmp(a, "--time-threshold") == 0 && v) { opts.time_threshold = atof(v); i++; }
+        else if (strcmp(a, "--alloc-threshold") == 0 && v) { opts.alloc_threshold = atof(v); i++; }
+        else { usage(argv[0]); return 2; }
+    }
+    if (opts.reps < 1) opts.reps = 1;
+
+    /* Scratch SPIFFS/NVS so session files never touch the caller's tree */
+    char dir[] = "/tmp/mimi_bench.XXXXXX";
+    if (!mkdtemp(dir) || chdir(dir) != 0) {
+        fprintf(stderr, "cannot create scratch dir: %s\n", strerror(errno));
+        return 2;
+    }
+    mkdir(MIMI_SPIFFS_BASE, 0755);
+    mkdir(MIMI_SPIFFS_SESSION_DIR, 0755);
+
+    esp_log_level_set("*", ESP_LOG_WARN);
+    nvs_flash_init();
+    storage_stats_init();
+    message_bus_init();
+    session_mgr_init();
+
+    bench_register_session();
+    bench_register_llm();
+    bench_register_telegram();
+    bench_register_search();
+    bench_register_memory();
+    bench_register_storage();
+    bench_register_grep();
+    bench_register_bus();
+
+    printf("cJSON %s, %d reps, %.0f ms per case\n\n", cjson_version(), opts.reps, opts.min_time_ms);
+    printf("%-44s %12s %10s %12s %10s\n", "benchmark", "ns/op", "allocs/op", "bytes/op", "iters");
+    for (int i = 0; i < s_case_count; i++) {
+        bench_result_t *r = &s_results[i];
+        if (opts.filter && !strstr(r->bc->name, opts.filter)) continue;
+        run_case(r, &opts);
+        printf("%-44s %12.0f %10.1f %12.0f %10llu\n", r->bc->name, r->ns_per_op,
+               r->allocs_per_op, r->bytes_per_op, (unsigned long long)r->iters);
+        fflush(stdout);
+    }
+
+    bool any_footprint = false;
+    for (int i = 0; i < s_case_count; i++) {
+        if (s_results[i].ran && s_results[i].bc->footprint) any_footprint = true;
+    }
+    if (any_footprint) {
+        printf("\n%-44s %12s\n", "flash footprint", "bytes");
+        for (int i = 0; i < s_case_count; i++) {
+            bench_result_t *r = &s_results[i];
+            if (r->ran && r->bc->footprint) {
+                printf("%-44s %12zu\n", r->bc->name, r->bc->footprint);
+            }
+        }
+    }
+
+    bool any_scan = false;
+    for (int i = 0; i < s_case_count; i++) {
+        if (s_results[i].ran && s_results[i].bc->scanned) any_scan = true;
+    }
+    if (any_scan) {
+        printf("\n%-44s %12s\n", "throughput", "MB/s");
+        for (int i = 0; i < s_case_count; i++) {
+            bench_result_t *r = &s_results[i];
+            if (r->ran && r->bc->scanned && r->ns_per_op > 0) {
+                printf("%-44s %12.1f\n", r->bc->name, r->bc->scanned * 1e3 / r->ns_per_op);
+            }
+        }
+    }
+
+    bool any_wear = false;
+    for (int i = 0; i < s_case_count; i++) {
+        if (s_results[i].ran && s_results[i].pages_per_op > 0) any_wear = true;
+    }
+    if (any_wear) {
+        printf("\n%-44s %12s %12s\n", "flash wear (modeled)", "pages/op", "erases/op");
+        for (int i = 0; i < s_case_count; i++) {
+            bench_result_t *r = &s_results[i];
+            if (r->ran && r->pages_per_op > 0) {
+                printf("%-44s %12.2f %12.3f\n", r->bc->name, r->pages_per_op, r->erases_per_op);
+            }
+        }
+    }
+
+    int rc = 0;
+    if (opts.json_out && write_results(opts.json_out) != 0) rc = 2;
+    if (opts.write_baseline) {
+        if (write_results(opts.write_baseline) != 0) rc = 2;
+        else printf("\nbaseline written to %s\n", opts.write_baseline);
+    }
+    if (opts.baseline) {
+        int regressions = compare_baseline(&opts);
+        if (regressions < 0) {
+            rc = 2;
+        } else if (regressions > 0) {
+            printf("\n%d regression(s) beyond thresholds (time %.0f%%, allocs %.0f%%)\n",
+                   regressions, opts.time_threshold * 100, opts.alloc_threshold * 100);
+            rc = 1;
+        } else {
+            printf("\nno regressions\n");
+        }
+    }
+
+    /* Best-effort scratch cleanup */
+    char cmd[64];
+    snprintf(cmd, sizeof(cmd), "rm -rf %s", dir);
+    if (chdir("/") == 0 && system(cmd) != 0) {
+        fprintf(stderr, "could not remove %s\n", dir);
+    }
+    return rc;
+}
@@ -0,0 +1,170 @@
+/* Linux host entry point: prepares a data directory that stands in for the
+ * SPIFFS partition and NVS, then runs the unmodified app_main(). */
+
+#include <dirent.h>
+#include <errno.h>
+#include <limits.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "mimi_config.h"
+#include "nvs_flash.h"
+#include "nvs.h"
+#include "esp_system.h"
+#include "proxy/http_vcr.h"
+#include "host_flash.h"
+#include "esp_log.h"
+
+static const char *TAG = "host";
+
+void app_main(void);
+
+/* ── Data directory ────────────────────────────────────────────── */
+
+static int mkdir_p(const char *path)
+{
+    char buf[PATH_MAX];
+    snprintf(buf, sizeof(buf), "%s", path);
+    for (char *p = buf + 1; *p; p++) {
+        if (*p == '/') {
+            *p = '\0';
+            if (mkdir(buf, 0755) != 0 && errno != EEXIST) return -1;
+            *p = '/';
+        }
+    }
+    return (mkdir(buf, 0755) == 0 || errno == EEXIST) ? 0 : -1;
+}
+
+/* Copy spiffs_data/ into the partition directory without overwriting */
+static void seed_tree(const char *src, const char *dst)
+{
+    DIR *d = opendir(src);
+    if (!d) return;
+    mkdir_p(dst);
+
+    struct dirent *e;
+    while ((e = readdir(d)) != NULL) {
+        if (e->d_name[0] == '.') continue;
+        char s[PATH_MAX], t[PATH_MAX];
+        snprintf(s, sizeof(s), "%s/%s", src, e->d_name);
+        snprintf(t, sizeof(t), "%s/%s", dst, e->d_name);
+
+        struct stat st;
+        if (stat(s, &st) != 0) continue;
+        if (S_ISDIR(st.st_mode)) {
+            seed_tree(s, t);
+            continue;
+        }
+        if (access(t, F_OK) == 0) continue;
+
+        FILE *in = fopen(s, "rb");
+        FILE *out = in ? fopen(t, "wb") : NULL;
+        if (in && out) {
+            char buf[4096];
+            size_t n;
+            while ((n = fread(buf, 1, sizeof(buf), in)) > 0) fwrite(buf, 1, n, out);
+        }
+        if (out) fclose(out);
+        if (in) fclose(in);
+    }
+    closedir(d);
+}
+
+/* ── NVS seeding ───────────────────────────────────────────────── */
+
+/* Credentials normally come from mimi_secrets.h or the serial CLI; on the
+ * host they are taken from the environment so the build never needs real
+ * keys. NVS values override build-time secrets, exactly as on the device. */
+static void seed_nvs(const char *ns, const char *key, const char *env)
+{
+    const char *value = getenv(env);
+    if (!value) return;
+
+    nvs_handle_t nvs;
+    if (nvs_open(ns, NVS_READWRITE, &nvs) != ESP_OK) return;
+    nvs_set_str(nvs, key, value);
+    nvs_commit(nvs);
+    nvs_close(nvs);
+}
+
+/* MIMI_HOST_VCR=off|record|replay selects the HTTP record/replay mode */
+static void seed_vcr(void)
+{
+    const char *mode = getenv("MIMI_HOST_VCR");
+    if (!mode) return;
+
+    const char *file = getenv("MIMI_HOST_VCR_FILE");
+    const char *pace = getenv("MIMI_HOST_VCR_PACE");
+    uint8_t m = strcmp(mode, "record") == 0 ? HTTP_VCR_RECORD
+              : strcmp(mode, "replay") == 0 ? HTTP_VCR_REPLAY
+              : HTTP_VCR_OFF;
+    nvs_handle_t nvs;
+    if (nvs_open(MIMI_NVS_VCR, NVS_READWRITE, &nvs) != ESP_OK) return;
+    nvs_set_u8(nvs, MIMI_NVS_KEY_VCR_MODE, m);
+    nvs_set_str(nvs, MIMI_NVS_KEY_VCR_FILE, file ? file : MIMI_VCR_DEFAULT_FILE);
+    nvs_set_u16(nvs, MIMI_NVS_KEY_VCR_PACE, pace ? (uint16_t)atoi(pace) : 100);
+    nvs_commit(nvs);
+    nvs_close(nvs);
+
+    /* Recording from boot starts a fresh cassette */
+    if (m == HTTP_VCR_RECORD) {
+        FILE *f = fopen(file ? file : MIMI_VCR_DEFAULT_FILE, "w");
+        if (f) fclose(f);
+    }
+}
+
+static volatile sig_atomic_t s_stop = 0;
+
+/* The main thread does the shutdown, handlers take locks */
+static void on_signal(int sig)
+{
+    s_stop = sig;
+}
+
+int main(int argc, char **argv)
+{
+    const char *data_dir = argc > 1 ? argv[1] : getenv("MIMI_HOST_DATA_DIR");
+    if (!data_dir) data_dir = "mimi_host_data";
+
+    if (mkdir_p(data_dir) != 0 || chdir(data_dir) != 0) {
+        fprintf(stderr, "Cannot use data directory %s: %s\n", data_dir, strerror(errno));
+        return 1;
+    }
+    mkdir_p(MIMI_SPIFFS_BASE);
+
+    /* Format of a fresh partition; later runs mount what it holds */
+    const char *fs = getenv("MIMI_HOST_FS");
+    if (fs && access(HOST_FS_RECORD, F_OK) != 0) host_fs_set_format(fs);
+
+    const char *seed = getenv("MIMI_HOST_SEED_DIR");
+    seed_tree(seed ? seed : MIMI_HOST_DEFAULT_SEED_DIR, MIMI_SPIFFS_BASE);
+
+    nvs_flash_init();
+    seed_nvs(MIMI_NVS_LLM,    MIMI_NVS_KEY_API_KEY,    "MIMI_HOST_API_KEY");
+    seed_nvs(MIMI_NVS_LLM,    MIMI_NVS_KEY_MODEL,      "MIMI_HOST_MODEL");
+    seed_nvs(MIMI_NVS_LLM,    MIMI_NVS_KEY_PROVIDER,   "MIMI_HOST_PROVIDER");
+    seed_nvs(MIMI_NVS_TG,     MIMI_NVS_KEY_TG_TOKEN,   "MIMI_HOST_TG_TOKEN");
+    seed_nvs(MIMI_NVS_SEARCH, MIMI_NVS_KEY_API_KEY,    "MIMI_HOST_SEARCH_KEY");
+    seed_nvs(MIMI_NVS_SEARCH, MIMI_NVS_KEY_TAVILY_KEY, "MIMI_HOST_TAVILY_KEY");
+    seed_vcr();
+
+    signal(SIGINT, on_signal);
+    signal(SIGTERM, on_signal);
+    signal(SIGPIPE, SIG_IGN);
+
+    ESP_LOGI(TAG, "Data dir: %s, upstream: %s", data_dir,
+             getenv("MIMI_HOST_UPSTREAM") ? getenv("MIMI_HOST_UPSTREAM") : "(real endpoints)");
+    app_main();
+
+    /* app_main returns once tasks are running, as on the device */
+    while (!s_stop) pause();
+
+    /* Flush what a restart would (buffered session writes) before exiting */
+    host_run_shutdown_handlers();
+    fflush(NULL);
+    _exit(0);
+}
@@ -0,0 +1,415 @@
+#!/usr/bin/env python3
+"""Mock cloud upstreams for the MimiClaw host build.
+
+One HTTP server stands in for every API the firmware talks to; the host
+HTTP client rewrites all request URLs to MIMI_HOST_UPSTREAM and keeps the
+path, so routing here is by path alone:
+
+  POST /v1/messages               Anthropic Messages API
+  POST /v1/chat/completions       OpenAI Chat Completions API
+  GET  /bot<token>/getUpdates     Telegram long poll (load generator)
+  POST /bot<token>/sendMessage    Telegram send (latency sink)
+  POST /search                    Tavily search
+  POST /v1/embeddings             OpenAI embeddings (hashed bag of words)
+  GET  /res/v1/web/search         Brave search
+  HEAD /                          Date header for the get_current_time tool
+  GET  /stats                     JSON throughput / latency summary
+  POST /reset                     clear counters and regenerate the load
+
+Load model: --chats distinct Telegram chats send --messages messages in
+total at --rate messages/s (0 = all at once). Every --tool-every'th message
+asks for a web search, which makes the mock LLM answer with a tool_use
+round trip. With --followups, a chat's next message after a search asks
+about the same topic; the mock LLM answers it directly when the results
+are still in the conversation it was sent, and searches again otherwise.
+Reply latency is measured from the moment a message becomes visible to
+getUpdates until the final (non-status) sendMessage for it.
+"""
+
+import argparse
+import json
+import random
+import re
+import sys
+import threading
+import time
+import zlib
+from http.server import BaseHTTPRequestHandler, ThreadingHTTPServer
+from urllib.parse import parse_qs, urlparse
+
+WORKING_PREFIX = "\U0001F431mimi is working"
+
+
+def percentile(sorted_vals, p):
+    if not sorted_vals:
+        return 0.0
+    k = (len(sorted_vals) - 1) * p / 100.0
+    lo = int(k)
+    hi = min(lo + 1, len(sorted_vals) - 1)
+    return sorted_vals[lo] + (sorted_vals[hi] - sorted_vals[lo]) * (k - lo)
+
+
+class LoadState:
+    """Telegram-side load generator and reply bookkeeping."""
+
+    def __init__(self, args):
+        self.args = args
+        self.cond = threading.Condition()
+        self.reset()
+
+    def reset(self):
+        with self.cond:
+            self.updates = []          # visible updates, ascending update_id
+            self.pending = {}          # chat_id -> [(message_id, t_visible)]
+            self.latencies = []
+            self.sent = 0
+            self.replied = 0
+            self.status_msgs = 0
+            self.send_calls = 0
+            self.llm_calls = 0
+            self.search_calls = 0
+            self.embed_calls = 0
+            self.bytes_in = 0
+            self.t_start = None
+            self.t_last_reply = None
+            self.next_update_id = 1
+            self.generation = getattr(self, "generation", 0) + 1
+        threading.Thread(target=self._generate, args=(self.generation,), daemon=True).start()
+
+    def _generate(self, generation):
+        a = self.args
+        interval = 1.0 / a.rate if a.rate > 0 else 0.0
+        last_search = {}
+        for i in range(a.messages):
+            if interval:
+                time.sleep(interval)
+            chat_id = 100000 + (i % a.chats)
+            text = f"message {i} from chat {chat_id}"
+            if a.tool_every and (i + 1) % a.tool_every == 0:
+                text = f"please search the web for topic {i}"
+                last_search[chat_id] = i
+            elif a.followups and chat_id in last_search:
+                text = f"tell me more about topic {last_search.pop(chat_id)}"
+            with self.cond:
+                if generation != self.generation:
+                    return
+                now = time.monotonic()
+                if self.t_start is None:
+                    self.t_start = now
+                uid = self.next_update_id
+                self.next_update_id += 1
+                self.updates.append({
+                    "update_id": uid,
+                    "message": {
+                        "message_id": uid,
+                        "date": int(time.time()),
+                        "chat": {"id": chat_id, "type": "private"},
+                        "from": {"id": chat_id, "is_bot": False, "first_name": "load"},
+                        "text": text,
+                    },
+                })
+                self.pending.setdefault(str(chat_id), []).append((uid, now))
+                self.sent += 1
+                self.cond.notify_all()
+
+    def get_updates(self, offset, timeout):
+        deadline = time.monotonic() + min(timeout, self.args.poll_cap)
+        with self.cond:
+            while True:
+                batch = [u for u in self.updates if u["update_id"] >= offset][:100]
+                # Drop acknowledged updates so the list stays short
+                self.updates = [u for u in self.updates if u["update_id"] >= offset]
+                remaining = deadline - time.monotonic()
+                if batch or remaining <= 0:
+                    return batch
+                self.cond.wait(remaining)
+
+    def on_send(self, chat_id, text):
+        with self.cond:
+            self.send_calls += 1
+            # The firmware merges replies queued together for a chat into
+            # one send, separated by a blank line; mock texts have none
+            for part in text.split("\n\n"):
+                if part.startswith(WORKING_PREFIX):
+                    self.status_msgs += 1
+                    continue
+                queue = self.pending.get(str(chat_id))
+                if not queue:
+                    continue
+                _, t0 = queue.pop(0)
+                now = time.monotonic()
+                self.latencies.append((now - t0) * 1000.0)
+                self.replied += 1
+                self.t_last_reply = now
+            self.cond.notify_all()
+
+    def done(self):
+        with self.cond:
+            return self.sent == self.args.messages and self.replied >= self.sent
+
+    def stats(self):
+        with self.cond:
+            lat = sorted(self.latencies)
+            elapsed = 0.0
+            if self.t_start is not None:
+                end = self.t_last_reply if self.done_locked() else time.monotonic()
+                elapsed = max(end - self.t_start, 1e-9)
+            return {
+                "sent": self.sent,
+                "replied": self.replied,
+                "pending": self.sent - self.replied,
+                "status_msgs": self.status_msgs,
+                "send_calls": self.send_calls,
+                "llm_calls": self.llm_calls,
+                "search_calls": self.search_calls,
+                "embed_calls": self.embed_calls,
+                "llm_request_bytes": self.bytes_in,
+                "elapsed_s": round(elapsed, 3),
+                "throughput_msgs_per_s": round(self.replied / elapsed, 2) if elapsed else 0.0,
+                "latency_ms": {
+                    "p50": round(percentile(lat, 50), 1),
+                    "p90": round(percentile(lat, 90), 1),
+                    "p99": round(percentile(lat, 99), 1),
+                    "max": round(lat[-1], 1) if lat else 0.0,
+                },
+            }
+
+    def done_locked(self):
+        return self.sent == self.args.messages and self.replied >= self.sent
+
+
+def last_user_turn(messages):
+    for msg in reversed(messages):
+        if msg.get("role") in ("user", "tool"):
+            return msg
+    return {}
+
+
+FOLLOWUP = re.compile(r"tell me more about (topic \d+)")
+
+
+def followup_needs_search(messages, text):
+    """A follow-up is answered from earlier results if a search for its topic
+    is still in the conversation, as a tool_use block or an OpenAI tool call."""
+    m = FOLLOWUP.search(text)
+    if not m:
+        return False
+    topic = re.compile(re.escape(m.group(1)) + r"(?!\d)")
+    for msg in messages[:-1]:
+        calls = msg.get("tool_calls") or []
+        content = msg.get("content")
+        if isinstance(content, list):
+            calls = calls + [b for b in content if isinstance(b, dict) and b.get("type") == "tool_use"]
+        if any(topic.search(json.dumps(c)) for c in calls):
+            return False
+    return True
+
+
+def anthropic_reply(body, args):
+    msg = last_user_turn(body.get("messages", []))
+    content = msg.get("content")
+    if isinstance(content, list):
+        if any(b.get("type") == "tool_result" for b in content if isinstance(b, dict)):
+            return {
+                "id": "msg_mock", "type": "message", "role": "assistant",
+                "stop_reason": "end_turn",
+                "content": [{"type": "text", "text": "Here is what I found (mock)."}],
+            }
+        content = " ".join(b.get("text", "") for b in content if isinstance(b, dict))
+    text = content or ""
+    if FOLLOWUP.search(text) and not followup_needs_search(body.get("messages", []), text):
+        return {
+            "id": "msg_mock", "type": "message", "role": "assistant",
+            "stop_reason": "end_turn",
+            "content": [{"type": "text", "text": "From the earlier results (mock)."}],
+        }
+    if "search" in text or FOLLOWUP.search(text):
+        return {
+            "id": "msg_mock", "type": "message", "role": "assistant",
+            "stop_reason": "tool_use",
+            "content": [
+                {"type": "text", "text": "Let me look that up."},
+                {"type": "tool_use", "id": f"toolu_{random.randrange(1 << 30):08x}",
+                 "name": "web_search", "input": {"query": text}},
+            ],
+        }
+    return {
+        "id": "msg_mock", "type": "message", "role": "assistant",
+        "stop_reason": "end_turn",
+        "content": [{"type": "text", "text": "echo: " + text[: args.reply_bytes]}],
+    }
+
+
+def openai_reply(body, args):
+    msg = last_user_turn(body.get("messages", []))
+    if msg.get("role") == "tool":
+        return {"choices": [{"finish_reason": "stop", "message": {
+            "role": "assistant", "content": "Here is what I found (mock)."}}]}
+    text = msg.get("content") or ""
+    if isinstance(text, list):
+        text = " ".join(b.get("text", "") for b in text if isinstance(b, dict))
+    if FOLLOWUP.search(text) and not followup_needs_search(body.get("messages", []), text):
+        return {"choices": [{"finish_reason": "stop", "message": {
+            "role": "assistant", "content": "From the earlier results (mock)."}}]}
+    if "search" in text or FOLLOWUP.search(text):
+        return {"choices": [{"finish_reason": "tool_calls", "message": {
+            "role": "assistant", "content": None,
+            "tool_calls": [{"id": f"call_{random.randrange(1 << 30):08x}", "type": "function",
+                            "function": {"name": "web_search",
+                                         "arguments": json.dumps({"query": text})}}]}}]}
+    return {"choices": [{"finish_reason": "stop", "message": {
+        "role": "assistant", "content": "echo: " + text[: args.reply_bytes]}}]}
+
+
+SEARCH_RESULTS = [
+    {"title": f"Result {i}", "url": f"https://example.com/{i}",
+     "content": "Lorem ipsum dolor sit amet. " * 4,
+     "description": "Lorem ipsum dolor sit amet. " * 4}
+    for i in range(5)
+]
+
+
+# Words the mock embedding model treats as the same concept, so vector
+# recall can be told apart from keyword matching
+EMBED_SYNONYMS = {
+    "coffee": "espresso", "latte": "espresso", "tooth": "dentist",
+    "teeth": "dentist", "city": "lives", "home": "lives", "kitty": "cat",
+    "watering": "irrigation", "plants": "garden",
+}
+
+
+def mock_embedding(text, dims):
+    v = [0.0] * dims
+    for w in re.findall(r"[a-z0-9]+", text.lower()):
+        h = zlib.crc32(EMBED_SYNONYMS.get(w, w).encode())
+        v[h % dims] += -1.0 if h & 0x80000000 else 1.0
+    norm = sum(x * x for x in v) ** 0.5 or 1.0
+    return [x / norm for x in v]
+
+
+class Handler(BaseHTTPRequestHandler):
+    protocol_version = "HTTP/1.1"
+    server_version = "mimi-mock/1.0"
+
+    def log_message(self, fmt, *a):
+        if self.server.args.verbose:
+            sys.stderr.write("mock: " + fmt % a + "\n")
+
+    def _body(self):
+        n = int(self.headers.get("Content-Length") or 0)
+        return self.rfile.read(n) if n else b""
+
+    def _json(self, obj, status=200):
+        data = json.dumps(obj).encode()
+        self.send_response(status)
+        self.send_header("Content-Type", "application/json")
+        self.send_header("Content-Length", str(len(data)))
+        self.end_headers()
+        self.wfile.write(data)
+
+    def do_HEAD(self):
+        self.send_response(200)
+        self.send_header("Content-Length", "0")
+        self.end_headers()
+
+    def do_GET(self):
+        state = self.server.state
+        url = urlparse(self.path)
+        if url.path == "/stats":
+            return self._json(state.stats())
+        if url.path.endswith("/getUpdates"):
+            q = parse_qs(url.query)
+            offset = int(q.get("offset", ["0"])[0])
+            timeout = int(q.get("timeout", ["0"])[0])
+            return self._json({"ok": True, "result": state.get_updates(offset, timeout)})
+        if url.path == "/res/v1/web/search":
+            with state.cond:
+                state.search_calls += 1
+            return self._json({"web": {"results": SEARCH_RESULTS}})
+        if url.path == "/":
+            return self._json({"ok": True})
+        self._json({"ok": False, "description": "not found"}, 404)
+
+    def do_POST(self):
+        state = self.server.state
+        args = self.server.args
+        path = urlparse(self.path).path
+        raw = self._body()
+        try:
+            body = json.loads(raw) if raw else {}
+        except ValueError:
+            return self._json({"error": "bad json"}, 400)
+
+        if path == "/reset":
+            state.reset()
+            return self._json({"ok": True})
+        if path in ("/v1/messages", "/v1/chat/completions"):
+            with state.cond:
+                state.llm_calls += 1
+                state.bytes_in += len(raw)
+            if args.llm_latency_ms:
+                time.sleep(args.llm_latency_ms / 1000.0)
+            reply = anthropic_reply if path == "/v1/messages" else openai_reply
+            return self._json(reply(body, args))
+        if path.endswith("/sendMessage"):
+            state.on_send(body.get("chat_id"), body.get("text", ""))
+            return self._json({"ok": True, "result": {"message_id": random.randrange(1 << 30)}})
+        if path == "/search":
+            with state.cond:
+                state.search_calls += 1
+            return self._json({"results": SEARCH_RESULTS})
+        if path == "/v1/embeddings":
+            with state.cond:
+                state.embed_calls += 1
+            vec = mock_embedding(body.get("input", ""), int(body.get("dimensions", 256)))
+            return self._json({"data": [{"embedding": vec, "index": 0}]})
+        self._json({"ok": False, "description": "not found"}, 404)
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__.split("\n\n")[0])
+    ap.add_argument("--port", type=int, default=18800)
+    ap.add_argument("--chats", type=int, default=4, help="distinct Telegram chats")
+    ap.add_argument("--messages", type=int, default=100, help="total inbound messages")
+    ap.add_argument("--rate", type=float, default=0, help="messages per second (0 = burst)")
+    ap.add_argument("--tool-every", type=int, default=5,
+                    help="every Nth message triggers a web_search tool call (0 = never)")
+    ap.add_argument("--followups", action="store_true",
+                    help="follow each search with a question about its results")
+    ap.add_argument("--llm-latency-ms", type=int, default=0, help="simulated LLM latency")
+    ap.add_argument("--reply-bytes", type=int, default=200, help="max echoed reply length")
+    ap.add_argument("--poll-cap", type=float, default=5.0,
+                    help="cap on getUpdates long-poll wait in seconds")
+    ap.add_argument("--exit-when-done", action="store_true",
+                    help="print stats as JSON and exit once every message is answered")
+    ap.add_argument("--timeout", type=float, default=0,
+                    help="with --exit-when-done, give up after this many seconds")
+    ap.add_argument("--verbose", action="store_true")
+    args = ap.parse_args()
+
+    server = ThreadingHTTPServer(("127.0.0.1", args.port), Handler)
+    server.daemon_threads = True
+    server.args = args
+    server.state = LoadState(args)
+    threading.Thread(target=server.serve_forever, daemon=True).start()
+    sys.stderr.write(f"mock upstreams on http://127.0.0.1:{args.port}\n")
+
+    t0 = time.monotonic()
+    try:
+        while True:
+            time.sleep(0.2)
+            if not args.exit_when_done:
+                continue
+            timed_out = args.timeout and time.monotonic() - t0 > args.timeout
+            if server.state.done() or timed_out:
+                print(json.dumps(server.state.stats(), indent=2))
+                return 0 if not timed_out else 1
+    except KeyboardInterrupt:
+        print(json.dumps(server.state.stats(), indent=2))
+        return 0
+    finally:
+        server.shutdown()
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,45 @@
+#!/usr/bin/env bash
+# Run the host firmware against the mock upstreams and print the load
+# summary once every generated message has been answered.
+#
+#   host/run_mock.sh [mock_upstreams.py options...]
+#   e.g. host/run_mock.sh --chats 8 --messages 400 --rate 50
+#
+# Environment:
+#   MIMI_HOST_BIN    firmware binary        (default: build-host/mimiclaw_host)
+#   MIMI_HOST_DATA   scratch data directory (default: fresh mktemp dir)
+#   MOCK_PORT        mock server port       (default: 18800)
+#   MIMI_HOST_LOG_LEVEL  firmware log level 0-5 (default: 2, warnings)
+
+set -euo pipefail
+
+HERE="$(cd "$(dirname "$0")" && pwd)"
+ROOT="$(cd "$HERE/.." && pwd)"
+BIN="${MIMI_HOST_BIN:-$ROOT/build-host/mimiclaw_host}"
+PORT="${MOCK_PORT:-18800}"
+DATA="${MIMI_HOST_DATA:-$(mktemp -d -t mimi_host.XXXXXX)}"
+
+if [[ ! -x "$BIN" ]]; then
+    echo "Host binary not found at $BIN; build it with:" >&2
+    echo "  cmake -S host -B build-host && cmake --build build-host -j" >&2
+    exit 1
+fi
+
+python3 "$HERE/mock/mock_upstreams.py" --port "$PORT" --exit-when-done "$@" &
+MOCK_PID=$!
+sleep 0.5
+
+export MIMI_HOST_UPSTREAM="http://127.0.0.1:$PORT"
+export MIMI_HOST_API_KEY="${MIMI_HOST_API_KEY:-mock-key}"
+export MIMI_HOST_TG_TOKEN="${MIMI_HOST_TG_TOKEN:-123:mock}"
+export MIMI_HOST_TAVILY_KEY="${MIMI_HOST_TAVILY_KEY:-mock-tavily}"
+export MIMI_HOST_LOG_LEVEL="${MIMI_HOST_LOG_LEVEL:-2}"
+
+"$BIN" "$DATA" &
+FW_PID=$!
+trap 'kill $FW_PID $MOCK_PID 2>/dev/null || true' EXIT
+
+STATUS=0
+wait $MOCK_PID || STATUS=$?
+echo "data dir: $DATA" >&2
+exit $STATUS
@@ -0,0 +1,365 @@
+/* Host implementations of the small ESP-IDF system APIs: error names,
+ * logging, heap accounting, timer, RNG, event loop and SPIFFS / LittleFS
+ * mount. */
+
+#include <dirent.h>
+#include <errno.h>
+#include <limits.h>
+#include <malloc.h>
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/random.h>
+#include <sys/stat.h>
+#include <sys/statvfs.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "esp_err.h"
+#include "esp_log.h"
+#include "esp_system.h"
+#include "esp_heap_caps.h"
+#include "esp_timer.h"
+#include "esp_random.h"
+#include "esp_event.h"
+#include "esp_spiffs.h"
+#include "esp_littlefs.h"
+#include "host_flash.h"
+#include "esp_http_client.h"
+#include "esp_http_server.h"
+#include "nvs.h"
+
+/* ── Error names ───────────────────────────────────────────────── */
+
+const char *esp_err_to_name(esp_err_t code)
+{
+    switch (code) {
+    case ESP_OK:                        return "ESP_OK";
+    case ESP_FAIL:                      return "ESP_FAIL";
+    case ESP_ERR_NO_MEM:                return "ESP_ERR_NO_MEM";
+    case ESP_ERR_INVALID_ARG:           return "ESP_ERR_INVALID_ARG";
+    case ESP_ERR_INVALID_STATE:         return "ESP_ERR_INVALID_STATE";
+    case ESP_ERR_INVALID_SIZE:          return "ESP_ERR_INVALID_SIZE";
+    case ESP_ERR_NOT_FOUND:             return "ESP_ERR_NOT_FOUND";
+    case ESP_ERR_NOT_SUPPORTED:         return "ESP_ERR_NOT_SUPPORTED";
+    case ESP_ERR_TIMEOUT:               return "ESP_ERR_TIMEOUT";
+    case ESP_ERR_INVALID_RESPONSE:      return "ESP_ERR_INVALID_RESPONSE";
+    case ESP_ERR_INVALID_CRC:           return "ESP_ERR_INVALID_CRC";
+    case ESP_ERR_INVALID_VERSION:       return "ESP_ERR_INVALID_VERSION";
+    case ESP_ERR_NOT_FINISHED:          return "ESP_ERR_NOT_FINISHED";
+    case ESP_ERR_NOT_ALLOWED:           return "ESP_ERR_NOT_ALLOWED";
+    case ESP_ERR_NVS_NOT_INITIALIZED:   return "ESP_ERR_NVS_NOT_INITIALIZED";
+    case ESP_ERR_NVS_NOT_FOUND:         return "ESP_ERR_NVS_NOT_FOUND";
+    case ESP_ERR_NVS_INVALID_HANDLE:    return "ESP_ERR_NVS_INVALID_HANDLE";
+    case ESP_ERR_NVS_INVALID_LENGTH:    return "ESP_ERR_NVS_INVALID_LENGTH";
+    case ESP_ERR_NVS_NO_FREE_PAGES:     return "ESP_ERR_NVS_NO_FREE_PAGES";
+    case ESP_ERR_HTTP_CONNECT:          return "ESP_ERR_HTTP_CONNECT";
+    case ESP_ERR_HTTP_WRITE_DATA:       return "ESP_ERR_HTTP_WRITE_DATA";
+    case ESP_ERR_HTTP_FETCH_HEADER:     return "ESP_ERR_HTTP_FETCH_HEADER";
+    case ESP_ERR_HTTP_CONNECTION_CLOSED: return "ESP_ERR_HTTP_CONNECTION_CLOSED";
+    case ESP_ERR_HTTPD_INVALID_REQ:     return "ESP_ERR_HTTPD_INVALID_REQ";
+    case ESP_ERR_HTTPD_RESP_SEND:       return "ESP_ERR_HTTPD_RESP_SEND";
+    default:                            return "UNKNOWN ERROR";
+    }
+}
+
+/* ── Logging ───────────────────────────────────────────────────── */
+
+#define LOG_TAG_OVERRIDES 16
+
+static struct {
+    char tag[32];
+    esp_log_level_t level;
+} s_tag_levels[LOG_TAG_OVERRIDES];
+static int s_tag_level_count = 0;
+static int s_default_level = -1;
+static pthread_mutex_t s_log_lock = PTHREAD_MUTEX_INITIALIZER;
+
+void esp_log_level_set(const char *tag, esp_log_level_t level)
+{
+    pthread_mutex_lock(&s_log_lock);
+    if (strcmp(tag, "*") == 0) {
+        s_default_level = level;
+    } else {
+        int i;
+        for (i = 0; i < s_tag_level_count; i++) {
+            if (strcmp(s_tag_levels[i].tag, tag) == 0) break;
+        }
+        if (i < LOG_TAG_OVERRIDES) {
+            snprintf(s_tag_levels[i].tag, sizeof(s_tag_levels[i].tag), "%s", tag);
+            s_tag_levels[i].level = level;
+            if (i == s_tag_level_count) s_tag_level_count++;
+        }
+    }
+    pthread_mutex_unlock(&s_log_lock);
+}
+
+static esp_log_level_t level_for_tag(const char *tag)
+{
+    if (s_default_level < 0) {
+        const char *env = getenv("MIMI_HOST_LOG_LEVEL");
+        s_default_level = env ? atoi(env) : ESP_LOG_INFO;
+    }
+    for (int i = 0; i < s_tag_level_count; i++) {
+        if (strcmp(s_tag_levels[i].tag, tag) == 0) return s_tag_levels[i].level;
+    }
+    return (esp_log_level_t)s_default_level;
+}
+
+void esp_log_write(esp_log_level_t level, const char *tag, const char *format, ...)
+{
+    static const char letters[] = "NEWIDV";
+
+    pthread_mutex_lock(&s_log_lock);
+    if (level > level_for_tag(tag)) {
+        pthread_mutex_unlock(&s_log_lock);
+        return;
+    }
+
+    fprintf(stderr, "%c (%" PRId64 ") %s: ", letters[level],
+            esp_timer_get_time() / 1000, tag);
+    va_list ap;
+    va_start(ap, format);
+    vfprintf(stderr, format, ap);
+    va_end(ap);
+    fputc('\n', stderr);
+    pthread_mutex_unlock(&s_log_lock);
+}
+
+/* ── System ────────────────────────────────────────────────────── */
+
+#define HOST_SHUTDOWN_HANDLERS 5     /* as CONFIG_ESP_SYSTEM's table */
+
+static shutdown_handler_t s_shutdown_handlers[HOST_SHUTDOWN_HANDLERS];
+
+esp_err_t esp_register_shutdown_handler(shutdown_handler_t handle)
+{
+    for (int i = 0; i < HOST_SHUTDOWN_HANDLERS; i++) {
+        if (s_shutdown_handlers[i] == handle) return ESP_ERR_INVALID_STATE;
+        if (!s_shutdown_handlers[i]) {
+            s_shutdown_handlers[i] = handle;
+            return ESP_OK;
+        }
+    }
+    return ESP_ERR_NO_MEM;
+}
+
+void host_run_shutdown_handlers(void)
+{
+    for (int i = HOST_SHUTDOWN_HANDLERS - 1; i >= 0; i--) {
+        if (s_shutdown_handlers[i]) s_shutdown_handlers[i]();
+    }
+}
+
+void esp_restart(void)
+{
+    host_run_shutdown_handlers();
+    fprintf(stderr, "esp_restart() called, exiting host process\n");
+    fflush(NULL);
+    exit(3);
+}
+
+/* ── Heap ──────────────────────────────────────────────────────── */
+
+/* Nominal ESP32-S3 budgets, so heap logs look like the device's */
+#define HOST_INTERNAL_HEAP   (320 * 1024)
+#define HOST_PSRAM_HEAP      (8 * 1024 * 1024)
+
+void *heap_caps_malloc(size_t size, uint32_t caps)
+{
+    (void)caps;
+    return malloc(size);
+}
+
+void *heap_caps_calloc(size_t n, size_t size, uint32_t caps)
+{
+    (void)caps;
+    return calloc(n, size);
+}
+
+void *heap_caps_realloc(void *ptr, size_t size, uint32_t caps)
+{
+    (void)caps;
+    return realloc(ptr, size);
+}
+
+void heap_caps_free(void *ptr)
+{
+    free(ptr);
+}
+
+size_t heap_caps_get_free_size(uint32_t caps)
+{
+    size_t budget = (caps & MALLOC_CAP_SPIRAM) ? HOST_PSRAM_HEAP : HOST_INTERNAL_HEAP;
+    struct mallinfo2 mi = mallinfo2();
+    size_t used = mi.uordblks + mi.hblkhd;
+    return used < budget ? budget - used : 0;
+}
+
+size_t heap_caps_get_largest_free_block(uint32_t caps)
+{
+    return heap_caps_get_free_size(caps);
+}
+
+uint32_t esp_get_free_heap_size(void)
+{
+    return (uint32_t)heap_caps_get_free_size(MALLOC_CAP_DEFAULT);
+}
+
+/* ── Timer / RNG ───────────────────────────────────────────────── */
+
+static struct timespec s_boot_time;
+static pthread_once_t s_boot_once = PTHREAD_ONCE_INIT;
+
+static void record_boot_time(void)
+{
+    clock_gettime(CLOCK_MONOTONIC, &s_boot_time);
+}
+
+int64_t esp_timer_get_time(void)
+{
+    pthread_once(&s_boot_once, record_boot_time);
+
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (int64_t)(now.tv_sec - s_boot_time.tv_sec) * 1000000
+         + (now.tv_nsec - s_boot_time.tv_nsec) / 1000;
+}
+
+uint32_t esp_random(void)
+{
+    uint32_t v = 0;
+    if (getrandom(&v, sizeof(v), 0) != sizeof(v)) {
+        v = (uint32_t)rand();
+    }
+    return v;
+}
+
+/* ── Event loop ────────────────────────────────────────────────── */
+
+esp_err_t esp_event_loop_create_default(void)
+{
+    return ESP_OK;
+}
+
+/* ── SPIFFS / LittleFS ─────────────────────────────────────────── */
+
+/*
+ * Both backends mount the same host directory. Which format the partition
+ * "holds" is recorded next to it in HOST_FS_RECORD, so a mount of
+ * the other backend fails as it would on flash, and formatting wipes the
+ * directory. A directory without the record (first run, or seeded by
+ * host_main) takes the format of the first backend mounted on it.
+ */
+static void wipe_tree(const char *dir, bool keep_top)
+{
+    DIR *d = opendir(dir);
+    if (!d) return;
+    struct dirent *e;
+    while ((e = readdir(d)) != NULL) {
+        if (strcmp(e->d_name, ".") == 0 || strcmp(e->d_name, "..") == 0) continue;
+        char path[PATH_MAX];
+        snprintf(path, sizeof(path), "%s/%s", dir, e->d_name);
+        struct stat st;
+        if (lstat(path, &st) == 0 && S_ISDIR(st.st_mode)) {
+            wipe_tree(path, false);
+        } else {
+            unlink(path);
+        }
+    }
+    closedir(d);
+    if (!keep_top) rmdir(dir);
+}
+
+void host_fs_set_format(const char *kind)
+{
+    FILE *f = fopen(HOST_FS_RECORD, "w");
+    if (!f) return;
+    fputs(kind, f);
+    fclose(f);
+}
+
+static esp_err_t host_fs_mount(const char *base, const char *kind, bool format)
+{
+    if (!base) return ESP_ERR_INVALID_ARG;
+    if (mkdir(base, 0755) != 0 && errno != EEXIST) {
+        return ESP_FAIL;
+    }
+
+    char held[16] = "";
+    FILE *f = fopen(HOST_FS_RECORD, "r");
+    if (f) {
+        if (!fgets(held, sizeof(held), f)) held[0] = '\0';
+        fclose(f);
+    }
+    if (!held[0]) {
+        host_fs_set_format(kind);
+    } else if (strcmp(held, kind) != 0) {
+        if (!format) return ESP_FAIL;
+        wipe_tree(base, true);
+        host_fs_set_format(kind);
+    }
+    host_flash_set_flat(strcmp(kind, "spiffs") == 0);
+    return ESP_OK;
+}
+
+static esp_err_t host_fs_format(const char *kind)
+{
+    wipe_tree(MIMI_SPIFFS_BASE, true);
+    host_fs_set_format(kind);
+    return ESP_OK;
+}
+
+esp_err_t esp_vfs_spiffs_register(const esp_vfs_spiffs_conf_t *conf)
+{
+    if (!conf) return ESP_ERR_INVALID_ARG;
+    return host_fs_mount(conf->base_path, "spiffs", conf->format_if_mount_failed);
+}
+
+esp_err_t esp_vfs_spiffs_unregister(const char *partition_label)
+{
+    (void)partition_label;
+    return ESP_OK;
+}
+
+esp_err_t esp_spiffs_format(const char *partition_label)
+{
+    (void)partition_label;
+    return host_fs_format("spiffs");
+}
+
+esp_err_t esp_vfs_littlefs_register(const esp_vfs_littlefs_conf_t *conf)
+{
+    if (!conf) return ESP_ERR_INVALID_ARG;
+    return host_fs_mount(conf->base_path, "littlefs", conf->format_if_mount_failed);
+}
+
+esp_err_t esp_vfs_littlefs_unregister(const char *partition_label)
+{
+    (void)partition_label;
+    return ESP_OK;
+}
+
+esp_err_t esp_littlefs_format(const char *partition_label)
+{
+    (void)partition_label;
+    return host_fs_format("littlefs");
+}
+
+esp_err_t esp_littlefs_info(const char *partition_label, size_t *total_bytes, size_t *used_bytes)
+{
+    return esp_spiffs_info(partition_label, total_bytes, used_bytes);
+}
+
+esp_err_t esp_spiffs_info(const char *partition_label, size_t *total_bytes, size_t *used_bytes)
+{
+    (void)partition_label;
+    struct statvfs st;
+    if (statvfs(".", &st) != 0) return ESP_FAIL;
+    if (total_bytes) *total_bytes = (size_t)st.f_blocks * st.f_frsize;
+    if (used_bytes) *used_bytes = (size_t)(st.f_blocks - st.f_bfree) * st.f_frsize;
+    return ESP_OK;
+}
@@ -0,0 +1,459 @@
+/* Host FreeRTOS: tasks are detached pthreads, queues and semaphores are
+ * mutex/condvar pairs, and each software timer runs on its own thread.
+ * Timeouts are in ticks (1 tick = 1 ms); portMAX_DELAY blocks forever. */
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "freertos/timers.h"
+#include "esp_timer.h"
+
+/* ── Helpers ───────────────────────────────────────────────────── */
+
+static void deadline_after(struct timespec *ts, TickType_t ticks)
+{
+    clock_gettime(CLOCK_MONOTONIC, ts);
+    ts->tv_sec += ticks / 1000;
+    ts->tv_nsec += (long)(ticks % 1000) * 1000000L;
+    if (ts->tv_nsec >= 1000000000L) {
+        ts->tv_sec++;
+        ts->tv_nsec -= 1000000000L;
+    }
+}
+
+static void cond_init_monotonic(pthread_cond_t *cond)
+{
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(cond, &attr);
+    pthread_condattr_destroy(&attr);
+}
+
+/* Waits on cond until pred holds; false on timeout. Caller holds mutex. */
+#define WAIT_UNTIL(cond, mutex, ticks, pred) ({                             \
+        bool ok_ = true;                                                    \
+        if (!(pred)) {                                                      \
+            if ((ticks) == 0) {                                             \
+                ok_ = false;                                                \
+            } else if ((ticks) == portMAX_DELAY) {                          \
+                while (!(pred)) pthread_cond_wait(cond, mutex);             \
+            } else {                                                        \
+                struct timespec ts_;                                        \
+                deadline_after(&ts_, ticks);                                \
+                while (!(pred)) {                                           \
+                    if (pthread_cond_timedwait(cond, mutex, &ts_) == ETIMEDOUT) { \
+                        ok_ = (pred);                                       \
+                        break;                                              \
+                    }                                                       \
+                }                                                           \
+            }                                                               \
+        }                                                                   \
+        ok_;                                                                \
+    })
+
+/* ── Tasks ─────────────────────────────────────────────────────── */
+
+struct host_task {
+    pthread_t thread;
+    TaskFunction_t fn;
+    void *param;
+    BaseType_t core_id;
+    char name[16];
+};
+
+static __thread struct host_task *s_current_task = NULL;
+
+static void *task_trampoline(void *arg)
+{
+    struct host_task *task = arg;
+    s_current_task = task;
+    pthread_setname_np(pthread_self(), task->name);
+    task->fn(task->param);
+    /* FreeRTOS tasks must not return; treat it like vTaskDelete(NULL) */
+    return NULL;
+}
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t fn, const char *name,
+                                   uint32_t stack_depth, void *param,
+                                   UBaseType_t priority, TaskHandle_t *out_handle,
+                                   BaseType_t core_id)
+{
+    (void)priority;
+    struct host_task *task = calloc(1, sizeof(*task));
+    if (!task) return pdFAIL;
+    task->fn = fn;
+    task->param = param;
+    task->core_id = core_id;
+    strncpy(task->name, name ? name : "task", sizeof(task->name) - 1);
+
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+    /* Host libc frames are larger than on Xtensa; keep a generous floor */
+    size_t stack = stack_depth < 64 * 1024 ? 256 * 1024 : (size_t)stack_depth * 4;
+    pthread_attr_setstacksize(&attr, stack);
+
+    int rc = pthread_create(&task->thread, &attr, task_trampoline, task);
+    pthread_attr_destroy(&attr);
+    if (rc != 0) {
+        free(task);
+        return pdFAIL;
+    }
+    if (out_handle) *out_handle = task;
+    return pdPASS;
+}
+
+void vTaskDelete(TaskHandle_t handle)
+{
+    if (handle == NULL || handle == s_current_task) {
+        pthread_exit(NULL);
+    }
+    pthread_cancel(handle->thread);
+}
+
+void vTaskDelay(TickType_t ticks)
+{
+    struct timespec ts = {
+        .tv_sec = ticks / 1000,
+        .tv_nsec = (long)(ticks % 1000) * 1000000L,
+    };
+    while (nanosleep(&ts, &ts) != 0 && errno == EINTR) {
+    }
+}
+
+TickType_t xTaskGetTickCount(void)
+{
+    return (TickType_t)(esp_timer_get_time() / 1000);
+}
+
+UBaseType_t uxTaskGetStackHighWaterMark(TaskHandle_t handle)
+{
+    (void)handle;
+    return 0;
+}
+
+BaseType_t xPortGetCoreID(void)
+{
+    if (s_current_task && s_current_task->core_id != tskNO_AFFINITY) {
+        return s_current_task->core_id;
+    }
+    return 0;
+}
+
+/* ── Queues ────────────────────────────────────────────────────── */
+
+struct host_queue {
+    pthread_mutex_t lock;
+    pthread_cond_t not_empty;
+    pthread_cond_t not_full;
+    uint8_t *storage;
+    UBaseType_t length;
+    UBaseType_t item_size;
+    UBaseType_t head;
+    UBaseType_t count;
+};
+
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t item_size)
+{
+    struct host_queue *q = calloc(1, sizeof(*q));
+    if (!q) return NULL;
+    q->storage = calloc(length, item_size ? item_size : 1);
+    if (!q->storage) {
+        free(q);
+        return NULL;
+    }
+    q->length = length;
+    q->item_size = item_size;
+    pthread_mutex_init(&q->lock, NULL);
+    cond_init_monotonic(&q->not_empty);
+    cond_init_monotonic(&q->not_full);
+    return q;
+}
+
+void vQueueDelete(QueueHandle_t q)
+{
+    if (!q) return;
+    pthread_mutex_destroy(&q->lock);
+    pthread_cond_destroy(&q->not_empty);
+    pthread_cond_destroy(&q->not_full);
+    free(q->storage);
+    free(q);
+}
+
+static BaseType_t queue_send(QueueHandle_t q, const void *item, TickType_t ticks, bool front)
+{
+    pthread_mutex_lock(&q->lock);
+    if (!WAIT_UNTIL(&q->not_full, &q->lock, ticks, q->count < q->length)) {
+        pthread_mutex_unlock(&q->lock);
+        return errQUEUE_FULL;
+    }
+    UBaseType_t slot;
+    if (front) {
+        q->head = (q->head + q->length - 1) % q->length;
+        slot = q->head;
+    } else {
+        slot = (q->head + q->count) % q->length;
+    }
+    memcpy(q->storage + (size_t)slot * q->item_size, item, q->item_size);
+    q->count++;
+    pthread_cond_signal(&q->not_empty);
+    pthread_mutex_unlock(&q->lock);
+    return pdPASS;
+}
+
+BaseType_t xQueueSend(QueueHandle_t q, const void *item, TickType_t ticks)
+{
+    return queue_send(q, item, ticks, false);
+}
+
+BaseType_t xQueueSendToFront(QueueHandle_t q, const void *item, TickType_t ticks)
+{
+    return queue_send(q, item, ticks, true);
+}
+
+BaseType_t xQueueReceive(QueueHandle_t q, void *item, TickType_t ticks)
+{
+    pthread_mutex_lock(&q->lock);
+    if (!WAIT_UNTIL(&q->not_empty, &q->lock, ticks, q->count > 0)) {
+        pthread_mutex_unlock(&q->lock);
+        return pdFALSE;
+    }
+    memcpy(item, q->storage + (size_t)q->head * q->item_size, q->item_size);
+    q->head = (q->head + 1) % q->length;
+    q->count--;
+    pthread_cond_signal(&q->not_full);
+    pthread_mutex_unlock(&q->lock);
+    return pdPASS;
+}
+
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t q)
+{
+    pthread_mutex_lock(&q->lock);
+    UBaseType_t n = q->count;
+    pthread_mutex_unlock(&q->lock);
+    return n;
+}
+
+UBaseType_t uxQueueSpacesAvailable(QueueHandle_t q)
+{
+    pthread_mutex_lock(&q->lock);
+    UBaseType_t n = q->length - q->count;
+    pthread_mutex_unlock(&q->lock);
+    return n;
+}
+
+/* ── Semaphores ────────────────────────────────────────────────── */
+
+struct host_sem {
+    bool is_mutex;
+    pthread_mutex_t mutex;      /* recursive; used directly for mutexes */
+    pthread_cond_t cond;
+    UBaseType_t count;
+    UBaseType_t max_count;
+};
+
+static SemaphoreHandle_t sem_create(bool is_mutex, UBaseType_t max_count, UBaseType_t initial)
+{
+    struct host_sem *s = calloc(1, sizeof(*s));
+    if (!s) return NULL;
+    s->is_mutex = is_mutex;
+    s->count = initial;
+    s->max_count = max_count;
+
+    pthread_mutexattr_t attr;
+    pthread_mutexattr_init(&attr);
+    if (is_mutex) pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+    pthread_mutex_init(&s->mutex, &attr);
+    pthread_mutexattr_destroy(&attr);
+    cond_init_monotonic(&s->cond);
+    return s;
+}
+
+SemaphoreHandle_t xSemaphoreCreateMutex(void)
+{
+    return sem_create(true, 1, 1);
+}
+
+SemaphoreHandle_t xSemaphoreCreateBinary(void)
+{
+    return sem_create(false, 1, 0);
+}
+
+SemaphoreHandle_t xSemaphoreCreateCounting(UBaseType_t max_count, UBaseType_t initial)
+{
+    return sem_create(false, max_count, initial);
+}
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t s, TickType_t ticks)
+{
+    if (s->is_mutex) {
+        if (ticks == portMAX_DELAY) {
+            return pthread_mutex_lock(&s->mutex) == 0 ? pdTRUE : pdFALSE;
+        }
+        struct timespec ts;
+        clock_gettime(CLOCK_REALTIME, &ts);
+        ts.tv_sec += ticks / 1000;
+        ts.tv_nsec += (long)(ticks % 1000) * 1000000L;
+        if (ts.tv_nsec >= 1000000000L) {
+            ts.tv_sec++;
+            ts.tv_nsec -= 1000000000L;
+        }
+        return pthread_mutex_timedlock(&s->mutex, &ts) == 0 ? pdTRUE : pdFALSE;
+    }
+
+    pthread_mutex_lock(&s->mutex);
+    bool ok = WAIT_UNTIL(&s->cond, &s->mutex, ticks, s->count > 0);
+    if (ok) s->count--;
+    pthread_mutex_unlock(&s->mutex);
+    return ok ? pdTRUE : pdFALSE;
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t s)
+{
+    if (s->is_mutex) {
+        return pthread_mutex_unlock(&s->mutex) == 0 ? pdTRUE : pdFALSE;
+    }
+
+    pthread_mutex_lock(&s->mutex);
+    BaseType_t ret = pdFALSE;
+    if (s->count < s->max_count) {
+        s->count++;
+        pthread_cond_signal(&s->cond);
+        ret = pdTRUE;
+    }
+    pthread_mutex_unlock(&s->mutex);
+    return ret;
+}
+
+void vSemaphoreDelete(SemaphoreHandle_t s)
+{
+    if (!s) return;
+    pthread_mutex_destroy(&s->mutex);
+    pthread_cond_destroy(&s->cond);
+    free(s);
+}
+
+/* ── Software timers ───────────────────────────────────────────── */
+
+struct host_timer {
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    TimerCallbackFunction_t callback;
+    void *timer_id;
+    TickType_t period;
+    bool auto_reload;
+    bool running;
+    bool deleted;
+    bool thread_started;
+    uint32_t generation;    /* bumped on start/stop so a waiting thread re-arms */
+};
+
+static void *timer_thread(void *arg)
+{
+    struct host_timer *t = arg;
+    pthread_setname_np(pthread_self(), "tmr_svc");
+
+    pthread_mutex_lock(&t->lock);
+    while (!t->deleted) {
+        if (!t->running) {
+            pthread_cond_wait(&t->cond, &t->lock);
+            continue;
+        }
+
+        uint32_t gen = t->generation;
+        struct timespec ts;
+        deadline_after(&ts, t->period);
+        int rc = 0;
+        while (!t->deleted && t->running && t->generation == gen && rc != ETIMEDOUT) {
+            rc = pthread_cond_timedwait(&t->cond, &t->lock, &ts);
+        }
+        if (t->deleted || !t->running || t->generation != gen) continue;
+
+        if (!t->auto_reload) t->running = false;
+        pthread_mutex_unlock(&t->lock);
+        t->callback(t);
+        pthread_mutex_lock(&t->lock);
+    }
+    pthread_mutex_unlock(&t->lock);
+
+    pthread_mutex_destroy(&t->lock);
+    pthread_cond_destroy(&t->cond);
+    free(t);
+    return NULL;
+}
+
+TimerHandle_t xTimerCreate(const char *name, TickType_t period, UBaseType_t auto_reload,
+                           void *timer_id, TimerCallbackFunction_t callback)
+{
+    (void)name;
+    struct host_timer *t = calloc(1, sizeof(*t));
+    if (!t) return NULL;
+    t->callback = callback;
+    t->timer_id = timer_id;
+    t->period = period;
+    t->auto_reload = auto_reload;
+    pthread_mutex_init(&t->lock, NULL);
+    cond_init_monotonic(&t->cond);
+    return t;
+}
+
+BaseType_t xTimerStart(TimerHandle_t t, TickType_t ticks_to_wait)
+{
+    (void)ticks_to_wait;
+    pthread_mutex_lock(&t->lock);
+    if (!t->thread_started) {
+        if (pthread_create(&t->thread, NULL, timer_thread, t) != 0) {
+            pthread_mutex_unlock(&t->lock);
+            return pdFAIL;
+        }
+        pthread_detach(t->thread);
+        t->thread_started = true;
+    }
+    t->running = true;
+    t->generation++;
+    pthread_cond_broadcast(&t->cond);
+    pthread_mutex_unlock(&t->lock);
+    return pdPASS;
+}
+
+BaseType_t xTimerStop(TimerHandle_t t, TickType_t ticks_to_wait)
+{
+    (void)ticks_to_wait;
+    pthread_mutex_lock(&t->lock);
+    t->running = false;
+    t->generation++;
+    pthread_cond_broadcast(&t->cond);
+    pthread_mutex_unlock(&t->lock);
+    return pdPASS;
+}
+
+BaseType_t xTimerDelete(TimerHandle_t t, TickType_t ticks_to_wait)
+{
+    (void)ticks_to_wait;
+    pthread_mutex_lock(&t->lock);
+    if (!t->thread_started) {
+        pthread_mutex_unlock(&t->lock);
+        pthread_mutex_destroy(&t->lock);
+        pthread_cond_destroy(&t->cond);
+        free(t);
+        return pdPASS;
+    }
+    t->deleted = true;
+    pthread_cond_broadcast(&t->cond);
+    pthread_mutex_unlock(&t->lock);
+    return pdPASS;
+}
+
+void *pvTimerGetTimerID(TimerHandle_t t)
+{
+    return t->timer_id;
+}
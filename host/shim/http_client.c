@@ -0,0 +1,276 @@
+/* esp_http_client on libcurl. Body chunks and response headers are fed to
+ * the caller's event handler exactly as the IDF client would. */
+
+#include <curl/curl.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "esp_http_client.h"
+#include "host_http.h"
+#include "esp_log.h"
+
+static const char *TAG = "http_client";
+
+struct esp_http_client {
+    CURL *curl;
+    char *url;
+    esp_http_client_method_t method;
+    struct curl_slist *headers;
+    char *post_data;
+    int post_len;
+    int timeout_ms;
+    int buffer_size;
+    http_event_handle_cb event_handler;
+    void *user_data;
+    long status_code;
+    int64_t content_length;
+};
+
+static pthread_once_t s_curl_once = PTHREAD_ONCE_INIT;
+static host_http_responder_t s_responder = NULL;
+static void *s_responder_ctx = NULL;
+
+void host_http_set_responder(host_http_responder_t responder, void *ctx)
+{
+    s_responder_ctx = ctx;
+    s_responder = responder;
+}
+
+static void curl_global_setup(void)
+{
+    curl_global_init(CURL_GLOBAL_DEFAULT);
+}
+
+/* Replace scheme://authority with MIMI_HOST_UPSTREAM, keeping the path */
+static char *rewrite_url(const char *url)
+{
+    const char *upstream = getenv("MIMI_HOST_UPSTREAM");
+    if (!upstream || !upstream[0] || !url) return url ? strdup(url) : NULL;
+
+    const char *p = strstr(url, "://");
+    p = p ? p + 3 : url;
+    const char *path = strchr(p, '/');
+    if (!path) path = "/";
+
+    size_t ulen = strlen(upstream);
+    if (ulen && upstream[ulen - 1] == '/') ulen--;
+    size_t len = ulen + strlen(path) + 1;
+    char *out = malloc(len);
+    if (out) snprintf(out, len, "%.*s%s", (int)ulen, upstream, path);
+    return out;
+}
+
+static void dispatch(esp_http_client_handle_t client, esp_http_client_event_t *evt)
+{
+    if (!client->event_handler) return;
+    evt->client = client;
+    evt->user_data = client->user_data;
+    client->event_handler(evt);
+}
+
+static size_t on_body(char *ptr, size_t size, size_t nmemb, void *userdata)
+{
+    esp_http_client_handle_t client = userdata;
+    esp_http_client_event_t evt = {
+        .event_id = HTTP_EVENT_ON_DATA,
+        .data = ptr,
+        .data_len = (int)(size * nmemb),
+    };
+    dispatch(client, &evt);
+    return size * nmemb;
+}
+
+static size_t on_header(char *buffer, size_t size, size_t nitems, void *userdata)
+{
+    esp_http_client_handle_t client = userdata;
+    size_t len = size * nitems;
+
+    char *line = strndup(buffer, len);
+    if (!line) return len;
+    char *colon = strchr(line, ':');
+    if (colon) {
+        *colon = '\0';
+        char *value = colon + 1;
+        while (*value == ' ') value++;
+        char *end = value + strlen(value);
+        while (end > value && (end[-1] == '\r' || end[-1] == '\n')) *--end = '\0';
+
+        if (strcasecmp(line, "Content-Length") == 0) {
+            client->content_length = strtoll(value, NULL, 10);
+        }
+        esp_http_client_event_t evt = {
+            .event_id = HTTP_EVENT_ON_HEADER,
+            .header_key = line,
+            .header_value = value,
+        };
+        dispatch(client, &evt);
+    }
+    free(line);
+    return len;
+}
+
+esp_http_client_handle_t esp_http_client_init(const esp_http_client_config_t *config)
+{
+    pthread_once(&s_curl_once, curl_global_setup);
+
+    esp_http_client_handle_t client = calloc(1, sizeof(*client));
+    if (!client) return NULL;
+    client->curl = curl_easy_init();
+    if (!client->curl) {
+        free(client);
+        return NULL;
+    }
+    client->url = rewrite_url(config->url);
+    client->method = config->method;
+    client->timeout_ms = config->timeout_ms > 0 ? config->timeout_ms : 5000;
+    client->buffer_size = config->buffer_size > 0 ? config->buffer_size : 512;
+    client->event_handler = config->event_handler;
+    client->user_data = config->user_data;
+    client->content_length = -1;
+    return client;
+}
+
+esp_err_t esp_http_client_set_url(esp_http_client_handle_t client, const char *url)
+{
+    free(client->url);
+    client->url = rewrite_url(url);
+    return client->url ? ESP_OK : ESP_ERR_NO_MEM;
+}
+
+esp_err_t esp_http_client_set_method(esp_http_client_handle_t client, esp_http_client_method_t method)
+{
+    client->method = method;
+    return ESP_OK;
+}
+
+esp_err_t esp_http_client_set_header(esp_http_client_handle_t client, const char *key, const char *value)
+{
+    size_t len = strlen(key) + strlen(value) + 3;
+    char *line = malloc(len);
+    if (!line) return ESP_ERR_NO_MEM;
+    snprintf(line, len, "%s: %s", key, value);
+    client->headers = curl_slist_append(client->headers, line);
+    free(line);
+    return ESP_OK;
+}
+
+esp_err_t esp_http_client_set_post_field(esp_http_client_handle_t client, const char *data, int len)
+{
+    /* Like IDF, the buffer is borrowed and must outlive perform() */
+    client->post_data = (char *)data;
+    client->post_len = len;
+    return ESP_OK;
+}
+
+static esp_err_t perform_in_process(esp_http_client_handle_t client)
+{
+    host_http_request_t req = {
+        .url = client->url,
+        .method = client->method,
+        .body = client->post_data,
+        .body_len = client->post_len,
+    };
+    const char *resp = NULL;
+    int resp_len = 0;
+    int status = s_responder(&req, &resp, &resp_len, s_responder_ctx);
+    if (status < 0) {
+        esp_http_client_event_t evt = { .event_id = HTTP_EVENT_ERROR };
+        dispatch(client, &evt);
+        return ESP_ERR_HTTP_CONNECT;
+    }
+
+    client->status_code = status;
+    client->content_length = resp_len;
+    for (int off = 0; off < resp_len; off += client->buffer_size) {
+        int n = resp_len - off < client->buffer_size ? resp_len - off : client->buffer_size;
+        esp_http_client_event_t evt = {
+            .event_id = HTTP_EVENT_ON_DATA,
+            .data = (void *)(resp + off),
+            .data_len = n,
+        };
+        dispatch(client, &evt);
+    }
+    esp_http_client_event_t evt = { .event_id = HTTP_EVENT_ON_FINISH };
+    dispatch(client, &evt);
+    return ESP_OK;
+}
+
+esp_err_t esp_http_client_perform(esp_http_client_handle_t client)
+{
+    CURL *c = client->curl;
+    if (!client->url) return ESP_ERR_INVALID_ARG;
+    if (s_responder) return perform_in_process(client);
+
+    curl_easy_setopt(c, CURLOPT_URL, client->url);
+    curl_easy_setopt(c, CURLOPT_NOSIGNAL, 1L);
+    curl_easy_setopt(c, CURLOPT_TIMEOUT_MS, (long)client->timeout_ms);
+    curl_easy_setopt(c, CURLOPT_CONNECTTIMEOUT_MS, (long)client->timeout_ms);
+    curl_easy_setopt(c, CURLOPT_WRITEFUNCTION, on_body);
+    curl_easy_setopt(c, CURLOPT_WRITEDATA, client);
+    curl_easy_setopt(c, CURLOPT_HEADERFUNCTION, on_header);
+    curl_easy_setopt(c, CURLOPT_HEADERDATA, client);
+    /* Suppress "Expect: 100-continue" round trips on large bodies */
+    client->headers = curl_slist_append(client->headers, "Expect:");
+    curl_easy_setopt(c, CURLOPT_HTTPHEADER, client->headers);
+
+    switch (client->method) {
+    case HTTP_METHOD_POST:
+        curl_easy_setopt(c, CURLOPT_POST, 1L);
+        curl_easy_setopt(c, CURLOPT_POSTFIELDS, client->post_data ? client->post_data : "");
+        curl_easy_setopt(c, CURLOPT_POSTFIELDSIZE, (long)client->post_len);
+        break;
+    case HTTP_METHOD_HEAD:
+        curl_easy_setopt(c, CURLOPT_NOBODY, 1L);
+        break;
+    case HTTP_METHOD_PUT:
+    case HTTP_METHOD_PATCH:
+    case HTTP_METHOD_DELETE:
+        curl_easy_setopt(c, CURLOPT_CUSTOMREQUEST,
+                         client->method == HTTP_METHOD_PUT ? "PUT" :
+                         client->method == HTTP_METHOD_PATCH ? "PATCH" : "DELETE");
+        if (client->post_data) {
+            curl_easy_setopt(c, CURLOPT_POSTFIELDS, client->post_data);
+            curl_easy_setopt(c, CURLOPT_POSTFIELDSIZE, (long)client->post_len);
+        }
+        break;
+    default:
+        curl_easy_setopt(c, CURLOPT_HTTPGET, 1L);
+        break;
+    }
+
+    CURLcode rc = curl_easy_perform(c);
+    if (rc != CURLE_OK) {
+        ESP_LOGE(TAG, "%s: %s", client->url, curl_easy_strerror(rc));
+        esp_http_client_event_t evt = { .event_id = HTTP_EVENT_ERROR };
+        dispatch(client, &evt);
+        return rc == CURLE_COULDNT_CONNECT ? ESP_ERR_HTTP_CONNECT : ESP_FAIL;
+    }
+
+    curl_easy_getinfo(c, CURLINFO_RESPONSE_CODE, &client->status_code);
+    esp_http_client_event_t evt = { .event_id = HTTP_EVENT_ON_FINISH };
+    dispatch(client, &evt);
+    return ESP_OK;
+}
+
+int esp_http_client_get_status_code(esp_http_client_handle_t client)
+{
+    return (int)client->status_code;
+}
+
+int64_t esp_http_client_get_content_length(esp_http_client_handle_t client)
+{
+    return client->content_length;
+}
+
+esp_err_t esp_http_client_cleanup(esp_http_client_handle_t client)
+{
+    if (!client) return ESP_ERR_INVALID_ARG;
+    esp_http_client_event_t evt = { .event_id = HTTP_EVENT_DISCONNECTED };
+    dispatch(client, &evt);
+    curl_slist_free_all(client->headers);
+    curl_easy_cleanup(client->curl);
+    free(client->url);
+    free(client);
+    return ESP_OK;
+}
@@ -0,0 +1,516 @@
+/* Minimal esp_http_server for WebSocket endpoints: one poll() thread per
+ * server, RFC 6455 handshake and framing, server-to-client frames
+ * unmasked. Plain HTTP requests to a websocket URI get 400. */
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <openssl/evp.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "esp_http_server.h"
+#include "esp_log.h"
+
+static const char *TAG = "httpd";
+
+#define HTTPD_MAX_HANDLERS   8
+#define HTTPD_HDR_MAX        4096
+#define WS_GUID              "258EAFA5-E914-47DA-95CA-C5AB0DC85B11"
+
+typedef struct {
+    int fd;
+    bool upgraded;
+    bool closing;
+    const httpd_uri_t *uri;
+    uint8_t *buf;
+    size_t len;
+    size_t cap;
+} httpd_sess_t;
+
+typedef struct {
+    httpd_config_t config;
+    int listen_fd;
+    int wake_pipe[2];
+    pthread_t thread;
+    volatile bool stop;
+    pthread_mutex_t send_lock;
+    pthread_mutex_t sess_lock;
+    httpd_uri_t handlers[HTTPD_MAX_HANDLERS];
+    int handler_count;
+    httpd_sess_t *sessions;
+} httpd_server_t;
+
+/* Carried in httpd_req_t.aux while a frame handler runs */
+typedef struct {
+    int fd;
+    httpd_ws_type_t type;
+    bool final;
+    const uint8_t *payload;
+    size_t len;
+} httpd_req_aux_t;
+
+/* ── Socket helpers ────────────────────────────────────────────── */
+
+static int send_all(int fd, const void *data, size_t len)
+{
+    const uint8_t *p = data;
+    while (len > 0) {
+        ssize_t n = send(fd, p, len, MSG_NOSIGNAL);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        p += n;
+        len -= (size_t)n;
+    }
+    return 0;
+}
+
+static esp_err_t send_frame(httpd_server_t *srv, int fd, httpd_ws_type_t type,
+                            const uint8_t *payload, size_t len)
+{
+    uint8_t hdr[10];
+    size_t hlen = 0;
+    hdr[hlen++] = 0x80 | (uint8_t)type;
+    if (len < 126) {
+        hdr[hlen++] = (uint8_t)len;
+    } else if (len <= 0xFFFF) {
+        hdr[hlen++] = 126;
+        hdr[hlen++] = (uint8_t)(len >> 8);
+        hdr[hlen++] = (uint8_t)len;
+    } else {
+        hdr[hlen++] = 127;
+        for (int i = 7; i >= 0; i--) hdr[hlen++] = (uint8_t)((uint64_t)len >> (8 * i));
+    }
+
+    pthread_mutex_lock(&srv->send_lock);
+    int rc = send_all(fd, hdr, hlen);
+    if (rc == 0 && len) rc = send_all(fd, payload, len);
+    pthread_mutex_unlock(&srv->send_lock);
+    return rc == 0 ? ESP_OK : ESP_ERR_HTTPD_RESP_SEND;
+}
+
+static void wake(httpd_server_t *srv)
+{
+    char c = 1;
+    (void)!write(srv->wake_pipe[1], &c, 1);
+}
+
+/* ── Sessions ──────────────────────────────────────────────────── */
+
+static httpd_sess_t *find_sess(httpd_server_t *srv, int fd)
+{
+    for (int i = 0; i < srv->config.max_open_sockets; i++) {
+        if (srv->sessions[i].fd == fd) return &srv->sessions[i];
+    }
+    return NULL;
+}
+
+static void close_sess(httpd_server_t *srv, httpd_sess_t *s)
+{
+    int fd = s->fd;
+    pthread_mutex_lock(&srv->sess_lock);
+    free(s->buf);
+    memset(s, 0, sizeof(*s));
+    s->fd = -1;
+    pthread_mutex_unlock(&srv->sess_lock);
+
+    if (srv->config.close_fn) {
+        srv->config.close_fn(srv, fd);
+    } else {
+        close(fd);
+    }
+}
+
+static const httpd_uri_t *match_uri(httpd_server_t *srv, const char *path)
+{
+    for (int i = 0; i < srv->handler_count; i++) {
+        if (strcmp(srv->handlers[i].uri, path) == 0) return &srv->handlers[i];
+    }
+    return NULL;
+}
+
+static void invoke(httpd_server_t *srv, httpd_sess_t *s, int method, httpd_req_aux_t *aux)
+{
+    httpd_req_t req = {
+        .handle = srv,
+        .method = method,
+        .aux = aux,
+        .user_ctx = s->uri->user_ctx,
+    };
+    snprintf((char *)req.uri, sizeof(req.uri), "%s", s->uri->uri);
+    if (s->uri->handler(&req) != ESP_OK && method == HTTP_GET) {
+        s->closing = true;
+    }
+}
+
+/* ── Handshake ─────────────────────────────────────────────────── */
+
+static bool header_value(const char *hdrs, const char *name, char *out, size_t out_size)
+{
+    size_t nlen = strlen(name);
+    for (const char *line = hdrs; line && *line; ) {
+        const char *eol = strstr(line, "\r\n");
+        if (!eol) break;
+        if ((size_t)(eol - line) > nlen && strncasecmp(line, name, nlen) == 0 && line[nlen] == ':') {
+            const char *v = line + nlen + 1;
+            while (*v == ' ') v++;
+            snprintf(out, out_size, "%.*s", (int)(eol - v), v);
+            return true;
+        }
+        line = eol + 2;
+    }
+    return false;
+}
+
+/* Returns bytes consumed, 0 if incomplete, -1 to drop the connection */
+static ssize_t handle_handshake(httpd_server_t *srv, httpd_sess_t *s)
+{
+    char *end = memmem(s->buf, s->len, "\r\n\r\n", 4);
+    if (!end) return s->len >= HTTPD_HDR_MAX ? -1 : 0;
+    *end = '\0';
+    size_t consumed = (size_t)((uint8_t *)end - s->buf) + 4;
+
+    char method[8] = {0}, path[256] = {0};
+    if (sscanf((char *)s->buf, "%7s %255s", method, path) != 2 || strcmp(method, "GET") != 0) {
+        return -1;
+    }
+    char *q = strchr(path, '?');
+    if (q) *q = '\0';
+
+    const httpd_uri_t *uri = match_uri(srv, path);
+    char key[64];
+    const char *hdrs = strstr((char *)s->buf, "\r\n");
+    if (!uri || !hdrs || !header_value(hdrs + 2, "Sec-WebSocket-Key", key, sizeof(key))) {
+        static const char bad[] = "HTTP/1.1 400 Bad Request\r\nContent-Length: 0\r\n\r\n";
+        send_all(s->fd, bad, sizeof(bad) - 1);
+        return -1;
+    }
+
+    char concat[128];
+    snprintf(concat, sizeof(concat), "%s%s", key, WS_GUID);
+    unsigned char digest[EVP_MAX_MD_SIZE];
+    unsigned int dlen = 0;
+    EVP_Digest(concat, strlen(concat), digest, &dlen, EVP_sha1(), NULL);
+    char accept[64];
+    EVP_EncodeBlock((unsigned char *)accept, digest, (int)dlen);
+
+    char resp[256];
+    int n = snprintf(resp, sizeof(resp),
+                     "HTTP/1.1 101 Switching Protocols\r\n"
+                     "Upgrade: websocket\r\n"
+                     "Connection: Upgrade\r\n"
+                     "Sec-WebSocket-Accept: %s\r\n\r\n", accept);
+    pthread_mutex_lock(&srv->send_lock);
+    int rc = send_all(s->fd, resp, (size_t)n);
+    pthread_mutex_unlock(&srv->send_lock);
+    if (rc != 0) return -1;
+
+    s->upgraded = true;
+    s->uri = uri;
+    httpd_req_aux_t aux = { .fd = s->fd };
+    invoke(srv, s, HTTP_GET, &aux);
+    return (ssize_t)consumed;
+}
+
+/* ── Frames ────────────────────────────────────────────────────── */
+
+static ssize_t handle_frame(httpd_server_t *srv, httpd_sess_t *s)
+{
+    if (s->len < 2) return 0;
+    uint8_t *b = s->buf;
+    bool fin = b[0] & 0x80;
+    httpd_ws_type_t type = (httpd_ws_type_t)(b[0] & 0x0F);
+    bool masked = b[1] & 0x80;
+    uint64_t plen = b[1] & 0x7F;
+    size_t off = 2;
+
+    if (plen == 126) {
+        if (s->len < 4) return 0;
+        plen = ((uint64_t)b[2] << 8) | b[3];
+        off = 4;
+    } else if (plen == 127) {
+        if (s->len < 10) return 0;
+        plen = 0;
+        for (int i = 0; i < 8; i++) plen = (plen << 8) | b[2 + i];
+        off = 10;
+    }
+    if (!masked || plen > 1024 * 1024) return -1;     /* clients must mask */
+    if (s->len < off + 4 + plen) return 0;
+
+    uint8_t *mask = b + off;
+    uint8_t *payload = b + off + 4;
+    for (uint64_t i = 0; i < plen; i++) payload[i] ^= mask[i & 3];
+
+    switch (type) {
+    case HTTPD_WS_TYPE_CLOSE:
+        send_frame(srv, s->fd, HTTPD_WS_TYPE_CLOSE, NULL, 0);
+        return -1;
+    case HTTPD_WS_TYPE_PING:
+        if (!s->uri->handle_ws_control_frames) {
+            send_frame(srv, s->fd, HTTPD_WS_TYPE_PONG, payload, (size_t)plen);
+            break;
+        }
+        /* fall through */
+    default: {
+        httpd_req_aux_t aux = {
+            .fd = s->fd,
+            .type = type,
+            .final = fin,
+            .payload = payload,
+            .len = (size_t)plen,
+        };
+        invoke(srv, s, 0, &aux);
+        break;
+    }
+    }
+    return (ssize_t)(off + 4 + plen);
+}
+
+static void on_readable(httpd_server_t *srv, httpd_sess_t *s)
+{
+    if (s->cap - s->len < 4096) {
+        size_t cap = s->cap ? s->cap * 2 : 8192;
+        uint8_t *nb = realloc(s->buf, cap);
+        if (!nb) {
+            s->closing = true;
+            return;
+        }
+        s->buf = nb;
+        s->cap = cap;
+    }
+
+    ssize_t n = recv(s->fd, s->buf + s->len, s->cap - s->len - 1, 0);
+    if (n <= 0) {
+        if (n < 0 && (errno == EINTR || errno == EAGAIN)) return;
+        s->closing = true;
+        return;
+    }
+    s->len += (size_t)n;
+
+    while (s->len > 0 && !s->closing) {
+        ssize_t used = s->upgraded ? handle_frame(srv, s) : handle_handshake(srv, s);
+        if (used < 0) {
+            s->closing = true;
+            break;
+        }
+        if (used == 0) break;
+        memmove(s->buf, s->buf + used, s->len - (size_t)used);
+        s->len -= (size_t)used;
+    }
+}
+
+static void accept_client(httpd_server_t *srv)
+{
+    int fd = accept(srv->listen_fd, NULL, NULL);
+    if (fd < 0) return;
+
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+    pthread_mutex_lock(&srv->sess_lock);
+    httpd_sess_t *slot = find_sess(srv, -1);
+    if (slot) {
+        memset(slot, 0, sizeof(*slot));
+        slot->fd = fd;
+    }
+    pthread_mutex_unlock(&srv->sess_lock);
+
+    if (!slot) {
+        ESP_LOGW(TAG, "No free sessions (max_open_sockets=%d), closing fd=%d",
+                 srv->config.max_open_sockets, fd);
+        close(fd);
+    }
+}
+
+static void *server_task(void *arg)
+{
+    httpd_server_t *srv = arg;
+    int max = srv->config.max_open_sockets;
+    struct pollfd *pfds = calloc((size_t)max + 2, sizeof(*pfds));
+    int *map = calloc((size_t)max + 2, sizeof(int));
+    if (!pfds || !map) {
+        free(pfds);
+        free(map);
+        return NULL;
+    }
+
+    while (!srv->stop) {
+        int n = 0;
+        pfds[n++] = (struct pollfd){ .fd = srv->listen_fd, .events = POLLIN };
+        pfds[n++] = (struct pollfd){ .fd = srv->wake_pipe[0], .events = POLLIN };
+        for (int i = 0; i < max; i++) {
+            if (srv->sessions[i].fd >= 0) {
+                map[n] = i;
+                pfds[n++] = (struct pollfd){ .fd = srv->sessions[i].fd, .events = POLLIN };
+            }
+        }
+
+        if (poll(pfds, (nfds_t)n, 1000) < 0) {
+            if (errno == EINTR) continue;
+            break;
+        }
+        if (srv->stop) break;
+
+        if (pfds[1].revents & POLLIN) {
+            char drain[64];
+            (void)!read(srv->wake_pipe[0], drain, sizeof(drain));
+        }
+        for (int i = 2; i < n; i++) {
+            httpd_sess_t *s = &srv->sessions[map[i]];
+            if (pfds[i].revents & (POLLIN | POLLHUP | POLLERR)) on_readable(srv, s);
+            if (s->closing) close_sess(srv, s);
+        }
+        for (int i = 0; i < max; i++) {
+            if (srv->sessions[i].fd >= 0 && srv->sessions[i].closing) {
+                close_sess(srv, &srv->sessions[i]);
+            }
+        }
+        if (pfds[0].revents & POLLIN) accept_client(srv);
+    }
+
+    free(pfds);
+    free(map);
+    return NULL;
+}
+
+/* ── Public API ────────────────────────────────────────────────── */
+
+esp_err_t httpd_start(httpd_handle_t *handle, const httpd_config_t *config)
+{
+    if (!handle || !config) return ESP_ERR_INVALID_ARG;
+
+    httpd_server_t *srv = calloc(1, sizeof(*srv));
+    if (!srv) return ESP_ERR_HTTPD_ALLOC_MEM;
+    srv->config = *config;
+    srv->sessions = calloc(config->max_open_sockets, sizeof(httpd_sess_t));
+    if (!srv->sessions) {
+        free(srv);
+        return ESP_ERR_HTTPD_ALLOC_MEM;
+    }
+    for (int i = 0; i < config->max_open_sockets; i++) srv->sessions[i].fd = -1;
+    pthread_mutex_init(&srv->send_lock, NULL);
+    pthread_mutex_init(&srv->sess_lock, NULL);
+
+    srv->listen_fd = socket(AF_INET6, SOCK_STREAM, 0);
+    int one = 1, zero = 0;
+    setsockopt(srv->listen_fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    setsockopt(srv->listen_fd, IPPROTO_IPV6, IPV6_V6ONLY, &zero, sizeof(zero));
+    struct sockaddr_in6 addr = {
+        .sin6_family = AF_INET6,
+        .sin6_port = htons(config->server_port),
+        .sin6_addr = in6addr_any,
+    };
+    if (srv->listen_fd < 0
+        || bind(srv->listen_fd, (struct sockaddr *)&addr, sizeof(addr)) != 0
+        || listen(srv->listen_fd, config->backlog_conn > 0 ? config->backlog_conn : 5) != 0
+        || pipe(srv->wake_pipe) != 0) {
+        ESP_LOGE(TAG, "Failed to listen on port %d: %s", config->server_port, strerror(errno));
+        if (srv->listen_fd >= 0) close(srv->listen_fd);
+        free(srv->sessions);
+        free(srv);
+        return ESP_ERR_HTTPD_TASK;
+    }
+
+    if (pthread_create(&srv->thread, NULL, server_task, srv) != 0) {
+        close(srv->listen_fd);
+        close(srv->wake_pipe[0]);
+        close(srv->wake_pipe[1]);
+        free(srv->sessions);
+        free(srv);
+        return ESP_ERR_HTTPD_TASK;
+    }
+    pthread_setname_np(srv->thread, "httpd");
+    *handle = srv;
+    return ESP_OK;
+}
+
+esp_err_t httpd_stop(httpd_handle_t handle)
+{
+    httpd_server_t *srv = handle;
+    if (!srv) return ESP_ERR_INVALID_ARG;
+    srv->stop = true;
+    wake(srv);
+    pthread_join(srv->thread, NULL);
+
+    for (int i = 0; i < srv->config.max_open_sockets; i++) {
+        if (srv->sessions[i].fd >= 0) close_sess(srv, &srv->sessions[i]);
+    }
+    close(srv->listen_fd);
+    close(srv->wake_pipe[0]);
+    close(srv->wake_pipe[1]);
+    pthread_mutex_destroy(&srv->send_lock);
+    pthread_mutex_destroy(&srv->sess_lock);
+    free(srv->sessions);
+    free(srv);
+    return ESP_OK;
+}
+
+esp_err_t httpd_register_uri_handler(httpd_handle_t handle, const httpd_uri_t *uri_handler)
+{
+    httpd_server_t *srv = handle;
+    if (!srv || !uri_handler) return ESP_ERR_INVALID_ARG;
+    if (srv->handler_count >= HTTPD_MAX_HANDLERS) return ESP_ERR_HTTPD_HANDLERS_FULL;
+    if (match_uri(srv, uri_handler->uri)) return ESP_ERR_HTTPD_HANDLER_EXISTS;
+    srv->handlers[srv->handler_count++] = *uri_handler;
+    return ESP_OK;
+}
+
+int httpd_req_to_sockfd(httpd_req_t *r)
+{
+    return r->aux ? ((httpd_req_aux_t *)r->aux)->fd : -1;
+}
+
+esp_err_t httpd_ws_recv_frame(httpd_req_t *req, httpd_ws_frame_t *pkt, size_t max_len)
+{
+    httpd_req_aux_t *aux = req->aux;
+    if (!aux || !pkt) return ESP_ERR_INVALID_ARG;
+
+    pkt->type = aux->type;
+    pkt->final = aux->final;
+    pkt->fragmented = !aux->final;
+    pkt->len = aux->len;
+    if (max_len == 0) return ESP_OK;
+    if (!pkt->payload) return ESP_ERR_INVALID_ARG;
+    if (max_len < aux->len) return ESP_ERR_INVALID_SIZE;
+    memcpy(pkt->payload, aux->payload, aux->len);
+    return ESP_OK;
+}
+
+esp_err_t httpd_ws_send_frame(httpd_req_t *req, httpd_ws_frame_t *pkt)
+{
+    return httpd_ws_send_frame_async(req->handle, httpd_req_to_sockfd(req), pkt);
+}
+
+esp_err_t httpd_ws_send_frame_async(httpd_handle_t hd, int fd, httpd_ws_frame_t *frame)
+{
+    httpd_server_t *srv = hd;
+    if (!srv || !frame || fd < 0) return ESP_ERR_INVALID_ARG;
+
+    pthread_mutex_lock(&srv->sess_lock);
+    httpd_sess_t *s = find_sess(srv, fd);
+    bool ok = s && s->upgraded && !s->closing;
+    pthread_mutex_unlock(&srv->sess_lock);
+    if (!ok) return ESP_ERR_INVALID_ARG;
+
+    return send_frame(srv, fd, frame->type, frame->payload, frame->len);
+}
+
+esp_err_t httpd_sess_trigger_close(httpd_handle_t handle, int sockfd)
+{
+    httpd_server_t *srv = handle;
+    pthread_mutex_lock(&srv->sess_lock);
+    httpd_sess_t *s = find_sess(srv, sockfd);
+    if (s) s->closing = true;
+    pthread_mutex_unlock(&srv->sess_lock);
+    if (!s) return ESP_ERR_NOT_FOUND;
+    wake(srv);
+    return ESP_OK;
+}
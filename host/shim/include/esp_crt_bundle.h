@@ -0,0 +1,10 @@
+#pragma once
+
+#include "esp_err.h"
+
+/* libcurl verifies TLS against the system CA store on the host. */
+static inline esp_err_t esp_crt_bundle_attach(void *conf)
+{
+    (void)conf;
+    return ESP_OK;
+}
@@ -0,0 +1,12 @@
+#pragma once
+
+#include <stdint.h>
+#include "esp_err.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+
+typedef const char *esp_event_base_t;
+typedef void *esp_event_handler_t;
+
+esp_err_t esp_event_loop_create_default(void);
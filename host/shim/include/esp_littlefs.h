@@ -0,0 +1,23 @@
+#pragma once
+
+/* Host shim: LittleFS (joltwallet/littlefs) maps to the same directory as
+ * SPIFFS, with real subdirectories; see host_flash.h. */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "esp_err.h"
+
+typedef struct {
+    const char *base_path;
+    const char *partition_label;
+    const void *partition;
+    bool format_if_mount_failed;
+    bool read_only;
+    bool dont_mount;
+    bool grow_on_mount;
+} esp_vfs_littlefs_conf_t;
+
+esp_err_t esp_vfs_littlefs_register(const esp_vfs_littlefs_conf_t *conf);
+esp_err_t esp_vfs_littlefs_unregister(const char *partition_label);
+esp_err_t esp_littlefs_format(const char *partition_label);
+esp_err_t esp_littlefs_info(const char *partition_label, size_t *total_bytes, size_t *used_bytes);
@@ -0,0 +1,17 @@
+#pragma once
+
+#include <stdint.h>
+#include "esp_err.h"
+
+typedef void (*shutdown_handler_t)(void);
+
+/** Handlers run by esp_restart() before it exits, most recent first. */
+esp_err_t esp_register_shutdown_handler(shutdown_handler_t handle);
+
+/** Run the registered shutdown handlers, as esp_restart() does (host only). */
+void host_run_shutdown_handlers(void);
+
+/** Exits the host process; the runner script decides whether to relaunch. */
+void esp_restart(void) __attribute__((noreturn));
+
+uint32_t esp_get_free_heap_size(void);
@@ -0,0 +1,31 @@
+#pragma once
+
+/* Host shim for the FreeRTOS subset MimiClaw uses, backed by pthreads.
+ * One tick is one millisecond. */
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+typedef int32_t  BaseType_t;
+typedef uint32_t UBaseType_t;
+typedef uint32_t TickType_t;
+
+#define pdFALSE          ((BaseType_t)0)
+#define pdTRUE           ((BaseType_t)1)
+#define pdFAIL           pdFALSE
+#define pdPASS           pdTRUE
+#define errQUEUE_EMPTY   ((BaseType_t)0)
+#define errQUEUE_FULL    ((BaseType_t)0)
+
+#define portMAX_DELAY        ((TickType_t)0xffffffffUL)
+#define portTICK_PERIOD_MS   ((TickType_t)1)
+#define configTICK_RATE_HZ   1000
+
+#define pdMS_TO_TICKS(ms)    ((TickType_t)(ms))
+#define pdTICKS_TO_MS(t)     ((uint32_t)(t))
+
+#define tskNO_AFFINITY       0x7FFFFFFF
+
+/** Core the calling task was pinned to (0 for unpinned host threads). */
+BaseType_t xPortGetCoreID(void);
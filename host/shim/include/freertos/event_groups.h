@@ -0,0 +1,13 @@
+#pragma once
+
+#include "freertos/FreeRTOS.h"
+
+typedef uint32_t EventBits_t;
+typedef struct host_event_group *EventGroupHandle_t;
+
+#ifndef BIT0
+#define BIT0 (1UL << 0)
+#define BIT1 (1UL << 1)
+#define BIT2 (1UL << 2)
+#define BIT3 (1UL << 3)
+#endif
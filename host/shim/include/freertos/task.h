@@ -0,0 +1,25 @@
+#pragma once
+
+#include "freertos/FreeRTOS.h"
+
+typedef void (*TaskFunction_t)(void *);
+typedef struct host_task *TaskHandle_t;
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t fn, const char *name,
+                                   uint32_t stack_depth, void *param,
+                                   UBaseType_t priority, TaskHandle_t *out_handle,
+                                   BaseType_t core_id);
+
+static inline BaseType_t xTaskCreate(TaskFunction_t fn, const char *name,
+                                     uint32_t stack_depth, void *param,
+                                     UBaseType_t priority, TaskHandle_t *out_handle)
+{
+    return xTaskCreatePinnedToCore(fn, name, stack_depth, param, priority,
+                                   out_handle, tskNO_AFFINITY);
+}
+
+/** NULL deletes the calling task; otherwise the target is cancelled. */
+void vTaskDelete(TaskHandle_t handle);
+void vTaskDelay(TickType_t ticks);
+TickType_t xTaskGetTickCount(void);
+UBaseType_t uxTaskGetStackHighWaterMark(TaskHandle_t handle);
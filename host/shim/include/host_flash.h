@@ -0,0 +1,39 @@
+#pragma once
+
+/* Host shim: modeled SPIFFS flash wear.
+ *
+ * SPIFFS does not report erase counts, so the host VFS models them from
+ * the writes it sees under MIMI_SPIFFS_BASE. Data is programmed in 256 B
+ * pages carrying 251 bytes each; rewriting or deleting a file obsoletes
+ * its pages plus an index page, and appending rewrites the partial last
+ * page and the index page. Garbage collection erases one 4 KB block for
+ * every HOST_FLASH_PAGES_PER_BLOCK obsolete pages it reclaims. */
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define HOST_FLASH_PAGE_BYTES       256
+#define HOST_FLASH_PAGE_DATA        251
+#define HOST_FLASH_PAGES_PER_BLOCK  16
+
+typedef struct {
+    uint64_t pages_programmed;
+    uint64_t pages_obsoleted;
+    uint64_t bytes_written;     /* as passed to the file API */
+} host_flash_wear_t;
+
+void host_flash_get_wear(host_flash_wear_t *out);
+
+static inline double host_flash_erases(const host_flash_wear_t *w)
+{
+    return (double)w->pages_obsoleted / HOST_FLASH_PAGES_PER_BLOCK;
+}
+
+/* Partition format, emulated by esp_core.c. SPIFFS mounts make the VFS
+ * flat (readdir of the mount point lists every file, fopen creates
+ * parents); LittleFS mounts show the real directories. host_main sets the
+ * format of a fresh data directory from MIMI_HOST_FS. */
+#define HOST_FS_RECORD MIMI_SPIFFS_BASE ".fs"
+
+void host_flash_set_flat(bool flat);
+void host_fs_set_format(const char *kind);
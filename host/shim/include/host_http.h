@@ -0,0 +1,27 @@
+#pragma once
+
+/* Host-only hook into the esp_http_client shim. When a responder is
+ * installed, requests are answered in-process instead of going through
+ * libcurl: the body is delivered to the caller's event handler in
+ * buffer_size chunks, as the device client would. Used by the benchmarks
+ * to exercise request building and response parsing without sockets. */
+
+#include "esp_http_client.h"
+
+typedef struct {
+    const char *url;                    /* after MIMI_HOST_UPSTREAM rewrite */
+    esp_http_client_method_t method;
+    const char *body;
+    int body_len;
+} host_http_request_t;
+
+/**
+ * Produce the response for one request.
+ * Set *resp / *resp_len to a buffer that stays valid until the next call
+ * and return the HTTP status, or a negative value to fail the request.
+ */
+typedef int (*host_http_responder_t)(const host_http_request_t *req,
+                                     const char **resp, int *resp_len, void *ctx);
+
+/** Install (or with NULL, remove) the process-wide responder. */
+void host_http_set_responder(host_http_responder_t responder, void *ctx);
@@ -0,0 +1,394 @@
+/* Host NVS: a flat table of (namespace, key) entries held in memory and
+ * rewritten to a text file on every commit. One line per entry:
+ *   <namespace>\t<key>\t<type>\t<escaped value>
+ */
+
+#include <inttypes.h>
+#include <stdbool.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "nvs.h"
+#include "nvs_flash.h"
+
+#define NVS_MAX_ENTRIES   128
+#define NVS_MAX_HANDLES   32
+#define NVS_NAME_MAX      16    /* NVS_KEY_NAME_MAX_SIZE on device */
+
+typedef enum { NVS_T_STR = 's', NVS_T_I64 = 'q', NVS_T_U32 = 'u', NVS_T_U16 = 'h', NVS_T_U8 = 'b' } nvs_type_t;
+
+typedef struct {
+    char ns[NVS_NAME_MAX];
+    char key[NVS_NAME_MAX];
+    char type;
+    char *value;    /* strings verbatim, integers in decimal */
+} nvs_entry_t;
+
+typedef struct {
+    bool used;
+    bool writable;
+    char ns[NVS_NAME_MAX];
+} nvs_open_handle_t;
+
+static nvs_entry_t s_entries[NVS_MAX_ENTRIES];
+static int s_entry_count = 0;
+static nvs_open_handle_t s_handles[NVS_MAX_HANDLES];
+static bool s_initialized = false;
+static pthread_mutex_t s_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static const char *nvs_file(void)
+{
+    const char *path = getenv("MIMI_HOST_NVS_FILE");
+    return path ? path : "nvs.txt";
+}
+
+/* ── Persistence ───────────────────────────────────────────────── */
+
+static void write_escaped(FILE *f, const char *s)
+{
+    for (; *s; s++) {
+        switch (*s) {
+        case '\n': fputs("\\n", f); break;
+        case '\t': fputs("\\t", f); break;
+        case '\\': fputs("\\\\", f); break;
+        default:   fputc(*s, f); break;
+        }
+    }
+}
+
+static void unescape_in_place(char *s)
+{
+    char *w = s;
+    for (char *r = s; *r; r++) {
+        if (*r == '\\' && r[1]) {
+            r++;
+            *w++ = (*r == 'n') ? '\n' : (*r == 't') ? '\t' : *r;
+        } else {
+            *w++ = *r;
+        }
+    }
+    *w = '\0';
+}
+
+static void save_locked(void)
+{
+    char tmp[512];
+    snprintf(tmp, sizeof(tmp), "%s.tmp", nvs_file());
+    FILE *f = fopen(tmp, "w");
+    if (!f) return;
+    for (int i = 0; i < s_entry_count; i++) {
+        fprintf(f, "%s\t%s\t%c\t", s_entries[i].ns, s_entries[i].key, s_entries[i].type);
+        write_escaped(f, s_entries[i].value);
+        fputc('\n', f);
+    }
+    fclose(f);
+    rename(tmp, nvs_file());
+}
+
+static void load_locked(void)
+{
+    FILE *f = fopen(nvs_file(), "r");
+    if (!f) return;
+
+    char *line = NULL;
+    size_t cap = 0;
+    ssize_t n;
+    while ((n = getline(&line, &cap, f)) > 0 && s_entry_count < NVS_MAX_ENTRIES) {
+        if (line[n - 1] == '\n') line[n - 1] = '\0';
+        char *ns = strtok(line, "\t");
+        char *key = strtok(NULL, "\t");
+        char *type = strtok(NULL, "\t");
+        char *value = strtok(NULL, "");
+        if (!ns || !key || !type) continue;
+
+        nvs_entry_t *e = &s_entries[s_entry_count++];
+        snprintf(e->ns, sizeof(e->ns), "%s", ns);
+        snprintf(e->key, sizeof(e->key), "%s", key);
+        e->type = type[0];
+        e->value = strdup(value ? value : "");
+        unescape_in_place(e->value);
+    }
+    free(line);
+    fclose(f);
+}
+
+/* ── Lookup ────────────────────────────────────────────────────── */
+
+static nvs_open_handle_t *get_handle(nvs_handle_t handle)
+{
+    if (handle == 0 || handle > NVS_MAX_HANDLES) return NULL;
+    nvs_open_handle_t *h = &s_handles[handle - 1];
+    return h->used ? h : NULL;
+}
+
+static nvs_entry_t *find_entry(const char *ns, const char *key)
+{
+    for (int i = 0; i < s_entry_count; i++) {
+        if (strcmp(s_entries[i].ns, ns) == 0 && strcmp(s_entries[i].key, key) == 0) {
+            return &s_entries[i];
+        }
+    }
+    return NULL;
+}
+
+static esp_err_t set_value(nvs_handle_t handle, const char *key, char type, const char *value)
+{
+    if (!key || strlen(key) >= NVS_NAME_MAX) return ESP_ERR_NVS_INVALID_NAME;
+
+    pthread_mutex_lock(&s_lock);
+    nvs_open_handle_t *h = get_handle(handle);
+    if (!h) {
+        pthread_mutex_unlock(&s_lock);
+        return ESP_ERR_NVS_INVALID_HANDLE;
+    }
+    if (!h->writable) {
+        pthread_mutex_unlock(&s_lock);
+        return ESP_ERR_NVS_READ_ONLY;
+    }
+
+    nvs_entry_t *e = find_entry(h->ns, key);
+    if (!e) {
+        if (s_entry_count >= NVS_MAX_ENTRIES) {
+            pthread_mutex_unlock(&s_lock);
+            return ESP_ERR_NVS_NOT_ENOUGH_SPACE;
+        }
+        e = &s_entries[s_entry_count++];
+        snprintf(e->ns, sizeof(e->ns), "%s", h->ns);
+        snprintf(e->key, sizeof(e->key), "%s", key);
+        e->value = NULL;
+    }
+    free(e->value);
+    e->type = type;
+    e->value = strdup(value);
+    pthread_mutex_unlock(&s_lock);
+    return e->value ? ESP_OK : ESP_ERR_NO_MEM;
+}
+
+/* Copies the entry value into out (when given); caller frees nothing */
+static esp_err_t get_value(nvs_handle_t handle, const char *key, char type,
+                           char *out, size_t out_size, size_t *needed)
+{
+    pthread_mutex_lock(&s_lock);
+    nvs_open_handle_t *h = get_handle(handle);
+    if (!h) {
+        pthread_mutex_unlock(&s_lock);
+        return ESP_ERR_NVS_INVALID_HANDLE;
+    }
+    nvs_entry_t *e = find_entry(h->ns, key);
+    if (!e) {
+        pthread_mutex_unlock(&s_lock);
+        return ESP_ERR_NVS_NOT_FOUND;
+    }
+    if (e->type != type) {
+        pthread_mutex_unlock(&s_lock);
+        return ESP_ERR_NVS_TYPE_MISMATCH;
+    }
+
+    size_t len = strlen(e->value) + 1;
+    if (needed) *needed = len;
+    esp_err_t ret = ESP_OK;
+    if (out) {
+        if (out_size < len) {
+            ret = ESP_ERR_NVS_INVALID_LENGTH;
+        } else {
+            memcpy(out, e->value, len);
+        }
+    }
+    pthread_mutex_unlock(&s_lock);
+    return ret;
+}
+
+/* ── Flash / handles ───────────────────────────────────────────── */
+
+esp_err_t nvs_flash_init(void)
+{
+    pthread_mutex_lock(&s_lock);
+    if (!s_initialized) {
+        load_locked();
+        s_initialized = true;
+    }
+    pthread_mutex_unlock(&s_lock);
+    return ESP_OK;
+}
+
+esp_err_t nvs_flash_erase(void)
+{
+    pthread_mutex_lock(&s_lock);
+    for (int i = 0; i < s_entry_count; i++) free(s_entries[i].value);
+    s_entry_count = 0;
+    remove(nvs_file());
+    pthread_mutex_unlock(&s_lock);
+    return ESP_OK;
+}
+
+esp_err_t nvs_open(const char *name, nvs_open_mode_t open_mode, nvs_handle_t *out_handle)
+{
+    if (!name || strlen(name) >= NVS_NAME_MAX || !out_handle) return ESP_ERR_NVS_INVALID_NAME;
+
+    pthread_mutex_lock(&s_lock);
+    if (!s_initialized) {
+        pthread_mutex_unlock(&s_lock);
+        return ESP_ERR_NVS_NOT_INITIALIZED;
+    }
+
+    /* Like the device, a read-only open of an unknown namespace fails */
+    if (open_mode == NVS_READONLY) {
+        bool found = false;
+        for (int i = 0; i < s_entry_count && !found; i++) {
+            found = strcmp(s_entries[i].ns, name) == 0;
+        }
+        if (!found) {
+            pthread_mutex_unlock(&s_lock);
+            return ESP_ERR_NVS_NOT_FOUND;
+        }
+    }
+
+    for (int i = 0; i < NVS_MAX_HANDLES; i++) {
+        if (!s_handles[i].used) {
+            s_handles[i].used = true;
+            s_handles[i].writable = (open_mode == NVS_READWRITE);
+            snprintf(s_handles[i].ns, sizeof(s_handles[i].ns), "%s", name);
+            *out_handle = (nvs_handle_t)(i + 1);
+            pthread_mutex_unlock(&s_lock);
+            return ESP_OK;
+        }
+    }
+    pthread_mutex_unlock(&s_lock);
+    return ESP_ERR_NO_MEM;
+}
+
+void nvs_close(nvs_handle_t handle)
+{
+    pthread_mutex_lock(&s_lock);
+    nvs_open_handle_t *h = get_handle(handle);
+    if (h) h->used = false;
+    pthread_mutex_unlock(&s_lock);
+}
+
+esp_err_t nvs_commit(nvs_handle_t handle)
+{
+    pthread_mutex_lock(&s_lock);
+    esp_err_t ret = get_handle(handle) ? ESP_OK : ESP_ERR_NVS_INVALID_HANDLE;
+    if (ret == ESP_OK) save_locked();
+    pthread_mutex_unlock(&s_lock);
+    return ret;
+}
+
+esp_err_t nvs_erase_key(nvs_handle_t handle, const char *key)
+{
+    pthread_mutex_lock(&s_lock);
+    nvs_open_handle_t *h = get_handle(handle);
+    if (!h) {
+        pthread_mutex_unlock(&s_lock);
+        return ESP_ERR_NVS_INVALID_HANDLE;
+    }
+    nvs_entry_t *e = find_entry(h->ns, key);
+    if (!e) {
+        pthread_mutex_unlock(&s_lock);
+        return ESP_ERR_NVS_NOT_FOUND;
+    }
+    free(e->value);
+    *e = s_entries[--s_entry_count];
+    pthread_mutex_unlock(&s_lock);
+    return ESP_OK;
+}
+
+esp_err_t nvs_erase_all(nvs_handle_t handle)
+{
+    pthread_mutex_lock(&s_lock);
+    nvs_open_handle_t *h = get_handle(handle);
+    if (!h) {
+        pthread_mutex_unlock(&s_lock);
+        return ESP_ERR_NVS_INVALID_HANDLE;
+    }
+    for (int i = s_entry_count - 1; i >= 0; i--) {
+        if (strcmp(s_entries[i].ns, h->ns) == 0) {
+            free(s_entries[i].value);
+            s_entries[i] = s_entries[--s_entry_count];
+        }
+    }
+    pthread_mutex_unlock(&s_lock);
+    return ESP_OK;
+}
+
+/* ── Typed accessors ───────────────────────────────────────────── */
+
+esp_err_t nvs_set_str(nvs_handle_t handle, const char *key, const char *value)
+{
+    return set_value(handle, key, NVS_T_STR, value);
+}
+
+esp_err_t nvs_get_str(nvs_handle_t handle, const char *key, char *out_value, size_t *length)
+{
+    if (!length) return ESP_ERR_INVALID_ARG;
+    size_t needed = 0;
+    esp_err_t ret = get_value(handle, key, NVS_T_STR, out_value, *length, &needed);
+    if (ret == ESP_OK || ret == ESP_ERR_NVS_INVALID_LENGTH) *length = needed;
+    return ret;
+}
+
+static esp_err_t set_int(nvs_handle_t handle, const char *key, char type, int64_t value)
+{
+    char buf[24];
+    snprintf(buf, sizeof(buf), "%" PRId64, value);
+    return set_value(handle, key, type, buf);
+}
+
+static esp_err_t get_int(nvs_handle_t handle, const char *key, char type, int64_t *out)
+{
+    char buf[24];
+    esp_err_t ret = get_value(handle, key, type, buf, sizeof(buf), NULL);
+    if (ret == ESP_OK) *out = strtoll(buf, NULL, 10);
+    return ret;
+}
+
+esp_err_t nvs_set_i64(nvs_handle_t handle, const char *key, int64_t value)
+{
+    return set_int(handle, key, NVS_T_I64, value);
+}
+
+esp_err_t nvs_get_i64(nvs_handle_t handle, const char *key, int64_t *out_value)
+{
+    return get_int(handle, key, NVS_T_I64, out_value);
+}
+
+esp_err_t nvs_set_u32(nvs_handle_t handle, const char *key, uint32_t value)
+{
+    return set_int(handle, key, NVS_T_U32, value);
+}
+
+esp_err_t nvs_get_u32(nvs_handle_t handle, const char *key, uint32_t *out_value)
+{
+    int64_t v = 0;
+    esp_err_t ret = get_int(handle, key, NVS_T_U32, &v);
+    if (ret == ESP_OK) *out_value = (uint32_t)v;
+    return ret;
+}
+
+esp_err_t nvs_set_u16(nvs_handle_t handle, const char *key, uint16_t value)
+{
+    return set_int(handle, key, NVS_T_U16, value);
+}
+
+esp_err_t nvs_get_u16(nvs_handle_t handle, const char *key, uint16_t *out_value)
+{
+    int64_t v = 0;
+    esp_err_t ret = get_int(handle, key, NVS_T_U16, &v);
+    if (ret == ESP_OK) *out_value = (uint16_t)v;
+    return ret;
+}
+
+esp_err_t nvs_set_u8(nvs_handle_t handle, const char *key, uint8_t value)
+{
+    return set_int(handle, key, NVS_T_U8, value);
+}
+
+esp_err_t nvs_get_u8(nvs_handle_t handle, const char *key, uint8_t *out_value)
+{
+    int64_t v = 0;
+    esp_err_t ret = get_int(handle, key, NVS_T_U8, &v);
+    if (ret == ESP_OK) *out_value = (uint8_t)v;
+    return ret;
+}
@@ -0,0 +1,269 @@
+/* Flat SPIFFS semantics on top of a host directory.
+ *
+ * SPIFFS has no directories: "/spiffs/skills/x.md" is a single object
+ * named "skills/x.md", readdir() of the mount point lists every file with
+ * its embedded slashes, and fopen() for writing never needs a parent to
+ * exist. The firmware relies on all three, so the host build links with
+ * -Wl,--wrap for opendir/readdir/closedir/fopen and emulates them for
+ * paths under MIMI_SPIFFS_BASE. Everything else passes straight through.
+ *
+ * While LittleFS is mounted (host_flash_set_flat(false)) the directory is
+ * used as it is, with real subdirectories that must exist before a file
+ * is created in them.
+ *
+ * fclose/remove/rename are wrapped too, to feed the wear model in
+ * host_flash.h. */
+
+#include <dirent.h>
+#include <errno.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include "mimi_config.h"
+#include "host_flash.h"
+
+DIR *__real_opendir(const char *name);
+struct dirent *__real_readdir(DIR *dirp);
+int __real_closedir(DIR *dirp);
+FILE *__real_fopen(const char *path, const char *mode);
+int __real_fclose(FILE *f);
+int __real_remove(const char *path);
+int __real_rename(const char *from, const char *to);
+
+typedef struct {
+    uint32_t magic;
+    char **names;
+    size_t count;
+    size_t cap;
+    size_t pos;
+    struct dirent ent;
+} flat_dir_t;
+
+#define FLAT_DIR_MAGIC 0x5350464Cu  /* "SPFL" */
+
+static volatile bool s_flat = true;
+
+void host_flash_set_flat(bool flat)
+{
+    s_flat = flat;
+}
+
+static bool is_spiffs_root(const char *path)
+{
+    size_t n = strlen(MIMI_SPIFFS_BASE);
+    if (strncmp(path, MIMI_SPIFFS_BASE, n) != 0) return false;
+    return path[n] == '\0' || (path[n] == '/' && path[n + 1] == '\0');
+}
+
+static bool is_under_spiffs(const char *path)
+{
+    size_t n = strlen(MIMI_SPIFFS_BASE);
+    return strncmp(path, MIMI_SPIFFS_BASE, n) == 0 && path[n] == '/';
+}
+
+static void collect(flat_dir_t *fd, const char *abs, const char *rel)
+{
+    DIR *d = __real_opendir(abs);
+    if (!d) return;
+    struct dirent *e;
+    while ((e = __real_readdir(d)) != NULL) {
+        if (e->d_name[0] == '.') continue;
+        char abs_child[PATH_MAX], rel_child[PATH_MAX];
+        snprintf(abs_child, sizeof(abs_child), "%s/%s", abs, e->d_name);
+        snprintf(rel_child, sizeof(rel_child), "%s%s%s", rel, rel[0] ? "/" : "", e->d_name);
+
+        struct stat st;
+        if (stat(abs_child, &st) != 0) continue;
+        if (S_ISDIR(st.st_mode)) {
+            collect(fd, abs_child, rel_child);
+        } else if (S_ISREG(st.st_mode)) {
+            if (fd->count == fd->cap) {
+                size_t cap = fd->cap ? fd->cap * 2 : 32;
+                char **n = realloc(fd->names, cap * sizeof(char *));
+                if (!n) break;
+                fd->names = n;
+                fd->cap = cap;
+            }
+            fd->names[fd->count++] = strdup(rel_child);
+        }
+    }
+    __real_closedir(d);
+}
+
+DIR *__wrap_opendir(const char *name)
+{
+    if (!name || !s_flat || !is_spiffs_root(name)) return __real_opendir(name);
+
+    flat_dir_t *fd = calloc(1, sizeof(*fd));
+    if (!fd) return NULL;
+    fd->magic = FLAT_DIR_MAGIC;
+    collect(fd, MIMI_SPIFFS_BASE, "");
+    return (DIR *)fd;
+}
+
+struct dirent *__wrap_readdir(DIR *dirp)
+{
+    flat_dir_t *fd = (flat_dir_t *)dirp;
+    if (!fd || fd->magic != FLAT_DIR_MAGIC) return __real_readdir(dirp);
+
+    if (fd->pos >= fd->count) return NULL;
+    memset(&fd->ent, 0, sizeof(fd->ent));
+    fd->ent.d_type = DT_REG;
+    snprintf(fd->ent.d_name, sizeof(fd->ent.d_name), "%s", fd->names[fd->pos++]);
+    return &fd->ent;
+}
+
+int __wrap_closedir(DIR *dirp)
+{
+    flat_dir_t *fd = (flat_dir_t *)dirp;
+    if (!fd || fd->magic != FLAT_DIR_MAGIC) return __real_closedir(dirp);
+
+    for (size_t i = 0; i < fd->count; i++) free(fd->names[i]);
+    free(fd->names);
+    fd->magic = 0;
+    free(fd);
+    return 0;
+}
+
+/* ── Wear model ──────────────────────────────────────────────── */
+
+/* Streams open for writing under the mount, with the size they found */
+typedef struct {
+    FILE *f;
+    char path[PATH_MAX];
+    long old_size;
+    bool append;
+} wear_stream_t;
+
+#define WEAR_MAX_STREAMS 32
+
+static pthread_mutex_t s_wear_lock = PTHREAD_MUTEX_INITIALIZER;
+static wear_stream_t s_streams[WEAR_MAX_STREAMS];
+static host_flash_wear_t s_wear;
+
+static uint64_t pages(long bytes)
+{
+    return bytes > 0 ? (uint64_t)((bytes + HOST_FLASH_PAGE_DATA - 1) / HOST_FLASH_PAGE_DATA) : 0;
+}
+
+static long file_size(const char *path)
+{
+    struct stat st;
+    return stat(path, &st) == 0 ? (long)st.st_size : -1;
+}
+
+static void wear_track(FILE *f, const char *path, const char *mode, long old_size)
+{
+    pthread_mutex_lock(&s_wear_lock);
+    for (int i = 0; i < WEAR_MAX_STREAMS; i++) {
+        if (s_streams[i].f) continue;
+        s_streams[i].f = f;
+        snprintf(s_streams[i].path, sizeof(s_streams[i].path), "%s", path);
+        s_streams[i].old_size = old_size;
+        s_streams[i].append = mode[0] == 'a';
+        break;
+    }
+    pthread_mutex_unlock(&s_wear_lock);
+}
+
+void host_flash_get_wear(host_flash_wear_t *out)
+{
+    pthread_mutex_lock(&s_wear_lock);
+    *out = s_wear;
+    pthread_mutex_unlock(&s_wear_lock);
+}
+
+int __wrap_fclose(FILE *f)
+{
+    wear_stream_t ws = {0};
+    pthread_mutex_lock(&s_wear_lock);
+    for (int i = 0; i < WEAR_MAX_STREAMS; i++) {
+        if (s_streams[i].f == f) {
+            ws = s_streams[i];
+            s_streams[i].f = NULL;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&s_wear_lock);
+
+    int rc = __real_fclose(f);
+    if (!ws.f) return rc;
+
+    long size = file_size(ws.path);
+    if (size < 0) return rc;
+    long old = ws.old_size > 0 ? ws.old_size : 0;
+
+    pthread_mutex_lock(&s_wear_lock);
+    if (ws.append && ws.old_size >= 0) {
+        long added = size - old;
+        if (added > 0) {
+            /* Partial last page and index page are rewritten */
+            bool partial = old % HOST_FLASH_PAGE_DATA != 0;
+            s_wear.pages_programmed += pages(size) - pages(old) + (partial ? 1 : 0) + 1;
+            s_wear.pages_obsoleted += (partial ? 1 : 0) + 1;
+            s_wear.bytes_written += (uint64_t)added;
+        }
+    } else {
+        if (ws.old_size >= 0) s_wear.pages_obsoleted += pages(old) + 1;
+        s_wear.pages_programmed += pages(size) + 1;
+        s_wear.bytes_written += (uint64_t)size;
+    }
+    pthread_mutex_unlock(&s_wear_lock);
+    return rc;
+}
+
+int __wrap_remove(const char *path)
+{
+    long size = path && is_under_spiffs(path) ? file_size(path) : -1;
+    int rc = __real_remove(path);
+    if (rc == 0 && size >= 0) {
+        pthread_mutex_lock(&s_wear_lock);
+        s_wear.pages_obsoleted += pages(size) + 1;
+        pthread_mutex_unlock(&s_wear_lock);
+    }
+    return rc;
+}
+
+int __wrap_rename(const char *from, const char *to)
+{
+    bool tracked = from && is_under_spiffs(from);
+    long replaced = tracked && to ? file_size(to) : -1;
+    int rc = __real_rename(from, to);
+    if (rc == 0 && tracked) {
+        /* The index page is rewritten with the new name */
+        pthread_mutex_lock(&s_wear_lock);
+        s_wear.pages_programmed += 1;
+        s_wear.pages_obsoleted += 1 + (replaced >= 0 ? pages(replaced) + 1 : 0);
+        pthread_mutex_unlock(&s_wear_lock);
+    }
+    return rc;
+}
+
+/* ── fopen ───────────────────────────────────────────────────── */
+
+FILE *__wrap_fopen(const char *path, const char *mode)
+{
+    bool tracked = path && mode && mode[0] != 'r' && is_under_spiffs(path);
+    /* Before "w" truncates it */
+    long old_size = tracked ? file_size(path) : -1;
+    if (tracked && s_flat) {
+        char dir[PATH_MAX];
+        snprintf(dir, sizeof(dir), "%s", path);
+        for (char *p = dir + strlen(MIMI_SPIFFS_BASE) + 1; *p; p++) {
+            if (*p == '/') {
+                *p = '\0';
+                if (mkdir(dir, 0755) != 0 && errno != EEXIST) break;
+                *p = '/';
+            }
+        }
+    }
+    FILE *f = __real_fopen(path, mode);
+    if (f && tracked) wear_track(f, path, mode, old_size);
+    return f;
+}
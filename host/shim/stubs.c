@@ -0,0 +1,113 @@
+/* Host replacements for modules that only make sense on the device:
+ * WiFi (the host network is always up), the HTTP CONNECT proxy (libcurl
+ * honours the usual proxy environment variables), Feishu (not mocked) and
+ * the UART console. The get_time tool's settimeofday() is also intercepted
+ * so benchmarks never touch the workstation clock. */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <sys/time.h>
+
+#include "esp_log.h"
+#include "wifi/wifi_manager.h"
+#include "proxy/http_proxy.h"
+#include "channels/feishu/feishu_bot.h"
+#include "cli/serial_cli.h"
+
+static const char *TAG = "host";
+
+/* ── WiFi ──────────────────────────────────────────────────────── */
+
+esp_err_t wifi_manager_init(void) { return ESP_OK; }
+esp_err_t wifi_manager_start(void) { return ESP_OK; }
+esp_err_t wifi_manager_wait_connected(uint32_t timeout_ms) { (void)timeout_ms; return ESP_OK; }
+bool wifi_manager_is_connected(void) { return true; }
+const char *wifi_manager_get_ip(void) { return "127.0.0.1"; }
+EventGroupHandle_t wifi_manager_get_event_group(void) { return NULL; }
+void wifi_manager_scan_and_print(void) { }
+
+esp_err_t wifi_manager_set_credentials(const char *ssid, const char *password)
+{
+    (void)ssid;
+    (void)password;
+    return ESP_OK;
+}
+
+/* ── HTTP proxy ────────────────────────────────────────────────── */
+
+esp_err_t http_proxy_init(void) { return ESP_OK; }
+bool http_proxy_is_enabled(void) { return false; }
+esp_err_t http_proxy_clear(void) { return ESP_OK; }
+
+esp_err_t http_proxy_set(const char *host, uint16_t port, const char *type)
+{
+    (void)host;
+    (void)port;
+    (void)type;
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+proxy_conn_t *proxy_conn_open(const char *host, int port, int timeout_ms)
+{
+    (void)host;
+    (void)port;
+    (void)timeout_ms;
+    return NULL;
+}
+
+int proxy_conn_write(proxy_conn_t *conn, const char *data, int len)
+{
+    (void)conn;
+    (void)data;
+    (void)len;
+    return -1;
+}
+
+int proxy_conn_read(proxy_conn_t *conn, char *buf, int len, int timeout_ms)
+{
+    (void)conn;
+    (void)buf;
+    (void)len;
+    (void)timeout_ms;
+    return -1;
+}
+
+void proxy_conn_close(proxy_conn_t *conn) { (void)conn; }
+
+/* ── Feishu ────────────────────────────────────────────────────── */
+
+esp_err_t feishu_bot_init(void) { return ESP_OK; }
+esp_err_t feishu_bot_start(void) { return ESP_OK; }
+
+esp_err_t feishu_send_message(const char *chat_id, const char *text)
+{
+    (void)text;
+    ESP_LOGW(TAG, "Feishu is not available on host, dropping reply to %s", chat_id);
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+esp_err_t feishu_reply_message(const char *message_id, const char *text)
+{
+    return feishu_send_message(message_id, text);
+}
+
+esp_err_t feishu_set_credentials(const char *app_id, const char *app_secret)
+{
+    (void)app_id;
+    (void)app_secret;
+    return ESP_OK;
+}
+
+/* ── Serial CLI ────────────────────────────────────────────────── */
+
+esp_err_t serial_cli_init(void) { return ESP_OK; }
+
+/* ── Clock ─────────────────────────────────────────────────────── */
+
+int __wrap_settimeofday(const struct timeval *tv, const void *tz)
+{
+    (void)tz;
+    ESP_LOGI(TAG, "settimeofday(%lld) ignored on host", tv ? (long long)tv->tv_sec : 0LL);
+    return 0;
+}
@@ -1,5 +1,6 @@
 #include "agent_loop.h"
 #include "agent/context_builder.h"
+#include "agent/tool_digest.h"
 #include "mimi_config.h"
 #include "bus/message_bus.h"
 #include "llm/llm_proxy.h"
@@ -18,6 +19,8 @@ static const char *TAG = "agent";
 
 #define TOOL_OUTPUT_SIZE  (8 * 1024)
 
+static agent_stats_t s_stats = {0};
+
 /* Build the assistant content array from llm_response_t for the messages history.
  * Returns a cJSON array with text and tool_use blocks. */
 static cJSON *build_assistant_content(const llm_response_t *resp)
@@ -80,8 +83,8 @@ static void append_turn_context_prompt(char *prompt, size_t size, const mimi_msg
         "- source_chat_id: %s\n"
         "- If using cron_add for Telegram in this turn, set channel='telegram' and chat_id to source_chat_id.\n"
         "- Never use chat_id 'cron' for Telegram messages.\n",
-        msg->channel[0] ? msg->channel : "(unknown)",
-        msg->chat_id[0] ? msg->chat_id : "(empty)");
+        mimi_msg_channel(msg)[0] ? mimi_msg_channel(msg) : "(unknown)",
+        mimi_msg_chat_id(msg)[0] ? mimi_msg_chat_id(msg) : "(empty)");
 
     if (n < 0 || (size_t)n >= (size - off)) {
         prompt[size - 1] = '\0';
@@ -104,22 +107,24 @@ static char *patch_tool_input_with_context(const llm_tool_call_t *call, const mi
     }
 
     bool changed = false;
+    const char *msg_channel = mimi_msg_channel(msg);
+    const char *msg_chat_id = mimi_msg_chat_id(msg);
 
     cJSON *channel_item = cJSON_GetObjectItem(root, "channel");
     const char *channel = cJSON_IsString(channel_item) ? channel_item->valuestring : NULL;
 
-    if ((!channel || channel[0] == '\0') && msg->channel[0] != '\0') {
-        json_set_string(root, "channel", msg->channel);
-        channel = msg->channel;
+    if ((!channel || channel[0] == '\0') && msg_channel[0] != '\0') {
+        json_set_string(root, "channel", msg_channel);
+        channel = msg_channel;
         changed = true;
     }
 
     if (channel && strcmp(channel, MIMI_CHAN_TELEGRAM) == 0 &&
-        strcmp(msg->channel, MIMI_CHAN_TELEGRAM) == 0 && msg->chat_id[0] != '\0') {
+        msg->chan == MIMI_CHAN_ID_TELEGRAM && msg_chat_id[0] != '\0') {
         cJSON *chat_item = cJSON_GetObjectItem(root, "chat_id");
         const char *chat_id = cJSON_IsString(chat_item) ? chat_item->valuestring : NULL;
         if (!chat_id || chat_id[0] == '\0' || strcmp(chat_id, "cron") == 0) {
-            json_set_string(root, "chat_id", msg->chat_id);
+            json_set_string(root, "chat_id", msg_chat_id);
             changed = true;
         }
     }
@@ -128,7 +133,7 @@ static char *patch_tool_input_with_context(const llm_tool_call_t *call, const mi
     if (changed) {
         patched = cJSON_PrintUnformatted(root);
         if (patched) {
-            ESP_LOGI(TAG, "Patched cron_add target to %s:%s", msg->channel, msg->chat_id);
+            ESP_LOGI(TAG, "Patched cron_add target to %s:%s", msg_channel, msg_chat_id);
         }
     }
 
@@ -136,9 +141,10 @@ static char *patch_tool_input_with_context(const llm_tool_call_t *call, const mi
     return patched;
 }
 
-/* Build the user message with tool_result blocks */
+/* Build the user message with tool_result blocks; each call is also noted in digest */
 static cJSON *build_tool_results(const llm_response_t *resp, const mimi_msg_t *msg,
-                                 char *tool_output, size_t tool_output_size)
+                                 char *tool_output, size_t tool_output_size,
+                                 tool_digest_t *digest)
 {
     cJSON *content = cJSON_CreateArray();
 
@@ -153,6 +159,8 @@ static cJSON *build_tool_results(const llm_response_t *resp, const mimi_msg_t *m
         /* Execute tool */
         tool_output[0] = '\0';
         tool_registry_execute(call->name, tool_input, tool_output, tool_output_size);
+        s_stats.tool_calls++;
+        if (digest) tool_digest_add(digest, call->name, tool_input, tool_output);
         free(patched_input);
 
         ESP_LOGI(TAG, "Tool %s result: %d bytes", call->name, (int)strlen(tool_output));
@@ -190,52 +198,60 @@ static void agent_loop_task(void *arg)
         esp_err_t err = message_bus_pop_inbound(&msg, UINT32_MAX);
         if (err != ESP_OK) continue;
 
-        ESP_LOGI(TAG, "Processing message from %s:%s", msg.channel, msg.chat_id);
+        const char *chat_id = mimi_msg_chat_id(&msg);
+        const char *content = mimi_msg_text(&msg);
+        ESP_LOGI(TAG, "Processing message from %s:%s", mimi_msg_channel(&msg), chat_id);
 
         /* 1. Build system prompt */
-        context_build_system_prompt(system_prompt, MIMI_CONTEXT_BUF_SIZE);
+        context_build_system_prompt(system_prompt, MIMI_CONTEXT_BUF_SIZE, content);
         append_turn_context_prompt(system_prompt, MIMI_CONTEXT_BUF_SIZE, &msg);
-        ESP_LOGI(TAG, "LLM turn context: channel=%s chat_id=%s", msg.channel, msg.chat_id);
+        ESP_LOGI(TAG, "LLM turn context: channel=%s chat_id=%s", mimi_msg_channel(&msg), chat_id);
 
         /* 2. Load session history into cJSON array */
-        session_get_history_json(msg.chat_id, history_json,
-                                 MIMI_LLM_STREAM_BUF_SIZE, MIMI_AGENT_MAX_HISTORY);
+        session_get_history_json(chat_id, history_json,
+                                 MIMI_LLM_STREAM_BUF_SIZE, MIMI_AGENT_HISTORY_RECORDS);
 
         cJSON *messages = cJSON_Parse(history_json);
         if (!messages) messages = cJSON_CreateArray();
+        int replayed = tool_digest_expand(messages, MIMI_AGENT_MAX_HISTORY);
+        s_stats.digests_replayed += replayed;
 
         /* 3. Append current user message */
         cJSON *user_msg = cJSON_CreateObject();
         cJSON_AddStringToObject(user_msg, "role", "user");
-        cJSON_AddStringToObject(user_msg, "content", msg.content);
+        /* msg outlives messages: reference its text rather than copy it */
+        cJSON_AddItemToObject(user_msg, "content", cJSON_CreateStringReference(content));
         cJSON_AddItemToArray(messages, user_msg);
 
         /* 4. ReAct loop */
-        char *final_text = NULL;
+        mimi_payload_t *final_text = NULL;
         int iteration = 0;
+        int llm_calls = 0;
+        uint32_t tool_calls_before = s_stats.tool_calls;
         bool sent_working_status = false;
+        tool_digest_t digest;
+        tool_digest_init(&digest);
 
         while (iteration < MIMI_AGENT_MAX_TOOL_ITER) {
             /* Send "working" indicator before each API call */
 #if MIMI_AGENT_SEND_WORKING_STATUS
-            if (!sent_working_status && strcmp(msg.channel, MIMI_CHAN_SYSTEM) != 0) {
-                mimi_msg_t status = {0};
-                strncpy(status.channel, msg.channel, sizeof(status.channel) - 1);
-                strncpy(status.chat_id, msg.chat_id, sizeof(status.chat_id) - 1);
-                status.content = strdup("\xF0\x9F\x90\xB1mimi is working...");
-                if (status.content) {
-                    if (message_bus_push_outbound(&status) != ESP_OK) {
-                        ESP_LOGW(TAG, "Outbound queue full, drop working status");
-                        free(status.content);
-                    } else {
-                        sent_working_status = true;
-                    }
+            if (!sent_working_status && msg.chan != MIMI_CHAN_ID_SYSTEM) {
+                static mimi_payload_t working = MIMI_PAYLOAD_STATIC("\xF0\x9F\x90\xB1mimi is working...");
+                mimi_msg_t status;
+                mimi_msg_reply(&status, &msg, &working);
+                status.flags = MIMI_MSG_STATUS;     /* dropped if the reply catches up with it */
+                if (message_bus_push_outbound(&status) != ESP_OK) {
+                    ESP_LOGW(TAG, "Outbound queue full, drop working status");
+                    mimi_msg_release(&status);
+                } else {
+                    sent_working_status = true;
                 }
             }
 #endif
 
             llm_response_t resp;
             err = llm_chat_tools(system_prompt, messages, tools_json, &resp);
+            llm_calls++;
 
             if (err != ESP_OK) {
                 ESP_LOGE(TAG, "LLM call failed: %s", esp_err_to_name(err));
@@ -245,7 +261,9 @@ static void agent_loop_task(void *arg)
             if (!resp.tool_use) {
                 /* Normal completion — save final text and break */
                 if (resp.text && resp.text_len > 0) {
-                    final_text = strdup(resp.text);
+                    /* Take the response buffer over instead of copying it */
+                    final_text = mimi_payload_adopt(resp.text);
+                    if (final_text) resp.text = NULL;
                 }
                 llm_response_free(&resp);
                 break;
@@ -260,7 +278,8 @@ static void agent_loop_task(void *arg)
             cJSON_AddItemToArray(messages, asst_msg);
 
             /* Execute tools and append results */
-            cJSON *tool_results = build_tool_results(&resp, &msg, tool_output, TOOL_OUTPUT_SIZE);
+            cJSON *tool_results = build_tool_results(&resp, &msg, tool_output, TOOL_OUTPUT_SIZE,
+                                                     MIMI_AGENT_TOOL_DIGEST ? &digest : NULL);
             cJSON *result_msg = cJSON_CreateObject();
             cJSON_AddStringToObject(result_msg, "role", "user");
             cJSON_AddItemToObject(result_msg, "content", tool_results);
@@ -272,50 +291,58 @@ static void agent_loop_task(void *arg)
 
         cJSON_Delete(messages);
 
+        s_stats.turns++;
+        s_stats.llm_calls += llm_calls;
+        ESP_LOGI(TAG, "Turn for %s: %d LLM call(s), %d tool call(s), %d digest(s) replayed",
+                 chat_id, llm_calls, (int)(s_stats.tool_calls - tool_calls_before), replayed);
+
         /* 5. Send response */
-        if (final_text && final_text[0]) {
-            /* Save to session (only user text + final assistant text) */
-            esp_err_t save_user = session_append(msg.chat_id, "user", msg.content);
-            esp_err_t save_asst = session_append(msg.chat_id, "assistant", final_text);
+        if (final_text && final_text->len > 0) {
+            /* Save to session: user text, the turn's tool digest, final assistant text */
+            esp_err_t save_user = session_append(chat_id, "user", content);
+            char *digest_json = tool_digest_take(&digest);
+            if (digest_json && save_user == ESP_OK &&
+                session_append(chat_id, "tool", digest_json) == ESP_OK) {
+                s_stats.digests_saved++;
+            }
+            free(digest_json);
+            esp_err_t save_asst = session_append(chat_id, "assistant", final_text->text);
+            if (save_user == ESP_OK && save_asst == ESP_OK) {
+                save_asst = session_commit(chat_id);
+            }
             if (save_user != ESP_OK || save_asst != ESP_OK) {
                 ESP_LOGW(TAG, "Session save failed for chat %s (user=%s, assistant=%s)",
-                         msg.chat_id,
+                         chat_id,
                          esp_err_to_name(save_user),
                          esp_err_to_name(save_asst));
             } else {
-                ESP_LOGI(TAG, "Session saved for chat %s", msg.chat_id);
+                ESP_LOGI(TAG, "Session saved for chat %s", chat_id);
             }
 
             /* Push response to outbound */
-            mimi_msg_t out = {0};
-            strncpy(out.channel, msg.channel, sizeof(out.channel) - 1);
-            strncpy(out.chat_id, msg.chat_id, sizeof(out.chat_id) - 1);
-            out.content = final_text;  /* transfer ownership */
+            mimi_msg_t out;
+            mimi_msg_reply(&out, &msg, final_text);  /* transfer ownership */
             ESP_LOGI(TAG, "Queue final response to %s:%s (%d bytes)",
-                     out.channel, out.chat_id, (int)strlen(final_text));
+                     mimi_msg_channel(&out), chat_id, (int)final_text->len);
             if (message_bus_push_outbound(&out) != ESP_OK) {
                 ESP_LOGW(TAG, "Outbound queue full, drop final response");
-                free(final_text);
-            } else {
-                final_text = NULL;
+                mimi_msg_release(&out);
             }
         } else {
             /* Error or empty response */
-            free(final_text);
-            mimi_msg_t out = {0};
-            strncpy(out.channel, msg.channel, sizeof(out.channel) - 1);
-            strncpy(out.chat_id, msg.chat_id, sizeof(out.chat_id) - 1);
-            out.content = strdup("Sorry, I encountered an error.");
-            if (out.content) {
-                if (message_bus_push_outbound(&out) != ESP_OK) {
-                    ESP_LOGW(TAG, "Outbound queue full, drop error response");
-                    free(out.content);
-                }
+            static mimi_payload_t error_text = MIMI_PAYLOAD_STATIC("Sorry, I encountered an error.");
+            mimi_payload_unref(final_text);
+            mimi_msg_t out;
+            mimi_msg_reply(&out, &msg, &error_text);
+            if (message_bus_push_outbound(&out) != ESP_OK) {
+                ESP_LOGW(TAG, "Outbound queue full, drop error response");
+                mimi_msg_release(&out);
             }
         }
 
-        /* Free inbound message content */
-        free(msg.content);
+        /* Release the inbound message */
+        tool_digest_free(&digest);
+        mimi_msg_release(&msg);
 
         /* Log memory status */
         ESP_LOGI(TAG, "Free PSRAM: %d bytes",
@@ -323,6 +350,11 @@ static void agent_loop_task(void *arg)
     }
 }
 
+void agent_get_stats(agent_stats_t *out)
+{
+    *out = s_stats;
+}
+
 esp_err_t agent_loop_init(void)
 {
     ESP_LOGI(TAG, "Agent loop initialized");
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "esp_err.h"
+#include <stdint.h>
 
 /**
  * Initialize the agent loop.
@@ -12,3 +13,16 @@ esp_err_t agent_loop_init(void);
  * Consumes from inbound queue, calls Claude API, pushes to outbound queue.
  */
 esp_err_t agent_loop_start(void);
+
+typedef struct {
+    uint32_t turns;             /* inbound messages processed */
+    uint32_t llm_calls;
+    uint32_t tool_calls;
+    uint32_t digests_saved;     /* turns whose tool calls went into the session */
+    uint32_t digests_replayed;  /* digests sent back to the model in later turns */
+} agent_stats_t;
+
+/**
+ * Snapshot the agent loop counters.
+ */
+void agent_get_stats(agent_stats_t *out);
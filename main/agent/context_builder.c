@@ -1,17 +1,21 @@
 #include "context_builder.h"
 #include "mimi_config.h"
 #include "memory/memory_store.h"
+#include "memory/memory_index.h"
 #include "skills/skill_loader.h"
+#include "storage/storage_log.h"
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include "esp_log.h"
+#include "esp_heap_caps.h"
 
 static const char *TAG = "context";
 
 static size_t append_file(char *buf, size_t size, size_t offset, const char *path, const char *header)
 {
-    FILE *f = fopen(path, "r");
+    FILE *f = storage_fopen(path);
     if (!f) return offset;
 
     if (header && offset < size - 1) {
@@ -25,7 +29,7 @@ static size_t append_file(char *buf, size_t size, size_t offset, const char *pat
     return offset;
 }
 
-esp_err_t context_build_system_prompt(char *buf, size_t size)
+esp_err_t context_build_system_prompt(char *buf, size_t size, const char *query)
 {
     size_t off = 0;
 
@@ -40,10 +44,11 @@ esp_err_t context_build_system_prompt(char *buf, size_t size)
         "Use this when you need up-to-date facts, news, weather, or anything beyond your training data.\n"
         "- get_current_time: Get the current date and time. "
         "You do NOT have an internal clock — always use this tool when you need to know the time or date.\n"
-        "- read_file: Read a file (path must start with " MIMI_SPIFFS_BASE "/).\n"
+        "- read_file: Read a file (path must start with " MIMI_SPIFFS_BASE "/); page large files with start_line/line_count.\n"
         "- write_file: Write/overwrite a file.\n"
-        "- edit_file: Find-and-replace edit a file.\n"
+        "- edit_file: Find-and-replace edit a file; batch several changes in one call with edits.\n"
         "- list_dir: List files, optionally filter by prefix.\n"
+        "- search_files: Find lines containing a string across files (optionally under a prefix), with line numbers.\n"
         "- cron_add: Schedule a recurring or one-shot task. The message will trigger an agent turn when the job fires.\n"
         "- cron_list: List all scheduled cron jobs.\n"
         "- cron_remove: Remove a scheduled cron job by ID.\n\n"
@@ -52,7 +57,7 @@ esp_err_t context_build_system_prompt(char *buf, size_t size)
         "## Memory\n"
         "You have persistent memory stored on local flash:\n"
         "- Long-term memory: " MIMI_SPIFFS_MEMORY_DIR "/MEMORY.md\n"
-        "- Daily notes: " MIMI_SPIFFS_MEMORY_DIR "/daily/<YYYY-MM-DD>.md\n\n"
+        "- Daily notes: " MIMI_SPIFFS_MEMORY_DIR "/<YYYY-MM-DD>.md\n\n"
         "IMPORTANT: Actively use memory to remember things across conversations.\n"
         "- When you learn something new about the user (name, preferences, habits, context), write it to MEMORY.md.\n"
         "- When something noteworthy happens in a conversation, append it to today's daily note.\n"
@@ -69,17 +74,32 @@ esp_err_t context_build_system_prompt(char *buf, size_t size)
     off = append_file(buf, size, off, MIMI_SOUL_FILE, "Personality");
     off = append_file(buf, size, off, MIMI_USER_FILE, "User Info");
 
-    /* Long-term memory */
-    char mem_buf[4096];
-    if (memory_read_long_term(mem_buf, sizeof(mem_buf)) == ESP_OK && mem_buf[0]) {
-        off += snprintf(buf + off, size - off, "\n## Long-term Memory\n\n%s\n", mem_buf);
+    if (query && memory_index_ready()) {
+        /* Only the paragraphs that match this message, so the prompt stays flat as memory grows */
+        char *mem_buf = heap_caps_malloc(MIMI_CONTEXT_MEMORY_BUDGET, MALLOC_CAP_SPIRAM);
+        if (mem_buf && memory_index_search(query, mem_buf, MIMI_CONTEXT_MEMORY_BUDGET,
+                                           MIMI_INDEX_TOP_K) > 0) {
+            off += snprintf(buf + off, size - off,
+                "\n## Relevant Memory\n\n"
+                "Excerpts from memory, daily notes and skills that match the current message "
+                "(read_file the source for the rest):\n\n%s", mem_buf);
+        }
+        free(mem_buf);
+    } else {
+        /* Long-term memory */
+        char mem_buf[4096];
+        if (memory_read_long_term(mem_buf, sizeof(mem_buf)) == ESP_OK && mem_buf[0]) {
+            off += snprintf(buf + off, size - off, "\n## Long-term Memory\n\n%s\n", mem_buf);
+        }
     }
 
-    /* Recent daily notes (last 3 days) */
-    char recent_buf[4096];
-    if (memory_read_recent(recent_buf, sizeof(recent_buf), 3) == ESP_OK && recent_buf[0]) {
+    /* Recent daily notes: verbatim, then summaries and rollups per the lookback policy */
+    char *recent_buf = heap_caps_malloc(MIMI_NOTES_RECENT_BUDGET, MALLOC_CAP_SPIRAM);
+    if (recent_buf && memory_read_recent(recent_buf, MIMI_NOTES_RECENT_BUDGET) == ESP_OK &&
+        recent_buf[0]) {
         off += snprintf(buf + off, size - off, "\n## Recent Notes\n\n%s\n", recent_buf);
     }
+    free(recent_buf);
 
     /* Skills */
     char skills_buf[2048];
@@ -5,10 +5,12 @@
 
 /**
  * Build the system prompt from bootstrap files (SOUL.md, USER.md)
- * and memory context (MEMORY.md + recent daily notes).
+ * and memory context: the memory paragraphs that best match the query, or
+ * MEMORY.md + recent daily notes verbatim when there is no query or index.
  *
- * @param buf   Output buffer (caller allocates, recommend MIMI_CONTEXT_BUF_SIZE)
- * @param size  Buffer size
+ * @param buf    Output buffer (caller allocates, recommend MIMI_CONTEXT_BUF_SIZE)
+ * @param size   Buffer size
+ * @param query  Current user message, may be NULL
  */
-esp_err_t context_build_system_prompt(char *buf, size_t size);
+esp_err_t context_build_system_prompt(char *buf, size_t size, const char *query);
 
@@ -0,0 +1,221 @@
+#include "tool_digest.h"
+#include "mimi_config.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include "esp_log.h"
+
+static const char *TAG = "digest";
+
+#define DIGEST_ENTRY_OVERHEAD  48   /* keys, quotes and braces per call */
+#define DIGEST_MIN_RESULT      64   /* below this a call is omitted rather than cut */
+
+/* Longest prefix of s within max bytes that does not split a UTF-8 sequence */
+static size_t utf8_prefix(const char *s, size_t max)
+{
+    size_t n = strnlen(s, max + 1);
+    if (n <= max) return n;
+    n = max;
+    while (n > 0 && ((unsigned char)s[n] & 0xC0) == 0x80) n--;
+    return n;
+}
+
+static char *truncated_copy(const char *s, size_t max)
+{
+    static const char marker[] = " [truncated]";
+    size_t len = strlen(s);
+    size_t keep = utf8_prefix(s, max);
+    bool cut = keep < len;
+    char *out = malloc(keep + (cut ? sizeof(marker) : 1));
+    if (!out) return NULL;
+    memcpy(out, s, keep);
+    if (cut) {
+        memcpy(out + keep, marker, sizeof(marker));
+    } else {
+        out[keep] = '\0';
+    }
+    return out;
+}
+
+/* Input as an object, long string arguments cut (file contents and the like) */
+static cJSON *compact_input(const char *input)
+{
+    cJSON *obj = cJSON_Parse(input ? input : "{}");
+    cJSON *out = cJSON_CreateObject();
+    if (!cJSON_IsObject(obj)) {
+        cJSON_Delete(obj);
+        return out;
+    }
+    cJSON *item;
+    cJSON_ArrayForEach(item, obj) {
+        if (cJSON_IsString(item) && strlen(item->valuestring) > MIMI_AGENT_DIGEST_ARG_BYTES) {
+            char *cut = truncated_copy(item->valuestring, MIMI_AGENT_DIGEST_ARG_BYTES);
+            if (cut) cJSON_AddStringToObject(out, item->string, cut);
+            free(cut);
+        } else {
+            cJSON_AddItemToObject(out, item->string, cJSON_Duplicate(item, true));
+        }
+    }
+    cJSON_Delete(obj);
+    return out;
+}
+
+void tool_digest_init(tool_digest_t *d)
+{
+    memset(d, 0, sizeof(*d));
+}
+
+void tool_digest_add(tool_digest_t *d, const char *name, const char *input, const char *output)
+{
+    cJSON *args = compact_input(input);
+    char *args_json = cJSON_PrintUnformatted(args);
+    size_t fixed = strlen(name) + (args_json ? strlen(args_json) : 2) + DIGEST_ENTRY_OVERHEAD;
+    free(args_json);
+
+    size_t room = d->bytes + fixed < MIMI_AGENT_DIGEST_BYTES ?
+                  MIMI_AGENT_DIGEST_BYTES - d->bytes - fixed : 0;
+    if (room > MIMI_AGENT_DIGEST_RESULT_BYTES) room = MIMI_AGENT_DIGEST_RESULT_BYTES;
+    if (room < DIGEST_MIN_RESULT && strlen(output) > room) {
+        cJSON_Delete(args);
+        d->omitted++;
+        return;
+    }
+
+    char *result = truncated_copy(output, room);
+    if (!d->calls) d->calls = cJSON_CreateArray();
+    if (!result || !d->calls) {
+        free(result);
+        cJSON_Delete(args);
+        d->omitted++;
+        return;
+    }
+    cJSON *call = cJSON_CreateObject();
+    cJSON_AddStringToObject(call, "name", name);
+    cJSON_AddItemToObject(call, "input", args);
+    cJSON_AddStringToObject(call, "result", result);
+    cJSON_AddItemToArray(d->calls, call);
+    d->bytes += fixed + strlen(result);
+    free(result);
+}
+
+char *tool_digest_take(tool_digest_t *d)
+{
+    char *out = NULL;
+    if (d->calls && cJSON_GetArraySize(d->calls) > 0) {
+        out = cJSON_PrintUnformatted(d->calls);
+        if (d->omitted) {
+            ESP_LOGW(TAG, "Digest full, %d tool call(s) not kept", d->omitted);
+        }
+    }
+    tool_digest_free(d);
+    return out;
+}
+
+void tool_digest_free(tool_digest_t *d)
+{
+    cJSON_Delete(d->calls);
+    tool_digest_init(d);
+}
+
+/* Append the two messages one digest stands for; false if it is malformed */
+static bool replay_digest(cJSON *out, const char *text, int seq)
+{
+    cJSON *calls = cJSON_Parse(text);
+    if (!cJSON_IsArray(calls) || cJSON_GetArraySize(calls) == 0) {
+        cJSON_Delete(calls);
+        return false;
+    }
+
+    cJSON *uses = cJSON_CreateArray();
+    cJSON *results = cJSON_CreateArray();
+    int i = 0;
+    cJSON *call;
+    cJSON_ArrayForEach(call, calls) {
+        cJSON *name = cJSON_GetObjectItem(call, "name");
+        cJSON *input = cJSON_GetObjectItem(call, "input");
+        cJSON *result = cJSON_GetObjectItem(call, "result");
+        if (!cJSON_IsString(name) || !cJSON_IsString(result)) continue;
+
+        char id[48];
+        snprintf(id, sizeof(id), "toolu_digest_%d_%d", seq, i++);
+
+        cJSON *use = cJSON_CreateObject();
+        cJSON_AddStringToObject(use, "type", "tool_use");
+        cJSON_AddStringToObject(use, "id", id);
+        cJSON_AddStringToObject(use, "name", name->valuestring);
+        cJSON_AddItemToObject(use, "input", cJSON_IsObject(input) ?
+                              cJSON_Duplicate(input, true) : cJSON_CreateObject());
+        cJSON_AddItemToArray(uses, use);
+
+        cJSON *res = cJSON_CreateObject();
+        cJSON_AddStringToObject(res, "type", "tool_result");
+        cJSON_AddStringToObject(res, "tool_use_id", id);
+        cJSON_AddStringToObject(res, "content", result->valuestring);
+        cJSON_AddItemToArray(results, res);
+    }
+    cJSON_Delete(calls);
+    if (i == 0) {
+        cJSON_Delete(uses);
+        cJSON_Delete(results);
+        return false;
+    }
+
+    cJSON *asst = cJSON_CreateObject();
+    cJSON_AddStringToObject(asst, "role", "assistant");
+    cJSON_AddItemToObject(asst, "content", uses);
+    cJSON_AddItemToArray(out, asst);
+
+    cJSON *user = cJSON_CreateObject();
+    cJSON_AddStringToObject(user, "role", "user");
+    cJSON_AddItemToObject(user, "content", results);
+    cJSON_AddItemToArray(out, user);
+    return true;
+}
+
+static bool is_role(const cJSON *msg, const char *role)
+{
+    cJSON *r = cJSON_GetObjectItem(msg, "role");
+    return cJSON_IsString(r) && strcmp(r->valuestring, role) == 0;
+}
+
+int tool_digest_expand(cJSON *messages, int max_msgs)
+{
+    if (!cJSON_IsArray(messages)) return 0;
+
+    /* Digests ride along with their turn; only conversation counts */
+    int skip = cJSON_GetArraySize(messages);
+    for (int kept = 0; skip > 0 && kept < max_msgs; skip--) {
+        if (!is_role(cJSON_GetArrayItem(messages, skip - 1), "tool")) kept++;
+    }
+    while (skip-- > 0) cJSON_DeleteItemFromArray(messages, 0);
+
+    cJSON *src = cJSON_CreateArray();
+    cJSON *msg;
+    while ((msg = cJSON_DetachItemFromArray(messages, 0)) != NULL) {
+        cJSON_AddItemToArray(src, msg);
+    }
+
+    int replayed = 0;
+    bool started = false;
+    while ((msg = cJSON_DetachItemFromArray(src, 0)) != NULL) {
+        cJSON *content = cJSON_GetObjectItem(msg, "content");
+        if (!started && !(is_role(msg, "user") && cJSON_IsString(content))) {
+            cJSON_Delete(msg);
+            continue;
+        }
+        started = true;
+
+        if (is_role(msg, "tool")) {
+            if (cJSON_IsString(content) && replay_digest(messages, content->valuestring, replayed)) {
+                replayed++;
+            }
+            cJSON_Delete(msg);
+            continue;
+        }
+        cJSON_AddItemToArray(messages, msg);
+    }
+    cJSON_Delete(src);
+    return replayed;
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <stddef.h>
+#include "cJSON.h"
+
+/*
+ * Compact record of the tool calls made during one agent turn. It is saved
+ * to the session as a "tool" message between the user text and the final
+ * reply, and replayed as tool_use / tool_result blocks in later turns, so a
+ * follow-up about earlier results does not repeat the call.
+ */
+typedef struct {
+    cJSON *calls;       /* [{"name":..., "input":{...}, "result":"..."}] */
+    size_t bytes;       /* estimated stored size */
+    int omitted;        /* calls left out once MIMI_AGENT_DIGEST_BYTES was reached */
+} tool_digest_t;
+
+void tool_digest_init(tool_digest_t *d);
+
+/**
+ * Record one executed call. Long string arguments and the result are cut
+ * to MIMI_AGENT_DIGEST_ARG_BYTES / MIMI_AGENT_DIGEST_RESULT_BYTES.
+ */
+void tool_digest_add(tool_digest_t *d, const char *name, const char *input, const char *output);
+
+/**
+ * Render the digest for session_append() and reset it.
+ * @return JSON text (caller frees), or NULL if no call was recorded
+ */
+char *tool_digest_take(tool_digest_t *d);
+
+void tool_digest_free(tool_digest_t *d);
+
+/**
+ * Keep the newest max_msgs user/assistant messages of a loaded history and
+ * the digests among them, then replace each "tool" message with an
+ * assistant tool_use message and a user tool_result message. Messages
+ * before the first plain user message (a window cut mid-turn) are dropped.
+ * @return number of digests replayed
+ */
+int tool_digest_expand(cJSON *messages, int max_msgs);
@@ -0,0 +1,285 @@
+#include "bus/bus_msg.h"
+#include "mimi_config.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include "esp_log.h"
+#include "esp_heap_caps.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+
+static const char *TAG = "bus_msg";
+
+typedef struct {
+    uint32_t hash;
+    uint32_t last_used;         /* tick of the last intern, for eviction */
+    bool used;
+    char id[MIMI_CHAT_ID_MAX];
+} chat_slot_t;
+
+/* The table is in PSRAM; its refcounts, like every atomic the S3 touches,
+   are in internal RAM */
+static chat_slot_t *s_chats;            /* PSRAM, MIMI_BUS_CHATS slots */
+static _Atomic uint32_t *s_chat_refs;   /* internal RAM, one per slot */
+static SemaphoreHandle_t s_lock;        /* interning; lookups by slot are lock-free */
+
+static const char *_Atomic s_chan_names[MIMI_BUS_CHANNELS] = {
+    [MIMI_CHAN_ID_NONE] = "",
+    [MIMI_CHAN_ID_TELEGRAM] = MIMI_CHAN_TELEGRAM,
+    [MIMI_CHAN_ID_FEISHU] = MIMI_CHAN_FEISHU,
+    [MIMI_CHAN_ID_WEBSOCKET] = MIMI_CHAN_WEBSOCKET,
+    [MIMI_CHAN_ID_CLI] = MIMI_CHAN_CLI,
+    [MIMI_CHAN_ID_SYSTEM] = MIMI_CHAN_SYSTEM,
+};
+
+static struct {
+    _Atomic uint32_t payloads, adopted, chat_evictions, chat_full;
+    _Atomic uint64_t bytes_copied;
+} s_stats;
+
+esp_err_t bus_msg_init(void)
+{
+    if (s_chats) return ESP_OK;
+    s_lock = xSemaphoreCreateMutex();
+    s_chats = heap_caps_calloc(MIMI_BUS_CHATS, sizeof(chat_slot_t), MALLOC_CAP_SPIRAM);
+    s_chat_refs = heap_caps_calloc(MIMI_BUS_CHATS, sizeof(*s_chat_refs),
+                                   MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+    if (!s_lock || !s_chats || !s_chat_refs) {
+        ESP_LOGE(TAG, "Failed to allocate the chat table");
+        return ESP_ERR_NO_MEM;
+    }
+    s_chats[MIMI_CHAT_EMPTY].used = true;
+    return ESP_OK;
+}
+
+/* ── Payloads ───────────────────────────────────────────────── */
+
+/* The header holds the refcount, so it is always in internal RAM; the
+   text goes to PSRAM */
+static mimi_payload_t *payload_header(void)
+{
+    return heap_caps_malloc(sizeof(mimi_payload_t), MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+}
+
+mimi_payload_t *mimi_payload_alloc(size_t len)
+{
+    mimi_payload_t *p = payload_header();
+    if (!p) return NULL;
+    p->text = heap_caps_malloc(len + 1, MALLOC_CAP_SPIRAM);
+    if (!p->text) {
+        free(p);
+        return NULL;
+    }
+    atomic_init(&p->refs, 1);
+    p->len = (uint32_t)len;
+    p->text[len] = '\0';
+    atomic_fetch_add_explicit(&s_stats.payloads, 1, memory_order_relaxed);
+    return p;
+}
+
+mimi_payload_t *mimi_payload_new(const char *text, size_t len)
+{
+    mimi_payload_t *p = mimi_payload_alloc(len);
+    if (!p) return NULL;
+    memcpy(p->text, text, len);
+    atomic_fetch_add_explicit(&s_stats.bytes_copied, len, memory_order_relaxed);
+    return p;
+}
+
+mimi_payload_t *mimi_payload_from_str(const char *text)
+{
+    return mimi_payload_new(text, strlen(text));
+}
+
+mimi_payload_t *mimi_payload_adopt(char *text)
+{
+    mimi_payload_t *p = payload_header();
+    if (!p) return NULL;
+    atomic_init(&p->refs, 1);
+    p->len = (uint32_t)strlen(text);
+    p->text = text;
+    atomic_fetch_add_explicit(&s_stats.adopted, 1, memory_order_relaxed);
+    return p;
+}
+
+mimi_payload_t *mimi_payload_ref(mimi_payload_t *p)
+{
+    if (p && atomic_load_explicit(&p->refs, memory_order_relaxed) != 0) {
+        atomic_fetch_add_explicit(&p->refs, 1, memory_order_relaxed);
+    }
+    return p;
+}
+
+void mimi_payload_unref(mimi_payload_t *p)
+{
+    if (!p || atomic_load_explicit(&p->refs, memory_order_relaxed) == 0) return;
+    if (atomic_fetch_sub_explicit(&p->refs, 1, memory_order_acq_rel) != 1) return;
+    free(p->text);
+    free(p);
+}
+
+/* ── Channels ───────────────────────────────────────────────── */
+
+uint8_t bus_chan_intern(const char *name)
+{
+    if (!name || !name[0]) return MIMI_CHAN_ID_NONE;
+    for (int i = 1; i < MIMI_BUS_CHANNELS; i++) {
+        const char *n = atomic_load_explicit(&s_chan_names[i], memory_order_acquire);
+        if (!n) break;
+        if (strcmp(n, name) == 0) return (uint8_t)i;
+    }
+
+    uint8_t id = MIMI_CHAN_ID_NONE;
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    for (int i = 1; i < MIMI_BUS_CHANNELS; i++) {
+        const char *n = atomic_load_explicit(&s_chan_names[i], memory_order_relaxed);
+        if (n && strcmp(n, name) == 0) {
+            id = (uint8_t)i;
+            break;
+        }
+        if (!n) {
+            char *copy = strdup(name);
+            if (copy) {
+                atomic_store_explicit(&s_chan_names[i], copy, memory_order_release);
+                id = (uint8_t)i;
+                ESP_LOGI(TAG, "Channel '%s' is id %d", name, i);
+            }
+            break;
+        }
+    }
+    xSemaphoreGive(s_lock);
+    if (id == MIMI_CHAN_ID_NONE) ESP_LOGW(TAG, "No channel id left for '%s'", name);
+    return id;
+}
+
+const char *bus_chan_name(uint8_t chan)
+{
+    const char *n = chan < MIMI_BUS_CHANNELS
+                        ? atomic_load_explicit(&s_chan_names[chan], memory_order_acquire)
+                        : NULL;
+    return n ? n : "";
+}
+
+/* ── Chats ──────────────────────────────────────────────────── */
+
+static uint32_t chat_hash(const char *s)
+{
+    uint32_t h = 2166136261u;       /* FNV-1a */
+    while (*s) h = (h ^ (uint8_t)*s++) * 16777619u;
+    return h;
+}
+
+mimi_chat_t bus_chat_intern(const char *chat_id)
+{
+    if (!chat_id || !chat_id[0]) return MIMI_CHAT_EMPTY;
+    uint32_t h = chat_hash(chat_id);
+    uint32_t now = xTaskGetTickCount();
+
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    int free_slot = -1, victim = -1;
+    for (int i = 1; i < MIMI_BUS_CHATS; i++) {
+        chat_slot_t *c = &s_chats[i];
+        if (!c->used) {
+            if (free_slot < 0) free_slot = i;
+            continue;
+        }
+        if (c->hash == h && strncmp(c->id, chat_id, sizeof(c->id) - 1) == 0) {
+            atomic_fetch_add_explicit(&s_chat_refs[i], 1, memory_order_relaxed);
+            c->last_used = now;
+            xSemaphoreGive(s_lock);
+            return (mimi_chat_t)i;
+        }
+        /* Only this lock takes a slot from 0 to 1, so 0 stays 0 until we return */
+        if (atomic_load_explicit(&s_chat_refs[i], memory_order_acquire) == 0 &&
+            (victim < 0 || (int32_t)(c->last_used - s_chats[victim].last_used) < 0)) {
+            victim = i;
+        }
+    }
+
+    int slot = free_slot >= 0 ? free_slot : victim;
+    if (slot < 0) {
+        xSemaphoreGive(s_lock);
+        atomic_fetch_add_explicit(&s_stats.chat_full, 1, memory_order_relaxed);
+        ESP_LOGW(TAG, "Chat table full (%d held), refusing %s", MIMI_BUS_CHATS - 1, chat_id);
+        return MIMI_CHAT_INVALID;
+    }
+    if (slot == victim) atomic_fetch_add_explicit(&s_stats.chat_evictions, 1, memory_order_relaxed);
+
+    chat_slot_t *c = &s_chats[slot];
+    strncpy(c->id, chat_id, sizeof(c->id) - 1);
+    c->id[sizeof(c->id) - 1] = '\0';
+    c->hash = h;
+    c->last_used = now;
+    c->used = true;
+    atomic_store_explicit(&s_chat_refs[slot], 1, memory_order_release);
+    xSemaphoreGive(s_lock);
+    return (mimi_chat_t)slot;
+}
+
+void bus_chat_ref(mimi_chat_t chat)
+{
+    if (chat == MIMI_CHAT_EMPTY || chat >= MIMI_BUS_CHATS) return;
+    atomic_fetch_add_explicit(&s_chat_refs[chat], 1, memory_order_relaxed);
+}
+
+void bus_chat_unref(mimi_chat_t chat)
+{
+    if (chat == MIMI_CHAT_EMPTY || chat >= MIMI_BUS_CHATS) return;
+    atomic_fetch_sub_explicit(&s_chat_refs[chat], 1, memory_order_release);
+}
+
+const char *bus_chat_str(mimi_chat_t chat)
+{
+    if (chat >= MIMI_BUS_CHATS || !s_chats) return "";
+    return s_chats[chat].id;
+}
+
+/* ── Messages ───────────────────────────────────────────────── */
+
+esp_err_t mimi_msg_init(mimi_msg_t *msg, const char *channel, const char *chat_id,
+                        mimi_payload_t *payload)
+{
+    mimi_chat_t chat = bus_chat_intern(chat_id);
+    if (chat == MIMI_CHAT_INVALID) return ESP_ERR_NO_MEM;
+    msg->chan = bus_chan_intern(channel);
+    msg->flags = 0;
+    msg->chat = chat;
+    msg->payload = payload;
+    return ESP_OK;
+}
+
+void mimi_msg_reply(mimi_msg_t *out, const mimi_msg_t *in, mimi_payload_t *payload)
+{
+    bus_chat_ref(in->chat);
+    out->chan = in->chan;
+    out->flags = 0;
+    out->chat = in->chat;
+    out->payload = payload;
+}
+
+void mimi_msg_release(mimi_msg_t *msg)
+{
+    mimi_payload_unref(msg->payload);
+    bus_chat_unref(msg->chat);
+    msg->payload = NULL;
+    msg->chat = MIMI_CHAT_EMPTY;
+}
+
+void bus_msg_get_stats(bus_msg_stats_t *out)
+{
+    memset(out, 0, sizeof(*out));
+    out->payloads = atomic_load_explicit(&s_stats.payloads, memory_order_relaxed);
+    out->adopted = atomic_load_explicit(&s_stats.adopted, memory_order_relaxed);
+    out->bytes_copied = atomic_load_explicit(&s_stats.bytes_copied, memory_order_relaxed);
+    out->chat_evictions = atomic_load_explicit(&s_stats.chat_evictions, memory_order_relaxed);
+    out->chat_full = atomic_load_explicit(&s_stats.chat_full, memory_order_relaxed);
+    if (!s_chats) return;
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    for (int i = 1; i < MIMI_BUS_CHATS; i++) {
+        if (s_chats[i].used && atomic_load_explicit(&s_chat_refs[i], memory_order_relaxed)) {
+            out->chats++;
+        }
+    }
+    xSemaphoreGive(s_lock);
+}
@@ -0,0 +1,149 @@
+#pragma once
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+
+/**
+ * Bus message parts: refcounted payloads, interned channel ids and the
+ * chat-id table.
+ *
+ * A mimi_msg_t is eight bytes on the S3: a channel id, a chat table slot
+ * and a payload pointer. The text lives in a mimi_payload_t that any
+ * number of holders share by reference, so a producer hands its buffer to
+ * the bus without copying it (mimi_payload_adopt) and fanning a message
+ * out takes a mimi_payload_ref() per extra consumer, not a strdup. Chat
+ * ids are interned once into a table of MIMI_BUS_CHATS slots, refcounted
+ * by the messages that name them; a slot no message holds is reused for
+ * a new chat, least recently used first.
+ */
+
+/* Channel identifiers */
+#define MIMI_CHAN_TELEGRAM   "telegram"
+#define MIMI_CHAN_FEISHU     "feishu"
+#define MIMI_CHAN_WEBSOCKET  "websocket"
+#define MIMI_CHAN_CLI        "cli"
+#define MIMI_CHAN_SYSTEM     "system"
+
+/* Interned channels; names outside this list get ids from MIMI_CHAN_ID_BUILTIN up */
+typedef enum {
+    MIMI_CHAN_ID_NONE = 0,
+    MIMI_CHAN_ID_TELEGRAM,
+    MIMI_CHAN_ID_FEISHU,
+    MIMI_CHAN_ID_WEBSOCKET,
+    MIMI_CHAN_ID_CLI,
+    MIMI_CHAN_ID_SYSTEM,
+    MIMI_CHAN_ID_BUILTIN,
+} mimi_chan_id_t;
+
+#define MIMI_CHAT_ID_MAX 96             /* bytes, with the terminator */
+
+typedef uint16_t mimi_chat_t;
+#define MIMI_CHAT_EMPTY   0             /* "": always present, not counted */
+#define MIMI_CHAT_INVALID 0xFFFF
+
+/* Allocated in internal RAM, where the S3's atomics work; text is in PSRAM */
+typedef struct {
+    _Atomic uint32_t refs;              /* 0 for MIMI_PAYLOAD_STATIC: never freed */
+    uint32_t len;
+    char *text;                         /* NUL-terminated; a separate allocation, or adopted */
+} mimi_payload_t;
+
+/** A payload around a string literal: no allocation, never freed. */
+#define MIMI_PAYLOAD_STATIC(s) { .refs = 0, .len = sizeof(s) - 1, .text = (char *)(s) }
+
+/* Message flags */
+#define MIMI_MSG_STATUS 0x01            /* progress note: any later message to the chat supersedes it */
+
+/* Message types on the bus */
+typedef struct {
+    uint8_t chan;                       /* mimi_chan_id_t or an interned id */
+    uint8_t flags;                      /* MIMI_MSG_*; 0 from mimi_msg_init/reply */
+    mimi_chat_t chat;                   /* chat table slot, one reference held */
+    mimi_payload_t *payload;            /* one reference held; NULL for no text */
+} mimi_msg_t;
+
+typedef struct {
+    uint32_t payloads;                  /* allocated with a copy of their text */
+    uint32_t adopted;                   /* wrapped around the producer's buffer */
+    uint64_t bytes_copied;              /* text copied into payloads */
+    uint32_t chats;                     /* slots held by a message now */
+    uint32_t chat_evictions;            /* slots reused for another chat */
+    uint32_t chat_full;                 /* interns refused: every slot held */
+} bus_msg_stats_t;
+
+esp_err_t bus_msg_init(void);
+
+/* ── Payloads ──────────────────────────────────────────────── */
+
+/** Payload with room for len bytes of text, uninitialized but terminated; one reference. */
+mimi_payload_t *mimi_payload_alloc(size_t len);
+
+/** Payload holding a copy of text[0..len); one reference. */
+mimi_payload_t *mimi_payload_new(const char *text, size_t len);
+
+/** Payload holding a copy of a NUL-terminated string. */
+mimi_payload_t *mimi_payload_from_str(const char *text);
+
+/**
+ * Payload that takes over text, a malloc'd NUL-terminated string, without
+ * copying it. NULL on allocation failure, with text still the caller's.
+ */
+mimi_payload_t *mimi_payload_adopt(char *text);
+
+mimi_payload_t *mimi_payload_ref(mimi_payload_t *p);
+void mimi_payload_unref(mimi_payload_t *p);
+
+/* ── Channels and chats ────────────────────────────────────── */
+
+/** Id for a channel name, interning unknown names; MIMI_CHAN_ID_NONE if the table is full. */
+uint8_t bus_chan_intern(const char *name);
+const char *bus_chan_name(uint8_t chan);
+
+/** Slot for chat_id with one reference taken; MIMI_CHAT_INVALID if every slot is held. */
+mimi_chat_t bus_chat_intern(const char *chat_id);
+void bus_chat_ref(mimi_chat_t chat);
+void bus_chat_unref(mimi_chat_t chat);
+
+/** The chat id in slot chat; valid while a reference is held. */
+const char *bus_chat_str(mimi_chat_t chat);
+
+/* ── Messages ──────────────────────────────────────────────── */
+
+/**
+ * Address msg to channel/chat_id and give it payload (NULL allowed). On
+ * ESP_OK the message owns the payload reference; on ESP_ERR_NO_MEM (chat
+ * table full) the caller keeps it.
+ */
+esp_err_t mimi_msg_init(mimi_msg_t *msg, const char *channel, const char *chat_id,
+                        mimi_payload_t *payload);
+
+/** Address out to the same channel and chat as in, without a lookup; out owns payload. */
+void mimi_msg_reply(mimi_msg_t *out, const mimi_msg_t *in, mimi_payload_t *payload);
+
+/** Drop the message's payload and chat references. */
+void mimi_msg_release(mimi_msg_t *msg);
+
+static inline const char *mimi_msg_channel(const mimi_msg_t *msg)
+{
+    return bus_chan_name(msg->chan);
+}
+
+static inline const char *mimi_msg_chat_id(const mimi_msg_t *msg)
+{
+    return bus_chat_str(msg->chat);
+}
+
+static inline const char *mimi_msg_text(const mimi_msg_t *msg)
+{
+    return msg->payload ? msg->payload->text : "";
+}
+
+static inline size_t mimi_msg_len(const mimi_msg_t *msg)
+{
+    return msg->payload ? msg->payload->len : 0;
+}
+
+void bus_msg_get_stats(bus_msg_stats_t *out);
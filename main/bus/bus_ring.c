@@ -0,0 +1,209 @@
+#include "bus/bus_ring.h"
+
+#include <string.h>
+#include "esp_heap_caps.h"
+
+/* Slot states, tagged with the position they belong to so a stale
+   rewrite cannot hit a later message in the same slot */
+#define SLOT_READY   1u
+#define SLOT_TAKEN   2u
+#define SLOT_HELD    3u     /* being rewritten by bus_ring_replace_oldest() */
+#define TAG(pos, s)  ((uint32_t)(pos) << 2 | (s))
+
+esp_err_t bus_ring_init(bus_ring_t *r, uint32_t cap)
+{
+    memset(r, 0, sizeof(*r));
+    uint32_t n = 1;
+    while (n < cap) n <<= 1;
+    r->cap = n;
+    r->slots = heap_caps_calloc(n, sizeof(mimi_msg_t), MALLOC_CAP_SPIRAM);
+    r->ctl = heap_caps_calloc(n, sizeof(bus_slot_ctl_t), MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+    r->items = xSemaphoreCreateBinary();
+    r->space = xSemaphoreCreateBinary();
+    r->edit = xSemaphoreCreateMutex();
+    if (!r->slots || !r->ctl || !r->items || !r->space || !r->edit) {
+        bus_ring_deinit(r);
+        return ESP_ERR_NO_MEM;
+    }
+    for (uint32_t i = 0; i < n; i++) atomic_init(&r->ctl[i].seq, i);
+    return ESP_OK;
+}
+
+void bus_ring_deinit(bus_ring_t *r)
+{
+    mimi_msg_t msg;
+    if (r->slots && r->ctl) {
+        while (bus_ring_try_pop(r, &msg)) mimi_msg_release(&msg);
+    }
+    heap_caps_free(r->slots);
+    heap_caps_free(r->ctl);
+    if (r->items) vSemaphoreDelete(r->items);
+    if (r->space) vSemaphoreDelete(r->space);
+    if (r->edit) vSemaphoreDelete(r->edit);
+    memset(r, 0, sizeof(*r));
+}
+
+bool bus_ring_try_push(bus_ring_t *r, const mimi_msg_t *msg)
+{
+    uint32_t mask = r->cap - 1;
+    uint32_t pos = atomic_load_explicit(&r->head, memory_order_relaxed);
+    bus_slot_ctl_t *c;
+    for (;;) {
+        c = &r->ctl[pos & mask];
+        uint32_t seq = atomic_load_explicit(&c->seq, memory_order_acquire);
+        int32_t dif = (int32_t)(seq - pos);
+        if (dif == 0) {
+            if (atomic_compare_exchange_weak_explicit(&r->head, &pos, pos + 1,
+                                                      memory_order_relaxed,
+                                                      memory_order_relaxed)) {
+                break;
+            }
+        } else if (dif < 0) {
+            return false;       /* the consumer has not freed this slot yet */
+        } else {
+            pos = atomic_load_explicit(&r->head, memory_order_relaxed);
+        }
+    }
+
+    r->slots[pos & mask] = *msg;
+    atomic_store_explicit(&c->state, TAG(pos, SLOT_READY), memory_order_relaxed);
+    /* seq_cst, with the load of consumer_waiting below, pairs with
+       bus_ring_wait_items(): either it sees this message or we see it waiting */
+    atomic_store_explicit(&c->seq, pos + 1, memory_order_seq_cst);
+
+    uint32_t depth = pos + 1 - atomic_load_explicit(&r->tail, memory_order_relaxed);
+    uint32_t hw = atomic_load_explicit(&r->high_water, memory_order_relaxed);
+    while (depth > hw && depth <= r->cap &&
+           !atomic_compare_exchange_weak_explicit(&r->high_water, &hw, depth,
+                                                  memory_order_relaxed, memory_order_relaxed)) {
+    }
+
+    if (atomic_load_explicit(&r->consumer_waiting, memory_order_seq_cst) &&
+        atomic_exchange_explicit(&r->consumer_waiting, 0, memory_order_relaxed)) {
+        xSemaphoreGive(r->items);
+    }
+    return true;
+}
+
+bool bus_ring_try_pop(bus_ring_t *r, mimi_msg_t *out)
+{
+    uint32_t mask = r->cap - 1;
+    uint32_t pos = atomic_load_explicit(&r->tail, memory_order_relaxed);
+    bus_slot_ctl_t *c = &r->ctl[pos & mask];
+    if (atomic_load_explicit(&c->seq, memory_order_acquire) != pos + 1) return false;
+
+    /* A held slot is mid-rewrite: wait for it as for an unpublished push */
+    uint32_t expect = TAG(pos, SLOT_READY);
+    if (!atomic_compare_exchange_strong_explicit(&c->state, &expect, TAG(pos, SLOT_TAKEN),
+                                                 memory_order_acq_rel, memory_order_relaxed)) {
+        return false;
+    }
+    *out = r->slots[pos & mask];
+    atomic_store_explicit(&r->tail, pos + 1, memory_order_relaxed);
+    /* As in bus_ring_try_push(), against bus_ring_wait_space() */
+    atomic_store_explicit(&c->seq, pos + r->cap, memory_order_seq_cst);
+
+    /* Wake waiting producers once half the ring is free, so a full ring
+       costs one wake-up per half ring rather than one per message; a
+       producer that waits meanwhile re-checks after its timeout */
+    if (atomic_load_explicit(&r->producers_waiting, memory_order_seq_cst) &&
+        atomic_load_explicit(&r->head, memory_order_relaxed) - (pos + 1) <= r->cap / 2) {
+        xSemaphoreGive(r->space);
+    }
+    return true;
+}
+
+/* Hand a rewritten slot back to the consumer */
+static void slot_release(bus_ring_t *r, uint32_t pos)
+{
+    /* seq_cst against bus_ring_wait_items(), as for a push */
+    atomic_store_explicit(&r->ctl[pos & (r->cap - 1)].state, TAG(pos, SLOT_READY),
+                          memory_order_seq_cst);
+    if (atomic_load_explicit(&r->consumer_waiting, memory_order_seq_cst) &&
+        atomic_exchange_explicit(&r->consumer_waiting, 0, memory_order_relaxed)) {
+        xSemaphoreGive(r->items);
+    }
+}
+
+bool bus_ring_replace_oldest(bus_ring_t *r, const mimi_msg_t *msg)
+{
+    uint32_t mask = r->cap - 1;
+    mimi_msg_t oldest;
+    bool holding = false;
+    uint32_t held = 0;
+
+    xSemaphoreTake(r->edit, portMAX_DELAY);
+    uint32_t end = atomic_load_explicit(&r->head, memory_order_acquire);
+    for (uint32_t pos = atomic_load_explicit(&r->tail, memory_order_acquire); pos != end; pos++) {
+        /* Hold the slot before reading it: the consumer or a producer may
+           be reusing it otherwise. Fails only before the first hold, as
+           the consumer cannot pass a held slot. */
+        bus_slot_ctl_t *c = &r->ctl[pos & mask];
+        uint32_t expect = TAG(pos, SLOT_READY);
+        if (atomic_load_explicit(&c->seq, memory_order_acquire) != pos + 1 ||
+            !atomic_compare_exchange_strong_explicit(&c->state, &expect, TAG(pos, SLOT_HELD),
+                                                     memory_order_acq_rel,
+                                                     memory_order_relaxed)) {
+            continue;
+        }
+        const mimi_msg_t *m = &r->slots[pos & mask];
+        if (m->chan != msg->chan || m->chat != msg->chat) {
+            slot_release(r, pos);
+            continue;
+        }
+        if (holding) {
+            r->slots[held & mask] = r->slots[pos & mask];
+            slot_release(r, held);
+        } else {
+            oldest = r->slots[pos & mask];
+            holding = true;
+        }
+        held = pos;
+    }
+    if (holding) {
+        r->slots[held & mask] = *msg;
+        slot_release(r, held);
+        atomic_fetch_add_explicit(&r->dropped, 1, memory_order_relaxed);
+    }
+    xSemaphoreGive(r->edit);
+
+    if (holding) mimi_msg_release(&oldest);
+    return holding;
+}
+
+uint32_t bus_ring_depth(bus_ring_t *r)
+{
+    uint32_t tail = atomic_load_explicit(&r->tail, memory_order_acquire);
+    uint32_t head = atomic_load_explicit(&r->head, memory_order_acquire);
+    uint32_t depth = head - tail;
+    return depth > r->cap ? r->cap : depth;
+}
+
+void bus_ring_wait_items(bus_ring_t *r, TickType_t ticks)
+{
+    atomic_store_explicit(&r->consumer_waiting, 1, memory_order_seq_cst);
+    uint32_t pos = atomic_load_explicit(&r->tail, memory_order_relaxed);
+    bus_slot_ctl_t *c = &r->ctl[pos & (r->cap - 1)];
+    if (atomic_load_explicit(&c->seq, memory_order_seq_cst) != pos + 1 ||
+        atomic_load_explicit(&c->state, memory_order_seq_cst) == TAG(pos, SLOT_HELD)) {
+        xSemaphoreTake(r->items, ticks);
+    }
+    atomic_store_explicit(&r->consumer_waiting, 0, memory_order_relaxed);
+}
+
+void bus_ring_wait_space(bus_ring_t *r, TickType_t ticks)
+{
+    atomic_fetch_add_explicit(&r->producers_waiting, 1, memory_order_seq_cst);
+    uint32_t pos = atomic_load_explicit(&r->head, memory_order_relaxed);
+    if (atomic_load_explicit(&r->ctl[pos & (r->cap - 1)].seq, memory_order_seq_cst) != pos) {
+        xSemaphoreTake(r->space, ticks);
+    }
+    atomic_fetch_sub_explicit(&r->producers_waiting, 1, memory_order_relaxed);
+}
+
+void bus_ring_wake_consumer(bus_ring_t *r)
+{
+    /* Unconditional: the consumer may be about to wait without having seen
+       the work, and a binary semaphore keeps the give for it */
+    xSemaphoreGive(r->items);
+}
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "bus/message_bus.h"
+
+/**
+ * Bounded multi-producer, single-consumer ring of bus messages.
+ *
+ * Producers claim a slot with one compare-and-swap on the head and publish
+ * it through the slot's sequence number (Vyukov's bounded queue), so
+ * pushes never take a lock. The message slots live in PSRAM; the sequence
+ * and state words stay in internal RAM, where the S3's atomic
+ * instructions work. A consumer that finds the ring empty, or a producer
+ * that finds it full, sleeps on a semaphore the other side gives only
+ * when someone is waiting. bus_ring_replace_oldest() rewrites queued
+ * slots in place; the consumer stops at a slot it is rewriting as it
+ * does at one a producer has claimed but not yet published.
+ *
+ * Only one task may pop from a ring.
+ */
+
+typedef struct {
+    _Atomic uint32_t seq;       /* == pos: free for the push at pos; pos + 1: holds it */
+    _Atomic uint32_t state;     /* pos << 2 | SLOT_*, see bus_ring.c */
+} bus_slot_ctl_t;
+
+/* Producer- and consumer-side words on separate cache lines */
+#define BUS_RING_LINE 64
+
+typedef struct {
+    uint32_t cap;               /* power of two */
+    mimi_msg_t *slots;          /* PSRAM */
+    bus_slot_ctl_t *ctl;        /* internal RAM */
+    SemaphoreHandle_t items;    /* given when a push may end the consumer's wait */
+    SemaphoreHandle_t space;    /* given when a pop may end a producer's wait */
+    SemaphoreHandle_t edit;     /* serializes bus_ring_replace_oldest() */
+
+    _Alignas(BUS_RING_LINE) _Atomic uint32_t head;  /* next push; also the push count */
+    _Atomic uint32_t high_water;
+    _Atomic uint32_t producers_waiting;
+
+    _Alignas(BUS_RING_LINE) _Atomic uint32_t tail;  /* next pop; also the pop count */
+    _Atomic uint32_t consumer_waiting;
+    _Atomic uint32_t dropped;   /* messages bus_ring_replace_oldest() discarded */
+} bus_ring_t;
+
+/** @param cap slots, rounded up to a power of two */
+esp_err_t bus_ring_init(bus_ring_t *r, uint32_t cap);
+void bus_ring_deinit(bus_ring_t *r);
+
+/** Push without waiting; false when the ring is full. The ring owns the message on true. */
+bool bus_ring_try_push(bus_ring_t *r, const mimi_msg_t *msg);
+
+/** Pop without waiting; false when the ring is empty. */
+bool bus_ring_try_pop(bus_ring_t *r, mimi_msg_t *out);
+
+/**
+ * Push into a full ring by discarding the oldest queued message for
+ * msg's chat: the chat's later messages each move up one slot and msg
+ * takes the last, so the chat keeps its order and no free slot is needed.
+ * false if the ring holds no message for the chat; on true the ring owns
+ * msg and the discarded message has been released.
+ */
+bool bus_ring_replace_oldest(bus_ring_t *r, const mimi_msg_t *msg);
+
+/** Sleep until a push may have made the ring non-empty, or ticks pass. */
+void bus_ring_wait_items(bus_ring_t *r, TickType_t ticks);
+
+/** Sleep until a pop may have made room, or ticks pass. */
+void bus_ring_wait_space(bus_ring_t *r, TickType_t ticks);
+
+/** Wake the consumer, or end its next wait at once (after work it cannot see in the ring). */
+void bus_ring_wake_consumer(bus_ring_t *r);
+
+/** Messages queued now (approximate while producers are active). */
+uint32_t bus_ring_depth(bus_ring_t *r);
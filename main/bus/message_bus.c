@@ -1,59 +1,351 @@
 #include "message_bus.h"
+#include "bus/bus_ring.h"
 #include "mimi_config.h"
+#include "storage/storage_fs.h"
 #include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include <inttypes.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
 static const char *TAG = "bus";
 
-static QueueHandle_t s_inbound_queue;
-static QueueHandle_t s_outbound_queue;
+/* Longest a full-queue push sleeps before re-checking its deadline */
+#define BUS_WAIT_SLICE_MS 10
 
-esp_err_t message_bus_init(void)
-{
-    s_inbound_queue = xQueueCreate(MIMI_BUS_QUEUE_LEN, sizeof(mimi_msg_t));
-    s_outbound_queue = xQueueCreate(MIMI_BUS_QUEUE_LEN, sizeof(mimi_msg_t));
+/* Spill record: header, then len bytes of text. Names, not table ids,
+   which do not survive a restart; flags are not kept, so a spilled status
+   message is delivered like any other */
+typedef struct {
+    char channel[16];
+    char chat_id[MIMI_CHAT_ID_MAX];
+    uint32_t len;
+} spill_hdr_t;
 
-    if (!s_inbound_queue || !s_outbound_queue) {
-        ESP_LOGE(TAG, "Failed to create message queues");
+typedef struct {
+    bus_ring_t ring;
+    const char *name;
+    const char *spill_path;
+    _Atomic int policy;
+    _Atomic bool spilling;      /* set under spill_lock; pushes go to the file while set */
+    SemaphoreHandle_t spill_lock;
+    long spill_read;            /* offset of the next record to deliver */
+    long spill_size;            /* end of the last whole record */
+    bool spill_sealed;          /* a write failed: no appends until the file is drained */
+    uint32_t spill_pending;
+    _Atomic uint32_t delivered, waited, rejected, spilled;
+} bus_queue_t;
+
+static bus_queue_t s_queues[MIMI_BUS_QUEUES];
+
+static const char *s_policy_names[] = {
+    [BUS_POLICY_BLOCK] = "block",
+    [BUS_POLICY_SPILL] = "spill",
+    [BUS_POLICY_DROP_OLDEST] = "drop-oldest",
+};
+
+/* ── Spill file ─────────────────────────────────────────────── */
+
+/* Caller holds spill_lock */
+static esp_err_t spill_append(bus_queue_t *q, const mimi_msg_t *msg)
+{
+    spill_hdr_t hdr = {0};
+    size_t len = mimi_msg_len(msg);
+    if (q->spill_sealed || q->spill_size + (long)(sizeof(hdr) + len) > MIMI_BUS_SPILL_MAX_BYTES) {
         return ESP_ERR_NO_MEM;
     }
+    strncpy(hdr.channel, mimi_msg_channel(msg), sizeof(hdr.channel) - 1);
+    strncpy(hdr.chat_id, mimi_msg_chat_id(msg), sizeof(hdr.chat_id) - 1);
+    hdr.len = (uint32_t)len;
+
+    FILE *f = storage_open(q->spill_path, "a");
+    if (!f) return ESP_FAIL;
+    bool ok = fwrite(&hdr, sizeof(hdr), 1, f) == 1 &&
+              (len == 0 || fwrite(mimi_msg_text(msg), 1, len, f) == len);
+    if (fclose(f) != 0) ok = false;
+    if (!ok) {
+        /* The reader stops at spill_size, before any torn record */
+        q->spill_sealed = true;
+        return ESP_FAIL;
+    }
 
-    ESP_LOGI(TAG, "Message bus initialized (queue depth %d)", MIMI_BUS_QUEUE_LEN);
+    q->spill_size += sizeof(hdr) + len;
+    q->spill_pending++;
+    mimi_msg_t done = *msg;
+    mimi_msg_release(&done);
     return ESP_OK;
 }
 
-esp_err_t message_bus_push_inbound(const mimi_msg_t *msg)
+/* Next spilled message, or false once the file is drained (and removed). Consumer only. */
+static bool spill_next(bus_queue_t *q, mimi_msg_t *out)
 {
-    if (xQueueSend(s_inbound_queue, msg, pdMS_TO_TICKS(1000)) != pdTRUE) {
-        ESP_LOGW(TAG, "Inbound queue full, dropping message");
-        return ESP_ERR_NO_MEM;
+    xSemaphoreTake(q->spill_lock, portMAX_DELAY);
+    bool got = false;
+    while (!got && q->spill_read < q->spill_size) {
+        FILE *f = storage_open(q->spill_path, "r");
+        spill_hdr_t hdr;
+        if (!f || fseek(f, q->spill_read, SEEK_SET) != 0 || fread(&hdr, sizeof(hdr), 1, f) != 1) {
+            if (f) fclose(f);
+            ESP_LOGE(TAG, "%s spill unreadable at %ld, discarding %" PRIu32 " messages",
+                     q->name, q->spill_read, q->spill_pending);
+            q->spill_read = q->spill_size;
+            break;
+        }
+        hdr.channel[sizeof(hdr.channel) - 1] = '\0';
+        hdr.chat_id[sizeof(hdr.chat_id) - 1] = '\0';
+        mimi_payload_t *p = mimi_payload_alloc(hdr.len);
+        if (p && fread(p->text, 1, hdr.len, f) == hdr.len &&
+            mimi_msg_init(out, hdr.channel, hdr.chat_id, p) == ESP_OK) {
+            got = true;
+        } else {
+            mimi_payload_unref(p);
+            ESP_LOGW(TAG, "%s spill: skipping a %" PRIu32 "-byte record", q->name, hdr.len);
+        }
+        fclose(f);
+        q->spill_read += sizeof(hdr) + hdr.len;
+        if (q->spill_pending) q->spill_pending--;
     }
-    return ESP_OK;
+    if (!got) {
+        storage_remove(q->spill_path);
+        q->spill_read = q->spill_size = 0;
+        q->spill_sealed = false;
+        q->spill_pending = 0;
+        atomic_store(&q->spilling, false);
+    }
+    xSemaphoreGive(q->spill_lock);
+    return got;
 }
 
-esp_err_t message_bus_pop_inbound(mimi_msg_t *msg, uint32_t timeout_ms)
+/* Pick up a spill file left by the previous boot */
+static void spill_recover(bus_queue_t *q)
 {
-    TickType_t ticks = (timeout_ms == UINT32_MAX) ? portMAX_DELAY : pdMS_TO_TICKS(timeout_ms);
-    if (xQueueReceive(s_inbound_queue, msg, ticks) != pdTRUE) {
-        return ESP_ERR_TIMEOUT;
+    FILE *f = storage_open(q->spill_path, "r");
+    if (!f) return;
+    spill_hdr_t hdr;
+    long off = 0, size = 0;
+    if (fseek(f, 0, SEEK_END) == 0) size = ftell(f);
+    /* A record torn by the restart ends the file */
+    while (fseek(f, off, SEEK_SET) == 0 && fread(&hdr, sizeof(hdr), 1, f) == 1 &&
+           off + (long)(sizeof(hdr) + hdr.len) <= size) {
+        off += sizeof(hdr) + hdr.len;
+        q->spill_pending++;
+    }
+    fclose(f);
+    q->spill_size = off;
+    q->spill_sealed = off < size;
+    if (q->spill_pending) {
+        atomic_store(&q->spilling, true);
+        ESP_LOGI(TAG, "%s: %" PRIu32 " spilled messages from before restart",
+                 q->name, q->spill_pending);
+    } else {
+        storage_remove(q->spill_path);
+        q->spill_size = 0;
     }
+}
+
+/* ── Queues ─────────────────────────────────────────────────── */
+
+static esp_err_t queue_init(bus_queue_t *q, const char *name, uint32_t cap,
+                            message_bus_policy_t policy, const char *spill_path)
+{
+    memset(q, 0, sizeof(*q));
+    q->name = name;
+    q->spill_path = spill_path;
+    atomic_init(&q->policy, policy);
+    q->spill_lock = xSemaphoreCreateMutex();
+    if (!q->spill_lock) return ESP_ERR_NO_MEM;
+    esp_err_t err = bus_ring_init(&q->ring, cap);
+    if (err != ESP_OK) return err;
+    spill_recover(q);
     return ESP_OK;
 }
 
-esp_err_t message_bus_push_outbound(const mimi_msg_t *msg)
+esp_err_t message_bus_init(void)
 {
-    if (xQueueSend(s_outbound_queue, msg, pdMS_TO_TICKS(1000)) != pdTRUE) {
-        ESP_LOGW(TAG, "Outbound queue full, dropping message");
-        return ESP_ERR_NO_MEM;
+    esp_err_t err = bus_msg_init();
+    if (err != ESP_OK) return err;
+    err = queue_init(&s_queues[MIMI_BUS_INBOUND], "inbound", MIMI_BUS_INBOUND_LEN,
+                     MIMI_BUS_INBOUND_POLICY, MIMI_BUS_SPILL_INBOUND);
+    if (err == ESP_OK) {
+        err = queue_init(&s_queues[MIMI_BUS_OUTBOUND], "outbound", MIMI_BUS_OUTBOUND_LEN,
+                         MIMI_BUS_OUTBOUND_POLICY, MIMI_BUS_SPILL_OUTBOUND);
     }
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to create message queues");
+        return err;
+    }
+
+    ESP_LOGI(TAG, "Message bus initialized (inbound %" PRIu32 " %s, outbound %" PRIu32 " %s)",
+             s_queues[MIMI_BUS_INBOUND].ring.cap,
+             message_bus_policy_name(MIMI_BUS_INBOUND_POLICY),
+             s_queues[MIMI_BUS_OUTBOUND].ring.cap,
+             message_bus_policy_name(MIMI_BUS_OUTBOUND_POLICY));
     return ESP_OK;
 }
 
+esp_err_t message_bus_push(message_bus_queue_t which, const mimi_msg_t *msg)
+{
+    bus_queue_t *q = &s_queues[which];
+
+    /* While a spill is being drained, later messages queue behind it */
+    if (atomic_load(&q->spilling)) {
+        xSemaphoreTake(q->spill_lock, portMAX_DELAY);
+        if (atomic_load(&q->spilling)) {
+            esp_err_t err = spill_append(q, msg);
+            xSemaphoreGive(q->spill_lock);
+            if (err == ESP_OK) {
+                atomic_fetch_add(&q->spilled, 1);
+                bus_ring_wake_consumer(&q->ring);
+            } else {
+                atomic_fetch_add(&q->rejected, 1);
+                ESP_LOGW(TAG, "%s spill full, refusing message for %s:%s",
+                         q->name, mimi_msg_channel(msg), mimi_msg_chat_id(msg));
+                return ESP_ERR_TIMEOUT;
+            }
+            return ESP_OK;
+        }
+        xSemaphoreGive(q->spill_lock);
+    }
+
+    if (bus_ring_try_push(&q->ring, msg)) return ESP_OK;
+
+    message_bus_policy_t policy = atomic_load(&q->policy);
+    if (policy == BUS_POLICY_SPILL) {
+        xSemaphoreTake(q->spill_lock, portMAX_DELAY);
+        atomic_store(&q->spilling, true);
+        esp_err_t err = spill_append(q, msg);
+        if (err != ESP_OK && q->spill_size == 0) atomic_store(&q->spilling, false);
+        bool spilling = atomic_load(&q->spilling);
+        xSemaphoreGive(q->spill_lock);
+        if (err == ESP_OK) {
+            atomic_fetch_add(&q->spilled, 1);
+            bus_ring_wake_consumer(&q->ring);
+            return ESP_OK;
+        }
+        if (spilling) {
+            /* Another push got its message into the file first: stay behind it */
+            atomic_fetch_add(&q->rejected, 1);
+            return ESP_ERR_TIMEOUT;
+        }
+        ESP_LOGW(TAG, "%s spill failed (%s), waiting instead", q->name, esp_err_to_name(err));
+    }
+
+    if (policy == BUS_POLICY_DROP_OLDEST && bus_ring_replace_oldest(&q->ring, msg)) {
+        ESP_LOGW(TAG, "%s full: dropped oldest message for %s:%s",
+                 q->name, mimi_msg_channel(msg), mimi_msg_chat_id(msg));
+        return ESP_OK;
+    }
+
+    atomic_fetch_add(&q->waited, 1);
+    TickType_t start = xTaskGetTickCount();
+    TickType_t limit = pdMS_TO_TICKS(MIMI_BUS_PUSH_TIMEOUT_MS);
+    TickType_t slice = pdMS_TO_TICKS(BUS_WAIT_SLICE_MS);
+    if (slice == 0) slice = 1;
+    for (;;) {
+        if (bus_ring_try_push(&q->ring, msg)) return ESP_OK;
+        TickType_t elapsed = xTaskGetTickCount() - start;
+        if (elapsed >= limit) break;
+        bus_ring_wait_space(&q->ring, limit - elapsed < slice ? limit - elapsed : slice);
+    }
+
+    atomic_fetch_add(&q->rejected, 1);
+    ESP_LOGW(TAG, "%s queue full, refusing message for %s:%s",
+             q->name, mimi_msg_channel(msg), mimi_msg_chat_id(msg));
+    return ESP_ERR_TIMEOUT;
+}
+
+esp_err_t message_bus_pop(message_bus_queue_t which, mimi_msg_t *msg, uint32_t timeout_ms)
+{
+    bus_queue_t *q = &s_queues[which];
+    TickType_t start = xTaskGetTickCount();
+    TickType_t limit = (timeout_ms == UINT32_MAX) ? portMAX_DELAY : pdMS_TO_TICKS(timeout_ms);
+
+    for (;;) {
+        /* Spilled messages are next in order once the ring is drained */
+        if (bus_ring_try_pop(&q->ring, msg) ||
+            (atomic_load(&q->spilling) && spill_next(q, msg))) {
+            /* Single consumer: no read-modify-write needed */
+            atomic_store_explicit(&q->delivered,
+                                  atomic_load_explicit(&q->delivered, memory_order_relaxed) + 1,
+                                  memory_order_relaxed);
+            return ESP_OK;
+        }
+
+        TickType_t wait = portMAX_DELAY;
+        if (limit != portMAX_DELAY) {
+            TickType_t elapsed = xTaskGetTickCount() - start;
+            if (elapsed >= limit) return ESP_ERR_TIMEOUT;
+            wait = limit - elapsed;
+        }
+        bus_ring_wait_items(&q->ring, wait);
+    }
+}
+
+esp_err_t message_bus_push_inbound(const mimi_msg_t *msg)
+{
+    return message_bus_push(MIMI_BUS_INBOUND, msg);
+}
+
+esp_err_t message_bus_pop_inbound(mimi_msg_t *msg, uint32_t timeout_ms)
+{
+    return message_bus_pop(MIMI_BUS_INBOUND, msg, timeout_ms);
+}
+
+esp_err_t message_bus_push_outbound(const mimi_msg_t *msg)
+{
+    return message_bus_push(MIMI_BUS_OUTBOUND, msg);
+}
+
 esp_err_t message_bus_pop_outbound(mimi_msg_t *msg, uint32_t timeout_ms)
 {
-    TickType_t ticks = (timeout_ms == UINT32_MAX) ? portMAX_DELAY : pdMS_TO_TICKS(timeout_ms);
-    if (xQueueReceive(s_outbound_queue, msg, ticks) != pdTRUE) {
-        return ESP_ERR_TIMEOUT;
+    return message_bus_pop(MIMI_BUS_OUTBOUND, msg, timeout_ms);
+}
+
+/* ── Policy and stats ───────────────────────────────────────── */
+
+void message_bus_set_policy(message_bus_queue_t which, message_bus_policy_t policy)
+{
+    atomic_store(&s_queues[which].policy, policy);
+    ESP_LOGI(TAG, "%s policy: %s", s_queues[which].name, message_bus_policy_name(policy));
+}
+
+const char *message_bus_policy_name(message_bus_policy_t policy)
+{
+    if ((unsigned)policy >= sizeof(s_policy_names) / sizeof(s_policy_names[0])) return "?";
+    return s_policy_names[policy];
+}
+
+bool message_bus_parse_policy(const char *name, message_bus_policy_t *out)
+{
+    for (size_t i = 0; i < sizeof(s_policy_names) / sizeof(s_policy_names[0]); i++) {
+        if (strcmp(name, s_policy_names[i]) == 0) {
+            *out = (message_bus_policy_t)i;
+            return true;
+        }
     }
-    return ESP_OK;
+    return false;
+}
+
+void message_bus_get_stats(message_bus_queue_t which, message_bus_stats_t *out)
+{
+    bus_queue_t *q = &s_queues[which];
+    memset(out, 0, sizeof(*out));
+    out->policy = atomic_load(&q->policy);
+    out->capacity = q->ring.cap;
+    if (!q->ring.slots) return;
+    out->depth = bus_ring_depth(&q->ring);
+    out->high_water = atomic_load(&q->ring.high_water);
+    out->dropped = atomic_load(&q->ring.dropped);
+    out->pushed = atomic_load(&q->ring.head) + out->dropped + atomic_load(&q->spilled);
+    out->popped = atomic_load(&q->delivered);
+    out->waited = atomic_load(&q->waited);
+    out->rejected = atomic_load(&q->rejected);
+    out->spilled = atomic_load(&q->spilled);
+    xSemaphoreTake(q->spill_lock, portMAX_DELAY);
+    out->spill_pending = q->spill_pending;
+    xSemaphoreGive(q->spill_lock);
 }
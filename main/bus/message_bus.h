@@ -1,48 +1,78 @@
 #pragma once
 
+#include <stdbool.h>
+#include <stdint.h>
 #include "esp_err.h"
-#include "freertos/FreeRTOS.h"
-#include "freertos/queue.h"
+#include "bus/bus_msg.h"
 
-/* Channel identifiers */
-#define MIMI_CHAN_TELEGRAM   "telegram"
-#define MIMI_CHAN_FEISHU     "feishu"
-#define MIMI_CHAN_WEBSOCKET  "websocket"
-#define MIMI_CHAN_CLI        "cli"
-#define MIMI_CHAN_SYSTEM     "system"
+typedef enum {
+    MIMI_BUS_INBOUND = 0,   /* channels, cron, heartbeat -> agent loop */
+    MIMI_BUS_OUTBOUND,      /* agent loop -> channels */
+    MIMI_BUS_QUEUES,
+} message_bus_queue_t;
+
+/* What a push does when its queue is full */
+typedef enum {
+    BUS_POLICY_BLOCK = 0,   /* wait up to MIMI_BUS_PUSH_TIMEOUT_MS, then fail */
+    BUS_POLICY_SPILL,       /* append to a file on flash, delivered once the queue drains */
+    BUS_POLICY_DROP_OLDEST, /* replace the chat's oldest queued message; BLOCK if it has none */
+} message_bus_policy_t;
 
-/* Message types on the bus */
 typedef struct {
-    char channel[16];       /* "telegram", "websocket", "cli" */
-    char chat_id[96];       /* Telegram/Feishu chat_id, open_id, or WS client id */
-    char *content;          /* Heap-allocated message text (caller must free) */
-} mimi_msg_t;
+    message_bus_policy_t policy;
+    uint32_t capacity;
+    uint32_t depth;             /* in the ring now */
+    uint32_t high_water;
+    uint32_t pushed, popped;
+    uint32_t waited;            /* pushes that found the queue full and waited */
+    uint32_t rejected;          /* pushes refused: the producer still owns the message */
+    uint32_t dropped;           /* queued messages BUS_POLICY_DROP_OLDEST discarded for a push */
+    uint32_t spilled;           /* pushes that went to flash */
+    uint32_t spill_pending;     /* of which not yet delivered */
+} message_bus_stats_t;
 
 /**
- * Initialize the message bus (inbound + outbound FreeRTOS queues).
+ * Initialize the message bus: two lock-free rings in PSRAM, of
+ * MIMI_BUS_INBOUND_LEN and MIMI_BUS_OUTBOUND_LEN messages. Messages spilled
+ * to flash before a restart are delivered first.
  */
 esp_err_t message_bus_init(void);
 
 /**
  * Push a message to the inbound queue (towards Agent Loop).
- * The bus takes ownership of msg->content.
+ * On ESP_OK the bus takes over the message's references. ESP_ERR_TIMEOUT
+ * means the queue stayed full (backpressure): the caller still owns the
+ * message (mimi_msg_release) and should hold off, keeping it if it can.
  */
 esp_err_t message_bus_push_inbound(const mimi_msg_t *msg);
 
 /**
  * Pop a message from the inbound queue (blocking).
- * Caller must free msg->content when done.
+ * Caller must mimi_msg_release() it when done.
  */
 esp_err_t message_bus_pop_inbound(mimi_msg_t *msg, uint32_t timeout_ms);
 
 /**
  * Push a message to the outbound queue (towards channels).
- * The bus takes ownership of msg->content.
+ * Ownership as for message_bus_push_inbound().
  */
 esp_err_t message_bus_push_outbound(const mimi_msg_t *msg);
 
 /**
  * Pop a message from the outbound queue (blocking).
- * Caller must free msg->content when done.
+ * Caller must mimi_msg_release() it when done.
  */
 esp_err_t message_bus_pop_outbound(mimi_msg_t *msg, uint32_t timeout_ms);
+
+/**
+ * Pop from either queue. Only one task may pop from each queue.
+ */
+esp_err_t message_bus_pop(message_bus_queue_t q, mimi_msg_t *msg, uint32_t timeout_ms);
+
+esp_err_t message_bus_push(message_bus_queue_t q, const mimi_msg_t *msg);
+
+void message_bus_set_policy(message_bus_queue_t q, message_bus_policy_t policy);
+bool message_bus_parse_policy(const char *name, message_bus_policy_t *out);
+const char *message_bus_policy_name(message_bus_policy_t policy);
+
+void message_bus_get_stats(message_bus_queue_t q, message_bus_stats_t *out);
@@ -0,0 +1,378 @@
+#include "bus/outbound.h"
+#include "bus/message_bus.h"
+#include "mimi_config.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_heap_caps.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include <stdatomic.h>
+#include <stdio.h>
+#include <string.h>
+
+static const char *TAG = "outbound";
+
+typedef struct {
+    mimi_msg_t msg;
+    int64_t queued_us;
+} outbound_item_t;
+
+typedef struct outbound_chan outbound_chan_t;
+
+typedef struct {
+    outbound_chan_t *ch;
+    QueueHandle_t queue;        /* NULL until the worker's first message */
+    int index;
+    bool start_failed;          /* logged once; the router keeps retrying */
+} outbound_worker_t;
+
+struct outbound_chan {
+    outbound_channel_t cfg;
+    outbound_worker_t workers[MIMI_OUTBOUND_MAX_WORKERS];
+    /* Router only: messages whose worker queue was full, oldest first */
+    outbound_item_t *held;      /* PSRAM, MIMI_OUTBOUND_HELD */
+    int held_n;
+    uint8_t held_for[MIMI_OUTBOUND_MAX_WORKERS];
+    _Atomic uint32_t queued, high_water, busy, started;
+    _Atomic uint32_t sent, failed, merged, superseded, waited, stalls, max_ms;
+    _Atomic uint64_t total_ms;
+    _Atomic uint32_t hist[OUTBOUND_STATS_BUCKETS];
+};
+
+static outbound_chan_t s_chans[MIMI_OUTBOUND_CHANNELS];
+static int s_chan_count;
+static outbound_chan_t *s_by_id[MIMI_BUS_CHANNELS];     /* by interned channel id */
+static bool s_started;
+static _Atomic uint32_t s_unrouted;
+
+uint32_t outbound_bucket_ms(int i)
+{
+    return i < OUTBOUND_STATS_BUCKETS - 1 ? 16u << (2 * i) : 0;
+}
+
+esp_err_t outbound_register(const outbound_channel_t *ch)
+{
+    if (s_started) return ESP_ERR_INVALID_STATE;
+    if (!ch->name || !ch->send || ch->workers == 0 || ch->workers > MIMI_OUTBOUND_MAX_WORKERS) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    uint8_t id = bus_chan_intern(ch->name);
+    if (id == MIMI_CHAN_ID_NONE || s_chan_count >= MIMI_OUTBOUND_CHANNELS) {
+        ESP_LOGE(TAG, "No room to register channel %s", ch->name);
+        return ESP_ERR_NO_MEM;
+    }
+    if (s_by_id[id]) return ESP_ERR_INVALID_STATE;
+
+    outbound_chan_t *c = &s_chans[s_chan_count];
+    c->held = heap_caps_calloc(MIMI_OUTBOUND_HELD, sizeof(outbound_item_t), MALLOC_CAP_SPIRAM);
+    if (!c->held) return ESP_ERR_NO_MEM;
+    s_chan_count++;
+    c->cfg = *ch;
+    for (int i = 0; i < ch->workers; i++) {
+        c->workers[i].ch = c;
+        c->workers[i].index = i;
+    }
+    s_by_id[id] = c;
+    ESP_LOGI(TAG, "Channel %s: %d worker(s)", ch->name, ch->workers);
+    return ESP_OK;
+}
+
+/* ── Workers ────────────────────────────────────────────────── */
+
+static void record_latency(outbound_chan_t *c, int64_t queued_us, bool ok)
+{
+    int64_t ms = (esp_timer_get_time() - queued_us) / 1000;
+    uint32_t v = ms < 0 ? 0 : ms > UINT32_MAX ? UINT32_MAX : (uint32_t)ms;
+    int b = 0;
+    while (b < OUTBOUND_STATS_BUCKETS - 1 && v >= outbound_bucket_ms(b)) b++;
+    atomic_fetch_add(&c->hist[b], 1);
+    atomic_fetch_add(&c->total_ms, v);
+    atomic_fetch_add(ok ? &c->sent : &c->failed, 1);
+    uint32_t max = atomic_load(&c->max_ms);
+    while (v > max && !atomic_compare_exchange_weak(&c->max_ms, &max, v)) {
+    }
+}
+
+/* Pending messages a worker has taken off its queue, oldest first */
+typedef struct {
+    outbound_item_t items[MIMI_OUTBOUND_WORKER_QUEUE];
+    int n;
+} pending_t;
+
+static void pending_remove(pending_t *p, int i)
+{
+    memmove(&p->items[i], &p->items[i + 1], (p->n - i - 1) * sizeof(p->items[0]));
+    p->n--;
+}
+
+/* Take what the queue holds; with a coalescing channel, wait until the
+   oldest message is MIMI_OUTBOUND_COALESCE_MS old for more to arrive */
+static void collect(outbound_worker_t *w, pending_t *p)
+{
+    if (p->n == 0) {
+        while (xQueueReceive(w->queue, &p->items[0], portMAX_DELAY) != pdTRUE) {
+        }
+        p->n = 1;
+    }
+    int64_t until = w->ch->cfg.coalesce_max
+                        ? p->items[0].queued_us + MIMI_OUTBOUND_COALESCE_MS * 1000
+                        : 0;
+    while (p->n < MIMI_OUTBOUND_WORKER_QUEUE) {
+        int64_t left_ms = (until - esp_timer_get_time() + 999) / 1000;
+        TickType_t ticks = left_ms > 0 ? pdMS_TO_TICKS(left_ms) : 0;
+        if (xQueueReceive(w->queue, &p->items[p->n], ticks) != pdTRUE) break;
+        p->n++;
+    }
+}
+
+/* Drop status messages that a later message for the same chat follows */
+static void drop_superseded(outbound_chan_t *c, pending_t *p)
+{
+    for (int i = 0; i < p->n; i++) {
+        if (!(p->items[i].msg.flags & MIMI_MSG_STATUS)) continue;
+        for (int j = i + 1; j < p->n; j++) {
+            if (p->items[j].msg.chat != p->items[i].msg.chat) continue;
+            ESP_LOGI(TAG, "%s: dropping status for %s, a later message is queued",
+                     c->cfg.name, mimi_msg_chat_id(&p->items[i].msg));
+            mimi_msg_release(&p->items[i].msg);
+            pending_remove(p, i--);
+            atomic_fetch_sub(&c->queued, 1);
+            atomic_fetch_add(&c->superseded, 1);
+            break;
+        }
+    }
+}
+
+/* Join the chat's next pending texts to head while they fit in coalesce_max */
+static void merge_into(outbound_chan_t *c, pending_t *p, outbound_item_t *head)
+{
+    static const char sep[] = "\n\n";
+    if (!c->cfg.coalesce_max || (head->msg.flags & MIMI_MSG_STATUS)) return;
+
+    int take[MIMI_OUTBOUND_WORKER_QUEUE];
+    int ntake = 0;
+    size_t total = mimi_msg_len(&head->msg);
+    for (int i = 0; i < p->n; i++) {
+        const mimi_msg_t *m = &p->items[i].msg;
+        if (m->chat != head->msg.chat) continue;
+        /* Stop at the first one that cannot join, so the chat stays in order */
+        if ((m->flags & MIMI_MSG_STATUS) ||
+            total + sizeof(sep) - 1 + mimi_msg_len(m) > c->cfg.coalesce_max) {
+            break;
+        }
+        total += sizeof(sep) - 1 + mimi_msg_len(m);
+        take[ntake++] = i;
+    }
+    if (ntake == 0) return;
+
+    mimi_payload_t *joined = mimi_payload_alloc(total);
+    if (!joined) return;        /* send them one by one */
+    size_t off = mimi_msg_len(&head->msg);
+    memcpy(joined->text, mimi_msg_text(&head->msg), off);
+    for (int k = 0; k < ntake; k++) {
+        const mimi_msg_t *m = &p->items[take[k]].msg;
+        memcpy(joined->text + off, sep, sizeof(sep) - 1);
+        off += sizeof(sep) - 1;
+        memcpy(joined->text + off, mimi_msg_text(m), mimi_msg_len(m));
+        off += mimi_msg_len(m);
+    }
+    /* Back to front, so the indices still to remove stay valid */
+    for (int k = ntake - 1; k >= 0; k--) {
+        mimi_msg_release(&p->items[take[k]].msg);
+        pending_remove(p, take[k]);
+    }
+    mimi_payload_unref(head->msg.payload);
+    head->msg.payload = joined;
+    atomic_fetch_sub(&c->queued, ntake);
+    atomic_fetch_add(&c->merged, ntake);
+    ESP_LOGI(TAG, "%s: merged %d message(s) for %s into one send",
+             c->cfg.name, ntake + 1, mimi_msg_chat_id(&head->msg));
+}
+
+static void outbound_worker_task(void *arg)
+{
+    outbound_worker_t *w = arg;
+    outbound_chan_t *c = w->ch;
+    pending_t pending = { .n = 0 };
+
+    while (1) {
+        collect(w, &pending);
+        drop_superseded(c, &pending);
+
+        outbound_item_t item = pending.items[0];
+        pending_remove(&pending, 0);
+        merge_into(c, &pending, &item);
+        atomic_fetch_sub(&c->queued, 1);
+        atomic_fetch_add(&c->busy, 1);
+
+        const char *chat_id = mimi_msg_chat_id(&item.msg);
+        esp_err_t err = c->cfg.send(chat_id, mimi_msg_text(&item.msg));
+        record_latency(c, item.queued_us, err == ESP_OK);
+        if (err != ESP_OK) {
+            ESP_LOGE(TAG, "%s send failed for %s: %s", c->cfg.name, chat_id, esp_err_to_name(err));
+        } else {
+            ESP_LOGI(TAG, "%s send success for %s (%d bytes)",
+                     c->cfg.name, chat_id, (int)mimi_msg_len(&item.msg));
+        }
+
+        atomic_fetch_sub(&c->busy, 1);
+        mimi_msg_release(&item.msg);
+    }
+}
+
+static esp_err_t worker_start(outbound_worker_t *w)
+{
+    outbound_chan_t *c = w->ch;
+    w->queue = xQueueCreate(MIMI_OUTBOUND_WORKER_QUEUE, sizeof(outbound_item_t));
+    if (!w->queue) return ESP_ERR_NO_MEM;
+
+    char name[16];
+    snprintf(name, sizeof(name), "out_%.8s%d", c->cfg.name, w->index);
+    if (xTaskCreatePinnedToCore(outbound_worker_task, name, c->cfg.stack, w,
+                                MIMI_OUTBOUND_PRIO, NULL, MIMI_OUTBOUND_CORE) != pdPASS) {
+        vQueueDelete(w->queue);
+        w->queue = NULL;
+        return ESP_ERR_NO_MEM;
+    }
+    atomic_fetch_add(&c->started, 1);
+    return ESP_OK;
+}
+
+/* ── Router ─────────────────────────────────────────────────── */
+
+/* Hand item to its worker without waiting; false if the worker's queue is
+   full or the worker cannot start */
+static bool hand_over(outbound_chan_t *c, const outbound_item_t *item)
+{
+    outbound_worker_t *w = &c->workers[item->msg.chat % c->cfg.workers];
+    if (!w->queue && worker_start(w) != ESP_OK) {
+        if (!w->start_failed) ESP_LOGE(TAG, "Failed to start a %s worker, holding its messages", c->cfg.name);
+        w->start_failed = true;
+        return false;
+    }
+    return xQueueSend(w->queue, item, 0) == pdTRUE;
+}
+
+/* Retry held messages in order; one that cannot go holds back the rest
+   for its worker only */
+static void drain_held(outbound_chan_t *c)
+{
+    bool blocked[MIMI_OUTBOUND_MAX_WORKERS] = { false };
+    int keep = 0;
+    for (int i = 0; i < c->held_n; i++) {
+        int wi = c->held[i].msg.chat % c->cfg.workers;
+        if (!blocked[wi] && hand_over(c, &c->held[i])) {
+            c->held_for[wi]--;
+            continue;
+        }
+        blocked[wi] = true;
+        c->held[keep++] = c->held[i];
+    }
+    c->held_n = keep;
+}
+
+static void route(mimi_msg_t *msg)
+{
+    outbound_chan_t *c = msg->chan < MIMI_BUS_CHANNELS ? s_by_id[msg->chan] : NULL;
+    if (!c) {
+        atomic_fetch_add(&s_unrouted, 1);
+        ESP_LOGW(TAG, "Unknown channel: %s", mimi_msg_channel(msg));
+        mimi_msg_release(msg);
+        return;
+    }
+
+    /* A chat's slot is held while any of its messages is queued, so all of
+       them reach the same worker and leave in order */
+    int wi = msg->chat % c->cfg.workers;
+    outbound_item_t item = { .msg = *msg, .queued_us = esp_timer_get_time() };
+    /* Counted before the send: the worker may take it at once */
+    uint32_t depth = atomic_fetch_add(&c->queued, 1) + 1;
+    uint32_t hw = atomic_load(&c->high_water);
+    while (depth > hw && !atomic_compare_exchange_weak(&c->high_water, &hw, depth)) {
+    }
+    if (c->held_for[wi] == 0 && hand_over(c, &item)) return;
+
+    /* Behind its worker: keep it until the worker takes more. The router
+       only calls this with room left (see outbound_router_task). */
+    atomic_fetch_add(&c->waited, 1);
+    c->held[c->held_n++] = item;
+    c->held_for[wi]++;
+    if (c->held_n == MIMI_OUTBOUND_HELD) {
+        atomic_fetch_add(&c->stalls, 1);
+        ESP_LOGW(TAG, "%s is %d messages behind, pausing the outbound queue",
+                 c->cfg.name, MIMI_OUTBOUND_HELD);
+    }
+}
+
+static void outbound_router_task(void *arg)
+{
+    ESP_LOGI(TAG, "Outbound dispatch started, %d channel(s)", s_chan_count);
+
+    while (1) {
+        bool holding = false, full = false;
+        for (int i = 0; i < s_chan_count; i++) {
+            outbound_chan_t *c = &s_chans[i];
+            if (!c->held_n) continue;
+            drain_held(c);
+            holding |= c->held_n > 0;
+            full |= c->held_n == MIMI_OUTBOUND_HELD;
+        }
+        /* A channel with no room left stops the router taking more: the
+           outbound queue fills and pushes wait, as they did when sends
+           ran on this task */
+        if (full) {
+            vTaskDelay(pdMS_TO_TICKS(MIMI_OUTBOUND_RETRY_MS));
+            continue;
+        }
+
+        mimi_msg_t msg;
+        if (message_bus_pop_outbound(&msg, holding ? MIMI_OUTBOUND_RETRY_MS : UINT32_MAX) != ESP_OK) {
+            continue;
+        }
+        ESP_LOGI(TAG, "Dispatching response to %s:%s",
+                 mimi_msg_channel(&msg), mimi_msg_chat_id(&msg));
+        route(&msg);
+    }
+}
+
+esp_err_t outbound_start(void)
+{
+    if (s_started) return ESP_OK;
+    s_started = true;
+    BaseType_t ret = xTaskCreatePinnedToCore(
+        outbound_router_task, "outbound",
+        MIMI_OUTBOUND_STACK, NULL,
+        MIMI_OUTBOUND_PRIO, NULL, MIMI_OUTBOUND_CORE);
+    return (ret == pdPASS) ? ESP_OK : ESP_FAIL;
+}
+
+/* ── Stats ──────────────────────────────────────────────────── */
+
+bool outbound_get_stats(int i, outbound_stats_t *out)
+{
+    if (i < 0 || i >= s_chan_count) return false;
+    outbound_chan_t *c = &s_chans[i];
+    memset(out, 0, sizeof(*out));
+    out->name = c->cfg.name;
+    out->workers = c->cfg.workers;
+    out->started = (uint8_t)atomic_load(&c->started);
+    out->busy = (uint8_t)atomic_load(&c->busy);
+    out->depth = atomic_load(&c->queued);
+    out->high_water = atomic_load(&c->high_water);
+    out->sent = atomic_load(&c->sent);
+    out->failed = atomic_load(&c->failed);
+    out->merged = atomic_load(&c->merged);
+    out->superseded = atomic_load(&c->superseded);
+    out->waited = atomic_load(&c->waited);
+    out->stalls = atomic_load(&c->stalls);
+    out->total_ms = atomic_load(&c->total_ms);
+    out->max_ms = atomic_load(&c->max_ms);
+    for (int b = 0; b < OUTBOUND_STATS_BUCKETS; b++) out->hist[b] = atomic_load(&c->hist[b]);
+    return true;
+}
+
+uint32_t outbound_unrouted(void)
+{
+    return atomic_load(&s_unrouted);
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "esp_err.h"
+
+/**
+ * Outbound dispatch: per-channel workers behind the outbound bus.
+ *
+ * One router task pops the outbound queue and hands each message to a
+ * worker of its channel, so a slow send holds up only its own channel.
+ * A channel has up to MIMI_OUTBOUND_MAX_WORKERS workers, each with its
+ * own queue of MIMI_OUTBOUND_WORKER_QUEUE messages; a chat always goes to
+ * the same worker, which keeps its replies in order while other chats
+ * send concurrently. Workers start with the first message they get. The
+ * router never waits on a channel: a message for a worker whose queue is
+ * full is held, in order, and handed over once the worker takes more.
+ * Only when a channel holds MIMI_OUTBOUND_HELD messages does the router
+ * stop taking from the outbound queue, which then pushes back on its
+ * producers as the bus does. No message is dropped.
+ *
+ * Before a send the worker coalesces what is pending for the chat. A
+ * status message (MIMI_MSG_STATUS) that a later message for the chat
+ * already follows is dropped. On channels with a coalesce_max, the worker
+ * holds a message until it is MIMI_OUTBOUND_COALESCE_MS old, and joins
+ * the chat's next queued texts to it while the result fits in
+ * coalesce_max bytes, so a burst costs one upstream call.
+ */
+
+/** Deliver text to chat_id; called on the channel's worker tasks, up to `workers` at once. */
+typedef esp_err_t (*outbound_send_fn)(const char *chat_id, const char *text);
+
+typedef struct {
+    const char *name;           /* channel name, e.g. MIMI_CHAN_TELEGRAM */
+    outbound_send_fn send;
+    uint8_t workers;            /* concurrency limit, 1..MIMI_OUTBOUND_MAX_WORKERS */
+    uint32_t stack;             /* worker task stack in bytes */
+    uint32_t coalesce_max;      /* longest merged text in bytes; 0 never merges */
+} outbound_channel_t;
+
+/* Delivery latency buckets (queued to sent): < 16 ms, then x4 up to >= 16 s */
+#define OUTBOUND_STATS_BUCKETS 7
+
+typedef struct {
+    const char *name;
+    uint8_t workers;            /* configured limit */
+    uint8_t started;            /* worker tasks running */
+    uint8_t busy;               /* sends in flight */
+    uint32_t depth;             /* queued, not yet sending */
+    uint32_t high_water;
+    uint32_t sent, failed;      /* upstream sends */
+    uint32_t merged;            /* messages joined to an earlier one's send */
+    uint32_t superseded;        /* status messages dropped for a later message */
+    uint32_t waited;            /* found the worker's queue full and were held */
+    uint32_t stalls;            /* times the held messages filled up and paused routing */
+    uint64_t total_ms;          /* delivery latency over sent + failed */
+    uint32_t max_ms;
+    uint32_t hist[OUTBOUND_STATS_BUCKETS];
+} outbound_stats_t;
+
+/** Route the channel's outbound messages to ch->send. Call before outbound_start(). */
+esp_err_t outbound_register(const outbound_channel_t *ch);
+
+/** Start the router task. */
+esp_err_t outbound_start(void);
+
+/** Upper bound of latency bucket i in milliseconds (0 for the last, open-ended one). */
+uint32_t outbound_bucket_ms(int i);
+
+/** Stats of registered channel i; false past the end. */
+bool outbound_get_stats(int i, outbound_stats_t *out);
+
+/** Messages for a channel nobody registered. */
+uint32_t outbound_unrouted(void);
@@ -2,6 +2,7 @@
 #include "mimi_config.h"
 #include "bus/message_bus.h"
 #include "proxy/http_proxy.h"
+#include "proxy/http_vcr.h"
 
 #include <string.h>
 #include <stdlib.h>
@@ -375,7 +376,22 @@ static esp_err_t feishu_get_tenant_token(void)
 /* ── Feishu API call helper ────────────────────────────────── */
 static char *feishu_api_call(const char *url, const char *method, const char *post_data)
 {
+    /* VCR key: the message id in reply URLs differs between runs */
+    char vcr_key[64];
+    const char *path = strncmp(url, FEISHU_API_BASE, strlen(FEISHU_API_BASE)) == 0
+                       ? url + strlen(FEISHU_API_BASE) : url;
+    snprintf(vcr_key, sizeof(vcr_key), "%s %s", method,
+             strstr(path, "/reply") ? "/im/v1/messages/reply" : path);
+    size_t post_len = post_data ? strlen(post_data) : 0;
+
+    if (http_vcr_replaying()) {
+        http_vcr_resp_t vr;
+        if (http_vcr_replay("feishu", vcr_key, post_data, post_len, &vr) != ESP_OK) return NULL;
+        return vr.body;
+    }
+
     if (feishu_get_tenant_token() != ESP_OK) return NULL;
+    int64_t start_us = esp_timer_get_time();
 
     http_resp_t resp = { .buf = calloc(1, 4096), .len = 0, .cap = 4096 };
     if (!resp.buf) return NULL;
@@ -414,6 +430,7 @@ static char *feishu_api_call(const char *url, const char *method, const char *po
         return NULL;
     }
 
+    http_vcr_record("feishu", vcr_key, post_data, post_len, 0, resp.buf, start_us);
     return resp.buf;
 }
 
@@ -770,16 +787,15 @@ static void handle_message_event(cJSON *event)
     }
 
     /* Push to inbound message bus */
-    mimi_msg_t msg = {0};
-    strncpy(msg.channel, MIMI_CHAN_FEISHU, sizeof(msg.channel) - 1);
-    strncpy(msg.chat_id, route_id, sizeof(msg.chat_id) - 1);
-    msg.content = strdup(cleaned);
-
-    if (msg.content) {
-        if (message_bus_push_inbound(&msg) != ESP_OK) {
-            ESP_LOGW(TAG, "Inbound queue full, dropping feishu message");
-            free(msg.content);
-        }
+    mimi_payload_t *payload = mimi_payload_from_str(cleaned);
+    mimi_msg_t msg;
+    if (payload && mimi_msg_init(&msg, MIMI_CHAN_FEISHU, route_id, payload) != ESP_OK) {
+        mimi_payload_unref(payload);
+        payload = NULL;
+    }
+    if (payload && message_bus_push_inbound(&msg) != ESP_OK) {
+        ESP_LOGW(TAG, "Inbound queue full, dropping feishu message");
+        mimi_msg_release(&msg);
     }
 
     cJSON_Delete(content_obj);
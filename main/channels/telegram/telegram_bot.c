@@ -2,6 +2,7 @@
 #include "mimi_config.h"
 #include "bus/message_bus.h"
 #include "proxy/http_proxy.h"
+#include "proxy/http_vcr.h"
 
 #include <string.h>
 #include <stdlib.h>
@@ -244,10 +245,26 @@ static char *tg_api_call_direct(const char *method, const char *post_data)
 
 static char *tg_api_call(const char *method, const char *post_data)
 {
+    size_t post_len = post_data ? strlen(post_data) : 0;
+    if (http_vcr_replaying()) {
+        http_vcr_resp_t vr;
+        if (http_vcr_replay("telegram", method, post_data, post_len, &vr) != ESP_OK) {
+            return NULL;
+        }
+        return vr.body;
+    }
+
+    int64_t start_us = esp_timer_get_time();
+    char *resp;
     if (http_proxy_is_enabled()) {
-        return tg_api_call_via_proxy(method, post_data);
+        resp = tg_api_call_via_proxy(method, post_data);
+    } else {
+        resp = tg_api_call_direct(method, post_data);
     }
-    return tg_api_call_direct(method, post_data);
+    if (resp) {
+        http_vcr_record("telegram", method, post_data, post_len, 0, resp, start_us);
+    }
+    return resp;
 }
 
 static bool tg_response_is_ok(const char *resp, const char **out_desc)
@@ -281,23 +298,89 @@ static bool tg_response_is_ok(const char *resp, const char **out_desc)
     return false;
 }
 
-static void process_updates(const char *json_str)
+/* Queue one update's text message for the agent. true if it was queued or
+   needs no queueing; false if the bus refused it, in which case the update
+   must be fetched again. */
+static bool forward_update(cJSON *update, int64_t uid)
+{
+    cJSON *message = cJSON_GetObjectItem(update, "message");
+    if (!message) return true;
+
+    cJSON *text = cJSON_GetObjectItem(message, "text");
+    if (!text || !cJSON_IsString(text)) return true;
+
+    cJSON *chat = cJSON_GetObjectItem(message, "chat");
+    if (!chat) return true;
+
+    cJSON *chat_id = cJSON_GetObjectItem(chat, "id");
+    if (!chat_id) return true;
+
+    int msg_id_val = -1;
+    cJSON *message_id = cJSON_GetObjectItem(message, "message_id");
+    if (cJSON_IsNumber(message_id)) {
+        msg_id_val = (int)message_id->valuedouble;
+    }
+
+    char chat_id_str[32];
+    if (cJSON_IsString(chat_id) && chat_id->valuestring) {
+        strncpy(chat_id_str, chat_id->valuestring, sizeof(chat_id_str) - 1);
+        chat_id_str[sizeof(chat_id_str) - 1] = '\0';
+    } else if (cJSON_IsNumber(chat_id)) {
+        snprintf(chat_id_str, sizeof(chat_id_str), "%.0f", chat_id->valuedouble);
+    } else {
+        return true;
+    }
+
+    uint64_t msg_key = 0;
+    if (msg_id_val >= 0) {
+        msg_key = make_msg_key(chat_id_str, msg_id_val);
+        if (seen_msg_contains(msg_key)) {
+            ESP_LOGW(TAG, "Drop duplicate message update_id=%" PRId64 " chat=%s message_id=%d",
+                     uid, chat_id_str, msg_id_val);
+            return true;
+        }
+    }
+
+    ESP_LOGI(TAG, "Message update_id=%" PRId64 " message_id=%d from chat %s: %.40s...",
+             uid, msg_id_val, chat_id_str, text->valuestring);
+
+    /* Push to inbound bus: the payload takes over the parsed string */
+    mimi_payload_t *payload = mimi_payload_adopt(text->valuestring);
+    if (!payload) return false;
+    text->valuestring = NULL;
+    mimi_msg_t msg;
+    if (mimi_msg_init(&msg, MIMI_CHAN_TELEGRAM, chat_id_str, payload) != ESP_OK) {
+        mimi_payload_unref(payload);
+        return false;
+    }
+    if (message_bus_push_inbound(&msg) != ESP_OK) {
+        mimi_msg_release(&msg);
+        return false;
+    }
+    /* Only now: a refused message must not look like a duplicate when it comes back */
+    if (msg_id_val >= 0) seen_msg_insert(msg_key);
+    return true;
+}
+
+/* false if the bus pushed back; the offset then stops at the refused update */
+static bool process_updates(const char *json_str)
 {
     cJSON *root = cJSON_Parse(json_str);
-    if (!root) return;
+    if (!root) return true;
 
     cJSON *ok = cJSON_GetObjectItem(root, "ok");
     if (!cJSON_IsTrue(ok)) {
         cJSON_Delete(root);
-        return;
+        return true;
     }
 
     cJSON *result = cJSON_GetObjectItem(root, "result");
     if (!cJSON_IsArray(result)) {
         cJSON_Delete(root);
-        return;
+        return true;
     }
 
+    bool accepted = true;
     cJSON *update;
     cJSON_ArrayForEach(update, result) {
         /* Track offset and skip stale/duplicate updates */
@@ -306,70 +389,24 @@ static void process_updates(const char *json_str)
         if (cJSON_IsNumber(update_id)) {
             uid = (int64_t)update_id->valuedouble;
         }
-        if (uid >= 0) {
-            if (uid < s_update_offset) {
-                continue;
-            }
-            s_update_offset = uid + 1;
-            save_update_offset_if_needed(false);
-        }
-
-        /* Extract message */
-        cJSON *message = cJSON_GetObjectItem(update, "message");
-        if (!message) continue;
-
-        cJSON *text = cJSON_GetObjectItem(message, "text");
-        if (!text || !cJSON_IsString(text)) continue;
-
-        cJSON *chat = cJSON_GetObjectItem(message, "chat");
-        if (!chat) continue;
-
-        cJSON *chat_id = cJSON_GetObjectItem(chat, "id");
-        if (!chat_id) continue;
-
-        int msg_id_val = -1;
-        cJSON *message_id = cJSON_GetObjectItem(message, "message_id");
-        if (cJSON_IsNumber(message_id)) {
-            msg_id_val = (int)message_id->valuedouble;
-        }
-
-        char chat_id_str[32];
-        if (cJSON_IsString(chat_id) && chat_id->valuestring) {
-            strncpy(chat_id_str, chat_id->valuestring, sizeof(chat_id_str) - 1);
-            chat_id_str[sizeof(chat_id_str) - 1] = '\0';
-        } else if (cJSON_IsNumber(chat_id)) {
-            snprintf(chat_id_str, sizeof(chat_id_str), "%.0f", chat_id->valuedouble);
-        } else {
+        if (uid >= 0 && uid < s_update_offset) {
             continue;
         }
 
-        if (msg_id_val >= 0) {
-            uint64_t msg_key = make_msg_key(chat_id_str, msg_id_val);
-            if (seen_msg_contains(msg_key)) {
-                ESP_LOGW(TAG, "Drop duplicate message update_id=%" PRId64 " chat=%s message_id=%d",
-                         uid, chat_id_str, msg_id_val);
-                continue;
-            }
-            seen_msg_insert(msg_key);
+        if (!forward_update(update, uid)) {
+            ESP_LOGW(TAG, "Inbound bus full, holding offset at update_id=%" PRId64, uid);
+            accepted = false;
+            break;
         }
 
-        ESP_LOGI(TAG, "Message update_id=%" PRId64 " message_id=%d from chat %s: %.40s...",
-                 uid, msg_id_val, chat_id_str, text->valuestring);
-
-        /* Push to inbound bus */
-        mimi_msg_t msg = {0};
-        strncpy(msg.channel, MIMI_CHAN_TELEGRAM, sizeof(msg.channel) - 1);
-        strncpy(msg.chat_id, chat_id_str, sizeof(msg.chat_id) - 1);
-        msg.content = strdup(text->valuestring);
-        if (msg.content) {
-            if (message_bus_push_inbound(&msg) != ESP_OK) {
-                ESP_LOGW(TAG, "Inbound queue full, drop telegram message");
-                free(msg.content);
-            }
+        if (uid >= 0) {
+            s_update_offset = uid + 1;
+            save_update_offset_if_needed(false);
         }
     }
 
     cJSON_Delete(root);
+    return accepted;
 }
 
 static void telegram_poll_task(void *arg)
@@ -390,8 +427,12 @@ static void telegram_poll_task(void *arg)
 
         char *resp = tg_api_call(params, NULL);
         if (resp) {
-            process_updates(resp);
+            bool accepted = process_updates(resp);
             free(resp);
+            if (!accepted) {
+                /* Let the agent catch up; Telegram re-delivers from the held offset */
+                vTaskDelay(pdMS_TO_TICKS(MIMI_BUS_PUSH_TIMEOUT_MS));
+            }
         } else {
             /* Back off on error */
             vTaskDelay(pdMS_TO_TICKS(3000));
@@ -409,7 +450,7 @@ esp_err_t telegram_bot_init(void)
         char tmp[128] = {0};
         size_t len = sizeof(tmp);
         if (nvs_get_str(nvs, MIMI_NVS_KEY_TG_TOKEN, tmp, &len) == ESP_OK && tmp[0]) {
-            strncpy(s_bot_token, tmp, sizeof(s_bot_token) - 1);
+            snprintf(s_bot_token, sizeof(s_bot_token), "%s", tmp);
         }
 
         int64_t offset = 0;
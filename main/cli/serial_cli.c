@@ -4,23 +4,33 @@
 #include "channels/telegram/telegram_bot.h"
 #include "channels/feishu/feishu_bot.h"
 #include "llm/llm_proxy.h"
+#include "agent/agent_loop.h"
+#include "bus/message_bus.h"
+#include "bus/outbound.h"
 #include "memory/memory_store.h"
+#include "memory/memory_index.h"
+#include "memory/memory_vec.h"
 #include "memory/session_mgr.h"
 #include "proxy/http_proxy.h"
+#include "proxy/http_vcr.h"
 #include "tools/tool_registry.h"
 #include "tools/tool_web_search.h"
 #include "cron/cron_service.h"
 #include "heartbeat/heartbeat.h"
 #include "skills/skill_loader.h"
+#include "storage/storage_cache.h"
+#include "storage/storage_fs.h"
+#include "storage/storage_log.h"
+#include "storage/storage_stats.h"
 
 #include <string.h>
 #include <stdio.h>
 #include <ctype.h>
-#include <dirent.h>
 #include "esp_log.h"
 #include "esp_console.h"
 #include "esp_system.h"
 #include "esp_heap_caps.h"
+#include "esp_timer.h"
 #include "nvs_flash.h"
 #include "nvs.h"
 #include "argtable3/argtable3.h"
@@ -206,6 +216,451 @@ static int cmd_memory_write(int argc, char **argv)
     return 0;
 }
 
+/* --- memory_search command --- */
+static struct {
+    struct arg_str *query;
+    struct arg_int *top_k;
+    struct arg_end *end;
+} memory_search_args;
+
+static int cmd_memory_search(int argc, char **argv)
+{
+    int nerrors = arg_parse(argc, argv, (void **)&memory_search_args);
+    if (nerrors != 0) {
+        arg_print_errors(stderr, memory_search_args.end, argv[0]);
+        return 1;
+    }
+    int top_k = memory_search_args.top_k->count ? memory_search_args.top_k->ival[0]
+                                                : MIMI_INDEX_TOP_K;
+    char *buf = heap_caps_malloc(MIMI_CONTEXT_MEMORY_BUDGET, MALLOC_CAP_SPIRAM);
+    if (!buf) {
+        printf("Out of memory.\n");
+        return 1;
+    }
+    int hits = memory_index_search(memory_search_args.query->sval[0], buf,
+                                   MIMI_CONTEXT_MEMORY_BUDGET, top_k);
+    printf("%s", hits ? buf : "No matching paragraphs.\n");
+    free(buf);
+
+    memory_index_stats_t st;
+    memory_index_get_stats(&st);
+    printf("--- %d hit(s) in %lu us; %lu files, %lu paragraphs (%lu dead), "
+           "%lu terms, %lu postings, %u bytes PSRAM, %lu rebuilds\n",
+           hits, (unsigned long)st.last_search_us, (unsigned long)st.files,
+           (unsigned long)st.chunks, (unsigned long)st.dead_chunks,
+           (unsigned long)st.terms, (unsigned long)st.postings,
+           (unsigned)st.psram_bytes, (unsigned long)st.rebuilds);
+
+    memory_vec_stats_t vs;
+    memory_vec_get_stats(&vs);
+    printf("--- vectors: %s, %lu x %d int8 (%u bytes flash, %u PSRAM), last scan %lu us, "
+           "%lu embeds, %lu failed, %lu vector-only hits\n",
+           memory_vec_backend_name(vs.backend), (unsigned long)vs.vectors, MIMI_VEC_DIM,
+           (unsigned)vs.flash_bytes, (unsigned)vs.psram_bytes, (unsigned long)vs.last_scan_us,
+           (unsigned long)vs.embeds, (unsigned long)vs.embed_failures,
+           (unsigned long)st.vector_only);
+    return 0;
+}
+
+/* --- set_embed command --- */
+static struct {
+    struct arg_str *backend;
+    struct arg_str *key;
+    struct arg_str *url;
+    struct arg_str *model;
+    struct arg_end *end;
+} embed_args;
+
+static int cmd_set_embed(int argc, char **argv)
+{
+    int nerrors = arg_parse(argc, argv, (void **)&embed_args);
+    if (nerrors != 0) {
+        arg_print_errors(stderr, embed_args.end, argv[0]);
+        return 1;
+    }
+    const char *name = embed_args.backend->sval[0];
+    memory_vec_backend_t backend;
+    if (strcmp(name, "off") == 0) {
+        backend = MEMORY_VEC_OFF;
+    } else if (strcmp(name, "local") == 0) {
+        backend = MEMORY_VEC_LOCAL;
+    } else if (strcmp(name, "remote") == 0) {
+        backend = MEMORY_VEC_REMOTE;
+    } else {
+        printf("Unknown backend '%s' (off|local|remote).\n", name);
+        return 1;
+    }
+    memory_vec_set_backend(backend,
+                           embed_args.key->count ? embed_args.key->sval[0] : NULL,
+                           embed_args.url->count ? embed_args.url->sval[0] : NULL,
+                           embed_args.model->count ? embed_args.model->sval[0] : NULL);
+    memory_index_reembed();
+    printf("Embedding backend: %s (stored vectors dropped, re-embedding).\n",
+           memory_vec_backend_name(backend));
+    return 0;
+}
+
+/* --- memory_notes command --- */
+static struct {
+    struct arg_int *full;
+    struct arg_int *summary;
+    struct arg_int *weeks;
+    struct arg_int *months;
+    struct arg_lit *show;
+    struct arg_end *end;
+} notes_args;
+
+static int cmd_memory_notes(int argc, char **argv)
+{
+    int nerrors = arg_parse(argc, argv, (void **)&notes_args);
+    if (nerrors != 0) {
+        arg_print_errors(stderr, notes_args.end, argv[0]);
+        return 1;
+    }
+    memory_notes_policy_t policy;
+    memory_notes_get_policy(&policy);
+    if (notes_args.full->count || notes_args.summary->count ||
+        notes_args.weeks->count || notes_args.months->count) {
+        if (notes_args.full->count) policy.full_days = (uint8_t)notes_args.full->ival[0];
+        if (notes_args.summary->count) policy.summary_days = (uint8_t)notes_args.summary->ival[0];
+        if (notes_args.weeks->count) policy.weeks = (uint8_t)notes_args.weeks->ival[0];
+        if (notes_args.months->count) policy.months = (uint8_t)notes_args.months->ival[0];
+        esp_err_t err = memory_notes_set_policy(&policy);
+        if (err == ESP_ERR_INVALID_ARG) {
+            printf("Out of range (verbatim <= 7, days <= 31, weeks <= 12, months <= 12).\n");
+            return 1;
+        }
+        if (err != ESP_OK) printf("Applied, but saving to NVS failed: %s\n", esp_err_to_name(err));
+    }
+
+    if (notes_args.show->count) {
+        char *buf = heap_caps_malloc(MIMI_NOTES_RECENT_BUDGET, MALLOC_CAP_SPIRAM);
+        if (!buf) {
+            printf("Out of memory.\n");
+            return 1;
+        }
+        memory_read_recent(buf, MIMI_NOTES_RECENT_BUDGET);
+        printf("%s\n", buf[0] ? buf : "(no recent notes)");
+        free(buf);
+    }
+
+    memory_notes_stats_t st;
+    memory_notes_get_stats(&st);
+    printf("Lookback: %d day(s) verbatim, %d days summarized, %d+ weeks, %d months\n",
+           policy.full_days, policy.summary_days, policy.weeks, policy.months);
+    printf("Block: %lu bytes cached, %lu hits, %lu rebuilds (%lu files read, last %lu us), "
+           "%lu rollups written\n",
+           (unsigned long)st.block_bytes, (unsigned long)st.hits, (unsigned long)st.rebuilds,
+           (unsigned long)st.files_read, (unsigned long)st.last_build_us,
+           (unsigned long)st.rollups_written);
+    return 0;
+}
+
+/* --- storage_log command --- */
+static struct {
+    struct arg_lit *checkpoint;
+    struct arg_end *end;
+} wal_args;
+
+static int cmd_storage_log(int argc, char **argv)
+{
+    int nerrors = arg_parse(argc, argv, (void **)&wal_args);
+    if (nerrors != 0) {
+        arg_print_errors(stderr, wal_args.end, argv[0]);
+        return 1;
+    }
+    if (wal_args.checkpoint->count) {
+        esp_err_t err = storage_checkpoint();
+        printf("Checkpoint %s\n", err == ESP_OK ? "done" : esp_err_to_name(err));
+    }
+
+    storage_log_stats_t st;
+    storage_log_get_stats(&st);
+    printf("Pending: %lu file(s), %lu bytes; log %lu bytes\n",
+           (unsigned long)st.pending_files, (unsigned long)st.pending_bytes,
+           (unsigned long)st.log_bytes);
+    printf("Writes: %lu (%lu coalesced), %llu bytes in, %llu logged, max %lu us\n",
+           (unsigned long)st.writes, (unsigned long)st.coalesced,
+           (unsigned long long)st.bytes_in, (unsigned long long)st.bytes_logged,
+           (unsigned long)st.max_write_us);
+    printf("Checkpoints: %lu (last %lu us), %lu files written, %lu records replayed at boot\n",
+           (unsigned long)st.checkpoints, (unsigned long)st.last_checkpoint_us,
+           (unsigned long)st.files_written, (unsigned long)st.replayed);
+    return 0;
+}
+
+/* --- fs_backend command --- */
+static struct {
+    struct arg_str *backend;
+    struct arg_end *end;
+} fs_args;
+
+static int cmd_fs_backend(int argc, char **argv)
+{
+    int nerrors = arg_parse(argc, argv, (void **)&fs_args);
+    if (nerrors != 0) {
+        arg_print_errors(stderr, fs_args.end, argv[0]);
+        return 1;
+    }
+
+    storage_fs_backend_t cur = storage_fs_backend();
+    if (fs_args.backend->count) {
+        storage_fs_backend_t target;
+        if (!storage_fs_parse_backend(fs_args.backend->sval[0], &target)) {
+            printf("Unknown backend '%s' (spiffs or littlefs)\n", fs_args.backend->sval[0]);
+            return 1;
+        }
+        if (target == cur) {
+            printf("Already on %s\n", storage_fs_backend_name(cur));
+            return 0;
+        }
+
+        /* Everything buffered in RAM has to be on flash before the copy */
+        session_flush();
+        memory_vec_flush();
+        storage_checkpoint();
+
+        int files = 0;
+        size_t bytes = 0;
+        printf("Migrating to %s...\n", storage_fs_backend_name(target));
+        esp_err_t err = storage_fs_migrate(target, &files, &bytes);
+        if (err != ESP_OK) {
+            printf("Migration failed: %s (%d files staged); still on %s\n",
+                   esp_err_to_name(err), files, storage_fs_backend_name(storage_fs_backend()));
+            return 1;
+        }
+        printf("Migrated %d files, %d bytes. Restarting...\n", files, (int)bytes);
+        esp_restart();
+        return 0;  /* unreachable */
+    }
+
+    size_t total = 0, used = 0;
+    storage_fs_info(&total, &used);
+    storage_fs_stats_t st;
+    storage_fs_get_stats(&st);
+    printf("Backend: %s, %d of %d bytes used\n", storage_fs_backend_name(cur), (int)used, (int)total);
+    printf("Listings: %lu (%lu from cache), %lu scans visiting %llu entries, last %lu us\n",
+           (unsigned long)st.lists, (unsigned long)st.hits, (unsigned long)st.scans,
+           (unsigned long long)st.entries_scanned, (unsigned long)st.last_scan_us);
+    printf("Cache: %lu dirs, %lu names, %d bytes\n",
+           (unsigned long)st.cached_dirs, (unsigned long)st.cached_names, (int)st.cached_bytes);
+    return 0;
+}
+
+/* --- fs_cache command --- */
+static struct {
+    struct arg_lit *drop;
+    struct arg_end *end;
+} fs_cache_args;
+
+static int cmd_fs_cache(int argc, char **argv)
+{
+    int nerrors = arg_parse(argc, argv, (void **)&fs_cache_args);
+    if (nerrors != 0) {
+        arg_print_errors(stderr, fs_cache_args.end, argv[0]);
+        return 1;
+    }
+    if (fs_cache_args.drop->count) {
+        storage_cache_reset();
+        printf("Read cache dropped\n");
+    }
+
+    storage_cache_stats_t st;
+    storage_cache_get_stats(&st);
+    uint32_t reads = st.hits + st.misses;
+    printf("Read cache: %lu file(s), %d of %d bytes\n",
+           (unsigned long)st.files, (int)st.bytes, MIMI_FS_CACHE_BYTES);
+    printf("Hits: %lu of %lu (%d%%), %lu too large, %lu invalidated by writes, %lu evicted\n",
+           (unsigned long)st.hits, (unsigned long)reads,
+           reads ? (int)(st.hits * 100ULL / reads) : 0, (unsigned long)st.bypassed,
+           (unsigned long)st.invalidations, (unsigned long)st.evictions);
+
+    storage_cache_file_t file;
+    for (size_t i = 0; storage_cache_get_file(i, &file); i++) {
+        uint32_t n = file.hits + file.misses;
+        char held[16];
+        if (file.missing) snprintf(held, sizeof(held), "missing");
+        else if (file.held) snprintf(held, sizeof(held), "%d B", (int)file.len);
+        else snprintf(held, sizeof(held), "-");
+        printf("  %3d%% %6lu hits %5lu misses  %-8s %s\n",
+               n ? (int)(file.hits * 100ULL / n) : 0, (unsigned long)file.hits,
+               (unsigned long)file.misses, held, file.path);
+    }
+    return 0;
+}
+
+/* --- fs_stats command --- */
+static struct {
+    struct arg_lit *reset;
+    struct arg_end *end;
+} fs_stats_args;
+
+static void print_bucket_label(uint32_t (*bound)(int), int i)
+{
+    uint32_t us = bound(i);
+    uint32_t top = us ? us : bound(i - 1);
+    char label[12];
+    if (top >= 1024) snprintf(label, sizeof(label), "%s%luk", us ? "<" : ">=", (unsigned long)(top / 1024));
+    else snprintf(label, sizeof(label), "<%lu", (unsigned long)top);
+    printf(" %6s", label);
+}
+
+static int cmd_fs_stats(int argc, char **argv)
+{
+    int nerrors = arg_parse(argc, argv, (void **)&fs_stats_args);
+    if (nerrors != 0) {
+        arg_print_errors(stderr, fs_stats_args.end, argv[0]);
+        return 1;
+    }
+
+    printf("Flash I/O by path class, latency histogram in us:\n");
+    printf("  %-8s %-5s %7s %10s %7s %7s", "class", "op", "count", "bytes", "avg us", "max us");
+    for (int i = 0; i < STORAGE_STATS_BUCKETS; i++) print_bucket_label(storage_stats_bucket_us, i);
+    printf("\n");
+    for (int c = 0; c < STORAGE_CLASS_COUNT; c++) {
+        for (int op = 0; op < STORAGE_OP_COUNT; op++) {
+            storage_op_stats_t st;
+            storage_stats_get(c, op, &st);
+            if (!st.count) continue;
+            printf("  %-8s %-5s %7lu %10llu %7lu %7lu", storage_class_name(c), storage_op_name(op),
+                   (unsigned long)st.count, (unsigned long long)st.bytes,
+                   (unsigned long)(st.total_us / st.count), (unsigned long)st.max_us);
+            for (int i = 0; i < STORAGE_STATS_BUCKETS; i++) printf(" %6lu", (unsigned long)st.hist[i]);
+            printf("\n");
+        }
+    }
+
+    int64_t now_ms = esp_timer_get_time() / 1000;
+    printf("Stalls (>= %d ms): %lu\n", MIMI_FS_STALL_US / 1000,
+           (unsigned long)storage_stats_stall_count());
+    storage_stall_t stall;
+    for (size_t i = 0; storage_stats_get_stall(i, &stall); i++) {
+        printf("  %6llds ago  %-5s %5lu ms  %s\n", (long long)((now_ms - stall.at_ms) / 1000),
+               storage_op_name(stall.op), (unsigned long)(stall.us / 1000), stall.path);
+    }
+
+    storage_stats_sample_space(true);
+    storage_space_sample_t last, first;
+    if (storage_stats_get_space(0, &last)) {
+        size_t n = 1;
+        first = last;
+        while (storage_stats_get_space(n, &first)) n++;     /* leaves the oldest in first */
+        long long delta = (long long)last.used - (long long)first.used;
+        int64_t span_ms = last.at_ms - first.at_ms;
+        printf("Space: %d of %d bytes used (%d%%), %+lld bytes over %d min (%d samples)",
+               (int)last.used, (int)last.total,
+               last.total ? (int)(last.used * 100ULL / last.total) : 0,
+               delta, (int)(span_ms / 60000), (int)n);
+        if (span_ms >= 60000) printf(", %+lld/h", delta * 3600000LL / span_ms);
+        printf("\n");
+    }
+
+    storage_flash_counters_t fc;
+    if (storage_stats_flash_counters(&fc) == ESP_OK) {
+        printf("Flash chip: %lu reads (%llu B, %llu ms), %lu writes (%llu B, %llu ms), "
+               "%lu erases (%llu B, %llu ms)\n",
+               (unsigned long)fc.reads, (unsigned long long)fc.read_bytes,
+               (unsigned long long)(fc.read_us / 1000), (unsigned long)fc.writes,
+               (unsigned long long)fc.write_bytes, (unsigned long long)(fc.write_us / 1000),
+               (unsigned long)fc.erases, (unsigned long long)fc.erase_bytes,
+               (unsigned long long)(fc.erase_us / 1000));
+    } else {
+        printf("Flash chip counters: off (CONFIG_SPI_FLASH_ENABLE_COUNTERS)\n");
+    }
+
+    if (fs_stats_args.reset->count) {
+        storage_stats_reset();
+        printf("Counters reset\n");
+    }
+    return 0;
+}
+
+/* --- bus_stats command --- */
+static struct {
+    struct arg_str *inbound;
+    struct arg_str *outbound;
+    struct arg_end *end;
+} bus_stats_args;
+
+static int set_bus_policy(message_bus_queue_t q, struct arg_str *arg)
+{
+    if (!arg->count) return 0;
+    message_bus_policy_t policy;
+    if (!message_bus_parse_policy(arg->sval[0], &policy)) {
+        printf("Unknown policy '%s' (block, spill, drop-oldest)\n", arg->sval[0]);
+        return 1;
+    }
+    message_bus_set_policy(q, policy);
+    return 0;
+}
+
+static int cmd_bus_stats(int argc, char **argv)
+{
+    int nerrors = arg_parse(argc, argv, (void **)&bus_stats_args);
+    if (nerrors != 0) {
+        arg_print_errors(stderr, bus_stats_args.end, argv[0]);
+        return 1;
+    }
+    if (set_bus_policy(MIMI_BUS_INBOUND, bus_stats_args.inbound) ||
+        set_bus_policy(MIMI_BUS_OUTBOUND, bus_stats_args.outbound)) {
+        return 1;
+    }
+
+    static const char *names[] = { "inbound", "outbound" };
+    printf("  %-8s %-11s %5s %5s %5s %8s %8s %6s %8s %7s %7s %7s\n", "queue", "policy",
+           "cap", "depth", "peak", "pushed", "popped", "waits", "refused", "dropped",
+           "spilled", "on fs");
+    for (int q = 0; q < MIMI_BUS_QUEUES; q++) {
+        message_bus_stats_t st;
+        message_bus_get_stats(q, &st);
+        printf("  %-8s %-11s %5lu %5lu %5lu %8lu %8lu %6lu %8lu %7lu %7lu %7lu\n", names[q],
+               message_bus_policy_name(st.policy), (unsigned long)st.capacity,
+               (unsigned long)st.depth, (unsigned long)st.high_water, (unsigned long)st.pushed,
+               (unsigned long)st.popped, (unsigned long)st.waited, (unsigned long)st.rejected,
+               (unsigned long)st.dropped, (unsigned long)st.spilled,
+               (unsigned long)st.spill_pending);
+    }
+
+    bus_msg_stats_t ms;
+    bus_msg_get_stats(&ms);
+    printf("  payloads: %lu copied (%llu bytes), %lu adopted\n",
+           (unsigned long)ms.payloads, (unsigned long long)ms.bytes_copied,
+           (unsigned long)ms.adopted);
+    printf("  chats:    %lu/%d held, %lu evicted, %lu refused\n",
+           (unsigned long)ms.chats, MIMI_BUS_CHATS - 1, (unsigned long)ms.chat_evictions,
+           (unsigned long)ms.chat_full);
+    return 0;
+}
+
+/* --- outbound_stats command --- */
+static int cmd_outbound_stats(int argc, char **argv)
+{
+    printf("Outbound channels, delivery latency histogram in ms:\n");
+    printf("  %-10s %7s %5s %5s %6s %6s %6s %6s %6s %6s %7s %7s", "channel", "workers", "depth",
+           "peak", "sent", "failed", "merged", "status", "waited", "stalls", "avg ms", "max ms");
+    for (int i = 0; i < OUTBOUND_STATS_BUCKETS; i++) print_bucket_label(outbound_bucket_ms, i);
+    printf("\n");
+
+    outbound_stats_t st;
+    for (int c = 0; outbound_get_stats(c, &st); c++) {
+        uint32_t n = st.sent + st.failed;
+        char workers[12];
+        snprintf(workers, sizeof(workers), "%d/%d/%d", st.busy, st.started, st.workers);
+        printf("  %-10s %7s %5lu %5lu %6lu %6lu %6lu %6lu %6lu %6lu %7lu %7lu", st.name, workers,
+               (unsigned long)st.depth, (unsigned long)st.high_water, (unsigned long)st.sent,
+               (unsigned long)st.failed, (unsigned long)st.merged, (unsigned long)st.superseded,
+               (unsigned long)st.waited, (unsigned long)st.stalls,
+               n ? (unsigned long)(st.total_ms / n) : 0UL, (unsigned long)st.max_ms);
+        for (int b = 0; b < OUTBOUND_STATS_BUCKETS; b++) printf(" %6lu", (unsigned long)st.hist[b]);
+        printf("\n");
+    }
+    printf("  workers: busy/started/limit; merged: joined to an earlier send; status: superseded\n");
+    printf("  waited: held behind a full worker; stalls: outbound queue paused for a channel\n");
+    printf("  %lu message(s) for unknown channels\n",
+           (unsigned long)outbound_unrouted());
+    return 0;
+}
+
 /* --- session_list command --- */
 static int cmd_session_list(int argc, char **argv)
 {
@@ -235,6 +690,164 @@ static int cmd_session_clear(int argc, char **argv)
     return 0;
 }
 
+/* --- session_cache command --- */
+static struct {
+    struct arg_str *action;
+    struct arg_end *end;
+} session_cache_args;
+
+static int cmd_session_cache(int argc, char **argv)
+{
+    int nerrors = arg_parse(argc, argv, (void **)&session_cache_args);
+    if (nerrors != 0) {
+        arg_print_errors(stderr, session_cache_args.end, argv[0]);
+        return 1;
+    }
+    if (session_cache_args.action->count) {
+        if (strcmp(session_cache_args.action->sval[0], "flush") != 0) {
+            printf("Usage: session_cache [flush]\n");
+            return 1;
+        }
+        session_cache_flush();
+        printf("Session cache flushed.\n");
+        return 0;
+    }
+
+    session_cache_stats_t st;
+    session_cache_get_stats(&st);
+    uint32_t total = st.hits + st.misses;
+    printf("Entries:   %d/%d\n", st.entries, MIMI_SESSION_CACHE_ENTRIES);
+    printf("Bytes:     %d/%d\n", (int)st.bytes, MIMI_SESSION_CACHE_BYTES);
+    printf("Hits:      %lu (%lu%%)\n", (unsigned long)st.hits,
+           total ? (unsigned long)(st.hits * 100ULL / total) : 0UL);
+    printf("Misses:    %lu\n", (unsigned long)st.misses);
+    printf("Evictions: %lu\n", (unsigned long)st.evictions);
+    return 0;
+}
+
+/* --- session_gc command --- */
+static int cmd_session_gc(int argc, char **argv)
+{
+    size_t reclaimed = 0;
+    if (session_gc_run(&reclaimed) != ESP_OK) {
+        printf("GC failed (no memory).\n");
+        return 1;
+    }
+    session_gc_stats_t st;
+    session_gc_get_stats(&st);
+    printf("Reclaimed: %d bytes\n", (int)reclaimed);
+    printf("Archives:  %d (%d bytes)\n", st.archives, (int)st.archive_bytes);
+    printf("Rotations: %lu\n", (unsigned long)st.rotations);
+    printf("GC runs:   %lu, %lu files, %llu bytes total\n",
+           (unsigned long)st.gc_runs, (unsigned long)st.files_removed,
+           (unsigned long long)st.bytes_reclaimed);
+    return 0;
+}
+
+/* --- session_format command --- */
+static struct {
+    struct arg_str *format;
+    struct arg_end *end;
+} session_format_args;
+
+static int cmd_session_format(int argc, char **argv)
+{
+    int nerrors = arg_parse(argc, argv, (void **)&session_format_args);
+    if (nerrors != 0) {
+        arg_print_errors(stderr, session_format_args.end, argv[0]);
+        return 1;
+    }
+    if (!session_format_args.format->count) {
+        printf("Session format: %s\n", session_format_name(session_get_format()));
+        return 0;
+    }
+
+    const char *name = session_format_args.format->sval[0];
+    for (int f = SESSION_FORMAT_JSONL; f <= SESSION_FORMAT_BIN_LZ; f++) {
+        if (strcmp(name, session_format_name((session_format_t)f)) == 0) {
+            if (session_set_format((session_format_t)f) != ESP_OK) {
+                printf("Failed to save session format.\n");
+                return 1;
+            }
+            printf("Session format set to %s. Run 'session_migrate' to convert existing chats now.\n",
+                   name);
+            return 0;
+        }
+    }
+    printf("Usage: session_format [jsonl|bin|lz]\n");
+    return 1;
+}
+
+/* --- session_migrate command --- */
+static int cmd_session_migrate(int argc, char **argv)
+{
+    int migrated = 0;
+    if (session_migrate_all(&migrated) != ESP_OK) {
+        printf("Migration failed, see log.\n");
+        return 1;
+    }
+    printf("Migrated %d session(s) to %s.\n", migrated,
+           session_format_name(session_get_format()));
+    return 0;
+}
+
+/* --- session_sync command --- */
+static struct {
+    struct arg_str *mode;
+    struct arg_end *end;
+} session_sync_args;
+
+static int cmd_session_sync(int argc, char **argv)
+{
+    int nerrors = arg_parse(argc, argv, (void **)&session_sync_args);
+    if (nerrors != 0) {
+        arg_print_errors(stderr, session_sync_args.end, argv[0]);
+        return 1;
+    }
+    if (session_sync_args.mode->count) {
+        const char *name = session_sync_args.mode->sval[0];
+        int mode = -1;
+        for (int m = SESSION_SYNC_ALWAYS; m <= SESSION_SYNC_INTERVAL; m++) {
+            if (strcmp(name, session_sync_name((session_sync_t)m)) == 0) mode = m;
+        }
+        if (mode < 0) {
+            printf("Usage: session_sync [always|turn|interval]\n");
+            return 1;
+        }
+        if (session_set_sync((session_sync_t)mode) != ESP_OK) {
+            printf("Failed to set session sync.\n");
+            return 1;
+        }
+    }
+
+    session_sync_stats_t st;
+    session_sync_get_stats(&st);
+    printf("Sync:      %s (flush every %d ms)\n", session_sync_name(session_get_sync()),
+           MIMI_SESSION_FLUSH_MS);
+    printf("Appends:   %lu\n", (unsigned long)st.appends);
+    printf("Writes:    %lu (%lu.%02lu records each)\n", (unsigned long)st.writes,
+           st.writes ? (unsigned long)(st.appends / st.writes) : 0UL,
+           st.writes ? (unsigned long)(st.appends * 100ULL / st.writes % 100) : 0UL);
+    printf("Flushes:   %lu, slowest %lld us\n", (unsigned long)st.flushes,
+           (long long)st.max_flush_us);
+    printf("Pending:   %d bytes in %d chats\n", (int)st.pending_bytes, st.pending_chats);
+    return 0;
+}
+
+/* --- agent_stats command --- */
+static int cmd_agent_stats(int argc, char **argv)
+{
+    agent_stats_t st;
+    agent_get_stats(&st);
+    printf("Turns:      %lu\n", (unsigned long)st.turns);
+    printf("LLM calls:  %lu\n", (unsigned long)st.llm_calls);
+    printf("Tool calls: %lu\n", (unsigned long)st.tool_calls);
+    printf("Digests:    %lu saved, %lu replayed (%s)\n",
+           (unsigned long)st.digests_saved, (unsigned long)st.digests_replayed,
+           MIMI_AGENT_TOOL_DIGEST ? "on" : "off");
+    return 0;
+}
+
 /* --- heap_info command --- */
 static int cmd_heap_info(int argc, char **argv)
 {
@@ -284,6 +897,49 @@ static int cmd_clear_proxy(int argc, char **argv)
     return 0;
 }
 
+/* --- vcr command --- */
+static struct {
+    struct arg_str *mode;
+    struct arg_str *file;
+    struct arg_int *pace;
+    struct arg_end *end;
+} vcr_args;
+
+static int cmd_vcr(int argc, char **argv)
+{
+    int nerrors = arg_parse(argc, argv, (void **)&vcr_args);
+    if (nerrors != 0) {
+        arg_print_errors(stderr, vcr_args.end, argv[0]);
+        return 1;
+    }
+
+    const char *mode_str = vcr_args.mode->sval[0];
+    http_vcr_mode_t mode;
+    if (strcmp(mode_str, "status") == 0) {
+        http_vcr_print_status();
+        return 0;
+    } else if (strcmp(mode_str, "off") == 0) {
+        mode = HTTP_VCR_OFF;
+    } else if (strcmp(mode_str, "record") == 0) {
+        mode = HTTP_VCR_RECORD;
+    } else if (strcmp(mode_str, "replay") == 0) {
+        mode = HTTP_VCR_REPLAY;
+    } else {
+        printf("Invalid mode: %s. Use off, record, replay or status.\n", mode_str);
+        return 1;
+    }
+
+    const char *file = vcr_args.file->count ? vcr_args.file->sval[0] : NULL;
+    int pace = vcr_args.pace->count ? vcr_args.pace->ival[0] : -1;
+    esp_err_t err = http_vcr_set_mode(mode, file, pace);
+    if (err != ESP_OK) {
+        printf("VCR %s failed: %s\n", mode_str, esp_err_to_name(err));
+        return 1;
+    }
+    http_vcr_print_status();
+    return 0;
+}
+
 /* --- set_search_key command --- */
 static struct {
     struct arg_str *key;
@@ -330,10 +986,22 @@ static int cmd_wifi_scan(int argc, char **argv)
 }
 
 /* --- skill_list command --- */
+static struct {
+    struct arg_lit *rescan;
+    struct arg_end *end;
+} skill_list_args;
+
 static int cmd_skill_list(int argc, char **argv)
 {
-    (void)argc;
-    (void)argv;
+    int nerrors = arg_parse(argc, argv, (void **)&skill_list_args);
+    if (nerrors != 0) {
+        arg_print_errors(stderr, skill_list_args.end, argv[0]);
+        return 1;
+    }
+    if (skill_list_args.rescan->count) {
+        esp_err_t err = skill_loader_rescan();
+        printf("Rescan %s\n", err == ESP_OK ? "done" : esp_err_to_name(err));
+    }
 
     char *buf = malloc(4096);
     if (!buf) {
@@ -391,7 +1059,7 @@ static int cmd_skill_show(int argc, char **argv)
         return 1;
     }
 
-    FILE *f = fopen(path, "r");
+    FILE *f = storage_fopen(path);
     if (!f) {
         printf("Skill not found: %s\n", path);
         return 1;
@@ -438,32 +1106,25 @@ static int cmd_skill_search(int argc, char **argv)
     }
 
     const char *keyword = skill_search_args.keyword->sval[0];
-    DIR *dir = opendir(MIMI_SPIFFS_BASE);
-    if (!dir) {
-        printf("Cannot open " MIMI_SPIFFS_BASE ".\n");
-        return 1;
-    }
-
-    const char *prefix = "skills/";
-    const size_t prefix_len = strlen(prefix);
     int matches = 0;
 
-    struct dirent *ent;
-    while ((ent = readdir(dir)) != NULL) {
-        const char *name = ent->d_name;
-        size_t name_len = strlen(name);
+    skill_info_t skill;
+    for (size_t i = 0; skill_loader_get(i, &skill); i++) {
+        char full_path[96];
+        snprintf(full_path, sizeof(full_path), MIMI_SKILLS_PREFIX "%s", skill.name);
 
-        if (strncmp(name, prefix, prefix_len) != 0) continue;
-        if (name_len < prefix_len + 4) continue;
-        if (strcmp(name + name_len - 3, ".md") != 0) continue;
-
-        char full_path[296];
-        snprintf(full_path, sizeof(full_path), MIMI_SPIFFS_BASE "/%s", name);
+        /* Catalog first: name, title, description and trigger keywords */
+        if (contains_nocase(skill.name, keyword) || contains_nocase(skill.title, keyword) ||
+            contains_nocase(skill.desc, keyword) || contains_nocase(skill.keywords, keyword)) {
+            matches++;
+            printf("- %s (matched in catalog)\n", full_path);
+            continue;
+        }
 
-        bool file_matched = contains_nocase(name, keyword);
+        bool file_matched = false;
         int matched_line = 0;
 
-        FILE *f = fopen(full_path, "r");
+        FILE *f = storage_fopen(full_path);
         if (!f) continue;
 
         char line[256];
@@ -479,15 +1140,10 @@ static int cmd_skill_search(int argc, char **argv)
 
         if (file_matched) {
             matches++;
-            if (matched_line > 0) {
-                printf("- %s (matched at line %d)\n", full_path, matched_line);
-            } else {
-                printf("- %s (matched in filename)\n", full_path);
-            }
+            printf("- %s (matched at line %d)\n", full_path, matched_line);
         }
     }
 
-    closedir(dir);
     if (matches == 0) {
         printf("No skills matched keyword: %s\n", keyword);
     } else {
@@ -872,10 +1528,13 @@ esp_err_t serial_cli_init(void)
     esp_console_cmd_register(&provider_cmd);
 
     /* skill_list */
+    skill_list_args.rescan = arg_lit0("r", "rescan", "Re-read every skill file into the catalog");
+    skill_list_args.end = arg_end(1);
     esp_console_cmd_t skill_list_cmd = {
         .command = "skill_list",
-        .help = "List installed skills from " MIMI_SKILLS_PREFIX,
+        .help = "List installed skills from " MIMI_SKILLS_PREFIX " (catalog)",
         .func = &cmd_skill_list,
+        .argtable = &skill_list_args,
     };
     esp_console_cmd_register(&skill_list_cmd);
 
@@ -920,6 +1579,111 @@ esp_err_t serial_cli_init(void)
     };
     esp_console_cmd_register(&mem_write_cmd);
 
+    /* memory_search */
+    memory_search_args.query = arg_str1(NULL, NULL, "<query>", "Words to look up");
+    memory_search_args.top_k = arg_int0("k", "top", "<n>", "Paragraphs to return");
+    memory_search_args.end = arg_end(2);
+    esp_console_cmd_t mem_search_cmd = {
+        .command = "memory_search",
+        .help = "Rank memory, daily-note and skill paragraphs against a query (BM25)",
+        .func = &cmd_memory_search,
+        .argtable = &memory_search_args,
+    };
+    esp_console_cmd_register(&mem_search_cmd);
+
+    /* set_embed */
+    embed_args.backend = arg_str1(NULL, NULL, "<off|local|remote>", "Embedding backend");
+    embed_args.key = arg_str0("k", "key", "<key>", "API key for the remote endpoint");
+    embed_args.url = arg_str0("u", "url", "<url>", "OpenAI-compatible /embeddings URL");
+    embed_args.model = arg_str0("m", "model", "<model>", "Embedding model");
+    embed_args.end = arg_end(4);
+    esp_console_cmd_t embed_cmd = {
+        .command = "set_embed",
+        .help = "Set how memory paragraphs are embedded for vector recall",
+        .func = &cmd_set_embed,
+        .argtable = &embed_args,
+    };
+    esp_console_cmd_register(&embed_cmd);
+
+    /* memory_notes */
+    notes_args.full = arg_int0("f", "full", "<days>", "Days copied verbatim, from today");
+    notes_args.summary = arg_int0("s", "summary", "<days>", "Days (counting today) summarized per day");
+    notes_args.weeks = arg_int0("w", "weeks", "<n>", "Completed weeks from weekly rollups");
+    notes_args.months = arg_int0("m", "months", "<n>", "Completed months from monthly rollups");
+    notes_args.show = arg_lit0("p", "print", "Print the recent notes block");
+    notes_args.end = arg_end(5);
+    esp_console_cmd_t notes_cmd = {
+        .command = "memory_notes",
+        .help = "Show or set the daily-note lookback and its rollups",
+        .func = &cmd_memory_notes,
+        .argtable = &notes_args,
+    };
+    esp_console_cmd_register(&notes_cmd);
+
+    /* storage_log */
+    wal_args.checkpoint = arg_lit0("c", "checkpoint", "Write pending files out now");
+    wal_args.end = arg_end(1);
+    esp_console_cmd_t wal_cmd = {
+        .command = "storage_log",
+        .help = "Show write-ahead log stats, optionally checkpoint",
+        .func = &cmd_storage_log,
+        .argtable = &wal_args,
+    };
+    esp_console_cmd_register(&wal_cmd);
+
+    /* fs_backend */
+    fs_args.backend = arg_str0(NULL, NULL, "<spiffs|littlefs>", "Migrate all files to this backend");
+    fs_args.end = arg_end(1);
+    esp_console_cmd_t fs_cmd = {
+        .command = "fs_backend",
+        .help = "Show filesystem backend and directory cache stats, or migrate and restart",
+        .func = &cmd_fs_backend,
+        .argtable = &fs_args,
+    };
+    esp_console_cmd_register(&fs_cmd);
+
+    /* fs_cache */
+    fs_cache_args.drop = arg_lit0("d", "drop", "Drop every cached file");
+    fs_cache_args.end = arg_end(1);
+    esp_console_cmd_t fs_cache_cmd = {
+        .command = "fs_cache",
+        .help = "Show read cache stats per file, most recently read first",
+        .func = &cmd_fs_cache,
+        .argtable = &fs_cache_args,
+    };
+    esp_console_cmd_register(&fs_cache_cmd);
+
+    /* fs_stats */
+    fs_stats_args.reset = arg_lit0("r", "reset", "Reset the counters after showing them");
+    fs_stats_args.end = arg_end(1);
+    esp_console_cmd_t fs_stats_cmd = {
+        .command = "fs_stats",
+        .help = "Show flash I/O counts, latency and stalls per path class, and free space",
+        .func = &cmd_fs_stats,
+        .argtable = &fs_stats_args,
+    };
+    esp_console_cmd_register(&fs_stats_cmd);
+
+    /* bus_stats */
+    bus_stats_args.inbound = arg_str0("i", "inbound", "<policy>", "Inbound full-queue policy: block, spill, drop-oldest");
+    bus_stats_args.outbound = arg_str0("o", "outbound", "<policy>", "Outbound full-queue policy");
+    bus_stats_args.end = arg_end(2);
+    esp_console_cmd_t bus_stats_cmd = {
+        .command = "bus_stats",
+        .help = "Show message bus depth, backpressure and spill counts; set full-queue policies",
+        .func = &cmd_bus_stats,
+        .argtable = &bus_stats_args,
+    };
+    esp_console_cmd_register(&bus_stats_cmd);
+
+    /* outbound_stats */
+    esp_console_cmd_t outbound_stats_cmd = {
+        .command = "outbound_stats",
+        .help = "Show per-channel outbound workers, queue depth and delivery latency",
+        .func = &cmd_outbound_stats,
+    };
+    esp_console_cmd_register(&outbound_stats_cmd);
+
     /* session_list */
     esp_console_cmd_t sess_list_cmd = {
         .command = "session_list",
@@ -939,6 +1703,63 @@ esp_err_t serial_cli_init(void)
     };
     esp_console_cmd_register(&sess_clear_cmd);
 
+    /* session_cache */
+    session_cache_args.action = arg_str0(NULL, NULL, "[flush]", "Drop all cached histories");
+    session_cache_args.end = arg_end(1);
+    esp_console_cmd_t sess_cache_cmd = {
+        .command = "session_cache",
+        .help = "Show session history cache stats",
+        .func = &cmd_session_cache,
+        .argtable = &session_cache_args,
+    };
+    esp_console_cmd_register(&sess_cache_cmd);
+
+    /* session_gc */
+    esp_console_cmd_t sess_gc_cmd = {
+        .command = "session_gc",
+        .help = "Remove expired session archives now and show rotation stats",
+        .func = &cmd_session_gc,
+    };
+    esp_console_cmd_register(&sess_gc_cmd);
+
+    /* session_format */
+    session_format_args.format = arg_str0(NULL, NULL, "<jsonl|bin|lz>", "Storage format for new records");
+    session_format_args.end = arg_end(1);
+    esp_console_cmd_t sess_fmt_cmd = {
+        .command = "session_format",
+        .help = "Show or set the session file format",
+        .func = &cmd_session_format,
+        .argtable = &session_format_args,
+    };
+    esp_console_cmd_register(&sess_fmt_cmd);
+
+    /* session_migrate */
+    esp_console_cmd_t sess_migrate_cmd = {
+        .command = "session_migrate",
+        .help = "Convert all active sessions to the current format",
+        .func = &cmd_session_migrate,
+    };
+    esp_console_cmd_register(&sess_migrate_cmd);
+
+    /* session_sync */
+    session_sync_args.mode = arg_str0(NULL, NULL, "<always|turn|interval>", "When appended records reach flash");
+    session_sync_args.end = arg_end(1);
+    esp_console_cmd_t sess_sync_cmd = {
+        .command = "session_sync",
+        .help = "Show or set session write batching and its stats",
+        .func = &cmd_session_sync,
+        .argtable = &session_sync_args,
+    };
+    esp_console_cmd_register(&sess_sync_cmd);
+
+    /* agent_stats */
+    esp_console_cmd_t agent_stats_cmd = {
+        .command = "agent_stats",
+        .help = "Show agent turn, LLM call and tool digest counters",
+        .func = &cmd_agent_stats,
+    };
+    esp_console_cmd_register(&agent_stats_cmd);
+
     /* heap_info */
     esp_console_cmd_t heap_cmd = {
         .command = "heap_info",
@@ -990,6 +1811,19 @@ esp_err_t serial_cli_init(void)
     };
     esp_console_cmd_register(&clear_proxy_cmd);
 
+    /* vcr */
+    vcr_args.mode = arg_str1(NULL, NULL, "<mode>", "off|record|replay|status");
+    vcr_args.file = arg_str0(NULL, NULL, "<file>", "Cassette path (default: " MIMI_VCR_DEFAULT_FILE ")");
+    vcr_args.pace = arg_int0("p", "pace", "<pct>", "Replay latency in % of recorded (default: 100, 0 = none)");
+    vcr_args.end = arg_end(3);
+    esp_console_cmd_t vcr_cmd = {
+        .command = "vcr",
+        .help = "Record/replay upstream HTTP traffic (e.g. vcr replay /spiffs/vcr/slow.jsonl -p 10)",
+        .func = &cmd_vcr,
+        .argtable = &vcr_args,
+    };
+    esp_console_cmd_register(&vcr_cmd);
+
     /* config_show */
     esp_console_cmd_t config_show_cmd = {
         .command = "config_show",
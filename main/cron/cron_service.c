@@ -1,6 +1,7 @@
 #include "cron/cron_service.h"
 #include "mimi_config.h"
 #include "bus/message_bus.h"
+#include "storage/storage_log.h"
 
 #include <stdio.h>
 #include <stdlib.h>
@@ -60,7 +61,7 @@ static void cron_generate_id(char *id_buf)
 
 static esp_err_t cron_load_jobs(void)
 {
-    FILE *f = fopen(MIMI_CRON_FILE, "r");
+    FILE *f = storage_fopen(MIMI_CRON_FILE);
     if (!f) {
         ESP_LOGI(TAG, "No cron file found, starting fresh");
         s_job_count = 0;
@@ -215,21 +216,11 @@ static esp_err_t cron_save_jobs(void)
         return ESP_ERR_NO_MEM;
     }
 
-    FILE *f = fopen(MIMI_CRON_FILE, "w");
-    if (!f) {
-        ESP_LOGE(TAG, "Failed to open %s for writing", MIMI_CRON_FILE);
-        free(json_str);
-        return ESP_FAIL;
-    }
-
-    size_t len = strlen(json_str);
-    size_t written = fwrite(json_str, 1, len, f);
-    fclose(f);
+    esp_err_t err = storage_write_file(MIMI_CRON_FILE, json_str, strlen(json_str));
     free(json_str);
-
-    if (written != len) {
-        ESP_LOGE(TAG, "Cron save incomplete: %d/%d bytes", (int)written, (int)len);
-        return ESP_FAIL;
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to save %s", MIMI_CRON_FILE);
+        return err;
     }
 
     ESP_LOGI(TAG, "Saved %d cron jobs to %s", s_job_count, MIMI_CRON_FILE);
@@ -253,18 +244,20 @@ static void cron_process_due_jobs(void)
         /* Job is due — fire it */
         ESP_LOGI(TAG, "Cron job firing: %s (%s)", job->name, job->id);
 
-        /* Push message to inbound queue */
+        /* Push message to inbound queue; the job keeps its own text, so copy it */
+        mimi_payload_t *payload = mimi_payload_from_str(job->message);
         mimi_msg_t msg;
-        memset(&msg, 0, sizeof(msg));
-        strncpy(msg.channel, job->channel, sizeof(msg.channel) - 1);
-        strncpy(msg.chat_id, job->chat_id, sizeof(msg.chat_id) - 1);
-        msg.content = strdup(job->message);
-
-        if (msg.content) {
-            esp_err_t err = message_bus_push_inbound(&msg);
+        if (payload) {
+            esp_err_t err = mimi_msg_init(&msg, job->channel, job->chat_id, payload);
+            if (err != ESP_OK) {
+                mimi_payload_unref(payload);
+            } else if ((err = message_bus_push_inbound(&msg)) != ESP_OK) {
+                mimi_msg_release(&msg);
+            }
             if (err != ESP_OK) {
-                ESP_LOGW(TAG, "Failed to push cron message: %s", esp_err_to_name(err));
-                free(msg.content);
+                /* Bus full: leave the job due so the next check fires it again */
+                ESP_LOGW(TAG, "Failed to push cron message, retrying: %s", esp_err_to_name(err));
+                continue;
             }
         }
 
@@ -1,11 +1,14 @@
 #include "ws_server.h"
 #include "mimi_config.h"
 #include "bus/message_bus.h"
+#include "storage/storage_stats.h"
 
 #include <string.h>
 #include <stdlib.h>
 #include "esp_log.h"
 #include "esp_http_server.h"
+#include "esp_heap_caps.h"
+#include "esp_timer.h"
 #include "cJSON.h"
 
 static const char *TAG = "ws";
@@ -20,6 +23,8 @@ typedef struct {
 } ws_client_t;
 
 static ws_client_t s_clients[MIMI_WS_MAX_CLIENTS];
+static uint32_t s_rx_msgs = 0;
+static uint32_t s_dropped = 0;     /* inbound bus full */
 
 static ws_client_t *find_client_by_fd(int fd)
 {
@@ -67,6 +72,83 @@ static void remove_client(int fd)
     }
 }
 
+/* Flash I/O per path class, as fs_stats shows it */
+static void add_fs_stats(cJSON *stats)
+{
+    cJSON *fs = cJSON_CreateObject();
+    for (int c = 0; c < STORAGE_CLASS_COUNT; c++) {
+        storage_op_stats_t op[STORAGE_OP_COUNT];
+        uint64_t us = 0;
+        uint32_t max_us = 0, count = 0;
+        for (int i = 0; i < STORAGE_OP_COUNT; i++) {
+            storage_stats_get(c, i, &op[i]);
+            count += op[i].count;
+            us += op[i].total_us;
+            if (op[i].max_us > max_us) max_us = op[i].max_us;
+        }
+        if (!count) continue;
+        cJSON *cls = cJSON_CreateObject();
+        cJSON_AddNumberToObject(cls, "opens", op[STORAGE_OP_OPEN].count);
+        cJSON_AddNumberToObject(cls, "reads", op[STORAGE_OP_READ].count);
+        cJSON_AddNumberToObject(cls, "read_bytes", (double)op[STORAGE_OP_READ].bytes);
+        cJSON_AddNumberToObject(cls, "writes", op[STORAGE_OP_WRITE].count);
+        cJSON_AddNumberToObject(cls, "write_bytes", (double)op[STORAGE_OP_WRITE].bytes);
+        cJSON_AddNumberToObject(cls, "meta", op[STORAGE_OP_META].count);
+        cJSON_AddNumberToObject(cls, "io_us", (double)us);
+        cJSON_AddNumberToObject(cls, "max_us", max_us);
+        cJSON_AddItemToObject(fs, storage_class_name(c), cls);
+    }
+    cJSON_AddNumberToObject(fs, "stalls", storage_stats_stall_count());
+
+    storage_space_sample_t space;
+    if (storage_stats_get_space(0, &space)) {
+        cJSON_AddNumberToObject(fs, "used", (double)space.used);
+        cJSON_AddNumberToObject(fs, "total", (double)space.total);
+    }
+    storage_flash_counters_t fc;
+    if (storage_stats_flash_counters(&fc) == ESP_OK) {
+        cJSON_AddNumberToObject(fs, "erases", fc.erases);
+        cJSON_AddNumberToObject(fs, "flash_write_bytes", (double)fc.write_bytes);
+    }
+    cJSON_AddItemToObject(stats, "fs", fs);
+}
+
+/* Answer {"type":"stats"} so load generators can sample server health */
+static void send_stats(httpd_req_t *req)
+{
+    int active = 0;
+    for (int i = 0; i < MIMI_WS_MAX_CLIENTS; i++) {
+        if (s_clients[i].active) active++;
+    }
+
+    cJSON *stats = cJSON_CreateObject();
+    cJSON_AddStringToObject(stats, "type", "stats");
+    cJSON_AddNumberToObject(stats, "uptime_ms", (double)(esp_timer_get_time() / 1000));
+    cJSON_AddNumberToObject(stats, "internal_free",
+                            (double)heap_caps_get_free_size(MALLOC_CAP_INTERNAL));
+    cJSON_AddNumberToObject(stats, "internal_largest",
+                            (double)heap_caps_get_largest_free_block(MALLOC_CAP_INTERNAL));
+    cJSON_AddNumberToObject(stats, "psram_free",
+                            (double)heap_caps_get_free_size(MALLOC_CAP_SPIRAM));
+    cJSON_AddNumberToObject(stats, "clients", active);
+    cJSON_AddNumberToObject(stats, "max_clients", MIMI_WS_MAX_CLIENTS);
+    cJSON_AddNumberToObject(stats, "rx_msgs", s_rx_msgs);
+    cJSON_AddNumberToObject(stats, "dropped", s_dropped);
+    add_fs_stats(stats);
+
+    char *json_str = cJSON_PrintUnformatted(stats);
+    cJSON_Delete(stats);
+    if (!json_str) return;
+
+    httpd_ws_frame_t ws_pkt = {
+        .type = HTTPD_WS_TYPE_TEXT,
+        .payload = (uint8_t *)json_str,
+        .len = strlen(json_str),
+    };
+    httpd_ws_send_frame(req, &ws_pkt);
+    free(json_str);
+}
+
 static esp_err_t ws_handler(httpd_req_t *req)
 {
     if (req->method == HTTP_GET) {
@@ -126,14 +208,22 @@ static esp_err_t ws_handler(httpd_req_t *req)
 
         ESP_LOGI(TAG, "WS message from %s: %.40s...", chat_id, content->valuestring);
 
-        /* Push to inbound bus */
-        mimi_msg_t msg = {0};
-        strncpy(msg.channel, MIMI_CHAN_WEBSOCKET, sizeof(msg.channel) - 1);
-        strncpy(msg.chat_id, chat_id, sizeof(msg.chat_id) - 1);
-        msg.content = strdup(content->valuestring);
-        if (msg.content) {
-            message_bus_push_inbound(&msg);
+        /* Push to inbound bus: the payload takes over the parsed string */
+        mimi_payload_t *payload = mimi_payload_adopt(content->valuestring);
+        if (payload) {
+            content->valuestring = NULL;
+            s_rx_msgs++;
+            mimi_msg_t msg;
+            if (mimi_msg_init(&msg, MIMI_CHAN_WEBSOCKET, chat_id, payload) != ESP_OK) {
+                s_dropped++;
+                mimi_payload_unref(payload);
+            } else if (message_bus_push_inbound(&msg) != ESP_OK) {
+                s_dropped++;
+                mimi_msg_release(&msg);
+            }
         }
+    } else if (type && cJSON_IsString(type) && strcmp(type->valuestring, "stats") == 0) {
+        send_stats(req);
     }
 
     cJSON_Delete(root);
@@ -181,7 +271,7 @@ esp_err_t ws_server_send(const char *chat_id, const char *text)
     /* Build response JSON */
     cJSON *resp = cJSON_CreateObject();
     cJSON_AddStringToObject(resp, "type", "response");
-    cJSON_AddStringToObject(resp, "content", text);
+    cJSON_AddItemToObject(resp, "content", cJSON_CreateStringReference(text));
     cJSON_AddStringToObject(resp, "chat_id", chat_id);
 
     char *json_str = cJSON_PrintUnformatted(resp);
@@ -9,6 +9,9 @@
  * Protocol:
  *   Inbound:  {"type":"message","content":"hello","chat_id":"ws_client1"}
  *   Outbound: {"type":"response","content":"Hi!","chat_id":"ws_client1"}
+ *
+ * A {"type":"stats"} request is answered with heap, client and drop
+ * counters ({"type":"stats",...}) for load testing.
  */
 esp_err_t ws_server_start(void);
 
@@ -1,6 +1,7 @@
 #include "heartbeat/heartbeat.h"
 #include "mimi_config.h"
 #include "bus/message_bus.h"
+#include "storage/storage_log.h"
 
 #include <stdio.h>
 #include <stdlib.h>
@@ -30,7 +31,7 @@ static TimerHandle_t s_heartbeat_timer = NULL;
  */
 static bool heartbeat_has_tasks(void)
 {
-    FILE *f = fopen(MIMI_HEARTBEAT_FILE, "r");
+    FILE *f = storage_fopen(MIMI_HEARTBEAT_FILE);
     if (!f) {
         return false;
     }
@@ -81,21 +82,15 @@ static bool heartbeat_send(void)
         return false;
     }
 
+    static mimi_payload_t prompt = MIMI_PAYLOAD_STATIC(HEARTBEAT_PROMPT);
     mimi_msg_t msg;
-    memset(&msg, 0, sizeof(msg));
-    strncpy(msg.channel, MIMI_CHAN_SYSTEM, sizeof(msg.channel) - 1);
-    strncpy(msg.chat_id, "heartbeat", sizeof(msg.chat_id) - 1);
-    msg.content = strdup(HEARTBEAT_PROMPT);
-
-    if (!msg.content) {
-        ESP_LOGE(TAG, "Failed to allocate heartbeat prompt");
-        return false;
+    esp_err_t err = mimi_msg_init(&msg, MIMI_CHAN_SYSTEM, "heartbeat", &prompt);
+    if (err == ESP_OK) {
+        err = message_bus_push_inbound(&msg);
+        if (err != ESP_OK) mimi_msg_release(&msg);
     }
-
-    esp_err_t err = message_bus_push_inbound(&msg);
     if (err != ESP_OK) {
         ESP_LOGW(TAG, "Failed to push heartbeat message: %s", esp_err_to_name(err));
-        free(msg.content);
         return false;
     }
 
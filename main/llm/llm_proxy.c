@@ -1,6 +1,7 @@
 #include "llm_proxy.h"
 #include "mimi_config.h"
 #include "proxy/http_proxy.h"
+#include "proxy/http_vcr.h"
 
 #include <string.h>
 #include <stdlib.h>
@@ -8,6 +9,7 @@
 #include "esp_http_client.h"
 #include "esp_crt_bundle.h"
 #include "esp_heap_caps.h"
+#include "esp_timer.h"
 #include "nvs.h"
 #include "cJSON.h"
 
@@ -76,7 +78,8 @@ static void safe_copy(char *dst, size_t dst_size, const char *src)
         dst[0] = '\0';
         return;
     }
-    size_t n = strnlen(src, dst_size - 1);
+    size_t n = strlen(src);
+    if (n >= dst_size) n = dst_size - 1;
     memcpy(dst, src, n);
     dst[n] = '\0';
 }
@@ -354,13 +357,35 @@ static esp_err_t llm_http_via_proxy(const char *post_data, resp_buf_t *rb, int *
 
 /* ── Shared HTTP dispatch ─────────────────────────────────────── */
 
+static esp_err_t llm_http_replay(const char *post_data, resp_buf_t *rb, int *out_status)
+{
+    http_vcr_resp_t vr;
+    esp_err_t err = http_vcr_replay("llm", llm_api_path(), post_data, strlen(post_data), &vr);
+    if (err != ESP_OK) return err;
+    err = resp_buf_append(rb, vr.body, vr.len);
+    *out_status = vr.status;
+    free(vr.body);
+    return err;
+}
+
 static esp_err_t llm_http_call(const char *post_data, resp_buf_t *rb, int *out_status)
 {
+    if (http_vcr_replaying()) {
+        return llm_http_replay(post_data, rb, out_status);
+    }
+
+    int64_t start_us = esp_timer_get_time();
+    esp_err_t err;
     if (http_proxy_is_enabled()) {
-        return llm_http_via_proxy(post_data, rb, out_status);
+        err = llm_http_via_proxy(post_data, rb, out_status);
     } else {
-        return llm_http_direct(post_data, rb, out_status);
+        err = llm_http_direct(post_data, rb, out_status);
     }
+    if (err == ESP_OK) {
+        http_vcr_record("llm", llm_api_path(), post_data, strlen(post_data),
+                        *out_status, rb->data, start_us);
+    }
+    return err;
 }
 
 static cJSON *convert_tools_openai(const char *tools_json)
@@ -0,0 +1,891 @@
+#include "memory_index.h"
+#include "memory_vec.h"
+#include "mimi_config.h"
+#include "storage/storage_fs.h"
+#include "storage/storage_log.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_heap_caps.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+
+static const char *TAG = "mem_index";
+
+/*
+ * Inverted index over the markdown files the agent keeps as memory. A
+ * document is one paragraph (blank-line separated, headings glued to the
+ * paragraph below, long ones split at line ends). Terms are stored only as
+ * 32-bit FNV-1a hashes: a collision merges two terms' postings, which costs
+ * a little ranking precision and saves keeping the vocabulary. A posting
+ * packs (chunk id << 8 | term frequency). Rewriting a file marks its old
+ * chunks dead; their postings are skipped until dead chunks outnumber live
+ * ones and the whole index is rebuilt from flash.
+ *
+ * With an embedding backend configured, each paragraph also gets a vector
+ * in memory_vec, keyed by a hash of its text. A search then fuses the BM25
+ * ranking with the vector ranking by reciprocal rank, so paraphrases that
+ * share no keyword can still surface.
+ */
+
+#define MI_DEAD          0xFFFF
+#define MI_TOKEN_MAX     32
+#define MI_CHUNK_TERMS   256
+#define MI_COMPACT_MIN   64
+#define MI_PATH_LEN      64
+
+typedef struct {
+    char     rel[MI_PATH_LEN];   /* path below MIMI_SPIFFS_BASE, "" = free slot */
+    uint32_t size;               /* file size when indexed */
+    uint32_t tail_off;           /* start of the last paragraph */
+} mi_file_t;
+
+typedef struct {
+    uint32_t off;
+    uint32_t key;                /* text hash, the memory_vec row key */
+    uint16_t len;
+    uint16_t terms;              /* document length in tokens */
+    uint16_t file;               /* MI_DEAD once replaced */
+} mi_chunk_t;
+
+typedef struct {
+    uint32_t  hash;              /* 0 = empty slot */
+    uint32_t  n;
+    uint32_t  cap;
+    uint32_t *post;
+} mi_term_t;
+
+static SemaphoreHandle_t s_lock = NULL;
+static bool s_ready = false;
+
+static mi_file_t  *s_files = NULL;
+static uint32_t    s_nfiles = 0, s_files_cap = 0;
+static mi_chunk_t *s_chunks = NULL;
+static uint32_t    s_nchunks = 0, s_chunks_cap = 0;
+static mi_term_t  *s_terms = NULL;
+static uint32_t    s_nterms = 0, s_terms_cap = 0;
+
+static uint32_t s_live = 0, s_dead = 0;
+static uint64_t s_total_terms = 0;
+static size_t   s_post_bytes = 0;
+static uint32_t s_npostings = 0;
+static uint32_t s_searches = 0, s_rebuilds = 0, s_last_search_us = 0;
+static uint32_t s_vec_hits = 0;
+static TaskHandle_t s_embed_task = NULL;
+
+static void start_embed_task(void);
+
+static void *grow(void *ptr, uint32_t *cap, size_t elem, uint32_t need)
+{
+    if (need <= *cap) return ptr;
+    uint32_t n = *cap ? *cap : 16;
+    while (n < need) n *= 2;
+    void *p = heap_caps_realloc(ptr, (size_t)n * elem, MALLOC_CAP_SPIRAM);
+    if (!p) return NULL;
+    *cap = n;
+    return p;
+}
+
+/* ── Tokenizer ───────────────────────────────────────────────── */
+
+static const char *s_stopwords[] = {
+    "a", "an", "and", "are", "as", "at", "be", "but", "by", "do", "for",
+    "from", "has", "have", "he", "her", "his", "how", "i", "if", "in", "is",
+    "it", "its", "me", "my", "of", "on", "or", "our", "she", "so", "that",
+    "the", "their", "them", "then", "there", "they", "this", "to", "was",
+    "we", "what", "when", "which", "who", "will", "with", "you", "your",
+};
+
+static bool is_stopword(const char *tok, size_t n)
+{
+    if (n > 5) return false;
+    for (size_t i = 0; i < sizeof(s_stopwords) / sizeof(s_stopwords[0]); i++) {
+        if (strlen(s_stopwords[i]) == n && memcmp(s_stopwords[i], tok, n) == 0) return true;
+    }
+    return false;
+}
+
+static uint32_t term_hash(const char *s, size_t n)
+{
+    uint32_t h = 2166136261u;
+    for (size_t i = 0; i < n; i++) {
+        h ^= (uint8_t)s[i];
+        h *= 16777619u;
+    }
+    return h ? h : 1;
+}
+
+/* Han, kana and hangul carry meaning per character and have no spaces */
+static bool is_cjk(uint32_t cp)
+{
+    return (cp >= 0x3040 && cp <= 0x30FF) || (cp >= 0x3400 && cp <= 0x4DBF) ||
+           (cp >= 0x4E00 && cp <= 0x9FFF) || (cp >= 0xAC00 && cp <= 0xD7AF) ||
+           (cp >= 0xF900 && cp <= 0xFAFF);
+}
+
+/* Punctuation, symbols and emoji outside ASCII */
+static bool is_separator(uint32_t cp)
+{
+    return cp < 0xC0 || (cp >= 0x2000 && cp <= 0x2BFF) ||
+           (cp >= 0x3000 && cp <= 0x303F) || (cp >= 0xFF00 && cp <= 0xFF20) ||
+           cp >= 0x1F000;
+}
+
+static void emit_word(const char *tok, size_t n, memory_token_fn fn, void *ctx)
+{
+    if (n < 2 || is_stopword(tok, n)) return;
+    fn(tok, n, ctx);
+}
+
+/*
+ * Lower-cased ASCII alphanumeric runs, with accented letters kept inside
+ * the word; each CJK character is a token of its own.
+ */
+void memory_index_tokenize(const char *text, size_t len, memory_token_fn fn, void *ctx)
+{
+    char tok[MI_TOKEN_MAX];
+    size_t n = 0;
+
+    for (size_t i = 0; i < len; i++) {
+        unsigned char c = (unsigned char)text[i];
+        if (c < 0x80) {
+            if ((c >= 'a' && c <= 'z') || (c >= '0' && c <= '9')) {
+                if (n < MI_TOKEN_MAX) tok[n++] = (char)c;
+            } else if (c >= 'A' && c <= 'Z') {
+                if (n < MI_TOKEN_MAX) tok[n++] = (char)(c + 32);
+            } else {
+                emit_word(tok, n, fn, ctx);
+                n = 0;
+            }
+            continue;
+        }
+
+        size_t clen = c >= 0xF0 ? 4 : c >= 0xE0 ? 3 : c >= 0xC0 ? 2 : 1;
+        if (i + clen > len) clen = len - i;
+        uint32_t cp = clen == 1 ? 0 : c & (0x3F >> (clen - 1));
+        for (size_t k = 1; k < clen; k++) cp = (cp << 6) | ((unsigned char)text[i + k] & 0x3F);
+
+        if (is_cjk(cp)) {
+            emit_word(tok, n, fn, ctx);
+            n = 0;
+            fn(text + i, clen, ctx);
+        } else if (clen == 1 || is_separator(cp)) {
+            emit_word(tok, n, fn, ctx);
+            n = 0;
+        } else if (n + clen <= MI_TOKEN_MAX) {
+            memcpy(tok + n, text + i, clen);
+            n += clen;
+        }
+        i += clen - 1;
+    }
+    emit_word(tok, n, fn, ctx);
+}
+
+/* ── Term table ──────────────────────────────────────────────── */
+
+static mi_term_t *term_find(uint32_t hash)
+{
+    if (!s_terms_cap) return NULL;
+    uint32_t mask = s_terms_cap - 1;
+    for (uint32_t i = hash & mask;; i = (i + 1) & mask) {
+        if (s_terms[i].hash == hash) return &s_terms[i];
+        if (s_terms[i].hash == 0) return NULL;
+    }
+}
+
+static bool term_table_grow(void)
+{
+    uint32_t cap = s_terms_cap ? s_terms_cap * 2 : 1024;
+    mi_term_t *t = heap_caps_calloc(cap, sizeof(mi_term_t), MALLOC_CAP_SPIRAM);
+    if (!t) return false;
+    for (uint32_t i = 0; i < s_terms_cap; i++) {
+        if (!s_terms[i].hash) continue;
+        uint32_t j = s_terms[i].hash & (cap - 1);
+        while (t[j].hash) j = (j + 1) & (cap - 1);
+        t[j] = s_terms[i];
+    }
+    free(s_terms);
+    s_terms = t;
+    s_terms_cap = cap;
+    return true;
+}
+
+static bool term_add_posting(uint32_t hash, uint32_t posting)
+{
+    mi_term_t *t = term_find(hash);
+    if (!t) {
+        if ((s_nterms + 1) * 10 > s_terms_cap * 7 && !term_table_grow()) return false;
+        uint32_t mask = s_terms_cap - 1;
+        uint32_t i = hash & mask;
+        while (s_terms[i].hash) i = (i + 1) & mask;
+        t = &s_terms[i];
+        t->hash = hash;
+        s_nterms++;
+    }
+    uint32_t old_cap = t->cap;
+    uint32_t *p = grow(t->post, &t->cap, sizeof(uint32_t), t->n + 1);
+    if (!p) return false;
+    s_post_bytes += (size_t)(t->cap - old_cap) * sizeof(uint32_t);
+    t->post = p;
+    t->post[t->n++] = posting;
+    s_npostings++;
+    return true;
+}
+
+/* ── Indexing ────────────────────────────────────────────────── */
+
+typedef struct {
+    uint32_t hash[MI_CHUNK_TERMS];
+    uint8_t  tf[MI_CHUNK_TERMS];
+    int      n;
+    int      tokens;
+} chunk_terms_t;
+
+static void collect_term(const char *tok, size_t n, void *ctx)
+{
+    chunk_terms_t *ct = ctx;
+    uint32_t hash = term_hash(tok, n);
+    ct->tokens++;
+    for (int i = 0; i < ct->n; i++) {
+        if (ct->hash[i] == hash) {
+            if (ct->tf[i] < 255) ct->tf[i]++;
+            return;
+        }
+    }
+    if (ct->n < MI_CHUNK_TERMS) {
+        ct->hash[ct->n] = hash;
+        ct->tf[ct->n++] = 1;
+    }
+}
+
+static void add_chunk(uint16_t file, uint32_t off, const char *text, size_t len,
+                      chunk_terms_t *ct)
+{
+    while (len > 0 && (text[len - 1] == '\n' || text[len - 1] == '\r' ||
+                       text[len - 1] == ' ' || text[len - 1] == '\t')) {
+        len--;
+    }
+    s_files[file].tail_off = off;
+
+    ct->n = 0;
+    ct->tokens = 0;
+    memory_index_tokenize(text, len, collect_term, ct);
+    if (ct->n == 0) return;
+
+    /* The local embedder is cheap enough to run inline; remote ones go to embed_task */
+    uint32_t key = term_hash(text, len);
+    if (memory_vec_backend() == MEMORY_VEC_LOCAL && !memory_vec_has(key)) {
+        int8_t vec[MIMI_VEC_DIM];
+        float scale;
+        if (memory_vec_embed(text, len, vec, &scale) == ESP_OK) memory_vec_put(key, vec, scale);
+    }
+
+    mi_chunk_t *c = grow(s_chunks, &s_chunks_cap, sizeof(mi_chunk_t), s_nchunks + 1);
+    if (!c) return;
+    s_chunks = c;
+    uint32_t id = s_nchunks;
+    if (id >= (1u << 24)) return;
+
+    for (int i = 0; i < ct->n; i++) {
+        if (!term_add_posting(ct->hash[i], id << 8 | ct->tf[i])) {
+            ESP_LOGW(TAG, "Out of PSRAM, paragraph partially indexed");
+            break;
+        }
+    }
+    s_chunks[id] = (mi_chunk_t) {
+        .off = off, .key = key, .len = (uint16_t)len,
+        .terms = (uint16_t)(ct->tokens < 0xFFFF ? ct->tokens : 0xFFFF), .file = file,
+    };
+    s_nchunks++;
+    s_live++;
+    s_total_terms += s_chunks[id].terms;
+}
+
+static bool is_blank(const char *s, size_t n)
+{
+    for (size_t i = 0; i < n; i++) {
+        if (s[i] != ' ' && s[i] != '\t' && s[i] != '\r') return false;
+    }
+    return true;
+}
+
+static void index_text(uint16_t file, uint32_t base, const char *text, size_t len)
+{
+    chunk_terms_t *ct = heap_caps_malloc(sizeof(chunk_terms_t), MALLOC_CAP_SPIRAM);
+    if (!ct) return;
+
+    size_t p = 0;
+    while (p < len) {
+        size_t start = p, end = p;
+        bool body = false;
+        while (p < len) {
+            size_t eol = p;
+            while (eol < len && text[eol] != '\n') eol++;
+            size_t next = eol < len ? eol + 1 : eol;
+
+            if (is_blank(text + p, eol - p)) {
+                p = next;
+                if (body) break;
+                if (end == start) start = end = p;
+                continue;
+            }
+            if (end > start && next - start > MIMI_INDEX_CHUNK_BYTES) break;
+            if (next - start > MIMI_INDEX_CHUNK_BYTES) {
+                /* One line longer than a paragraph: cut on a character boundary */
+                size_t cut = start + MIMI_INDEX_CHUNK_BYTES;
+                while (cut > start + 1 && ((unsigned char)text[cut] & 0xC0) == 0x80) cut--;
+                end = p = cut;
+                break;
+            }
+            if (text[p] != '#') body = true;
+            end = p = next;
+        }
+        if (end > start) add_chunk(file, base + (uint32_t)start, text + start, end - start, ct);
+    }
+    free(ct);
+}
+
+static void kill_chunks(uint16_t file, uint32_t from_off)
+{
+    for (uint32_t i = 0; i < s_nchunks; i++) {
+        mi_chunk_t *c = &s_chunks[i];
+        if (c->file != file || c->off < from_off) continue;
+        c->file = MI_DEAD;
+        s_live--;
+        s_dead++;
+        s_total_terms -= c->terms;
+    }
+}
+
+static bool indexable(const char *rel)
+{
+    size_t n = strlen(rel);
+    if (n >= MI_PATH_LEN || n < 4 || strcmp(rel + n - 3, ".md") != 0) return false;
+    return strncmp(rel, "memory/", 7) == 0 || strncmp(rel, "skills/", 7) == 0;
+}
+
+static const char *rel_path(const char *path)
+{
+    size_t base_len = strlen(MIMI_SPIFFS_BASE);
+    if (!path || strncmp(path, MIMI_SPIFFS_BASE, base_len) != 0 || path[base_len] != '/') {
+        return NULL;
+    }
+    return path + base_len + 1;
+}
+
+static int file_find(const char *rel)
+{
+    for (uint32_t i = 0; i < s_nfiles; i++) {
+        if (strcmp(s_files[i].rel, rel) == 0) return (int)i;
+    }
+    return -1;
+}
+
+static int file_slot(const char *rel)
+{
+    int id = file_find(rel);
+    if (id >= 0) return id;
+    for (uint32_t i = 0; i < s_nfiles; i++) {
+        if (!s_files[i].rel[0]) {
+            id = (int)i;
+            break;
+        }
+    }
+    if (id < 0) {
+        if (s_nfiles >= MI_DEAD) return -1;
+        mi_file_t *f = grow(s_files, &s_files_cap, sizeof(mi_file_t), s_nfiles + 1);
+        if (!f) return -1;
+        s_files = f;
+        id = (int)s_nfiles++;
+    }
+    memset(&s_files[id], 0, sizeof(mi_file_t));
+    snprintf(s_files[id].rel, MI_PATH_LEN, "%s", rel);
+    return id;
+}
+
+/* Index rel from byte offset `from`, dropping its paragraphs at or after it. */
+static void index_file(const char *rel, uint32_t from)
+{
+    char path[MI_PATH_LEN + 16];
+    snprintf(path, sizeof(path), MIMI_SPIFFS_BASE "/%s", rel);
+
+    int id = file_find(rel);
+    FILE *f = storage_fopen(path);
+    if (!f) {
+        if (id >= 0) {
+            kill_chunks((uint16_t)id, 0);
+            s_files[id].rel[0] = '\0';
+        }
+        return;
+    }
+    if (id < 0) {
+        id = file_slot(rel);
+        from = 0;
+        if (id < 0) {
+            fclose(f);
+            return;
+        }
+    }
+
+    fseek(f, 0, SEEK_END);
+    long size = ftell(f);
+    if (size < 0 || (uint32_t)size < from) from = 0;
+    kill_chunks((uint16_t)id, from);
+    s_files[id].tail_off = from;
+    s_files[id].size = size > 0 ? (uint32_t)size : 0;
+
+    size_t len = size > 0 ? (size_t)size - from : 0;
+    char *text = len ? heap_caps_malloc(len, MALLOC_CAP_SPIRAM) : NULL;
+    if (text) {
+        fseek(f, from, SEEK_SET);
+        len = fread(text, 1, len, f);
+        index_text((uint16_t)id, from, text, len);
+        free(text);
+    }
+    fclose(f);
+}
+
+static void index_reset(void)
+{
+    for (uint32_t i = 0; i < s_terms_cap; i++) free(s_terms[i].post);
+    free(s_terms);
+    s_terms = NULL;
+    s_terms_cap = s_nterms = 0;
+    s_nchunks = s_nfiles = 0;
+    s_live = s_dead = 0;
+    s_total_terms = 0;
+    s_post_bytes = 0;
+    s_npostings = 0;
+}
+
+static int cmp_key(const void *a, const void *b)
+{
+    uint32_t x = *(const uint32_t *)a, y = *(const uint32_t *)b;
+    return x < y ? -1 : x > y;
+}
+
+/* Forget vectors of paragraphs that no longer exist */
+static void vec_retain_live(void)
+{
+    if (memory_vec_backend() == MEMORY_VEC_OFF) return;
+    uint32_t *keys = heap_caps_malloc((s_live + 1) * sizeof(uint32_t), MALLOC_CAP_SPIRAM);
+    if (!keys) return;
+    size_t n = 0;
+    for (uint32_t i = 0; i < s_nchunks; i++) {
+        if (s_chunks[i].file != MI_DEAD) keys[n++] = s_chunks[i].key;
+    }
+    qsort(keys, n, sizeof(uint32_t), cmp_key);
+    memory_vec_retain(keys, n);
+    free(keys);
+}
+
+static void index_scan(void)
+{
+    static const struct {
+        const char *path;
+        const char *rel;
+    } dirs[] = {
+        { MIMI_SPIFFS_MEMORY_DIR, "memory" },
+        { MIMI_SKILLS_DIR,        "skills" },
+    };
+    index_reset();
+    for (size_t i = 0; i < sizeof(dirs) / sizeof(dirs[0]); i++) {
+        storage_dir_t *dir = storage_opendir(dirs[i].path);
+        if (!dir) continue;
+        const char *name;
+        while ((name = storage_readdir(dir)) != NULL) {
+            char rel[MI_PATH_LEN + 8];
+            snprintf(rel, sizeof(rel), "%s/%s", dirs[i].rel, name);
+            if (indexable(rel)) index_file(rel, 0);
+        }
+        storage_closedir(dir);
+    }
+    vec_retain_live();
+}
+
+static void maybe_compact(void)
+{
+    if (s_dead < MI_COMPACT_MIN || s_dead < s_live) return;
+    index_scan();
+    s_rebuilds++;
+    ESP_LOGI(TAG, "Rebuilt: %lu paragraphs, %lu terms",
+             (unsigned long)s_live, (unsigned long)s_nterms);
+}
+
+/* ── Public API ──────────────────────────────────────────────── */
+
+esp_err_t memory_index_init(void)
+{
+    if (!s_lock) s_lock = xSemaphoreCreateMutex();
+    if (!s_lock) return ESP_ERR_NO_MEM;
+    esp_err_t err = memory_vec_init();
+    if (err != ESP_OK) return err;
+
+    int64_t t0 = esp_timer_get_time();
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    index_scan();
+    s_ready = true;
+    xSemaphoreGive(s_lock);
+    memory_vec_flush();
+    start_embed_task();
+
+    ESP_LOGI(TAG, "Indexed %lu files, %lu paragraphs, %lu terms in %d ms",
+             (unsigned long)s_nfiles, (unsigned long)s_live, (unsigned long)s_nterms,
+             (int)((esp_timer_get_time() - t0) / 1000));
+    return ESP_OK;
+}
+
+bool memory_index_ready(void)
+{
+    return s_ready;
+}
+
+static void update(const char *path, bool append)
+{
+    const char *rel = rel_path(path);
+    if (!s_ready || !rel || !indexable(rel)) return;
+
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    int id = file_find(rel);
+    index_file(rel, append && id >= 0 ? s_files[id].tail_off : 0);
+    maybe_compact();
+    xSemaphoreGive(s_lock);
+    memory_vec_flush();
+}
+
+void memory_index_update_file(const char *path)
+{
+    update(path, false);
+}
+
+void memory_index_append_file(const char *path)
+{
+    update(path, true);
+}
+
+/* ── Remote embeddings ───────────────────────────────────────── */
+
+typedef struct {
+    uint32_t key;
+    uint32_t off;
+    uint16_t len;
+    char     rel[MI_PATH_LEN];
+} pending_t;
+
+/* Live paragraphs without a vector yet; caller holds s_lock */
+static int collect_pending(pending_t *out, int max)
+{
+    int n = 0;
+    for (uint32_t i = 0; i < s_nchunks && n < max; i++) {
+        const mi_chunk_t *c = &s_chunks[i];
+        if (c->file == MI_DEAD || memory_vec_has(c->key)) continue;
+        bool dup = false;
+        for (int j = 0; j < n && !dup; j++) dup = out[j].key == c->key;
+        if (dup) continue;
+        out[n].key = c->key;
+        out[n].off = c->off;
+        out[n].len = c->len;
+        snprintf(out[n].rel, MI_PATH_LEN, "%s", s_files[c->file].rel);
+        n++;
+    }
+    return n;
+}
+
+static bool read_text(const pending_t *p, char *text)
+{
+    char path[MI_PATH_LEN + 16];
+    snprintf(path, sizeof(path), MIMI_SPIFFS_BASE "/%s", p->rel);
+    FILE *f = storage_fopen(path);
+    if (!f) return false;
+    fseek(f, p->off, SEEK_SET);
+    size_t n = fread(text, 1, p->len, f);
+    fclose(f);
+    return n == p->len && term_hash(text, n) == p->key;
+}
+
+/*
+ * Embeds paragraphs through the network a batch at a time, outside s_lock
+ * so turns never wait on it. A failed request waits for the next interval.
+ */
+static void embed_task(void *arg)
+{
+    pending_t *batch = heap_caps_malloc(sizeof(pending_t) * MIMI_VEC_EMBED_BATCH,
+                                        MALLOC_CAP_SPIRAM);
+    char *text = heap_caps_malloc(MIMI_INDEX_CHUNK_BYTES, MALLOC_CAP_SPIRAM);
+    if (!batch || !text) {
+        ESP_LOGE(TAG, "Embed task out of memory");
+        free(batch);
+        free(text);
+        s_embed_task = NULL;
+        vTaskDelete(NULL);
+        return;
+    }
+
+    TickType_t wait = pdMS_TO_TICKS(MIMI_VEC_EMBED_INTERVAL_MS);
+    while (1) {
+        vTaskDelay(wait);
+        wait = pdMS_TO_TICKS(MIMI_VEC_EMBED_INTERVAL_MS);
+        if (memory_vec_backend() != MEMORY_VEC_REMOTE) continue;
+
+        xSemaphoreTake(s_lock, portMAX_DELAY);
+        int n = collect_pending(batch, MIMI_VEC_EMBED_BATCH);
+        xSemaphoreGive(s_lock);
+
+        int done = 0;
+        bool failed = false;
+        for (int i = 0; i < n && !failed; i++) {
+            int8_t vec[MIMI_VEC_DIM];
+            float scale;
+            if (!read_text(&batch[i], text)) continue;
+            if (memory_vec_embed(text, batch[i].len, vec, &scale) != ESP_OK) {
+                failed = true;
+                break;
+            }
+            memory_vec_put(batch[i].key, vec, scale);
+            done++;
+        }
+        if (done) {
+            memory_vec_flush();
+            ESP_LOGI(TAG, "Embedded %d paragraphs", done);
+        }
+        /* More to do: keep going without the full interval */
+        if (n == MIMI_VEC_EMBED_BATCH && !failed) wait = pdMS_TO_TICKS(100);
+    }
+}
+
+static void start_embed_task(void)
+{
+    if (s_embed_task || memory_vec_backend() != MEMORY_VEC_REMOTE) return;
+    if (xTaskCreate(embed_task, "mem_embed", MIMI_VEC_EMBED_STACK, NULL,
+                    MIMI_VEC_EMBED_PRIO, &s_embed_task) != pdPASS) {
+        ESP_LOGE(TAG, "Failed to start embed task");
+        s_embed_task = NULL;
+    }
+}
+
+void memory_index_reembed(void)
+{
+    if (!s_ready) return;
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    index_scan();
+    xSemaphoreGive(s_lock);
+    memory_vec_flush();
+    start_embed_task();
+}
+
+/* ── Search ──────────────────────────────────────────────────── */
+
+typedef struct {
+    uint32_t hash[MIMI_INDEX_QUERY_TERMS];
+    int n;
+} query_terms_t;
+
+static void collect_query_term(const char *tok, size_t n, void *ctx)
+{
+    query_terms_t *q = ctx;
+    uint32_t hash = term_hash(tok, n);
+    for (int i = 0; i < q->n; i++) {
+        if (q->hash[i] == hash) return;
+    }
+    if (q->n < MIMI_INDEX_QUERY_TERMS) q->hash[q->n++] = hash;
+}
+
+/* Copy one paragraph into buf; false if the file changed behind our back. */
+static bool read_chunk(const mi_chunk_t *c, char *buf, size_t size, size_t *off)
+{
+    const mi_file_t *fe = &s_files[c->file];
+    char path[MI_PATH_LEN + 16];
+    snprintf(path, sizeof(path), MIMI_SPIFFS_BASE "/%s", fe->rel);
+
+    FILE *f = storage_fopen(path);
+    if (!f) return false;
+    fseek(f, 0, SEEK_END);
+    if (ftell(f) != (long)fe->size) {
+        fclose(f);
+        return false;
+    }
+
+    int head = snprintf(buf + *off, size - *off, "[%s]\n", fe->rel);
+    if (head < 0 || *off + head + c->len + 2 >= size) {
+        buf[*off] = '\0';
+        fclose(f);
+        return true;
+    }
+    fseek(f, c->off, SEEK_SET);
+    size_t n = fread(buf + *off + head, 1, c->len, f);
+    fclose(f);
+    *off += head + n;
+    *off += snprintf(buf + *off, size - *off, "\n\n");
+    return true;
+}
+
+/* Best chunk ids by BM25, highest first; caller holds s_lock */
+static int bm25_rank(const query_terms_t *q, uint32_t *best, int max)
+{
+    float *score = s_live ? heap_caps_calloc(s_nchunks, sizeof(float), MALLOC_CAP_SPIRAM) : NULL;
+    if (!score) return 0;
+
+    const float k1 = MIMI_INDEX_BM25_K1, b = MIMI_INDEX_BM25_B;
+    float avgdl = (float)s_total_terms / (float)s_live;
+    if (avgdl < 1.0f) avgdl = 1.0f;
+
+    for (int i = 0; i < q->n; i++) {
+        mi_term_t *t = term_find(q->hash[i]);
+        if (!t) continue;
+        uint32_t df = 0;
+        for (uint32_t j = 0; j < t->n; j++) {
+            if (s_chunks[t->post[j] >> 8].file != MI_DEAD) df++;
+        }
+        if (!df) continue;
+        float idf = logf(1.0f + ((float)s_live - df + 0.5f) / (df + 0.5f));
+        for (uint32_t j = 0; j < t->n; j++) {
+            uint32_t id = t->post[j] >> 8;
+            const mi_chunk_t *c = &s_chunks[id];
+            if (c->file == MI_DEAD) continue;
+            float tf = (float)(t->post[j] & 0xFF);
+            score[id] += idf * tf * (k1 + 1.0f) /
+                         (tf + k1 * (1.0f - b + b * (float)c->terms / avgdl));
+        }
+    }
+
+    int n = 0;
+    for (uint32_t id = 0; id < s_nchunks; id++) {
+        if (score[id] <= 0.0f) continue;
+        if (n == max && score[id] <= score[best[n - 1]]) continue;
+        int pos = n < max ? n++ : n - 1;
+        while (pos > 0 && score[best[pos - 1]] < score[id]) {
+            best[pos] = best[pos - 1];
+            pos--;
+        }
+        best[pos] = id;
+    }
+    free(score);
+    return n;
+}
+
+typedef struct {
+    uint32_t id;
+    float    rrf;
+    bool     keyword;
+} fused_t;
+
+static int fuse(fused_t *f, int n, uint32_t id, int rank, bool keyword)
+{
+    int i = 0;
+    while (i < n && f[i].id != id) i++;
+    if (i == n) f[n++] = (fused_t) { .id = id };
+    f[i].rrf += 1.0f / (float)(MIMI_VEC_RRF_K + rank + 1);
+    f[i].keyword |= keyword;
+    return n;
+}
+
+int memory_index_search(const char *query, char *buf, size_t size, int top_k)
+{
+    if (size == 0) return 0;
+    buf[0] = '\0';
+    if (!s_ready || !query || top_k <= 0) return 0;
+
+    int64_t t0 = esp_timer_get_time();
+    query_terms_t q = { .n = 0 };
+    memory_index_tokenize(query, strlen(query), collect_query_term, &q);
+    if (q.n == 0) return 0;
+    if (top_k > MIMI_INDEX_TOP_K_MAX) top_k = MIMI_INDEX_TOP_K_MAX;
+
+    /* Query vector first: the remote backend goes to the network */
+    memory_vec_hit_t hits[MIMI_VEC_CANDIDATES];
+    int nhits = 0;
+    memory_vec_stats_t vs;
+    memory_vec_get_stats(&vs);
+    if (vs.backend != MEMORY_VEC_OFF && vs.vectors > 0) {
+        int8_t qvec[MIMI_VEC_DIM] __attribute__((aligned(16)));
+        float qscale;
+        if (memory_vec_embed(query, strlen(query), qvec, &qscale) == ESP_OK) {
+            nhits = memory_vec_scan(qvec, qscale, hits, MIMI_VEC_CANDIDATES);
+        }
+    }
+
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    s_searches++;
+
+    /* Reciprocal rank fusion of the keyword and vector rankings */
+    uint32_t best[MIMI_INDEX_TOP_K_MAX];
+    fused_t fused[MIMI_INDEX_TOP_K_MAX + MIMI_VEC_CANDIDATES];
+    int nbest = bm25_rank(&q, best, MIMI_INDEX_TOP_K_MAX);
+    int nfused = 0;
+    for (int i = 0; i < nbest; i++) nfused = fuse(fused, nfused, best[i], i, true);
+    for (int i = 0; i < nhits; i++) {
+        for (uint32_t id = 0; id < s_nchunks; id++) {
+            if (s_chunks[id].key == hits[i].key && s_chunks[id].file != MI_DEAD) {
+                nfused = fuse(fused, nfused, id, i, false);
+                break;
+            }
+        }
+    }
+    for (int i = 1; i < nfused; i++) {
+        fused_t f = fused[i];
+        int j = i;
+        while (j > 0 && fused[j - 1].rrf < f.rrf) {
+            fused[j] = fused[j - 1];
+            j--;
+        }
+        fused[j] = f;
+    }
+    if (nfused > top_k) nfused = top_k;
+
+    size_t off = 0;
+    int written = 0;
+    char stale[MIMI_INDEX_TOP_K_MAX][MI_PATH_LEN];
+    int nstale = 0;
+    for (int i = 0; i < nfused; i++) {
+        const mi_chunk_t *c = &s_chunks[fused[i].id];
+        size_t before = off;
+        if (!read_chunk(c, buf, size, &off)) {
+            snprintf(stale[nstale++], MI_PATH_LEN, "%s", s_files[c->file].rel);
+            continue;
+        }
+        if (off > before) {
+            written++;
+            if (!fused[i].keyword) s_vec_hits++;
+        }
+    }
+
+    /* Edited without going through memory_store or the file tools */
+    for (int i = 0; i < nstale; i++) {
+        if (i > 0 && strcmp(stale[i], stale[i - 1]) == 0) continue;
+        ESP_LOGI(TAG, "%s changed on flash, re-indexing", stale[i]);
+        index_file(stale[i], 0);
+    }
+    if (nstale) maybe_compact();
+
+    s_last_search_us = (uint32_t)(esp_timer_get_time() - t0);
+    xSemaphoreGive(s_lock);
+    if (nstale) memory_vec_flush();
+    return written;
+}
+
+void memory_index_get_stats(memory_index_stats_t *out)
+{
+    memset(out, 0, sizeof(*out));
+    if (!s_lock) return;
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    for (uint32_t i = 0; i < s_nfiles; i++) {
+        if (s_files[i].rel[0]) out->files++;
+    }
+    out->chunks = s_live;
+    out->dead_chunks = s_dead;
+    out->terms = s_nterms;
+    out->postings = s_npostings;
+    out->searches = s_searches;
+    out->rebuilds = s_rebuilds;
+    out->last_search_us = s_last_search_us;
+    out->vector_only = s_vec_hits;
+    out->psram_bytes = (size_t)s_files_cap * sizeof(mi_file_t) +
+                       (size_t)s_chunks_cap * sizeof(mi_chunk_t) +
+                       (size_t)s_terms_cap * sizeof(mi_term_t) + s_post_bytes;
+    xSemaphoreGive(s_lock);
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include "esp_err.h"
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+/**
+ * Build the keyword index over MEMORY.md, daily notes and skill files.
+ * Each paragraph is one document; postings live in PSRAM. Call after
+ * SPIFFS is mounted and the built-in skills are installed.
+ */
+esp_err_t memory_index_init(void);
+
+/**
+ * Re-index one file after it was rewritten. Paths outside the memory and
+ * skills directories are ignored; a missing file drops its paragraphs.
+ */
+void memory_index_update_file(const char *path);
+
+/**
+ * Index only the tail of a file that was appended to, reusing the
+ * paragraphs before the last one.
+ */
+void memory_index_append_file(const char *path);
+
+/**
+ * Rank paragraphs against a query with BM25, fused with vector similarity
+ * when an embedding backend is set, and copy the best ones, each prefixed
+ * by its source file, into buf.
+ *
+ * @param query  Free text, usually the current user message
+ * @param buf    Output buffer, always NUL-terminated
+ * @param size   Byte budget including the terminator
+ * @param top_k  Maximum number of paragraphs
+ * @return Number of paragraphs written
+ */
+int memory_index_search(const char *query, char *buf, size_t size, int top_k);
+
+/** Token callback: a lower-cased word or one CJK character, not NUL-terminated. */
+typedef void (*memory_token_fn)(const char *tok, size_t len, void *ctx);
+
+/** Split text into the index's terms (stopwords and one-letter words dropped). */
+void memory_index_tokenize(const char *text, size_t len, memory_token_fn fn, void *ctx);
+
+/**
+ * Rebuild from flash and embed every paragraph again, after the
+ * embedding backend changed.
+ */
+void memory_index_reembed(void);
+
+/** True once the index has been built. */
+bool memory_index_ready(void);
+
+typedef struct {
+    uint32_t files;          /* indexed files */
+    uint32_t chunks;         /* live paragraphs */
+    uint32_t dead_chunks;    /* replaced paragraphs awaiting compaction */
+    uint32_t terms;          /* distinct term hashes */
+    uint32_t postings;       /* including postings of dead paragraphs */
+    uint32_t searches;
+    uint32_t rebuilds;
+    uint32_t last_search_us;
+    uint32_t vector_only;    /* injected paragraphs no keyword matched */
+    size_t   psram_bytes;    /* tables and posting lists */
+} memory_index_stats_t;
+
+/** Snapshot of index size and activity. */
+void memory_index_get_stats(memory_index_stats_t *out);
@@ -1,14 +1,48 @@
 #include "memory_store.h"
+#include "memory_index.h"
 #include "mimi_config.h"
+#include "storage/storage_fs.h"
+#include "storage/storage_log.h"
 
 #include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <stdbool.h>
 #include <string.h>
 #include <time.h>
 #include <sys/stat.h>
 #include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_heap_caps.h"
+#include "nvs.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
 
 static const char *TAG = "memory";
 
+static memory_notes_policy_t s_policy = {
+    .full_days = MIMI_NOTES_FULL_DAYS,
+    .summary_days = MIMI_NOTES_SUMMARY_DAYS,
+    .weeks = MIMI_NOTES_ROLLUP_WEEKS,
+    .months = MIMI_NOTES_ROLLUP_MONTHS,
+};
+
+/* Cached recent-notes block, guarded by s_notes_lock */
+static SemaphoreHandle_t s_notes_lock;
+static char *s_cache;
+static size_t s_cache_len;
+static int s_cache_day;
+static bool s_cache_valid;
+static char *s_scratch;                 /* file reads while assembling */
+static TaskHandle_t s_rollup_task;
+static SemaphoreHandle_t s_rollup_wake;
+static SemaphoreHandle_t s_rollup_lock;
+
+static uint32_t s_hits, s_rebuilds, s_files_read, s_last_build_us, s_rollups_written;
+
+static void notes_invalidate(void);
+
 static void get_date_str(char *buf, size_t size, int days_ago)
 {
     time_t now;
@@ -23,13 +57,33 @@ esp_err_t memory_store_init(void)
 {
     /* SPIFFS is flat — no real directory creation needed.
        Just verify we can open the base path. */
-    ESP_LOGI(TAG, "Memory store initialized at %s", MIMI_SPIFFS_BASE);
+    if (!s_notes_lock) s_notes_lock = xSemaphoreCreateMutex();
+    if (!s_rollup_lock) s_rollup_lock = xSemaphoreCreateMutex();
+    if (!s_notes_lock || !s_rollup_lock) return ESP_ERR_NO_MEM;
+
+    nvs_handle_t nvs;
+    if (nvs_open(MIMI_NVS_NOTES, NVS_READONLY, &nvs) == ESP_OK) {
+        nvs_get_u8(nvs, MIMI_NVS_KEY_NOTES_FULL, &s_policy.full_days);
+        nvs_get_u8(nvs, MIMI_NVS_KEY_NOTES_SUMMARY, &s_policy.summary_days);
+        nvs_get_u8(nvs, MIMI_NVS_KEY_NOTES_WEEKS, &s_policy.weeks);
+        nvs_get_u8(nvs, MIMI_NVS_KEY_NOTES_MONTHS, &s_policy.months);
+        nvs_close(nvs);
+    }
+
+    if (!s_cache) s_cache = heap_caps_malloc(MIMI_NOTES_RECENT_BUDGET, MALLOC_CAP_SPIRAM);
+    if (!s_scratch) s_scratch = heap_caps_malloc(MIMI_NOTES_DAY_READ_BYTES, MALLOC_CAP_SPIRAM);
+    if (!s_cache || !s_scratch) return ESP_ERR_NO_MEM;
+    notes_invalidate();
+
+    ESP_LOGI(TAG, "Memory store initialized at %s (notes: %d verbatim, %d days, %d weeks, %d months)",
+             MIMI_SPIFFS_BASE, s_policy.full_days, s_policy.summary_days,
+             s_policy.weeks, s_policy.months);
     return ESP_OK;
 }
 
 esp_err_t memory_read_long_term(char *buf, size_t size)
 {
-    FILE *f = fopen(MIMI_MEMORY_FILE, "r");
+    FILE *f = storage_fopen(MIMI_MEMORY_FILE);
     if (!f) {
         buf[0] = '\0';
         return ESP_ERR_NOT_FOUND;
@@ -43,13 +97,11 @@ esp_err_t memory_read_long_term(char *buf, size_t size)
 
 esp_err_t memory_write_long_term(const char *content)
 {
-    FILE *f = fopen(MIMI_MEMORY_FILE, "w");
-    if (!f) {
+    if (storage_write_file(MIMI_MEMORY_FILE, content, strlen(content)) != ESP_OK) {
         ESP_LOGE(TAG, "Cannot write %s", MIMI_MEMORY_FILE);
         return ESP_FAIL;
     }
-    fputs(content, f);
-    fclose(f);
+    memory_index_update_file(MIMI_MEMORY_FILE);
     ESP_LOGI(TAG, "Long-term memory updated (%d bytes)", (int)strlen(content));
     return ESP_OK;
 }
@@ -62,10 +114,12 @@ esp_err_t memory_append_today(const char *note)
     char path[64];
     snprintf(path, sizeof(path), "%s/%s.md", MIMI_SPIFFS_MEMORY_DIR, date_str);
 
-    FILE *f = fopen(path, "a");
+    /* A rewrite of today's note may still be in the log */
+    storage_sync_file(path);
+    FILE *f = storage_open(path, "a");
     if (!f) {
         /* Try creating — if file doesn't exist yet, write header */
-        f = fopen(path, "w");
+        f = storage_open(path, "w");
         if (!f) {
             ESP_LOGE(TAG, "Cannot open %s", path);
             return ESP_FAIL;
@@ -75,33 +129,661 @@ esp_err_t memory_append_today(const char *note)
 
     fprintf(f, "%s\n", note);
     fclose(f);
+    memory_index_append_file(path);
+    memory_notes_changed(path);
     return ESP_OK;
 }
 
-esp_err_t memory_read_recent(char *buf, size_t size, int days)
+/* ── Dates ───────────────────────────────────────────────────── */
+
+/* Days since 1970-01-01 in the proleptic Gregorian calendar */
+static int days_from_civil(int y, int m, int d)
 {
-    size_t offset = 0;
-    buf[0] = '\0';
+    y -= m <= 2;
+    int era = (y >= 0 ? y : y - 399) / 400;
+    unsigned yoe = (unsigned)(y - era * 400);
+    unsigned doy = (153 * (unsigned)(m > 2 ? m - 3 : m + 9) + 2) / 5 + (unsigned)d - 1;
+    unsigned doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    return era * 146097 + (int)doe - 719468;
+}
+
+static void civil_from_days(int z, int *y, int *m, int *d)
+{
+    z += 719468;
+    int era = (z >= 0 ? z : z - 146096) / 146097;
+    unsigned doe = (unsigned)(z - era * 146097);
+    unsigned yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+    unsigned doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+    unsigned mp = (5 * doy + 2) / 153;
+    *d = (int)(doy - (153 * mp + 2) / 5 + 1);
+    *m = (int)(mp < 10 ? mp + 3 : mp - 9);
+    *y = (int)yoe + era * 400 + (*m <= 2);
+}
+
+static int today_day(void)
+{
+    time_t now = time(NULL);
+    struct tm tm;
+    localtime_r(&now, &tm);
+    return days_from_civil(tm.tm_year + 1900, tm.tm_mon + 1, tm.tm_mday);
+}
+
+/* Rollups need a real date; before SNTP the clock sits in 1970 */
+static bool clock_valid(int today)
+{
+    return today >= days_from_civil(2024, 1, 1);
+}
+
+static int monday_of(int day)
+{
+    return day - ((day + 3) % 7 + 7) % 7;
+}
+
+static int month_first(int day)
+{
+    int y, m, d;
+    civil_from_days(day, &y, &m, &d);
+    return days_from_civil(y, m, 1);
+}
+
+static int month_last(int first)
+{
+    int y, m, d;
+    civil_from_days(first, &y, &m, &d);
+    return (m == 12 ? days_from_civil(y + 1, 1, 1) : days_from_civil(y, m + 1, 1)) - 1;
+}
+
+static void day_str(int day, char *buf, size_t size)
+{
+    int y, m, d;
+    civil_from_days(day, &y, &m, &d);
+    snprintf(buf, size, "%04d-%02d-%02d", y, m, d);
+}
+
+static bool parse_day(const char *s, int *day)
+{
+    int y, m, d, n = 0;
+    if (sscanf(s, "%4d-%2d-%2d%n", &y, &m, &d, &n) != 3 || n != 10) return false;
+    if (m < 1 || m > 12 || d < 1 || d > 31) return false;
+    *day = days_from_civil(y, m, d);
+    return true;
+}
+
+static void note_path(int day, char *buf, size_t size)
+{
+    char date[16];
+    day_str(day, date, sizeof(date));
+    snprintf(buf, size, "%s/%s.md", MIMI_SPIFFS_MEMORY_DIR, date);
+}
+
+/* ── Lookback tiers ──────────────────────────────────────────── */
+
+typedef enum {
+    TIER_FULL,
+    TIER_SUMMARY,
+    TIER_WEEK,
+    TIER_MONTH,
+} notes_tier_t;
+
+/* One period of a tier: days first.., of which only first..upto are still uncovered */
+typedef void (*tier_fn)(notes_tier_t tier, int first, int upto, void *ctx);
+
+static void rollup_path(notes_tier_t tier, int first, char *buf, size_t size)
+{
+    int y, m, d;
+    civil_from_days(first, &y, &m, &d);
+    if (tier == TIER_WEEK) {
+        snprintf(buf, size, "%s/week-%04d-%02d-%02d.md", MIMI_NOTES_ROLLUP_DIR, y, m, d);
+    } else {
+        snprintf(buf, size, "%s/month-%04d-%02d.md", MIMI_NOTES_ROLLUP_DIR, y, m);
+    }
+}
+
+/*
+ * Walk the policy newest first. The summary tier reaches back at least to
+ * the start of the current week (or month, without weekly rollups), so
+ * rollups only ever cover completed periods and the tiers leave no gaps.
+ * The weekly tier likewise runs on until the current month is covered.
+ */
+static void walk_tiers(const memory_notes_policy_t *p, int today, bool rollups,
+                       tier_fn fn, void *ctx)
+{
+    int day = today;
+    for (int i = 0; i < p->full_days; i++, day--) {
+        fn(TIER_FULL, day, day, ctx);
+    }
+
+    int oldest = today - p->summary_days + 1;
+    int this_month = month_first(today);
+    if (p->weeks > 0 && monday_of(today) < oldest) oldest = monday_of(today);
+    if (p->weeks == 0 && p->months > 0 && this_month < oldest) oldest = this_month;
+    for (; day >= oldest; day--) {
+        fn(TIER_SUMMARY, day, day, ctx);
+    }
+    if (!rollups) return;
+
+    for (int n = 0; n < p->weeks || (p->months > 0 && day >= this_month); n++) {
+        int monday = monday_of(day);
+        fn(TIER_WEEK, monday, day, ctx);
+        day = monday - 1;
+    }
+    for (int n = 0; n < p->months; n++) {
+        int first = month_first(day);
+        fn(TIER_MONTH, first, day, ctx);
+        day = first - 1;
+    }
+}
+
+/* ── Note summaries ──────────────────────────────────────────── */
+
+static int read_note(const char *path, char *buf, size_t cap, bool tail)
+{
+    FILE *f = storage_fopen(path);
+    if (!f) return -1;
+    size_t skip = 0;
+    if (tail && fseek(f, 0, SEEK_END) == 0) {
+        long size = ftell(f);
+        if (size > (long)cap - 1) {
+            fseek(f, size - (long)cap + 1, SEEK_SET);
+            skip = 1;
+        } else {
+            fseek(f, 0, SEEK_SET);
+        }
+    }
+    size_t n = fread(buf, 1, cap - 1, f);
+    fclose(f);
+    buf[n] = '\0';
+
+    if (skip) {
+        /* Started mid-file: drop the partial first line */
+        char *nl = strchr(buf, '\n');
+        size_t from = nl ? (size_t)(nl - buf) + 1 : n;
+        memmove(buf, buf + from, n - from + 1);
+        n -= from;
+    }
+    return (int)n;
+}
+
+/* Length of an entry's first sentence, or of as many whole words as fit */
+static size_t first_sentence(const char *s, size_t len, bool *cut)
+{
+    *cut = false;
+    for (size_t i = 0; i < len; i++) {
+        if ((s[i] == '.' || s[i] == '!' || s[i] == '?') && (i + 1 == len || s[i + 1] == ' ')) {
+            if (i + 1 <= MIMI_NOTES_LINE_BYTES) return i + 1;
+            break;
+        }
+        if (i + 3 <= len && memcmp(s + i, "\xE3\x80\x82", 3) == 0 && i + 3 <= MIMI_NOTES_LINE_BYTES) {
+            return i + 3;    /* ideographic full stop */
+        }
+    }
+    if (len <= MIMI_NOTES_LINE_BYTES) return len;
+
+    *cut = true;
+    size_t n = MIMI_NOTES_LINE_BYTES;
+    while (n > MIMI_NOTES_LINE_BYTES / 2 && s[n] != ' ') n--;
+    if (s[n] != ' ') n = MIMI_NOTES_LINE_BYTES;
+    while (n > 0 && ((unsigned char)s[n] & 0xC0) == 0x80) n--;
+    return n;
+}
+
+static size_t bullet_len(const char *s, size_t len)
+{
+    if (len >= 2 && (s[0] == '-' || s[0] == '*' || s[0] == '+') && s[1] == ' ') return 2;
+    size_t i = 0;
+    while (i < len && s[i] >= '0' && s[i] <= '9') i++;
+    if (i > 0 && i + 1 < len && s[i] == '.' && s[i + 1] == ' ') return i + 2;
+    return 0;
+}
+
+/*
+ * Reduce a daily note to "- <first sentence>" lines, one per entry, where
+ * an entry is a list item or a paragraph. Headings are skipped. With
+ * count_rest, entries past max_lines are counted on a last line.
+ */
+static size_t summarize(const char *text, int max_lines, bool count_rest, char *out, size_t size)
+{
+    size_t len = 0;
+    int lines = 0, more = 0;
+    bool in_entry = false;
+    out[0] = '\0';
+
+    for (const char *p = text; *p; ) {
+        const char *eol = strchr(p, '\n');
+        size_t n = eol ? (size_t)(eol - p) : strlen(p);
+        const char *line = p;
+        p = eol ? eol + 1 : p + n;
+
+        while (n > 0 && (line[n - 1] == '\r' || line[n - 1] == ' ')) n--;
+        while (n > 0 && *line == ' ') {
+            line++;
+            n--;
+        }
+        if (n == 0 || line[0] == '#') {
+            in_entry = false;
+            continue;
+        }
+        size_t b = bullet_len(line, n);
+        if (in_entry && b == 0) continue;    /* rest of a paragraph */
+        in_entry = true;
+
+        if (lines >= max_lines) {
+            more++;
+            continue;
+        }
+        bool cut;
+        size_t keep = first_sentence(line + b, n - b, &cut);
+        int w = snprintf(out + len, size - len, "- %.*s%s\n", (int)keep, line + b, cut ? "..." : "");
+        if (w < 0 || (size_t)w >= size - len) {
+            out[len] = '\0';
+            more++;
+            continue;
+        }
+        len += (size_t)w;
+        lines++;
+    }
+    if (count_rest && more > 0) {
+        int w = snprintf(out + len, size - len, "- (+%d more)\n", more);
+        if (w > 0 && (size_t)w < size - len) len += (size_t)w;
+        else out[len] = '\0';
+    }
+    return len;
+}
+
+/*
+ * A rollup keeps one entry from each of up to MIMI_NOTES_{WEEK,MONTH}_LINES
+ * days, spread evenly over the days in first..last that have notes,
+ * newest first, as "## YYYY-MM-DD" sections.
+ */
+static size_t rollup_build(notes_tier_t tier, int first, int last, char *text,
+                           char *out, size_t size, int *days_out)
+{
+    int want = tier == TIER_WEEK ? MIMI_NOTES_WEEK_LINES : MIMI_NOTES_MONTH_LINES;
+    int days[31], n = 0;
+    char date[16], note[96];
+    struct stat st;
+    for (int day = last; day >= first && n < 31; day--) {
+        note_path(day, note, sizeof(note));
+        if (storage_stat(note, &st) == 0 && st.st_size > 0) days[n++] = day;
+    }
 
-    for (int i = 0; i < days && offset < size - 1; i++) {
-        char date_str[16];
-        get_date_str(date_str, sizeof(date_str), i);
+    day_str(first, date, sizeof(date));
+    size_t len = (size_t)snprintf(out, size, tier == TIER_WEEK ? "# Week of %s\n" : "# Month %.7s\n",
+                                  date);
+    for (int i = 0; i < want && i < n; i++) {
+        int day = days[n <= want ? i : i * n / want];
+        note_path(day, note, sizeof(note));
+        char summary[MIMI_NOTES_LINE_BYTES + 8];
+        if (read_note(note, text, MIMI_NOTES_DAY_READ_BYTES, false) <= 0 ||
+            summarize(text, 1, false, summary, sizeof(summary)) == 0) {
+            continue;
+        }
+        s_files_read++;
+        day_str(day, date, sizeof(date));
+        int w = snprintf(out + len, size - len, "\n## %s\n%s", date, summary);
+        if (w < 0 || (size_t)w >= size - len) {
+            out[len] = '\0';
+            break;
+        }
+        len += (size_t)w;
+    }
+    if (days_out) *days_out = n;
+    return len;
+}
+
+/* ── Recent notes block ──────────────────────────────────────── */
+
+/* Cumulative share of the budget each tier may fill; what one leaves goes to the next */
+static const uint8_t s_tier_pct[] = {
+    MIMI_NOTES_FULL_PCT,
+    MIMI_NOTES_FULL_PCT + MIMI_NOTES_SUMMARY_PCT,
+    MIMI_NOTES_FULL_PCT + MIMI_NOTES_SUMMARY_PCT + MIMI_NOTES_WEEK_PCT,
+    100,
+};
+
+typedef struct {
+    char  *buf;
+    size_t size;
+    size_t len;
+    size_t limit;            /* end of the current tier's share */
+    notes_tier_t tier;
+    bool   tier_full;        /* an older period would not fit either */
+    int    header_first;     /* period the last header was written for */
+    bool   want_rollups;
+} notes_block_t;
+
+static bool block_put(notes_block_t *b, const char *fmt, ...)
+{
+    if (b->tier_full) return false;
+    va_list ap;
+    va_start(ap, fmt);
+    int w = vsnprintf(b->buf + b->len, b->limit - b->len, fmt, ap);
+    va_end(ap);
+    if (w < 0 || (size_t)w >= b->limit - b->len) {
+        b->buf[b->len] = '\0';
+        b->tier_full = true;
+        return false;
+    }
+    b->len += (size_t)w;
+    return true;
+}
+
+static bool block_header(notes_block_t *b, int first)
+{
+    if (b->header_first >= 0 && (b->tier == TIER_SUMMARY || b->header_first == first)) return true;
+    b->header_first = first;
 
-        char path[64];
-        snprintf(path, sizeof(path), "%s/%s.md", MIMI_SPIFFS_MEMORY_DIR, date_str);
+    char date[16];
+    day_str(first, date, sizeof(date));
+    switch (b->tier) {
+    case TIER_SUMMARY: return block_put(b, "### Earlier days\n");
+    case TIER_WEEK:    return block_put(b, "### Week of %s\n", date);
+    case TIER_MONTH:   return block_put(b, "### %.7s\n", date);
+    default:           return true;
+    }
+}
 
-        FILE *f = fopen(path, "r");
-        if (!f) continue;
+/*
+ * Copy the "## YYYY-MM-DD" sections of a rollup that fall in first..upto,
+ * folding each date into its lines.
+ */
+static void block_rollup(notes_block_t *b, int first, int upto, const char *text)
+{
+    const char *date = NULL;
+    for (const char *p = text; *p; ) {
+        const char *eol = strchr(p, '\n');
+        size_t n = eol ? (size_t)(eol - p) : strlen(p);
+        const char *line = p;
+        p = eol ? eol + 1 : p + n;
 
-        if (offset > 0 && offset < size - 4) {
-            offset += snprintf(buf + offset, size - offset, "\n---\n");
+        int day;
+        if (n >= 3 && strncmp(line, "## ", 3) == 0) {
+            date = parse_day(line + 3, &day) && day >= first && day <= upto ? line + 3 : NULL;
+            continue;
+        }
+        if (!date || n < 2 || strncmp(line, "- ", 2) != 0) continue;
+        if (!block_header(b, first) ||
+            !block_put(b, "- %.5s: %.*s\n", date + 5, (int)n - 2, line + 2)) {
+            return;
         }
+    }
+}
+
+static void assemble_tier(notes_tier_t tier, int first, int upto, void *ctx)
+{
+    notes_block_t *b = ctx;
+    char path[96], date[16];
 
-        size_t n = fread(buf + offset, 1, size - offset - 1, f);
-        offset += n;
-        buf[offset] = '\0';
-        fclose(f);
+    if (tier != b->tier || b->limit == 0) {
+        b->tier = tier;
+        b->limit = b->size * s_tier_pct[tier] / 100;
+        b->tier_full = b->len + 1 >= b->limit;
+        b->header_first = -1;
     }
+    if (b->tier_full) return;
 
+    if (tier == TIER_FULL || tier == TIER_SUMMARY) {
+        note_path(first, path, sizeof(path));
+        size_t cap = MIMI_NOTES_DAY_READ_BYTES;
+        if (tier == TIER_FULL && b->limit - b->len < cap + 32) {
+            if (b->limit - b->len < 96) return;
+            cap = b->limit - b->len - 32;    /* keep the newest lines that fit */
+        }
+        int n = read_note(path, s_scratch, cap, tier == TIER_FULL);
+        s_files_read++;
+        if (n <= 0) return;
+
+        day_str(first, date, sizeof(date));
+        if (tier == TIER_FULL) {
+            /* The note's own "# <date>" heading would repeat ours */
+            const char *text = s_scratch;
+            size_t dl = strlen(date);
+            if (strncmp(text, "# ", 2) == 0 && strncmp(text + 2, date, dl) == 0) {
+                text += 2 + dl;
+                text += strspn(text, "\r\n");
+            }
+            size_t tl = strlen(text);
+            if (tl > 0) {
+                block_put(b, "### %s\n%s%s", date, text, text[tl - 1] == '\n' ? "" : "\n");
+            }
+            return;
+        }
+        char summary[(MIMI_NOTES_LINE_BYTES + 8) * (MIMI_NOTES_SUMMARY_LINES + 1)];
+        if (summarize(s_scratch, MIMI_NOTES_SUMMARY_LINES, true, summary, sizeof(summary)) > 0 &&
+            block_header(b, first)) {
+            block_put(b, "%s:\n%s", date, summary);
+        }
+        return;
+    }
+
+    if (tier == TIER_WEEK && upto < first + 6) {
+        /* The rest of a week the summaries already started on */
+        char part[MIMI_NOTES_WEEK_LINES * (MIMI_NOTES_LINE_BYTES + 24) + 32];
+        rollup_build(tier, first, upto, s_scratch, part, sizeof(part), NULL);
+        block_rollup(b, first, upto, part);
+        return;
+    }
+
+    rollup_path(tier, first, path, sizeof(path));
+    int n = read_note(path, s_scratch, MIMI_NOTES_DAY_READ_BYTES, false);
+    s_files_read++;
+    if (n < 0) {
+        b->want_rollups = true;
+        return;
+    }
+    block_rollup(b, first, upto, s_scratch);
+}
+
+static void assemble(char *buf, size_t size, int today, bool *want_rollups)
+{
+    notes_block_t b = {
+        .buf = buf, .size = size,
+    };
+    buf[0] = '\0';
+    memory_notes_policy_t policy = s_policy;
+    walk_tiers(&policy, today, clock_valid(today), assemble_tier, &b);
+    *want_rollups = b.want_rollups;
+}
+
+esp_err_t memory_read_recent(char *buf, size_t size)
+{
+    buf[0] = '\0';
+    if (!s_notes_lock || !s_cache) return ESP_ERR_INVALID_STATE;
+
+    int today = today_day();
+    bool want_rollups = false;
+    xSemaphoreTake(s_notes_lock, portMAX_DELAY);
+    if (!s_cache_valid || s_cache_day != today) {
+        int64_t t0 = esp_timer_get_time();
+        assemble(s_cache, MIMI_NOTES_RECENT_BUDGET, today, &want_rollups);
+        s_cache_len = strlen(s_cache);
+        s_cache_day = today;
+        s_cache_valid = true;
+        s_rebuilds++;
+        s_last_build_us = (uint32_t)(esp_timer_get_time() - t0);
+        ESP_LOGD(TAG, "Recent notes rebuilt: %u bytes in %lu us",
+                 (unsigned)s_cache_len, (unsigned long)s_last_build_us);
+    } else {
+        s_hits++;
+    }
+    size_t n = s_cache_len < size - 1 ? s_cache_len : size - 1;
+    memcpy(buf, s_cache, n);
+    buf[n] = '\0';
+    xSemaphoreGive(s_notes_lock);
+
+    if (want_rollups && s_rollup_wake) xSemaphoreGive(s_rollup_wake);
     return ESP_OK;
 }
+
+static void notes_invalidate(void)
+{
+    if (!s_notes_lock) return;
+    xSemaphoreTake(s_notes_lock, portMAX_DELAY);
+    s_cache_valid = false;
+    xSemaphoreGive(s_notes_lock);
+}
+
+void memory_notes_changed(const char *path)
+{
+    const char *dir = MIMI_SPIFFS_MEMORY_DIR "/";
+    size_t dir_len = strlen(dir);
+    int day;
+    if (!path || strncmp(path, dir, dir_len) != 0) return;
+    if (!parse_day(path + dir_len, &day) || strcmp(path + dir_len + 10, ".md") != 0) return;
+
+    /* Rollups covering this day were summarized from the old text */
+    char rollup[96];
+    rollup_path(TIER_WEEK, monday_of(day), rollup, sizeof(rollup));
+    storage_remove(rollup);
+    rollup_path(TIER_MONTH, month_first(day), rollup, sizeof(rollup));
+    storage_remove(rollup);
+    notes_invalidate();
+}
+
+/* ── Rollups ─────────────────────────────────────────────────── */
+
+typedef struct {
+    char *text;      /* one daily note */
+    char *out;       /* rollup being built */
+    int   written;
+} rollup_ctx_t;
+
+static void rollup_tier(notes_tier_t tier, int first, int upto, void *arg)
+{
+    rollup_ctx_t *ctx = arg;
+    if (tier != TIER_WEEK && tier != TIER_MONTH) return;
+    int last = tier == TIER_WEEK ? first + 6 : month_last(first);
+    if (tier == TIER_WEEK && upto < last) return;    /* summarized on the fly instead */
+
+    char path[96];
+    struct stat st;
+    rollup_path(tier, first, path, sizeof(path));
+    if (stat(path, &st) == 0) return;
+
+    int days;
+    size_t len = rollup_build(tier, first, last, ctx->text, ctx->out, MIMI_NOTES_ROLLUP_BYTES, &days);
+
+    /* Written even when empty, so a quiet week is not summarized again */
+    FILE *f = storage_open(path, "w");
+    if (!f) {
+        ESP_LOGW(TAG, "Cannot write %s", path);
+        return;
+    }
+    fwrite(ctx->out, 1, len, f);
+    fclose(f);
+    ctx->written++;
+    ESP_LOGI(TAG, "Rollup %s: %d days with notes", path, days);
+}
+
+esp_err_t memory_rollup_run(int *written_out)
+{
+    if (written_out) *written_out = 0;
+    if (!s_rollup_lock) return ESP_ERR_INVALID_STATE;
+    int today = today_day();
+    if (!clock_valid(today)) return ESP_ERR_INVALID_STATE;
+
+    rollup_ctx_t ctx = {
+        .text = heap_caps_malloc(MIMI_NOTES_DAY_READ_BYTES, MALLOC_CAP_SPIRAM),
+        .out = heap_caps_malloc(MIMI_NOTES_ROLLUP_BYTES, MALLOC_CAP_SPIRAM),
+    };
+    if (!ctx.text || !ctx.out) {
+        free(ctx.text);
+        free(ctx.out);
+        return ESP_ERR_NO_MEM;
+    }
+
+    xSemaphoreTake(s_rollup_lock, portMAX_DELAY);
+    memory_notes_policy_t policy;
+    memory_notes_get_policy(&policy);
+    walk_tiers(&policy, today, true, rollup_tier, &ctx);
+    xSemaphoreGive(s_rollup_lock);
+    free(ctx.text);
+    free(ctx.out);
+
+    if (ctx.written > 0) {
+        xSemaphoreTake(s_notes_lock, portMAX_DELAY);
+        s_rollups_written += (uint32_t)ctx.written;
+        s_cache_valid = false;
+        xSemaphoreGive(s_notes_lock);
+    }
+    if (written_out) *written_out = ctx.written;
+    return ESP_OK;
+}
+
+static void rollup_task(void *arg)
+{
+    (void)arg;
+    while (1) {
+        /* Woken when the recent-notes block finds a rollup missing */
+        xSemaphoreTake(s_rollup_wake, portMAX_DELAY);
+        memory_rollup_run(NULL);
+    }
+}
+
+esp_err_t memory_rollup_start(void)
+{
+    if (s_rollup_task) return ESP_OK;
+
+    s_rollup_wake = xSemaphoreCreateBinary();
+    if (!s_rollup_wake) return ESP_ERR_NO_MEM;
+    BaseType_t ok = xTaskCreate(rollup_task, "notes_rollup",
+                                MIMI_NOTES_ROLLUP_STACK, NULL,
+                                MIMI_NOTES_ROLLUP_PRIO, &s_rollup_task);
+    if (ok != pdPASS || !s_rollup_task) {
+        ESP_LOGE(TAG, "Failed to create rollup task");
+        s_rollup_task = NULL;
+        return ESP_FAIL;
+    }
+    xSemaphoreGive(s_rollup_wake);
+    return ESP_OK;
+}
+
+/* ── Policy ──────────────────────────────────────────────────── */
+
+void memory_notes_get_policy(memory_notes_policy_t *out)
+{
+    if (s_notes_lock) xSemaphoreTake(s_notes_lock, portMAX_DELAY);
+    *out = s_policy;
+    if (s_notes_lock) xSemaphoreGive(s_notes_lock);
+}
+
+esp_err_t memory_notes_set_policy(const memory_notes_policy_t *policy)
+{
+    if (policy->full_days > 7 || policy->summary_days > 31 ||
+        policy->weeks > 12 || policy->months > 12) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    xSemaphoreTake(s_notes_lock, portMAX_DELAY);
+    s_policy = *policy;
+    s_cache_valid = false;
+    xSemaphoreGive(s_notes_lock);
+    if (s_rollup_wake) xSemaphoreGive(s_rollup_wake);
+
+    nvs_handle_t nvs;
+    esp_err_t err = nvs_open(MIMI_NVS_NOTES, NVS_READWRITE, &nvs);
+    if (err != ESP_OK) return err;
+    nvs_set_u8(nvs, MIMI_NVS_KEY_NOTES_FULL, policy->full_days);
+    nvs_set_u8(nvs, MIMI_NVS_KEY_NOTES_SUMMARY, policy->summary_days);
+    nvs_set_u8(nvs, MIMI_NVS_KEY_NOTES_WEEKS, policy->weeks);
+    nvs_set_u8(nvs, MIMI_NVS_KEY_NOTES_MONTHS, policy->months);
+    err = nvs_commit(nvs);
+    nvs_close(nvs);
+    ESP_LOGI(TAG, "Notes lookback: %d verbatim, %d days, %d weeks, %d months",
+             policy->full_days, policy->summary_days, policy->weeks, policy->months);
+    return err;
+}
+
+void memory_notes_get_stats(memory_notes_stats_t *out)
+{
+    memset(out, 0, sizeof(*out));
+    if (!s_notes_lock) return;
+    xSemaphoreTake(s_notes_lock, portMAX_DELAY);
+    out->hits = s_hits;
+    out->rebuilds = s_rebuilds;
+    out->files_read = s_files_read;
+    out->last_build_us = s_last_build_us;
+    out->block_bytes = s_cache_valid ? (uint32_t)s_cache_len : 0;
+    out->rollups_written = s_rollups_written;
+    xSemaphoreGive(s_notes_lock);
+}
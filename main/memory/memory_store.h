@@ -2,6 +2,7 @@
 
 #include "esp_err.h"
 #include <stddef.h>
+#include <stdint.h>
 
 /**
  * Initialize memory store. Ensures SPIFFS directories exist.
@@ -25,7 +26,45 @@ esp_err_t memory_write_long_term(const char *content);
 esp_err_t memory_append_today(const char *note);
 
 /**
- * Read recent daily memories (last N days) into buffer.
- * @param days  Number of days to look back (default 3)
+ * How far back the "recent notes" block reaches, newest tier first:
+ * daily notes copied verbatim, then per-day summaries, then weekly and
+ * monthly rollup files. Each tier picks up where the previous one stopped.
  */
-esp_err_t memory_read_recent(char *buf, size_t size, int days);
+typedef struct {
+    uint8_t full_days;      /* today (and days before it) verbatim */
+    uint8_t summary_days;   /* days, counting today, covered by verbatim or summary */
+    uint8_t weeks;          /* completed weeks from rollups, at least */
+    uint8_t months;         /* completed months from rollups */
+} memory_notes_policy_t;
+
+/**
+ * Copy the recent notes block into buf, at most MIMI_NOTES_RECENT_BUDGET
+ * bytes. The block is assembled once and cached until a daily note
+ * changes, a rollup is written or the date rolls over.
+ */
+esp_err_t memory_read_recent(char *buf, size_t size);
+
+/** Drop the cached block if path is a daily note; stale rollups are removed. */
+void memory_notes_changed(const char *path);
+
+void memory_notes_get_policy(memory_notes_policy_t *out);
+
+/** Apply a lookback policy and save it to NVS. */
+esp_err_t memory_notes_set_policy(const memory_notes_policy_t *policy);
+
+/** Write the weekly and monthly rollups the policy needs and that are missing. */
+esp_err_t memory_rollup_run(int *written_out);
+
+/** Start the background task that writes rollups off the agent's path. */
+esp_err_t memory_rollup_start(void);
+
+typedef struct {
+    uint32_t hits;           /* reads served from the cached block */
+    uint32_t rebuilds;
+    uint32_t files_read;     /* notes and rollups opened by rebuilds */
+    uint32_t last_build_us;
+    uint32_t block_bytes;
+    uint32_t rollups_written;
+} memory_notes_stats_t;
+
+void memory_notes_get_stats(memory_notes_stats_t *out);
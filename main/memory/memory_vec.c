@@ -0,0 +1,599 @@
+#include "memory_vec.h"
+#include "memory_index.h"
+#include "mimi_config.h"
+#include "proxy/http_proxy.h"
+#include "storage/storage_fs.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_heap_caps.h"
+#include "esp_http_client.h"
+#include "esp_crt_bundle.h"
+#include "nvs.h"
+#include "cJSON.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#if __has_include("sdkconfig.h")
+#include "sdkconfig.h"
+#endif
+
+static const char *TAG = "mem_vec";
+
+#define VEC_MAGIC       0x4345564D   /* "MVEC" */
+#define VEC_VERSION     1
+#define VEC_ALIGN       16
+#define VEC_ROW_DISK    (sizeof(uint32_t) + sizeof(float) + MIMI_VEC_DIM)
+#define VEC_RESP_SIZE   (16 * 1024)
+
+_Static_assert(MIMI_VEC_DIM % VEC_ALIGN == 0, "MIMI_VEC_DIM must be a multiple of 16");
+
+typedef struct {
+    uint32_t magic;
+    uint8_t  version;
+    uint8_t  backend;
+    uint16_t dim;
+} vec_header_t;
+
+static SemaphoreHandle_t s_lock = NULL;
+static memory_vec_backend_t s_backend = MIMI_VEC_BACKEND_DEFAULT;
+static char s_url[160] = MIMI_EMBED_DEFAULT_URL;
+static char s_model[64] = MIMI_EMBED_DEFAULT_MODEL;
+static char s_api_key[160] = {0};
+
+/* Rows live in one 16-byte aligned block so the scan streams through it */
+static void     *s_rows_raw = NULL;
+static int8_t   *s_rows = NULL;
+static uint32_t *s_keys = NULL;
+static float    *s_scales = NULL;
+static uint32_t  s_count = 0, s_cap = 0, s_saved = 0;
+static uint32_t *s_slots = NULL;      /* key -> row + 1, open addressing */
+static uint32_t  s_slot_cap = 0;
+
+static uint32_t s_scans = 0, s_last_scan_us = 0, s_embeds = 0, s_embed_failures = 0;
+
+/* ── Dot product ─────────────────────────────────────────────── */
+
+#if defined(CONFIG_IDF_TARGET_ESP32S3) && defined(__XTENSA__)
+/*
+ * PIE: each EE.VMULAS.S8.ACCX multiplies 16 int8 lanes and adds them into
+ * the 40-bit ACCX accumulator. Operands must be 16-byte aligned and n a
+ * multiple of 16; MIMI_VEC_DIM lanes of +-127 cannot overflow 32 bits.
+ */
+int32_t memory_vec_dot(const int8_t *a, const int8_t *b, size_t n)
+{
+    int32_t acc;
+    uint32_t blocks = n / 16;
+    __asm__ volatile(
+        "ee.zero.accx\n"
+        "loopnez %3, 1f\n"
+        "ee.vld.128.ip q0, %1, 16\n"
+        "ee.vld.128.ip q1, %2, 16\n"
+        "ee.vmulas.s8.accx q0, q1\n"
+        "1:\n"
+        "rur.accx_0 %0\n"
+        : "=r"(acc), "+r"(a), "+r"(b)
+        : "r"(blocks)
+        : "memory");
+    return acc;
+}
+#else
+int32_t memory_vec_dot(const int8_t *a, const int8_t *b, size_t n)
+{
+    /* Plain enough for the host compiler to vectorise */
+    int32_t acc = 0;
+    for (size_t i = 0; i < n; i++) acc += (int32_t)a[i] * (int32_t)b[i];
+    return acc;
+}
+#endif
+
+/* ── Local embedder ──────────────────────────────────────────── */
+
+/*
+ * Feature hashing: every word and the character trigrams of longer words
+ * land in a signed bucket. Inflections and typos still share most
+ * trigrams, so "irrigating" finds "irrigation"; true synonyms need the
+ * remote backend.
+ */
+typedef struct {
+    float *v;
+} feat_ctx_t;
+
+static uint32_t feat_hash(const char *s, size_t n, uint32_t seed)
+{
+    uint32_t h = 2166136261u ^ seed;
+    for (size_t i = 0; i < n; i++) {
+        h ^= (uint8_t)s[i];
+        h *= 16777619u;
+    }
+    h ^= h >> 15;
+    h *= 0x2C1B3C6Du;
+    h ^= h >> 12;
+    return h;
+}
+
+static void feat_add(float *v, uint32_t h, float w)
+{
+    v[h % MIMI_VEC_DIM] += (h & 0x80000000u) ? -w : w;
+}
+
+static void collect_features(const char *tok, size_t n, void *arg)
+{
+    feat_ctx_t *ctx = arg;
+    feat_add(ctx->v, feat_hash(tok, n, 1), 0.5f);
+
+    if (n >= 4 && (unsigned char)tok[0] < 0x80) {
+        /* A word's trigrams together outweigh the exact word, so shared stems count */
+        char padded[34];
+        size_t m = n < 32 ? n : 32;
+        padded[0] = '^';
+        memcpy(padded + 1, tok, m);
+        padded[m + 1] = '$';
+        float w = 1.0f / sqrtf((float)m);
+        for (size_t i = 0; i + 3 <= m + 2; i++) {
+            feat_add(ctx->v, feat_hash(padded + i, 3, 3), w);
+        }
+    }
+}
+
+static esp_err_t embed_local(const char *text, size_t len, float *v)
+{
+    feat_ctx_t ctx = { .v = v };
+    memory_index_tokenize(text, len, collect_features, &ctx);
+    return ESP_OK;
+}
+
+/* ── Remote embedder ─────────────────────────────────────────── */
+
+typedef struct {
+    char *data;
+    size_t len;
+    size_t cap;
+} resp_buf_t;
+
+static esp_err_t http_event_handler(esp_http_client_event_t *evt)
+{
+    resp_buf_t *rb = (resp_buf_t *)evt->user_data;
+    if (evt->event_id == HTTP_EVENT_ON_DATA) {
+        if (rb->len + evt->data_len < rb->cap) {
+            memcpy(rb->data + rb->len, evt->data, evt->data_len);
+            rb->len += evt->data_len;
+            rb->data[rb->len] = '\0';
+        }
+    }
+    return ESP_OK;
+}
+
+static char *build_embed_payload(const char *text, size_t len)
+{
+    char *input = heap_caps_malloc(len + 1, MALLOC_CAP_SPIRAM);
+    if (!input) return NULL;
+    memcpy(input, text, len);
+    input[len] = '\0';
+
+    cJSON *req = cJSON_CreateObject();
+    cJSON_AddStringToObject(req, "model", s_model);
+    cJSON_AddStringToObject(req, "input", input);
+    cJSON_AddNumberToObject(req, "dimensions", MIMI_VEC_DIM);
+    char *payload = cJSON_PrintUnformatted(req);
+    cJSON_Delete(req);
+    free(input);
+    return payload;
+}
+
+static esp_err_t embed_remote(const char *text, size_t len, float *v)
+{
+    if (!s_api_key[0]) return ESP_ERR_INVALID_STATE;
+    if (http_proxy_is_enabled()) {
+        /* The CONNECT tunnel in http_proxy only serves the fixed upstreams */
+        ESP_LOGW(TAG, "Remote embeddings are not routed through the proxy");
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+
+    char *payload = build_embed_payload(text, len);
+    resp_buf_t rb = { .data = heap_caps_malloc(VEC_RESP_SIZE, MALLOC_CAP_SPIRAM),
+                      .len = 0, .cap = VEC_RESP_SIZE };
+    if (!payload || !rb.data) {
+        free(payload);
+        free(rb.data);
+        return ESP_ERR_NO_MEM;
+    }
+    rb.data[0] = '\0';
+
+    esp_http_client_config_t config = {
+        .url = s_url,
+        .event_handler = http_event_handler,
+        .user_data = &rb,
+        .timeout_ms = 15000,
+        .buffer_size = 4096,
+        .crt_bundle_attach = esp_crt_bundle_attach,
+    };
+    esp_http_client_handle_t client = esp_http_client_init(&config);
+    if (!client) {
+        free(payload);
+        free(rb.data);
+        return ESP_FAIL;
+    }
+    esp_http_client_set_method(client, HTTP_METHOD_POST);
+    esp_http_client_set_header(client, "Content-Type", "application/json");
+    char auth[192];
+    snprintf(auth, sizeof(auth), "Bearer %s", s_api_key);
+    esp_http_client_set_header(client, "Authorization", auth);
+    esp_http_client_set_post_field(client, payload, strlen(payload));
+
+    esp_err_t err = esp_http_client_perform(client);
+    int status = esp_http_client_get_status_code(client);
+    esp_http_client_cleanup(client);
+    free(payload);
+
+    if (err == ESP_OK && status != 200) {
+        ESP_LOGE(TAG, "Embeddings API returned %d", status);
+        err = ESP_FAIL;
+    }
+    if (err == ESP_OK) {
+        /* {"data":[{"embedding":[...]}]}; longer vectors are truncated and renormalised */
+        cJSON *root = cJSON_Parse(rb.data);
+        cJSON *emb = cJSON_GetObjectItem(cJSON_GetArrayItem(cJSON_GetObjectItem(root, "data"), 0),
+                                         "embedding");
+        if (!cJSON_IsArray(emb) || cJSON_GetArraySize(emb) < MIMI_VEC_DIM) {
+            ESP_LOGE(TAG, "Embeddings response has no %d-dim vector", MIMI_VEC_DIM);
+            err = ESP_ERR_INVALID_RESPONSE;
+        } else {
+            int i = 0;
+            cJSON *x;
+            cJSON_ArrayForEach(x, emb) {
+                if (i == MIMI_VEC_DIM) break;
+                v[i++] = (float)x->valuedouble;
+            }
+        }
+        cJSON_Delete(root);
+    }
+    free(rb.data);
+    return err;
+}
+
+esp_err_t memory_vec_embed(const char *text, size_t len, int8_t *out, float *scale)
+{
+    float *v = heap_caps_calloc(MIMI_VEC_DIM, sizeof(float), MALLOC_CAP_SPIRAM);
+    if (!v) return ESP_ERR_NO_MEM;
+
+    esp_err_t err;
+    switch (s_backend) {
+    case MEMORY_VEC_LOCAL:  err = embed_local(text, len, v); break;
+    case MEMORY_VEC_REMOTE: err = embed_remote(text, len, v); break;
+    default:                err = ESP_ERR_INVALID_STATE; break;
+    }
+
+    float norm = 0.0f, peak = 0.0f;
+    for (int i = 0; i < MIMI_VEC_DIM; i++) norm += v[i] * v[i];
+    norm = sqrtf(norm);
+    if (err == ESP_OK && norm == 0.0f) err = ESP_ERR_NOT_FOUND;   /* no tokens */
+
+    if (err == ESP_OK) {
+        for (int i = 0; i < MIMI_VEC_DIM; i++) {
+            v[i] /= norm;
+            if (fabsf(v[i]) > peak) peak = fabsf(v[i]);
+        }
+        *scale = peak / 127.0f;
+        for (int i = 0; i < MIMI_VEC_DIM; i++) out[i] = (int8_t)lrintf(v[i] / *scale);
+    }
+    free(v);
+
+    if (s_lock) xSemaphoreTake(s_lock, portMAX_DELAY);
+    if (err == ESP_OK) s_embeds++;
+    else if (err != ESP_ERR_NOT_FOUND) s_embed_failures++;
+    if (s_lock) xSemaphoreGive(s_lock);
+    return err;
+}
+
+/* ── Store ───────────────────────────────────────────────────── */
+
+static int slot_find(uint32_t key)
+{
+    if (!s_slot_cap) return -1;
+    uint32_t mask = s_slot_cap - 1;
+    for (uint32_t i = key & mask;; i = (i + 1) & mask) {
+        if (!s_slots[i]) return -1;
+        if (s_keys[s_slots[i] - 1] == key) return (int)(s_slots[i] - 1);
+    }
+}
+
+static void slots_rebuild(uint32_t cap)
+{
+    uint32_t *slots = heap_caps_calloc(cap, sizeof(uint32_t), MALLOC_CAP_SPIRAM);
+    if (!slots) return;
+    free(s_slots);
+    s_slots = slots;
+    s_slot_cap = cap;
+    for (uint32_t r = 0; r < s_count; r++) {
+        uint32_t i = s_keys[r] & (cap - 1);
+        while (s_slots[i]) i = (i + 1) & (cap - 1);
+        s_slots[i] = r + 1;
+    }
+}
+
+static bool reserve(uint32_t need)
+{
+    if (need <= s_cap) return true;
+    uint32_t cap = s_cap ? s_cap * 2 : 256;
+    while (cap < need) cap *= 2;
+
+    void *raw = heap_caps_malloc((size_t)cap * MIMI_VEC_DIM + VEC_ALIGN, MALLOC_CAP_SPIRAM);
+    uint32_t *keys = heap_caps_realloc(s_keys, cap * sizeof(uint32_t), MALLOC_CAP_SPIRAM);
+    if (keys) s_keys = keys;
+    float *scales = heap_caps_realloc(s_scales, cap * sizeof(float), MALLOC_CAP_SPIRAM);
+    if (scales) s_scales = scales;
+    if (!raw || !keys || !scales) {
+        free(raw);
+        return false;
+    }
+    int8_t *rows = (int8_t *)(((uintptr_t)raw + VEC_ALIGN - 1) & ~(uintptr_t)(VEC_ALIGN - 1));
+    if (s_count) memcpy(rows, s_rows, (size_t)s_count * MIMI_VEC_DIM);
+    free(s_rows_raw);
+    s_rows_raw = raw;
+    s_rows = rows;
+    s_cap = cap;
+    slots_rebuild(cap * 2);
+    return true;
+}
+
+static bool add_row(uint32_t key, const int8_t *vec, float scale)
+{
+    if (!reserve(s_count + 1)) return false;
+    uint32_t r = s_count++;
+    s_keys[r] = key;
+    s_scales[r] = scale;
+    memcpy(s_rows + (size_t)r * MIMI_VEC_DIM, vec, MIMI_VEC_DIM);
+    uint32_t i = key & (s_slot_cap - 1);
+    while (s_slots[i]) i = (i + 1) & (s_slot_cap - 1);
+    s_slots[i] = r + 1;
+    return true;
+}
+
+static void store_clear(void)
+{
+    s_count = s_saved = 0;
+    if (s_slots) memset(s_slots, 0, s_slot_cap * sizeof(uint32_t));
+}
+
+static bool write_header(FILE *f)
+{
+    vec_header_t hdr = { VEC_MAGIC, VEC_VERSION, (uint8_t)s_backend, MIMI_VEC_DIM };
+    return fwrite(&hdr, sizeof(hdr), 1, f) == 1;
+}
+
+static bool write_rows(FILE *f, uint32_t from)
+{
+    for (uint32_t r = from; r < s_count; r++) {
+        if (fwrite(&s_keys[r], sizeof(uint32_t), 1, f) != 1 ||
+            fwrite(&s_scales[r], sizeof(float), 1, f) != 1 ||
+            fwrite(s_rows + (size_t)r * MIMI_VEC_DIM, 1, MIMI_VEC_DIM, f) != MIMI_VEC_DIM) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/* Rewrite the whole file; caller holds s_lock */
+static esp_err_t store_rewrite(void)
+{
+    FILE *f = storage_open(MIMI_VEC_FILE, "w");
+    if (!f) return ESP_FAIL;
+    bool ok = write_header(f) && write_rows(f, 0);
+    fclose(f);
+    if (!ok) return ESP_FAIL;
+    s_saved = s_count;
+    return ESP_OK;
+}
+
+static void store_load(void)
+{
+    FILE *f = storage_open(MIMI_VEC_FILE, "r");
+    if (!f) return;
+
+    vec_header_t hdr;
+    if (fread(&hdr, sizeof(hdr), 1, f) != 1 || hdr.magic != VEC_MAGIC ||
+        hdr.version != VEC_VERSION || hdr.dim != MIMI_VEC_DIM || hdr.backend != s_backend) {
+        fclose(f);
+        ESP_LOGW(TAG, "%s is for another backend or layout, discarding", MIMI_VEC_FILE);
+        storage_remove(MIMI_VEC_FILE);
+        return;
+    }
+
+    int8_t vec[MIMI_VEC_DIM];
+    uint32_t key;
+    float scale;
+    while (fread(&key, sizeof(key), 1, f) == 1 && fread(&scale, sizeof(scale), 1, f) == 1 &&
+           fread(vec, 1, MIMI_VEC_DIM, f) == MIMI_VEC_DIM) {
+        if (slot_find(key) < 0 && !add_row(key, vec, scale)) break;
+    }
+    fclose(f);
+    s_saved = s_count;
+}
+
+/* ── Public API ──────────────────────────────────────────────── */
+
+esp_err_t memory_vec_init(void)
+{
+    if (!s_lock) s_lock = xSemaphoreCreateMutex();
+    if (!s_lock) return ESP_ERR_NO_MEM;
+
+    nvs_handle_t nvs;
+    if (nvs_open(MIMI_NVS_EMBED, NVS_READONLY, &nvs) == ESP_OK) {
+        uint8_t backend = 0;
+        if (nvs_get_u8(nvs, MIMI_NVS_KEY_EMBED_BACKEND, &backend) == ESP_OK &&
+            backend <= MEMORY_VEC_REMOTE) {
+            s_backend = (memory_vec_backend_t)backend;
+        }
+        size_t len = sizeof(s_url);
+        nvs_get_str(nvs, MIMI_NVS_KEY_EMBED_URL, s_url, &len);
+        len = sizeof(s_model);
+        nvs_get_str(nvs, MIMI_NVS_KEY_MODEL, s_model, &len);
+        len = sizeof(s_api_key);
+        nvs_get_str(nvs, MIMI_NVS_KEY_API_KEY, s_api_key, &len);
+        nvs_close(nvs);
+    }
+
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    store_clear();
+    if (s_backend != MEMORY_VEC_OFF) store_load();
+    xSemaphoreGive(s_lock);
+
+    ESP_LOGI(TAG, "Vector memory: backend=%s, %lu vectors of %d dims",
+             memory_vec_backend_name(s_backend), (unsigned long)s_count, MIMI_VEC_DIM);
+    return ESP_OK;
+}
+
+memory_vec_backend_t memory_vec_backend(void)
+{
+    return s_backend;
+}
+
+const char *memory_vec_backend_name(memory_vec_backend_t backend)
+{
+    switch (backend) {
+    case MEMORY_VEC_LOCAL:  return "local";
+    case MEMORY_VEC_REMOTE: return "remote";
+    default:                return "off";
+    }
+}
+
+esp_err_t memory_vec_set_backend(memory_vec_backend_t backend, const char *api_key,
+                                 const char *url, const char *model)
+{
+    if (backend > MEMORY_VEC_REMOTE) return ESP_ERR_INVALID_ARG;
+
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    s_backend = backend;
+    if (api_key) snprintf(s_api_key, sizeof(s_api_key), "%s", api_key);
+    if (url) snprintf(s_url, sizeof(s_url), "%s", url);
+    if (model) snprintf(s_model, sizeof(s_model), "%s", model);
+    store_clear();
+    storage_remove(MIMI_VEC_FILE);
+    xSemaphoreGive(s_lock);
+
+    nvs_handle_t nvs;
+    esp_err_t err = nvs_open(MIMI_NVS_EMBED, NVS_READWRITE, &nvs);
+    if (err == ESP_OK) {
+        nvs_set_u8(nvs, MIMI_NVS_KEY_EMBED_BACKEND, (uint8_t)backend);
+        if (api_key) nvs_set_str(nvs, MIMI_NVS_KEY_API_KEY, api_key);
+        if (url) nvs_set_str(nvs, MIMI_NVS_KEY_EMBED_URL, url);
+        if (model) nvs_set_str(nvs, MIMI_NVS_KEY_MODEL, model);
+        err = nvs_commit(nvs);
+        nvs_close(nvs);
+    }
+    ESP_LOGI(TAG, "Embedding backend set to %s", memory_vec_backend_name(backend));
+    return err;
+}
+
+bool memory_vec_has(uint32_t key)
+{
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    bool found = slot_find(key) >= 0;
+    xSemaphoreGive(s_lock);
+    return found;
+}
+
+esp_err_t memory_vec_put(uint32_t key, const int8_t *vec, float scale)
+{
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    bool ok = slot_find(key) >= 0 || add_row(key, vec, scale);
+    xSemaphoreGive(s_lock);
+    return ok ? ESP_OK : ESP_ERR_NO_MEM;
+}
+
+esp_err_t memory_vec_flush(void)
+{
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    esp_err_t err = ESP_OK;
+    if (s_saved < s_count) {
+        FILE *f = storage_open(MIMI_VEC_FILE, s_saved ? "a" : "w");
+        bool ok = f && (s_saved || write_header(f)) && write_rows(f, s_saved);
+        if (f) fclose(f);
+        if (ok) {
+            s_saved = s_count;
+        } else {
+            ESP_LOGE(TAG, "Cannot write %s", MIMI_VEC_FILE);
+            err = ESP_FAIL;
+        }
+    }
+    xSemaphoreGive(s_lock);
+    return err;
+}
+
+static int cmp_u32(const void *a, const void *b)
+{
+    uint32_t x = *(const uint32_t *)a, y = *(const uint32_t *)b;
+    return x < y ? -1 : x > y;
+}
+
+void memory_vec_retain(const uint32_t *live, size_t count)
+{
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    uint32_t kept = 0;
+    for (uint32_t r = 0; r < s_count; r++) {
+        if (!bsearch(&s_keys[r], live, count, sizeof(uint32_t), cmp_u32)) continue;
+        if (kept != r) {
+            s_keys[kept] = s_keys[r];
+            s_scales[kept] = s_scales[r];
+            memcpy(s_rows + (size_t)kept * MIMI_VEC_DIM, s_rows + (size_t)r * MIMI_VEC_DIM,
+                   MIMI_VEC_DIM);
+        }
+        kept++;
+    }
+    if (kept < s_count) {
+        ESP_LOGI(TAG, "Dropping %lu vectors of removed paragraphs",
+                 (unsigned long)(s_count - kept));
+        s_count = kept;
+        slots_rebuild(s_slot_cap);
+        if (store_rewrite() != ESP_OK) s_saved = 0;
+    }
+    xSemaphoreGive(s_lock);
+}
+
+int memory_vec_scan(const int8_t *query, float scale, memory_vec_hit_t *hits, int k)
+{
+    int64_t t0 = esp_timer_get_time();
+    int n = 0;
+    float min_cosine = s_backend == MEMORY_VEC_REMOTE ? MIMI_VEC_MIN_COSINE_REMOTE
+                                                     : MIMI_VEC_MIN_COSINE_LOCAL;
+
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    const int8_t *row = s_rows;
+    for (uint32_t r = 0; r < s_count; r++, row += MIMI_VEC_DIM) {
+        float cosine = (float)memory_vec_dot(query, row, MIMI_VEC_DIM) * scale * s_scales[r];
+        if (cosine < min_cosine) continue;
+        if (n == k && cosine <= hits[n - 1].cosine) continue;
+        int pos = n < k ? n++ : n - 1;
+        while (pos > 0 && hits[pos - 1].cosine < cosine) {
+            hits[pos] = hits[pos - 1];
+            pos--;
+        }
+        hits[pos] = (memory_vec_hit_t) { .key = s_keys[r], .cosine = cosine };
+    }
+    s_scans++;
+    s_last_scan_us = (uint32_t)(esp_timer_get_time() - t0);
+    xSemaphoreGive(s_lock);
+    return n;
+}
+
+void memory_vec_get_stats(memory_vec_stats_t *out)
+{
+    memset(out, 0, sizeof(*out));
+    out->backend = s_backend;
+    if (!s_lock) return;
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    out->vectors = s_count;
+    out->unsaved = s_count - s_saved;
+    out->scans = s_scans;
+    out->last_scan_us = s_last_scan_us;
+    out->embeds = s_embeds;
+    out->embed_failures = s_embed_failures;
+    out->flash_bytes = s_saved ? sizeof(vec_header_t) + (size_t)s_saved * VEC_ROW_DISK : 0;
+    out->psram_bytes = (size_t)s_cap * (MIMI_VEC_DIM + sizeof(uint32_t) + sizeof(float)) +
+                       VEC_ALIGN + (size_t)s_slot_cap * sizeof(uint32_t);
+    xSemaphoreGive(s_lock);
+}
@@ -0,0 +1,82 @@
+#pragma once
+
+#include "esp_err.h"
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+ * Flat int8 vector store for memory paragraphs, persisted as
+ * MIMI_VEC_FILE and scanned linearly in PSRAM. Vectors are unit-length
+ * before quantisation, so dot products approximate cosine similarity.
+ * Rows are keyed by a hash of the paragraph text, so a paragraph is
+ * embedded once however often its file is rewritten.
+ */
+
+typedef enum {
+    MEMORY_VEC_OFF = 0,     /* keyword ranking only */
+    MEMORY_VEC_LOCAL,       /* hashed word / n-gram features, on the CPU */
+    MEMORY_VEC_REMOTE,      /* OpenAI-compatible /embeddings endpoint */
+} memory_vec_backend_t;
+
+typedef struct {
+    uint32_t key;
+    float    cosine;
+} memory_vec_hit_t;
+
+/** Load the backend config from NVS and the stored vectors from flash. */
+esp_err_t memory_vec_init(void);
+
+memory_vec_backend_t memory_vec_backend(void);
+const char *memory_vec_backend_name(memory_vec_backend_t backend);
+
+/**
+ * Switch backends and drop every stored vector, since vectors from
+ * different models are not comparable. NULL strings keep the saved value.
+ */
+esp_err_t memory_vec_set_backend(memory_vec_backend_t backend, const char *api_key,
+                                 const char *url, const char *model);
+
+/**
+ * Embed text with the current backend into MIMI_VEC_DIM int8 lanes.
+ * The remote backend blocks on the network; call it off the agent's lock.
+ */
+esp_err_t memory_vec_embed(const char *text, size_t len, int8_t *out, float *scale);
+
+bool memory_vec_has(uint32_t key);
+
+/** Add a row in PSRAM; it reaches flash on the next memory_vec_flush(). */
+esp_err_t memory_vec_put(uint32_t key, const int8_t *vec, float scale);
+
+/** Append rows added since the last flush to MIMI_VEC_FILE. */
+esp_err_t memory_vec_flush(void);
+
+/**
+ * Drop rows whose key is not in live (sorted ascending) and rewrite the
+ * file if any went.
+ */
+void memory_vec_retain(const uint32_t *live, size_t count);
+
+/**
+ * Best k rows by cosine against an embedded query, highest first, skipping
+ * those under the backend's MIMI_VEC_MIN_COSINE_*. query must be 16-byte
+ * aligned.
+ */
+int memory_vec_scan(const int8_t *query, float scale, memory_vec_hit_t *hits, int k);
+
+/** int8 dot product; PIE vector instructions on the ESP32-S3. */
+int32_t memory_vec_dot(const int8_t *a, const int8_t *b, size_t n);
+
+typedef struct {
+    memory_vec_backend_t backend;
+    uint32_t vectors;
+    uint32_t unsaved;
+    uint32_t scans;
+    uint32_t last_scan_us;
+    uint32_t embeds;
+    uint32_t embed_failures;
+    size_t   flash_bytes;
+    size_t   psram_bytes;
+} memory_vec_stats_t;
+
+void memory_vec_get_stats(memory_vec_stats_t *out);
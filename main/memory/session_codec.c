@@ -0,0 +1,285 @@
+#include "session_codec.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include "esp_heap_caps.h"
+
+/* ── LZ codec ────────────────────────────────────────────────── */
+
+/*
+ * Token stream: a flag byte covers the next 8 items, LSB first. A 0 bit is
+ * one literal byte; a 1 bit is a match of two bytes, 12-bit (offset - 1)
+ * then a 4-bit (length - 3) nibble, where nibble 15 is followed by one
+ * extra length byte.
+ */
+#define LZ_WINDOW      4096
+#define LZ_MIN_MATCH   3
+#define LZ_MAX_MATCH   (LZ_MIN_MATCH + 15 + 255)
+#define LZ_MIN_INPUT   32
+#define LZ_HASH_BITS   12
+#define LZ_EMPTY       0xFFFF
+
+static inline uint32_t lz_hash(const uint8_t *p)
+{
+    uint32_t v = (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16);
+    return (v * 2654435761u) >> (32 - LZ_HASH_BITS);
+}
+
+size_t session_lz_compress(const uint8_t *src, size_t len, uint8_t *dst, size_t cap)
+{
+    if (len < LZ_MIN_INPUT || len >= LZ_EMPTY) return 0;
+    if (cap > len - 1) cap = len - 1;
+
+    uint16_t *head = heap_caps_malloc(sizeof(uint16_t) << LZ_HASH_BITS, MALLOC_CAP_SPIRAM);
+    if (!head) return 0;
+    memset(head, 0xFF, sizeof(uint16_t) << LZ_HASH_BITS);
+
+    size_t ip = 0, op = 0, flag_pos = 0;
+    int bit = 8;
+    while (ip < len) {
+        if (bit == 8) {
+            if (op >= cap) goto fail;
+            flag_pos = op++;
+            dst[flag_pos] = 0;
+            bit = 0;
+        }
+
+        size_t match_len = 0, match_off = 0;
+        if (ip + LZ_MIN_MATCH <= len) {
+            uint32_t h = lz_hash(src + ip);
+            uint16_t cand = head[h];
+            head[h] = (uint16_t)ip;
+            if (cand != LZ_EMPTY && ip - cand <= LZ_WINDOW) {
+                size_t max = len - ip < LZ_MAX_MATCH ? len - ip : LZ_MAX_MATCH;
+                size_t n = 0;
+                while (n < max && src[cand + n] == src[ip + n]) n++;
+                if (n >= LZ_MIN_MATCH) {
+                    match_len = n;
+                    match_off = ip - cand;
+                }
+            }
+        }
+
+        if (match_len) {
+            size_t code = match_len - LZ_MIN_MATCH;
+            if (op + (code >= 15 ? 3 : 2) > cap) goto fail;
+            dst[flag_pos] |= (uint8_t)(1u << bit);
+            dst[op++] = (uint8_t)((match_off - 1) >> 4);
+            dst[op++] = (uint8_t)(((match_off - 1) & 0xF) << 4 | (code < 15 ? code : 15));
+            if (code >= 15) dst[op++] = (uint8_t)(code - 15);
+            for (size_t k = 1; k < match_len && ip + k + LZ_MIN_MATCH <= len; k++) {
+                head[lz_hash(src + ip + k)] = (uint16_t)(ip + k);
+            }
+            ip += match_len;
+        } else {
+            if (op >= cap) goto fail;
+            dst[op++] = src[ip++];
+        }
+        bit++;
+    }
+    free(head);
+    return op;
+
+fail:
+    free(head);
+    return 0;
+}
+
+bool session_lz_decompress(const uint8_t *src, size_t len, uint8_t *dst, size_t out_len)
+{
+    size_t ip = 0, op = 0;
+    while (op < out_len) {
+        if (ip >= len) return false;
+        uint8_t flags = src[ip++];
+        for (int bit = 0; bit < 8 && op < out_len; bit++) {
+            if (!(flags & (1u << bit))) {
+                if (ip >= len) return false;
+                dst[op++] = src[ip++];
+                continue;
+            }
+            if (ip + 2 > len) return false;
+            size_t off = ((size_t)src[ip] << 4 | src[ip + 1] >> 4) + 1;
+            size_t n = (src[ip + 1] & 0xF) + LZ_MIN_MATCH;
+            ip += 2;
+            if (n == LZ_MIN_MATCH + 15) {
+                if (ip >= len) return false;
+                n += src[ip++];
+            }
+            if (off > op || n > out_len - op) return false;
+            if (off >= n) {
+                memcpy(dst + op, dst + op - off, n);
+                op += n;
+            } else {
+                for (size_t k = 0; k < n; k++, op++) {
+                    dst[op] = dst[op - off];
+                }
+            }
+        }
+    }
+    return ip == len;
+}
+
+/* ── Records ─────────────────────────────────────────────────── */
+
+static const char *s_role_names[] = { "user", "assistant", "system", "tool" };
+
+session_role_t session_role_from_name(const char *name)
+{
+    for (int i = 0; i < 4; i++) {
+        if (strcmp(name, s_role_names[i]) == 0) return (session_role_t)i;
+    }
+    return SESSION_ROLE_USER;
+}
+
+const char *session_role_name(session_role_t role)
+{
+    return s_role_names[role & 3];
+}
+
+static size_t put_varint(uint8_t *p, uint64_t v)
+{
+    size_t n = 0;
+    while (v >= 0x80) {
+        p[n++] = (uint8_t)(v | 0x80);
+        v >>= 7;
+    }
+    p[n++] = (uint8_t)v;
+    return n;
+}
+
+static bool get_varint(const uint8_t *p, size_t len, size_t *pos, uint64_t *out)
+{
+    uint64_t v = 0;
+    for (int shift = 0; shift < 64 && *pos < len; shift += 7) {
+        uint8_t b = p[(*pos)++];
+        v |= (uint64_t)(b & 0x7F) << shift;
+        if (!(b & 0x80)) {
+            *out = v;
+            return true;
+        }
+    }
+    return false;
+}
+
+size_t session_rec_encode(uint8_t *out, size_t cap, session_role_t role, int64_t ts,
+                          const char *content, size_t len, bool compress)
+{
+    if (cap < len + SESSION_REC_MAX_OVERHEAD) return 0;
+
+    uint8_t *packed = NULL;
+    size_t packed_len = 0;
+    if (compress && len >= LZ_MIN_INPUT) {
+        packed = heap_caps_malloc(len, MALLOC_CAP_SPIRAM);
+        if (packed) packed_len = session_lz_compress((const uint8_t *)content, len, packed, len);
+    }
+
+    size_t w = 0;
+    out[w++] = SESSION_REC_MAGIC;
+    out[w++] = (uint8_t)((role & 3) | (packed_len ? 0x04 : 0));
+    w += put_varint(out + w, ts > 0 ? (uint64_t)ts : 0);
+    w += put_varint(out + w, len);
+    if (packed_len) {
+        w += put_varint(out + w, packed_len);
+        memcpy(out + w, packed, packed_len);
+        w += packed_len;
+    } else {
+        w += put_varint(out + w, len);
+        memcpy(out + w, content, len);
+        w += len;
+    }
+    free(packed);
+
+    size_t total = w + SESSION_REC_TRAILER_LEN;
+    out[w++] = (uint8_t)total;
+    out[w++] = (uint8_t)(total >> 8);
+    out[w++] = (uint8_t)(total >> 16);
+    out[w++] = SESSION_REC_TRAILER_MAGIC;
+    return w;
+}
+
+size_t session_rec_trailer(const uint8_t tail[SESSION_REC_TRAILER_LEN])
+{
+    if (tail[3] != SESSION_REC_TRAILER_MAGIC) return 0;
+    return (size_t)tail[0] | ((size_t)tail[1] << 8) | ((size_t)tail[2] << 16);
+}
+
+bool session_rec_parse(const uint8_t *rec, size_t len, session_rec_t *out)
+{
+    if (len < 5 + SESSION_REC_TRAILER_LEN || rec[0] != SESSION_REC_MAGIC ||
+        session_rec_trailer(rec + len - SESSION_REC_TRAILER_LEN) != len) {
+        return false;
+    }
+    size_t body_end = len - SESSION_REC_TRAILER_LEN;
+    size_t pos = 2;
+    uint64_t ts, content_len, payload_len;
+    if (!get_varint(rec, body_end, &pos, &ts) ||
+        !get_varint(rec, body_end, &pos, &content_len) ||
+        !get_varint(rec, body_end, &pos, &payload_len) ||
+        payload_len != body_end - pos) {
+        return false;
+    }
+    out->role = (session_role_t)(rec[1] & 3);
+    out->compressed = (rec[1] & 0x04) != 0;
+    out->ts = (int64_t)ts;
+    out->content_len = (size_t)content_len;
+    out->payload = rec + pos;
+    out->payload_len = (size_t)payload_len;
+    return out->compressed || out->payload_len == out->content_len;
+}
+
+bool session_rec_content(const session_rec_t *rec, char *dst)
+{
+    if (rec->compressed) {
+        if (!session_lz_decompress(rec->payload, rec->payload_len,
+                                   (uint8_t *)dst, rec->content_len)) {
+            return false;
+        }
+    } else {
+        memcpy(dst, rec->payload, rec->content_len);
+    }
+    dst[rec->content_len] = '\0';
+    return true;
+}
+
+size_t session_rec_json_max(const session_rec_t *rec)
+{
+    /* Worst case every byte becomes \u00XX */
+    return rec->content_len * 6 + sizeof("{\"role\":\"assistant\",\"content\":\"\"}");
+}
+
+size_t session_rec_json(session_role_t role, const char *content, size_t content_len,
+                        char *dst, size_t cap)
+{
+    int head = snprintf(dst, cap, "{\"role\":\"%s\",\"content\":\"", session_role_name(role));
+    if (head < 0 || (size_t)head >= cap) return 0;
+
+    size_t w = (size_t)head;
+    for (size_t i = 0; i < content_len; i++) {
+        unsigned char c = (unsigned char)content[i];
+        if (w + 7 + 2 > cap) return 0;      /* longest escape + closing "} */
+        if (c == '"' || c == '\\') {
+            dst[w++] = '\\';
+            dst[w++] = (char)c;
+        } else if (c >= 32) {
+            dst[w++] = (char)c;
+        } else {
+            dst[w++] = '\\';
+            switch (c) {
+            case '\b': dst[w++] = 'b'; break;
+            case '\f': dst[w++] = 'f'; break;
+            case '\n': dst[w++] = 'n'; break;
+            case '\r': dst[w++] = 'r'; break;
+            case '\t': dst[w++] = 't'; break;
+            default:
+                w += (size_t)snprintf(dst + w, cap - w, "u%04x", c);
+                break;
+            }
+        }
+    }
+    if (w + 3 > cap) return 0;
+    dst[w++] = '"';
+    dst[w++] = '}';
+    dst[w] = '\0';
+    return w;
+}
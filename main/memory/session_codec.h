@@ -0,0 +1,90 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+ * Binary session record, the compact alternative to one JSON line:
+ *
+ *   0xA7                  record magic
+ *   u8  flags             bits 0-1 role, bit 2 payload is LZ-compressed
+ *   varint ts             unix seconds
+ *   varint content_len    decoded UTF-8 length
+ *   varint payload_len    stored length
+ *   payload
+ *   u24 record_len        whole record, little endian
+ *   0x7A                  trailer magic
+ *
+ * The trailer lets readers walk a file backwards from EOF the way they scan
+ * JSONL lines, and a torn final record fails the magic checks and is skipped.
+ *
+ * The LZ codec is LZSS with a 4 KB window and a single-probe hash, sized for
+ * per-message compression on the ESP32-S3: no dictionary survives between
+ * records, decoding needs no memory beyond the output buffer.
+ */
+
+#define SESSION_REC_MAGIC         0xA7
+#define SESSION_REC_TRAILER_MAGIC 0x7A
+#define SESSION_REC_TRAILER_LEN   4
+#define SESSION_REC_MAX_OVERHEAD  24     /* header + trailer upper bound */
+
+typedef enum {
+    SESSION_ROLE_USER = 0,
+    SESSION_ROLE_ASSISTANT,
+    SESSION_ROLE_SYSTEM,
+    SESSION_ROLE_TOOL,
+} session_role_t;
+
+typedef struct {
+    session_role_t role;
+    int64_t ts;
+    size_t content_len;         /* decoded size */
+    const uint8_t *payload;     /* points into the parsed record */
+    size_t payload_len;
+    bool compressed;
+} session_rec_t;
+
+/** Role from its API name; unknown names are stored as "user". */
+session_role_t session_role_from_name(const char *name);
+const char *session_role_name(session_role_t role);
+
+/**
+ * Encode one record into out (capacity >= len + SESSION_REC_MAX_OVERHEAD).
+ * @param compress  try LZ and keep it only when it is smaller
+ * @return record length, 0 on failure
+ */
+size_t session_rec_encode(uint8_t *out, size_t cap, session_role_t role, int64_t ts,
+                          const char *content, size_t len, bool compress);
+
+/** Validate a whole record and point out at its fields. */
+bool session_rec_parse(const uint8_t *rec, size_t len, session_rec_t *out);
+
+/**
+ * Record length announced by the 4 trailer bytes that end a record,
+ * or 0 if they are not a trailer.
+ */
+size_t session_rec_trailer(const uint8_t tail[SESSION_REC_TRAILER_LEN]);
+
+/** Decode the content into dst (content_len + 1 bytes, NUL-terminated). */
+bool session_rec_content(const session_rec_t *rec, char *dst);
+
+/** Upper bound of session_rec_json() output, NUL included. */
+size_t session_rec_json_max(const session_rec_t *rec);
+
+/**
+ * Render {"role":"...","content":"..."} exactly as cJSON prints it, so a
+ * history is byte-identical whichever format it was stored in.
+ * @return length without NUL, 0 if it does not fit in cap
+ */
+size_t session_rec_json(session_role_t role, const char *content, size_t content_len,
+                        char *dst, size_t cap);
+
+/**
+ * LZ-compress src into dst. Returns the compressed size, or 0 when the
+ * input is too small, longer than 64 KB or does not shrink below cap.
+ */
+size_t session_lz_compress(const uint8_t *src, size_t len, uint8_t *dst, size_t cap);
+
+/** Decompress exactly out_len bytes; false on malformed input. */
+bool session_lz_decompress(const uint8_t *src, size_t len, uint8_t *dst, size_t out_len);
@@ -1,136 +1,1377 @@
 #include "session_mgr.h"
+#include "session_codec.h"
 #include "mimi_config.h"
+#include "storage/storage_fs.h"
 
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
-#include <dirent.h>
 #include <time.h>
+#include <stdbool.h>
+#include <sys/stat.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
 #include "esp_log.h"
+#include "esp_heap_caps.h"
+#include "esp_timer.h"
+#include "esp_system.h"
+#include "nvs.h"
 #include "cJSON.h"
 
 static const char *TAG = "session";
 
-static void session_path(const char *chat_id, char *buf, size_t size)
+/* Serializes file layout changes: append, flush, rotate, clear and GC */
+static SemaphoreHandle_t s_seg_lock = NULL;
+
+static bool wb_flush_chat(const char *chat_id);
+
+/*
+ * On-flash segment formats, told apart by extension. session_format_t picks
+ * the one new records are written in; segments in the other format are
+ * converted when their chat is next touched.
+ */
+typedef enum {
+    SEG_JSONL = 0,
+    SEG_BIN,
+} seg_fmt_t;
+
+static const char *s_seg_ext[] = { "jsonl", "bin" };
+static session_format_t s_format = MIMI_SESSION_FORMAT_DEFAULT;
+
+static seg_fmt_t current_fmt(void)
 {
-    snprintf(buf, size, "%s/tg_%s.jsonl", MIMI_SPIFFS_SESSION_DIR, chat_id);
+    return s_format == SESSION_FORMAT_JSONL ? SEG_JSONL : SEG_BIN;
 }
 
-esp_err_t session_mgr_init(void)
+/* seq 0 is the active tg_<id>.<ext>, N the archive tg_<id>.N.<ext>;
+   false when the name does not fit in buf */
+static bool segment_path(const char *chat_id, int seq, seg_fmt_t fmt, char *buf, size_t size)
 {
-    ESP_LOGI(TAG, "Session manager initialized at %s", MIMI_SPIFFS_SESSION_DIR);
-    return ESP_OK;
+    int n;
+    if (seq > 0) {
+        n = snprintf(buf, size, "%s/tg_%s.%d.%s", MIMI_SPIFFS_SESSION_DIR, chat_id, seq, s_seg_ext[fmt]);
+    } else {
+        n = snprintf(buf, size, "%s/tg_%s.%s", MIMI_SPIFFS_SESSION_DIR, chat_id, s_seg_ext[fmt]);
+    }
+    return n >= 0 && (size_t)n < size;
 }
 
-esp_err_t session_append(const char *chat_id, const char *role, const char *content)
+static void rotate_tmp_path(const char *chat_id, char *buf, size_t size)
+{
+    snprintf(buf, size, "%s/tg_%s.tmp", MIMI_SPIFFS_SESSION_DIR, chat_id);
+}
+
+static storage_dir_t *open_session_dir(void)
+{
+    return storage_opendir(MIMI_SPIFFS_SESSION_DIR);
+}
+
+/*
+ * Split a directory entry into chat id, segment kind and format: *seq is 0
+ * for the active segment, N for archive N and -1 for a rotation or
+ * conversion left half-done in tg_<id>.tmp.
+ */
+static bool parse_segment_name(const char *d_name, char *chat_id, size_t size,
+                               int *seq, seg_fmt_t *fmt)
+{
+    const char *name = strrchr(d_name, '/');
+    name = name ? name + 1 : d_name;
+    if (strncmp(name, "tg_", 3) != 0) return false;
+
+    const char *id = name + 3;
+    size_t id_len = strlen(id);
+    *seq = 0;
+    *fmt = SEG_JSONL;
+    if (id_len > 4 && strcmp(id + id_len - 4, ".tmp") == 0) {
+        id_len -= 4;
+        *seq = -1;
+    } else {
+        size_t ext_len = 0;
+        for (int i = 0; i < 2 && !ext_len; i++) {
+            size_t n = strlen(s_seg_ext[i]);
+            if (id_len > n + 1 && id[id_len - n - 1] == '.' &&
+                strcmp(id + id_len - n, s_seg_ext[i]) == 0) {
+                ext_len = n + 1;
+                *fmt = (seg_fmt_t)i;
+            }
+        }
+        if (!ext_len) return false;
+        id_len -= ext_len;
+        size_t dot = id_len;
+        while (dot > 0 && id[dot - 1] >= '0' && id[dot - 1] <= '9') dot--;
+        if (dot > 1 && dot < id_len && id[dot - 1] == '.') {
+            *seq = atoi(id + dot);
+            id_len = dot - 1;
+        }
+    }
+    if (id_len == 0 || id_len >= size) return false;
+    memcpy(chat_id, id, id_len);
+    chat_id[id_len] = '\0';
+    return true;
+}
+
+/* ── History loading ─────────────────────────────────────────── */
+
+typedef struct {
+    long off;
+    size_t len;
+} rec_span_t;
+
+/*
+ * Scan backwards from EOF in fixed blocks and collect the spans of the last
+ * max_msgs non-empty lines, newest first. Cost depends on the size of the
+ * tail that is returned, not on the age of the conversation.
+ */
+static int scan_tail_lines(FILE *f, rec_span_t *spans, int max_msgs)
+{
+    if (fseek(f, 0, SEEK_END) != 0) return 0;
+    long size = ftell(f);
+    if (size <= 0) return 0;
+
+    char block[MIMI_SESSION_SCAN_BLOCK];
+    long pos = size;
+    long line_end = size;   /* exclusive end of the line being scanned */
+    int n = 0;
+
+    while (pos > 0 && n < max_msgs) {
+        size_t chunk = pos < (long)sizeof(block) ? (size_t)pos : sizeof(block);
+        pos -= (long)chunk;
+        if (fseek(f, pos, SEEK_SET) != 0 || fread(block, 1, chunk, f) != chunk) {
+            return n;
+        }
+        for (size_t i = chunk; i-- > 0 && n < max_msgs;) {
+            if (block[i] != '\n') continue;
+            long line_start = pos + (long)i + 1;
+            if (line_end > line_start) {
+                spans[n].off = line_start;
+                spans[n].len = (size_t)(line_end - line_start);
+                n++;
+            }
+            line_end = pos + (long)i;
+        }
+    }
+    if (pos == 0 && n < max_msgs && line_end > 0) {
+        spans[n].off = 0;
+        spans[n].len = (size_t)line_end;
+        n++;
+    }
+    return n;
+}
+
+/*
+ * Binary segments walk back record by record through the trailers. A torn
+ * final record fails the magic checks and the walk resynchronises on the
+ * previous intact trailer. spans may be NULL to only count.
+ */
+static int scan_tail_bin(FILE *f, rec_span_t *spans, int max_msgs)
+{
+    if (fseek(f, 0, SEEK_END) != 0) return 0;
+    long pos = ftell(f);
+    int n = 0;
+
+    while (pos >= SESSION_REC_TRAILER_LEN && n < max_msgs) {
+        uint8_t tail[SESSION_REC_TRAILER_LEN];
+        uint8_t magic = 0;
+        size_t len = 0;
+        if (fseek(f, pos - SESSION_REC_TRAILER_LEN, SEEK_SET) == 0 &&
+            fread(tail, 1, sizeof(tail), f) == sizeof(tail)) {
+            len = session_rec_trailer(tail);
+        }
+        if (len > SESSION_REC_TRAILER_LEN && len <= (size_t)pos &&
+            fseek(f, pos - (long)len, SEEK_SET) == 0 && fread(&magic, 1, 1, f) == 1 &&
+            magic == SESSION_REC_MAGIC) {
+            pos -= (long)len;
+            if (spans) {
+                spans[n].off = pos;
+                spans[n].len = len;
+            }
+            n++;
+        } else {
+            pos--;
+        }
+    }
+    return n;
+}
+
+static int scan_tail_records(FILE *f, seg_fmt_t fmt, rec_span_t *spans, int max_msgs)
+{
+    return fmt == SEG_BIN ? scan_tail_bin(f, spans, max_msgs)
+                          : scan_tail_lines(f, spans, max_msgs);
+}
+
+/*
+ * Cheap structural check so a line torn by a power cut cannot corrupt the
+ * spliced array: one balanced object, strings closed, nothing after it.
+ */
+static bool record_is_object(const char *p, size_t len)
+{
+    if (len < 2 || p[0] != '{' || p[len - 1] != '}') return false;
+    int depth = 0;
+    bool in_str = false;
+    for (size_t i = 0; i < len; i++) {
+        char c = p[i];
+        if (in_str) {
+            if (c == '\\') i++;
+            else if (c == '"') in_str = false;
+            continue;
+        }
+        if (c == '"') in_str = true;
+        else if (c == '{' || c == '[') depth++;
+        else if (c == '}' || c == ']') {
+            if (--depth < 0) return false;
+            if (depth == 0 && i != len - 1) return false;
+        }
+    }
+    return depth == 0 && !in_str;
+}
+
+/* Records end with ,"ts":<n>} (see session_append); LLM APIs reject the field */
+static size_t record_strip_ts(char *p, size_t len)
+{
+    static const char key[] = ",\"ts\":";
+    size_t i = len - 1;     /* closing brace */
+    while (i > 0 && ((p[i - 1] >= '0' && p[i - 1] <= '9') || p[i - 1] == '.' ||
+                     p[i - 1] == '-' || p[i - 1] == 'e' || p[i - 1] == '+')) {
+        i--;
+    }
+    size_t klen = sizeof(key) - 1;
+    if (i >= klen && i < len - 1 && memcmp(p + i - klen, key, klen) == 0) {
+        p[i - klen] = '}';
+        return i - klen + 1;
+    }
+    return len;
+}
+
+/* Read a binary record and render its history object (PSRAM, caller frees) */
+static char *bin_record_json(FILE *f, const rec_span_t *span, size_t *out_len)
+{
+    uint8_t *raw = heap_caps_malloc(span->len, MALLOC_CAP_SPIRAM);
+    if (!raw) return NULL;
+
+    char *json = NULL;
+    session_rec_t rec;
+    if (fseek(f, span->off, SEEK_SET) == 0 && fread(raw, 1, span->len, f) == span->len &&
+        session_rec_parse(raw, span->len, &rec)) {
+        char *content = heap_caps_malloc(rec.content_len + 1, MALLOC_CAP_SPIRAM);
+        size_t cap = session_rec_json_max(&rec);
+        json = heap_caps_malloc(cap, MALLOC_CAP_SPIRAM);
+        if (!content || !json || !session_rec_content(&rec, content) ||
+            (*out_len = session_rec_json(rec.role, content, rec.content_len, json, cap)) == 0) {
+            free(json);
+            json = NULL;
+        }
+        free(content);
+    }
+    free(raw);
+    return json;
+}
+
+/* Binary records need rendering, so fit them newest first, then emit */
+static void history_from_bin(FILE *f, const char *path, const char *chat_id,
+                             const rec_span_t *spans, int n, char *buf, size_t size)
+{
+    char **recs = calloc(n, sizeof(char *));
+    size_t *lens = calloc(n, sizeof(size_t));
+    int keep = 0;
+    bool truncated = false;
+    size_t need = 3;
+    for (int i = 0; recs && lens && i < n; i++) {
+        size_t len = 0;
+        char *json = bin_record_json(f, &spans[i], &len);
+        if (!json) {
+            ESP_LOGW(TAG, "Skipping malformed record at %s:%ld", path, spans[i].off);
+            continue;
+        }
+        if (need + len + 1 > size) {
+            free(json);
+            truncated = true;
+            break;
+        }
+        need += len + 1;
+        recs[keep] = json;
+        lens[keep++] = len;
+    }
+    if (truncated) {
+        ESP_LOGW(TAG, "History for %s truncated to %d of %d messages (buffer %u bytes)",
+                 chat_id, keep, n, (unsigned)size);
+    }
+
+    size_t w = 0;
+    buf[w++] = '[';
+    for (int i = keep - 1; i >= 0; i--) {
+        if (w > 1) buf[w++] = ',';
+        memcpy(buf + w, recs[i], lens[i]);
+        w += lens[i];
+        free(recs[i]);
+    }
+    buf[w++] = ']';
+    buf[w] = '\0';
+    free(recs);
+    free(lens);
+}
+
+/* Caller holds s_seg_lock */
+static esp_err_t history_from_file(const char *chat_id, seg_fmt_t fmt,
+                                   char *buf, size_t size, int max_msgs)
 {
     char path[64];
-    session_path(chat_id, path, sizeof(path));
+    segment_path(chat_id, 0, fmt, path, sizeof(path));
 
-    FILE *f = fopen(path, "a");
+    FILE *f = storage_open(path, "r");
     if (!f) {
-        ESP_LOGE(TAG, "Cannot open session file %s", path);
-        return ESP_FAIL;
+        /* No history yet */
+        return ESP_OK;
+    }
+    rec_span_t *spans = calloc(max_msgs, sizeof(rec_span_t));
+    if (!spans) {
+        fclose(f);
+        return ESP_ERR_NO_MEM;
     }
+    int n = scan_tail_records(f, fmt, spans, max_msgs);
 
-    cJSON *obj = cJSON_CreateObject();
-    cJSON_AddStringToObject(obj, "role", role);
-    cJSON_AddStringToObject(obj, "content", content);
-    cJSON_AddNumberToObject(obj, "ts", (double)time(NULL));
+    if (fmt == SEG_BIN) {
+        history_from_bin(f, path, chat_id, spans, n, buf, size);
+        fclose(f);
+        free(spans);
+        return ESP_OK;
+    }
 
-    char *line = cJSON_PrintUnformatted(obj);
-    cJSON_Delete(obj);
+    /* Keep the newest records that fit: '[' + records + ',' + ']' + NUL */
+    size_t need = 3;
+    int keep = 0;
+    while (keep < n && need + spans[keep].len + 1 <= size) {
+        need += spans[keep].len + 1;
+        keep++;
+    }
+    if (keep < n) {
+        ESP_LOGW(TAG, "History for %s truncated to %d of %d messages (buffer %u bytes)",
+                 chat_id, keep, n, (unsigned)size);
+    }
 
-    if (line) {
-        fprintf(f, "%s\n", line);
-        free(line);
+    /* Splice record bytes straight into the array, oldest first */
+    size_t w = 0;
+    buf[w++] = '[';
+    for (int i = keep - 1; i >= 0; i--) {
+        char *dst = buf + w + (w > 1 ? 1 : 0);
+        if (fseek(f, spans[i].off, SEEK_SET) != 0 ||
+            fread(dst, 1, spans[i].len, f) != spans[i].len) {
+            break;
+        }
+        if (!record_is_object(dst, spans[i].len)) {
+            ESP_LOGW(TAG, "Skipping malformed record at %s:%ld", path, spans[i].off);
+            continue;
+        }
+        size_t len = record_strip_ts(dst, spans[i].len);
+        if (w > 1) buf[w++] = ',';
+        w += len;
     }
+    buf[w++] = ']';
+    buf[w] = '\0';
 
     fclose(f);
+    free(spans);
     return ESP_OK;
 }
 
-esp_err_t session_get_history_json(const char *chat_id, char *buf, size_t size, int max_msgs)
+/* ── Record writing and format conversion ────────────────────── */
+
+/*
+ * Encode one record as it is stored in fmt (JSONL lines keep their '\n').
+ * When json is non-NULL it receives the record's history object without
+ * "ts" (caller frees), for the cache write-through.
+ */
+static uint8_t *encode_record(seg_fmt_t fmt, const char *role, const char *content, int64_t ts,
+                              size_t *rec_len, char **json, size_t *json_len)
+{
+    if (fmt == SEG_JSONL) {
+        cJSON *obj = cJSON_CreateObject();
+        cJSON_AddStringToObject(obj, "role", role);
+        cJSON_AddStringToObject(obj, "content", content);
+        cJSON_AddNumberToObject(obj, "ts", (double)ts);
+        char *line = cJSON_PrintUnformatted(obj);
+        cJSON_Delete(obj);
+        if (!line) return NULL;
+
+        size_t len = strlen(line);
+        uint8_t *rec = heap_caps_malloc(len + 1, MALLOC_CAP_SPIRAM);
+        if (!rec) {
+            free(line);
+            return NULL;
+        }
+        memcpy(rec, line, len);
+        rec[len] = '\n';
+        *rec_len = len + 1;
+        if (json) {
+            *json = line;
+            *json_len = record_strip_ts(line, len);
+        } else {
+            free(line);
+        }
+        return rec;
+    }
+
+    size_t len = strlen(content);
+    uint8_t *rec = heap_caps_malloc(len + SESSION_REC_MAX_OVERHEAD, MALLOC_CAP_SPIRAM);
+    if (!rec) return NULL;
+    session_role_t r = session_role_from_name(role);
+    *rec_len = session_rec_encode(rec, len + SESSION_REC_MAX_OVERHEAD, r, ts, content, len,
+                                  s_format == SESSION_FORMAT_BIN_LZ);
+    if (!*rec_len) {
+        free(rec);
+        return NULL;
+    }
+
+    if (json) {
+        session_rec_t hdr = { .content_len = len };
+        size_t cap = session_rec_json_max(&hdr);
+        *json = heap_caps_malloc(cap, MALLOC_CAP_SPIRAM);
+        *json_len = *json ? session_rec_json(r, content, len, *json, cap) : 0;
+    }
+    return rec;
+}
+
+static bool write_record(FILE *f, seg_fmt_t fmt, const char *role, const char *content, int64_t ts)
+{
+    size_t len = 0;
+    uint8_t *rec = encode_record(fmt, role, content, ts, &len, NULL, NULL);
+    bool ok = rec && fwrite(rec, 1, len, f) == len;
+    free(rec);
+    return ok;
+}
+
+/* Next line of a JSONL segment into a growing buffer; false at EOF */
+static bool read_line(FILE *f, char **buf, size_t *cap)
+{
+    size_t len = 0;
+    for (;;) {
+        if (len + 256 > *cap) {
+            size_t ncap = *cap ? *cap * 2 : 1024;
+            char *n = heap_caps_realloc(*buf, ncap, MALLOC_CAP_SPIRAM);
+            if (!n) return false;
+            *buf = n;
+            *cap = ncap;
+        }
+        if (!fgets(*buf + len, (int)(*cap - len), f)) return len > 0;
+        len += strlen(*buf + len);
+        if (len > 0 && (*buf)[len - 1] == '\n') {
+            (*buf)[len - 1] = '\0';
+            return true;
+        }
+    }
+}
+
+/* Copy every record of src into dst, oldest first. Returns records copied or -1. */
+static int convert_records(FILE *src, seg_fmt_t sfmt, FILE *dst, seg_fmt_t dfmt)
+{
+    int n = 0;
+    if (sfmt == SEG_JSONL) {
+        char *line = NULL;
+        size_t cap = 0;
+        while (read_line(src, &line, &cap)) {
+            cJSON *obj = cJSON_Parse(line);
+            cJSON *role = cJSON_GetObjectItem(obj, "role");
+            cJSON *content = cJSON_GetObjectItem(obj, "content");
+            cJSON *ts = cJSON_GetObjectItem(obj, "ts");
+            if (cJSON_IsString(role) && cJSON_IsString(content)) {
+                if (!write_record(dst, dfmt, role->valuestring, content->valuestring,
+                                  cJSON_IsNumber(ts) ? (int64_t)ts->valuedouble : 0)) {
+                    n = -1;
+                }
+                if (n >= 0) n++;
+            }
+            cJSON_Delete(obj);
+            if (n < 0) break;
+        }
+        free(line);
+        return n;
+    }
+
+    int total = scan_tail_bin(src, NULL, INT32_MAX);
+    rec_span_t *spans = heap_caps_malloc((total ? total : 1) * sizeof(rec_span_t), MALLOC_CAP_SPIRAM);
+    if (!spans) return -1;
+    total = scan_tail_bin(src, spans, total);
+    for (int i = total - 1; i >= 0 && n >= 0; i--) {
+        uint8_t *raw = heap_caps_malloc(spans[i].len, MALLOC_CAP_SPIRAM);
+        session_rec_t rec;
+        char *content = NULL;
+        if (raw && fseek(src, spans[i].off, SEEK_SET) == 0 &&
+            fread(raw, 1, spans[i].len, src) == spans[i].len &&
+            session_rec_parse(raw, spans[i].len, &rec) &&
+            (content = heap_caps_malloc(rec.content_len + 1, MALLOC_CAP_SPIRAM)) != NULL &&
+            session_rec_content(&rec, content)) {
+            if (write_record(dst, dfmt, session_role_name(rec.role), content, rec.ts)) {
+                n++;
+            } else {
+                n = -1;
+            }
+        }
+        free(content);
+        free(raw);
+    }
+    free(spans);
+    return n;
+}
+
+/*
+ * Rewrite an active segment in the other format through tg_<id>.tmp. The
+ * source is only removed once the converted copy is in place. Caller holds
+ * s_seg_lock.
+ */
+static esp_err_t segment_convert(const char *chat_id, seg_fmt_t sfmt, seg_fmt_t dfmt)
 {
+    char src_path[64], dst_path[64], tmp[96];
+    segment_path(chat_id, 0, sfmt, src_path, sizeof(src_path));
+    segment_path(chat_id, 0, dfmt, dst_path, sizeof(dst_path));
+    rotate_tmp_path(chat_id, tmp, sizeof(tmp));
+
+    FILE *src = storage_open(src_path, "r");
+    if (!src) return ESP_ERR_NOT_FOUND;
+    FILE *dst = storage_open(tmp, "w");
+    if (!dst) {
+        fclose(src);
+        return ESP_FAIL;
+    }
+    int n = convert_records(src, sfmt, dst, dfmt);
+    fclose(src);
+    if (fclose(dst) != 0) n = -1;
+
+    if (n < 0 || storage_rename(tmp, dst_path) != 0) {
+        ESP_LOGW(TAG, "Converting %s failed, left as is", src_path);
+        storage_remove(tmp);
+        return ESP_FAIL;
+    }
+    storage_remove(src_path);
+    ESP_LOGI(TAG, "Session %s converted to %s (%d records)", chat_id, s_seg_ext[dfmt], n);
+    return ESP_OK;
+}
+
+/* Make sure the chat's active segment is in the current format. Caller holds s_seg_lock. */
+static void ensure_current_format(const char *chat_id)
+{
+    seg_fmt_t fmt = current_fmt();
+    seg_fmt_t other = fmt == SEG_JSONL ? SEG_BIN : SEG_JSONL;
     char path[64];
-    session_path(chat_id, path, sizeof(path));
+    struct stat st;
+    segment_path(chat_id, 0, fmt, path, sizeof(path));
+    if (stat(path, &st) == 0) return;
+    segment_path(chat_id, 0, other, path, sizeof(path));
+    if (stat(path, &st) == 0) segment_convert(chat_id, other, fmt);
+}
+
+/* ── Hot history cache ───────────────────────────────────────── */
+
+/*
+ * PSRAM LRU of recently active chats. Each entry holds the newest
+ * MIMI_SESSION_CACHE_DEPTH records, already stripped of "ts" and ready to
+ * splice, so a turn in an active chat reads no flash. Appends write through
+ * to both the file and the cache.
+ */
+typedef struct {
+    char chat_id[96];
+    char *recs[MIMI_SESSION_CACHE_DEPTH];   /* ring, oldest at head */
+    size_t lens[MIMI_SESSION_CACHE_DEPTH];
+    int head;
+    int count;
+    size_t bytes;
+    uint32_t last_used;
+    uint32_t loaded_gen;                    /* s_append_gen when read from flash */
+    bool used;
+} cache_entry_t;
+
+static SemaphoreHandle_t s_cache_lock = NULL;
+static cache_entry_t *s_cache = NULL;
+static size_t s_cache_bytes = 0;
+static uint32_t s_cache_clock = 0;
+static uint32_t s_cache_hits = 0;
+static uint32_t s_cache_misses = 0;
+static uint32_t s_cache_evictions = 0;
+/* Bumped under s_seg_lock by every append, so a write-through can tell an
+ * entry loaded after its record landed, which already holds the record */
+static uint32_t s_append_gen = 0;
+
+static cache_entry_t *cache_find(const char *chat_id)
+{
+    for (int i = 0; i < MIMI_SESSION_CACHE_ENTRIES; i++) {
+        if (s_cache[i].used && strcmp(s_cache[i].chat_id, chat_id) == 0) {
+            return &s_cache[i];
+        }
+    }
+    return NULL;
+}
+
+static void cache_reset(cache_entry_t *e)
+{
+    for (int i = 0; i < e->count; i++) {
+        free(e->recs[(e->head + i) % MIMI_SESSION_CACHE_DEPTH]);
+    }
+    s_cache_bytes -= e->bytes;
+    memset(e, 0, sizeof(*e));
+}
+
+static bool cache_evict_lru(const cache_entry_t *keep)
+{
+    cache_entry_t *victim = NULL;
+    for (int i = 0; i < MIMI_SESSION_CACHE_ENTRIES; i++) {
+        cache_entry_t *e = &s_cache[i];
+        if (e->used && e != keep && (!victim || e->last_used < victim->last_used)) {
+            victim = e;
+        }
+    }
+    if (!victim) return false;
+    cache_reset(victim);
+    s_cache_evictions++;
+    return true;
+}
+
+/* Evict other entries until under budget; drops e itself if it alone is too big */
+static bool cache_enforce_budget(cache_entry_t *e)
+{
+    while (s_cache_bytes > MIMI_SESSION_CACHE_BYTES) {
+        if (!cache_evict_lru(e)) {
+            cache_reset(e);
+            s_cache_evictions++;
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool cache_push(cache_entry_t *e, const char *rec, size_t len)
+{
+    char *copy = heap_caps_malloc(len, MALLOC_CAP_SPIRAM);
+    if (!copy) return false;
+    memcpy(copy, rec, len);
 
-    FILE *f = fopen(path, "r");
+    if (e->count == MIMI_SESSION_CACHE_DEPTH) {
+        free(e->recs[e->head]);
+        e->bytes -= e->lens[e->head];
+        s_cache_bytes -= e->lens[e->head];
+        e->head = (e->head + 1) % MIMI_SESSION_CACHE_DEPTH;
+        e->count--;
+    }
+    int idx = (e->head + e->count) % MIMI_SESSION_CACHE_DEPTH;
+    e->recs[idx] = copy;
+    e->lens[idx] = len;
+    e->count++;
+    e->bytes += len;
+    s_cache_bytes += len;
+    return true;
+}
+
+static cache_entry_t *cache_load(const char *chat_id)
+{
+    cache_entry_t *e = NULL;
+    for (int i = 0; i < MIMI_SESSION_CACHE_ENTRIES && !e; i++) {
+        if (!s_cache[i].used) e = &s_cache[i];
+    }
+    if (!e) {
+        cache_evict_lru(NULL);
+        for (int i = 0; i < MIMI_SESSION_CACHE_ENTRIES && !e; i++) {
+            if (!s_cache[i].used) e = &s_cache[i];
+        }
+        if (!e) return NULL;
+    }
+    e->used = true;
+    strncpy(e->chat_id, chat_id, sizeof(e->chat_id) - 1);
+
+    xSemaphoreTake(s_seg_lock, portMAX_DELAY);
+    e->loaded_gen = s_append_gen;
+    wb_flush_chat(chat_id);
+    ensure_current_format(chat_id);
+    seg_fmt_t fmt = current_fmt();
+    char path[64];
+    segment_path(chat_id, 0, fmt, path, sizeof(path));
+    FILE *f = storage_open(path, "r");
     if (!f) {
-        /* No history yet */
-        snprintf(buf, size, "[]");
-        return ESP_OK;
+        xSemaphoreGive(s_seg_lock);
+        return e;   /* new chat: cache the empty history */
     }
 
-    /* Read all lines into a ring buffer of cJSON objects */
-    cJSON *messages[MIMI_SESSION_MAX_MSGS];
-    int count = 0;
-    int write_idx = 0;
+    rec_span_t spans[MIMI_SESSION_CACHE_DEPTH];
+    int n = scan_tail_records(f, fmt, spans, MIMI_SESSION_CACHE_DEPTH);
+    bool ok = true;
+    for (int i = n - 1; i >= 0 && ok; i--) {
+        if (fmt == SEG_BIN) {
+            size_t len = 0;
+            char *json = bin_record_json(f, &spans[i], &len);
+            if (json) {
+                ok = cache_push(e, json, len);
+                free(json);
+            } else {
+                ESP_LOGW(TAG, "Skipping malformed record at %s:%ld", path, spans[i].off);
+            }
+            continue;
+        }
+        char *rec = heap_caps_malloc(spans[i].len, MALLOC_CAP_SPIRAM);
+        if (!rec) {
+            ok = false;
+            break;
+        }
+        if (fseek(f, spans[i].off, SEEK_SET) == 0 &&
+            fread(rec, 1, spans[i].len, f) == spans[i].len &&
+            record_is_object(rec, spans[i].len)) {
+            ok = cache_push(e, rec, record_strip_ts(rec, spans[i].len));
+        } else {
+            ESP_LOGW(TAG, "Skipping malformed record at %s:%ld", path, spans[i].off);
+        }
+        free(rec);
+    }
+    fclose(f);
+    xSemaphoreGive(s_seg_lock);
 
-    char line[2048];
-    while (fgets(line, sizeof(line), f)) {
-        /* Strip newline */
-        size_t len = strlen(line);
-        if (len > 0 && line[len - 1] == '\n') line[len - 1] = '\0';
-        if (line[0] == '\0') continue;
+    if (!ok || !cache_enforce_budget(e)) {
+        if (e->used) cache_reset(e);
+        return NULL;
+    }
+    return e;
+}
 
-        cJSON *obj = cJSON_Parse(line);
-        if (!obj) continue;
+static void cache_render(const cache_entry_t *e, const char *chat_id,
+                         char *buf, size_t size, int max_msgs)
+{
+    int n = e->count < max_msgs ? e->count : max_msgs;
+
+    /* Keep the newest records that fit, as history_from_file() does */
+    size_t need = 3;
+    int keep = 0;
+    while (keep < n) {
+        int idx = (e->head + e->count - 1 - keep) % MIMI_SESSION_CACHE_DEPTH;
+        if (need + e->lens[idx] + 1 > size) break;
+        need += e->lens[idx] + 1;
+        keep++;
+    }
+    if (keep < n) {
+        ESP_LOGW(TAG, "History for %s truncated to %d of %d messages (buffer %u bytes)",
+                 chat_id, keep, n, (unsigned)size);
+    }
+
+    size_t w = 0;
+    buf[w++] = '[';
+    for (int i = e->count - keep; i < e->count; i++) {
+        int idx = (e->head + i) % MIMI_SESSION_CACHE_DEPTH;
+        if (w > 1) buf[w++] = ',';
+        memcpy(buf + w, e->recs[idx], e->lens[idx]);
+        w += e->lens[idx];
+    }
+    buf[w++] = ']';
+    buf[w] = '\0';
+}
 
-        /* Ring buffer: overwrite oldest if full */
-        if (count >= max_msgs) {
-            cJSON_Delete(messages[write_idx]);
+/* ── Segment rotation ────────────────────────────────────────── */
+
+/*
+ * The active segment rolls once it holds MIMI_SESSION_SEGMENT_BYTES or
+ * MIMI_SESSION_SEGMENT_MSGS records. The newest MIMI_SESSION_CARRY_MSGS
+ * records (at most half a segment) are copied into the fresh file, so
+ * history reads never span segments and stay cheap however long a chat
+ * runs. The old file becomes the archive tg_<id>.<seq>.<ext> for the GC
+ * task to age out.
+ */
+typedef struct {
+    char chat_id[96];
+    int msgs;
+    bool used;
+} seg_count_t;
+
+static seg_count_t s_seg_counts[MIMI_SESSION_CACHE_ENTRIES];
+static int s_seg_next = 0;
+static int64_t s_last_append_us = 0;
+static uint32_t s_rotations = 0;
+static uint32_t s_files_removed = 0;
+static uint64_t s_bytes_reclaimed = 0;
+
+static int count_records(const char *path, seg_fmt_t fmt)
+{
+    FILE *f = storage_open(path, "r");
+    if (!f) return 0;
+    if (fmt == SEG_BIN) {
+        int n = scan_tail_bin(f, NULL, INT32_MAX);
+        fclose(f);
+        return n;
+    }
+    char block[MIMI_SESSION_SCAN_BLOCK];
+    size_t n;
+    int lines = 0;
+    while ((n = fread(block, 1, sizeof(block), f)) > 0) {
+        for (size_t i = 0; i < n; i++) {
+            if (block[i] == '\n') lines++;
         }
-        messages[write_idx] = obj;
-        write_idx = (write_idx + 1) % max_msgs;
-        if (count < max_msgs) count++;
     }
     fclose(f);
+    return lines;
+}
+
+/* Record count of the active segment: counted on first use, then tracked */
+static seg_count_t *seg_count_find(const char *chat_id)
+{
+    for (int i = 0; i < MIMI_SESSION_CACHE_ENTRIES; i++) {
+        if (s_seg_counts[i].used && strcmp(s_seg_counts[i].chat_id, chat_id) == 0) {
+            return &s_seg_counts[i];
+        }
+    }
+    return NULL;
+}
+
+static seg_count_t *seg_count_load(const char *chat_id, const char *path, seg_fmt_t fmt)
+{
+    seg_count_t *c = &s_seg_counts[s_seg_next];
+    s_seg_next = (s_seg_next + 1) % MIMI_SESSION_CACHE_ENTRIES;
+    strncpy(c->chat_id, chat_id, sizeof(c->chat_id) - 1);
+    c->chat_id[sizeof(c->chat_id) - 1] = '\0';
+    c->msgs = count_records(path, fmt);
+    c->used = true;
+    return c;
+}
 
-    /* Build JSON array with only role + content */
-    cJSON *arr = cJSON_CreateArray();
-    int start = (count < max_msgs) ? 0 : write_idx;
-    for (int i = 0; i < count; i++) {
-        int idx = (start + i) % max_msgs;
-        cJSON *src = messages[idx];
+static int archive_max_seq(const char *chat_id)
+{
+    storage_dir_t *dir = open_session_dir();
+    if (!dir) return 0;
+    int max_seq = 0;
+    char id[96];
+    int seq;
+    seg_fmt_t fmt;
+    const char *entry;
+    while ((entry = storage_readdir(dir)) != NULL) {
+        if (parse_segment_name(entry, id, sizeof(id), &seq, &fmt) &&
+            seq > max_seq && strcmp(id, chat_id) == 0) {
+            max_seq = seq;
+        }
+    }
+    storage_closedir(dir);
+    return max_seq;
+}
 
-        cJSON *entry = cJSON_CreateObject();
-        cJSON *role = cJSON_GetObjectItem(src, "role");
-        cJSON *content = cJSON_GetObjectItem(src, "content");
-        if (role && content) {
-            cJSON_AddStringToObject(entry, "role", role->valuestring);
-            cJSON_AddStringToObject(entry, "content", content->valuestring);
+static bool copy_record(FILE *src, FILE *dst, seg_fmt_t fmt, const rec_span_t *span)
+{
+    char block[MIMI_SESSION_SCAN_BLOCK];
+    if (fseek(src, span->off, SEEK_SET) != 0) return false;
+    for (size_t left = span->len; left > 0;) {
+        size_t chunk = left < sizeof(block) ? left : sizeof(block);
+        if (fread(block, 1, chunk, src) != chunk || fwrite(block, 1, chunk, dst) != chunk) {
+            return false;
         }
-        cJSON_AddItemToArray(arr, entry);
+        left -= chunk;
+    }
+    return fmt == SEG_BIN || fputc('\n', dst) != EOF;
+}
+
+/* Caller holds s_seg_lock */
+static void segment_rotate(const char *chat_id, seg_fmt_t fmt, const char *path, seg_count_t *c)
+{
+    char tmp[96], arch[96];
+    rotate_tmp_path(chat_id, tmp, sizeof(tmp));
+
+    FILE *src = storage_open(path, "r");
+    if (!src) return;
+    FILE *dst = storage_open(tmp, "w");
+    if (!dst) {
+        fclose(src);
+        return;
     }
+    rec_span_t spans[MIMI_SESSION_CARRY_MSGS];
+    int n = scan_tail_records(src, fmt, spans, MIMI_SESSION_CARRY_MSGS);
 
-    /* Cleanup ring buffer */
-    int cleanup_start = (count < max_msgs) ? 0 : write_idx;
-    for (int i = 0; i < count; i++) {
-        int idx = (cleanup_start + i) % max_msgs;
-        cJSON_Delete(messages[idx]);
+    /* Carry at most half a segment, or long messages would roll every append */
+    size_t carried = 0;
+    int keep = 0;
+    while (keep < n && carried + spans[keep].len + 1 <= MIMI_SESSION_SEGMENT_BYTES / 2) {
+        carried += spans[keep].len + 1;
+        keep++;
+    }
+    n = keep;
+
+    bool ok = true;
+    for (int i = n - 1; i >= 0 && ok; i--) {
+        ok = copy_record(src, dst, fmt, &spans[i]);
+    }
+    fclose(src);
+    if (fclose(dst) != 0) ok = false;
+    if (!ok) {
+        ESP_LOGW(TAG, "Rotating %s failed, will retry on next append", path);
+        storage_remove(tmp);
+        return;
     }
 
-    char *json_str = cJSON_PrintUnformatted(arr);
-    cJSON_Delete(arr);
+    /* The old segment is renamed, never deleted, before the new one is in
+     * place; GC finishes a rotation interrupted between the two renames. */
+    segment_path(chat_id, archive_max_seq(chat_id) + 1, fmt, arch, sizeof(arch));
+    if (storage_rename(path, arch) != 0) {
+        ESP_LOGW(TAG, "Cannot archive %s", path);
+        storage_remove(tmp);
+        return;
+    }
+    if (storage_rename(tmp, path) != 0) {
+        ESP_LOGW(TAG, "Cannot install new segment for %s", path);
+        storage_rename(arch, path);
+        storage_remove(tmp);
+        return;
+    }
+
+    struct stat st;
+    size_t arch_bytes = stat(arch, &st) == 0 ? (size_t)st.st_size : 0;
+    c->msgs = n;
+    s_rotations++;
+    if (MIMI_SESSION_KEEP_SEGMENTS == 0 && storage_remove(arch) == 0) {
+        s_files_removed++;
+        s_bytes_reclaimed += arch_bytes;
+        ESP_LOGI(TAG, "Session %s rotated, %d records carried, %u bytes dropped",
+                 chat_id, n, (unsigned)arch_bytes);
+    } else {
+        ESP_LOGI(TAG, "Session %s rotated, %d records carried, %u bytes archived to %s",
+                 chat_id, n, (unsigned)arch_bytes, arch);
+    }
+}
+
+/* ── Write-behind buffer ─────────────────────────────────────── */
+
+/*
+ * Unless sync is SESSION_SYNC_ALWAYS, appends land in a per-chat PSRAM
+ * buffer of records already encoded for the active segment, and a flush
+ * writes each chat's batch with one open/write/close. Turns from several
+ * chats and several turns of one chat share a flush. Anything that reads a
+ * segment from flash flushes that chat first. Everything here runs under
+ * s_seg_lock.
+ */
+typedef struct {
+    char chat_id[96];
+    seg_fmt_t fmt;
+    uint8_t *buf;
+    size_t len;
+    size_t cap;
+    int recs;
+    bool used;
+} wb_entry_t;
+
+static wb_entry_t s_wb[MIMI_SESSION_WB_CHATS];
+static size_t s_wb_bytes = 0;
+static session_sync_t s_sync = MIMI_SESSION_SYNC_DEFAULT;
+static TaskHandle_t s_flush_task = NULL;
+static uint32_t s_wb_appends = 0;
+static uint32_t s_wb_writes = 0;
+static uint32_t s_wb_flushes = 0;
+static int64_t s_wb_max_flush_us = 0;
+
+/* Append encoded records to the active segment, rolling it once full */
+static bool segment_write(const char *chat_id, seg_fmt_t fmt, const uint8_t *data, size_t len,
+                          int recs)
+{
+    char path[64];
+    segment_path(chat_id, 0, fmt, path, sizeof(path));
+    FILE *f = storage_open(path, "a");
+    if (!f) {
+        ESP_LOGE(TAG, "Cannot open session file %s", path);
+        return false;
+    }
+    bool ok = fwrite(data, 1, len, f) == len;
+    long size = ftell(f);
+    if (fclose(f) != 0) ok = false;
+    s_wb_writes++;
+    if (!ok) {
+        ESP_LOGE(TAG, "Write to %s failed", path);
+        return false;
+    }
 
-    if (json_str) {
-        strncpy(buf, json_str, size - 1);
-        buf[size - 1] = '\0';
-        free(json_str);
+    seg_count_t *c = seg_count_find(chat_id);
+    if (c) {
+        c->msgs += recs;
     } else {
-        snprintf(buf, size, "[]");
+        c = seg_count_load(chat_id, path, fmt);
+    }
+    if (size >= MIMI_SESSION_SEGMENT_BYTES || c->msgs >= MIMI_SESSION_SEGMENT_MSGS) {
+        segment_rotate(chat_id, fmt, path, c);
+    }
+    return true;
+}
+
+static wb_entry_t *wb_find(const char *chat_id)
+{
+    for (int i = 0; i < MIMI_SESSION_WB_CHATS; i++) {
+        if (s_wb[i].used && strcmp(s_wb[i].chat_id, chat_id) == 0) return &s_wb[i];
+    }
+    return NULL;
+}
+
+static void wb_release(wb_entry_t *e)
+{
+    s_wb_bytes -= e->len;
+    free(e->buf);
+    memset(e, 0, sizeof(*e));
+}
+
+/* A failed write keeps the batch for the next flush */
+static bool wb_flush_entry(wb_entry_t *e)
+{
+    if (!segment_write(e->chat_id, e->fmt, e->buf, e->len, e->recs)) return false;
+    wb_release(e);
+    return true;
+}
+
+static bool wb_flush_chat(const char *chat_id)
+{
+    wb_entry_t *e = wb_find(chat_id);
+    return !e || wb_flush_entry(e);
+}
+
+static bool wb_flush_all(void)
+{
+    if (s_wb_bytes == 0) return true;
+    int64_t t0 = esp_timer_get_time();
+    bool ok = true;
+    for (int i = 0; i < MIMI_SESSION_WB_CHATS; i++) {
+        if (s_wb[i].used && !wb_flush_entry(&s_wb[i])) ok = false;
+    }
+    int64_t us = esp_timer_get_time() - t0;
+    if (us > s_wb_max_flush_us) s_wb_max_flush_us = us;
+    s_wb_flushes++;
+    return ok;
+}
+
+static bool wb_add(const char *chat_id, seg_fmt_t fmt, const uint8_t *rec, size_t len)
+{
+    wb_entry_t *e = wb_find(chat_id);
+    if (!e) {
+        for (int pass = 0; pass < 2 && !e; pass++) {
+            if (pass == 1) wb_flush_all();
+            for (int i = 0; i < MIMI_SESSION_WB_CHATS && !e; i++) {
+                if (!s_wb[i].used) e = &s_wb[i];
+            }
+        }
+        if (!e) return false;
+        e->used = true;
+        e->fmt = fmt;
+        strncpy(e->chat_id, chat_id, sizeof(e->chat_id) - 1);
+    }
+    if (e->len + len > e->cap) {
+        size_t ncap = e->cap ? e->cap * 2 : 1024;
+        if (ncap < e->len + len) ncap = e->len + len;
+        uint8_t *n = heap_caps_realloc(e->buf, ncap, MALLOC_CAP_SPIRAM);
+        if (!n) {
+            if (!e->len) wb_release(e);
+            return false;
+        }
+        e->buf = n;
+        e->cap = ncap;
+    }
+    memcpy(e->buf + e->len, rec, len);
+    e->len += len;
+    e->recs++;
+    s_wb_bytes += len;
+    return true;
+}
+
+/* Group commit for SESSION_SYNC_INTERVAL; in turn mode batches wait for
+ * session_commit(), a full buffer or shutdown */
+static void session_flush_task(void *arg)
+{
+    (void)arg;
+    while (1) {
+        vTaskDelay(pdMS_TO_TICKS(MIMI_SESSION_FLUSH_MS));
+        xSemaphoreTake(s_seg_lock, portMAX_DELAY);
+        if (s_sync == SESSION_SYNC_INTERVAL) wb_flush_all();
+        xSemaphoreGive(s_seg_lock);
+    }
+}
+
+/* esp_restart() runs this before the reset; a wedged lock is not waited out */
+static void session_shutdown_flush(void)
+{
+    if (xSemaphoreTake(s_seg_lock, pdMS_TO_TICKS(MIMI_SESSION_FLUSH_MS)) != pdTRUE) return;
+    wb_flush_all();
+    xSemaphoreGive(s_seg_lock);
+}
+
+/* ── Garbage collection ──────────────────────────────────────── */
+
+/*
+ * Archives are removed, newest kept, when a chat has more than
+ * MIMI_SESSION_KEEP_SEGMENTS of them, when their last record is older than
+ * MIMI_SESSION_RETAIN_DAYS, and oldest-first while SPIFFS is above
+ * MIMI_SESSION_GC_HIGH_WATER percent full. Active segments are never touched.
+ */
+#define GC_CLOCK_VALID_AFTER  1672531200    /* 2023-01-01: SNTP has run */
+
+typedef struct {
+    char chat_id[96];
+    int seq;            /* 0 once handled */
+    seg_fmt_t fmt;
+    size_t bytes;
+    int64_t newest_ts;
+} gc_file_t;
+
+static TaskHandle_t s_gc_task = NULL;
+static uint32_t s_gc_runs = 0;
+static size_t s_gc_last_reclaimed = 0;
+static int s_gc_archives = 0;
+static size_t s_gc_archive_bytes = 0;
+
+static int64_t segment_newest_ts(const char *path, seg_fmt_t fmt)
+{
+    FILE *f = storage_open(path, "r");
+    if (!f) return 0;
+    int64_t ts = 0;
+    rec_span_t span;
+    if (fmt == SEG_BIN) {
+        uint8_t *raw = NULL;
+        session_rec_t rec;
+        if (scan_tail_bin(f, &span, 1) == 1 &&
+            (raw = heap_caps_malloc(span.len, MALLOC_CAP_SPIRAM)) != NULL &&
+            fseek(f, span.off, SEEK_SET) == 0 && fread(raw, 1, span.len, f) == span.len &&
+            session_rec_parse(raw, span.len, &rec)) {
+            ts = rec.ts;
+        }
+        free(raw);
+    } else if (scan_tail_lines(f, &span, 1) == 1) {
+        char tail[48];
+        size_t n = span.len < sizeof(tail) - 1 ? span.len : sizeof(tail) - 1;
+        if (fseek(f, span.off + (long)(span.len - n), SEEK_SET) == 0 &&
+            fread(tail, 1, n, f) == n) {
+            tail[n] = '\0';
+            const char *p = strstr(tail, "\"ts\":");
+            if (p) ts = strtoll(p + 5, NULL, 10);
+        }
+    }
+    fclose(f);
+    return ts;
+}
+
+static int gc_by_chat(const void *a, const void *b)
+{
+    const gc_file_t *x = a, *y = b;
+    int c = strcmp(x->chat_id, y->chat_id);
+    if (c != 0) return c;
+    return y->seq - x->seq;     /* newest archive first */
+}
+
+static int gc_by_age(const void *a, const void *b)
+{
+    const gc_file_t *x = a, *y = b;
+    return (x->newest_ts > y->newest_ts) - (x->newest_ts < y->newest_ts);
+}
+
+static bool gc_remove(gc_file_t *g, size_t *reclaimed)
+{
+    char path[96];
+    if (!segment_path(g->chat_id, g->seq, g->fmt, path, sizeof(path))) return false;
+    if (storage_remove(path) != 0) return false;
+    ESP_LOGD(TAG, "GC removed %s (%u bytes)", path, (unsigned)g->bytes);
+    *reclaimed += g->bytes;
+    g->seq = 0;
+    return true;
+}
+
+/*
+ * A leftover tmp is either a conversion (its source is still there, so the
+ * partial copy goes) or a rotation cut between its two renames (no active
+ * segment, so the carried tail is installed in the format it was written in).
+ */
+static void gc_recover_tmp(const char *chat_id)
+{
+    char tmp[96], path[64];
+    struct stat st;
+    rotate_tmp_path(chat_id, tmp, sizeof(tmp));
+    for (int fmt = SEG_JSONL; fmt <= SEG_BIN; fmt++) {
+        segment_path(chat_id, 0, (seg_fmt_t)fmt, path, sizeof(path));
+        if (stat(path, &st) == 0) {
+            storage_remove(tmp);
+            return;
+        }
+    }
+
+    FILE *f = storage_open(tmp, "r");
+    int first = f ? fgetc(f) : EOF;
+    if (f) fclose(f);
+    segment_path(chat_id, 0, first == SESSION_REC_MAGIC ? SEG_BIN : SEG_JSONL, path, sizeof(path));
+    if (storage_rename(tmp, path) == 0) {
+        ESP_LOGW(TAG, "Recovered interrupted rotation of %s", path);
+    }
+}
+
+static void session_gc_task(void *arg)
+{
+    (void)arg;
+    while (1) {
+        vTaskDelay(pdMS_TO_TICKS(MIMI_SESSION_GC_INTERVAL_MS));
+
+        /* Only run between conversations */
+        for (;;) {
+            xSemaphoreTake(s_seg_lock, portMAX_DELAY);
+            int64_t quiet_us = esp_timer_get_time() - s_last_append_us;
+            xSemaphoreGive(s_seg_lock);
+            if (quiet_us >= (int64_t)MIMI_SESSION_GC_IDLE_MS * 1000) break;
+            vTaskDelay(pdMS_TO_TICKS(MIMI_SESSION_GC_IDLE_MS));
+        }
+        session_gc_run(NULL);
+    }
+}
+
+/* ── Public API ──────────────────────────────────────────────── */
+
+esp_err_t session_mgr_init(void)
+{
+    s_seg_lock = xSemaphoreCreateMutex();
+    if (!s_seg_lock) return ESP_ERR_NO_MEM;
+
+    nvs_handle_t nvs;
+    if (nvs_open(MIMI_NVS_SESSION, NVS_READONLY, &nvs) == ESP_OK) {
+        uint8_t fmt = 0, sync = 0;
+        if (nvs_get_u8(nvs, MIMI_NVS_KEY_SESSION_FORMAT, &fmt) == ESP_OK &&
+            fmt <= SESSION_FORMAT_BIN_LZ) {
+            s_format = (session_format_t)fmt;
+        }
+        if (nvs_get_u8(nvs, MIMI_NVS_KEY_SESSION_SYNC, &sync) == ESP_OK &&
+            sync <= SESSION_SYNC_INTERVAL) {
+            s_sync = (session_sync_t)sync;
+        }
+        nvs_close(nvs);
+    }
+
+    s_cache = heap_caps_calloc(MIMI_SESSION_CACHE_ENTRIES, sizeof(cache_entry_t), MALLOC_CAP_SPIRAM);
+    s_cache_lock = xSemaphoreCreateMutex();
+    if (!s_cache || !s_cache_lock) {
+        ESP_LOGW(TAG, "History cache disabled (no memory)");
+        free(s_cache);
+        s_cache = NULL;
+    }
+
+    if (xTaskCreate(session_flush_task, "session_flush", MIMI_SESSION_FLUSH_STACK, NULL,
+                    MIMI_SESSION_FLUSH_PRIO, &s_flush_task) != pdPASS) {
+        ESP_LOGW(TAG, "No flush task, writing sessions through");
+        s_flush_task = NULL;
+        s_sync = SESSION_SYNC_ALWAYS;
     }
+    esp_register_shutdown_handler(session_shutdown_flush);
 
+    ESP_LOGI(TAG, "Session manager initialized at %s (%s, sync %s, cache %d chats, %d KB)",
+             MIMI_SPIFFS_SESSION_DIR, session_format_name(s_format), session_sync_name(s_sync),
+             MIMI_SESSION_CACHE_ENTRIES, MIMI_SESSION_CACHE_BYTES / 1024);
     return ESP_OK;
 }
 
+esp_err_t session_append(const char *chat_id, const char *role, const char *content)
+{
+    int64_t ts = (int64_t)time(NULL);
+    xSemaphoreTake(s_seg_lock, portMAX_DELAY);
+    /* A chat with a batch pending was format-checked when the batch began */
+    bool buffered = s_sync != SESSION_SYNC_ALWAYS;
+    if (!buffered || !wb_find(chat_id)) ensure_current_format(chat_id);
+    seg_fmt_t fmt = current_fmt();
+
+    char *json = NULL;
+    size_t json_len = 0, rec_len = 0;
+    uint8_t *rec = encode_record(fmt, role, content, ts, &rec_len, &json, &json_len);
+    bool written = false;
+    if (rec) {
+        s_wb_appends++;
+        if (buffered) {
+            if (s_wb_bytes + rec_len > MIMI_SESSION_WB_BYTES) wb_flush_all();
+            written = s_wb_bytes + rec_len <= MIMI_SESSION_WB_BYTES &&
+                      wb_add(chat_id, fmt, rec, rec_len);
+        }
+        /* Unbuffered, or the buffer cannot take it: write now, behind any batch */
+        if (!written) {
+            written = wb_flush_chat(chat_id) && segment_write(chat_id, fmt, rec, rec_len, 1);
+        }
+        free(rec);
+    }
+    s_last_append_us = esp_timer_get_time();
+    uint32_t gen = ++s_append_gen;
+    xSemaphoreGive(s_seg_lock);
+
+    /* Write-through: only chats already cached are updated. Rotation keeps
+     * the newest records, so a cached tail stays valid across it. The cache
+     * lock ranks above s_seg_lock, so a reader may load the chat between the
+     * two; its entry then already ends with this record. */
+    if (s_cache) {
+        xSemaphoreTake(s_cache_lock, portMAX_DELAY);
+        cache_entry_t *e = cache_find(chat_id);
+        if (e && e->loaded_gen >= gen) {
+            e->last_used = ++s_cache_clock;
+        } else if (e) {
+            e->last_used = ++s_cache_clock;
+            /* A record that did not reach flash is not history: reload
+               from flash on the next read rather than serve it */
+            if (!written || !json_len || !cache_push(e, json, json_len)) {
+                cache_reset(e);
+            } else {
+                cache_enforce_budget(e);
+            }
+        }
+        xSemaphoreGive(s_cache_lock);
+    }
+    free(json);
+    return written ? ESP_OK : ESP_FAIL;
+}
+
+esp_err_t session_get_history_json(const char *chat_id, char *buf, size_t size, int max_msgs)
+{
+    if (size < 3) return ESP_ERR_INVALID_SIZE;
+    snprintf(buf, size, "[]");
+    if (max_msgs <= 0) return ESP_OK;
+
+    if (s_cache && max_msgs <= MIMI_SESSION_CACHE_DEPTH) {
+        xSemaphoreTake(s_cache_lock, portMAX_DELAY);
+        cache_entry_t *e = cache_find(chat_id);
+        if (e) {
+            s_cache_hits++;
+        } else {
+            s_cache_misses++;
+            e = cache_load(chat_id);
+        }
+        if (e) {
+            e->last_used = ++s_cache_clock;
+            cache_render(e, chat_id, buf, size, max_msgs);
+            xSemaphoreGive(s_cache_lock);
+            return ESP_OK;
+        }
+        xSemaphoreGive(s_cache_lock);
+    }
+
+    xSemaphoreTake(s_seg_lock, portMAX_DELAY);
+    wb_flush_chat(chat_id);
+    ensure_current_format(chat_id);
+    esp_err_t err = history_from_file(chat_id, current_fmt(), buf, size, max_msgs);
+    xSemaphoreGive(s_seg_lock);
+    return err;
+}
+
 esp_err_t session_clear(const char *chat_id)
 {
-    char path[64];
-    session_path(chat_id, path, sizeof(path));
+    /* Held across the removal (it ranks above s_seg_lock), so a reader
+       cannot load the old files into the cache before they are gone */
+    if (s_cache) xSemaphoreTake(s_cache_lock, portMAX_DELAY);
+
+    xSemaphoreTake(s_seg_lock, portMAX_DELAY);
+    wb_entry_t *pending = wb_find(chat_id);
+    bool found = pending != NULL;
+    if (pending) wb_release(pending);
+    seg_count_t *c = seg_count_find(chat_id);
+    if (c) c->used = false;
+
+    char path[96];
+    for (int fmt = SEG_JSONL; fmt <= SEG_BIN; fmt++) {
+        segment_path(chat_id, 0, (seg_fmt_t)fmt, path, sizeof(path));
+        if (storage_remove(path) == 0) found = true;
+    }
+    for (int seq = archive_max_seq(chat_id); seq > 0; seq = archive_max_seq(chat_id)) {
+        bool removed = false;
+        for (int fmt = SEG_JSONL; fmt <= SEG_BIN; fmt++) {
+            segment_path(chat_id, seq, (seg_fmt_t)fmt, path, sizeof(path));
+            if (storage_remove(path) == 0) removed = true;
+        }
+        if (!removed) break;
+        found = true;
+    }
+    xSemaphoreGive(s_seg_lock);
 
-    if (remove(path) == 0) {
+    if (s_cache) {
+        cache_entry_t *e = cache_find(chat_id);
+        if (e) cache_reset(e);
+        xSemaphoreGive(s_cache_lock);
+    }
+
+    if (found) {
         ESP_LOGI(TAG, "Session %s cleared", chat_id);
         return ESP_OK;
     }
@@ -139,27 +1380,394 @@ esp_err_t session_clear(const char *chat_id)
 
 void session_list(void)
 {
-    DIR *dir = opendir(MIMI_SPIFFS_SESSION_DIR);
+    session_flush();
+    storage_dir_t *dir = open_session_dir();
     if (!dir) {
-        /* SPIFFS is flat, so list all files matching pattern */
-        dir = opendir(MIMI_SPIFFS_BASE);
-        if (!dir) {
-            ESP_LOGW(TAG, "Cannot open SPIFFS directory");
-            return;
-        }
+        ESP_LOGW(TAG, "Cannot list %s", MIMI_SPIFFS_SESSION_DIR);
+        return;
     }
 
-    struct dirent *entry;
+    const char *entry;
     int count = 0;
-    while ((entry = readdir(dir)) != NULL) {
-        if (strstr(entry->d_name, "tg_") && strstr(entry->d_name, ".jsonl")) {
-            ESP_LOGI(TAG, "  Session: %s", entry->d_name);
+    int archives = 0;
+    char chat_id[96];
+    int seq;
+    seg_fmt_t fmt;
+    while ((entry = storage_readdir(dir)) != NULL) {
+        if (!parse_segment_name(entry, chat_id, sizeof(chat_id), &seq, &fmt)) continue;
+        if (seq == 0) {
+            ESP_LOGI(TAG, "  Session: %s", entry);
             count++;
+        } else if (seq > 0) {
+            archives++;
         }
     }
-    closedir(dir);
+    storage_closedir(dir);
 
     if (count == 0) {
         ESP_LOGI(TAG, "  No sessions found");
     }
+    if (archives > 0) {
+        ESP_LOGI(TAG, "  (%d archived segments)", archives);
+    }
+}
+
+void session_cache_flush(void)
+{
+    if (!s_cache) return;
+    xSemaphoreTake(s_cache_lock, portMAX_DELAY);
+    for (int i = 0; i < MIMI_SESSION_CACHE_ENTRIES; i++) {
+        if (s_cache[i].used) cache_reset(&s_cache[i]);
+    }
+    xSemaphoreGive(s_cache_lock);
+}
+
+void session_cache_get_stats(session_cache_stats_t *out)
+{
+    memset(out, 0, sizeof(*out));
+    if (!s_cache) return;
+    xSemaphoreTake(s_cache_lock, portMAX_DELAY);
+    out->hits = s_cache_hits;
+    out->misses = s_cache_misses;
+    out->evictions = s_cache_evictions;
+    out->bytes = s_cache_bytes;
+    for (int i = 0; i < MIMI_SESSION_CACHE_ENTRIES; i++) {
+        if (s_cache[i].used) out->entries++;
+    }
+    xSemaphoreGive(s_cache_lock);
+}
+
+esp_err_t session_gc_run(size_t *reclaimed_out)
+{
+    gc_file_t *files = heap_caps_calloc(MIMI_SESSION_GC_MAX_FILES, sizeof(gc_file_t),
+                                        MALLOC_CAP_SPIRAM);
+    if (!files) return ESP_ERR_NO_MEM;
+
+    xSemaphoreTake(s_seg_lock, portMAX_DELAY);
+
+    int n = 0;
+    storage_dir_t *dir = open_session_dir();
+    if (dir) {
+        const char *entry;
+        while (n < MIMI_SESSION_GC_MAX_FILES && (entry = storage_readdir(dir)) != NULL) {
+            gc_file_t *g = &files[n];
+            if (parse_segment_name(entry, g->chat_id, sizeof(g->chat_id),
+                                   &g->seq, &g->fmt) &&
+                g->seq != 0) {
+                n++;
+            }
+        }
+        storage_closedir(dir);
+    }
+
+    char path[96];
+    struct stat st;
+    for (int i = 0; i < n; i++) {
+        gc_file_t *g = &files[i];
+        if (g->seq < 0) {
+            gc_recover_tmp(g->chat_id);
+            g->seq = 0;
+            continue;
+        }
+        if (!segment_path(g->chat_id, g->seq, g->fmt, path, sizeof(path))) {
+            g->seq = 0;          /* a name this long was never ours */
+            continue;
+        }
+        g->bytes = stat(path, &st) == 0 ? (size_t)st.st_size : 0;
+        g->newest_ts = segment_newest_ts(path, g->fmt);
+    }
+
+    size_t reclaimed = 0;
+    int removed = 0;
+
+    /* Per-chat segment cap, newest archives kept */
+    qsort(files, n, sizeof(gc_file_t), gc_by_chat);
+    int kept = 0;
+    for (int i = 0; i < n; i++) {
+        if (i == 0 || strcmp(files[i].chat_id, files[i - 1].chat_id) != 0) kept = 0;
+        if (files[i].seq <= 0) continue;
+        if (++kept > MIMI_SESSION_KEEP_SEGMENTS && gc_remove(&files[i], &reclaimed)) removed++;
+    }
+
+    /* Retention age, once the clock can be trusted */
+    time_t now = time(NULL);
+    if (now > GC_CLOCK_VALID_AFTER) {
+        int64_t cutoff = (int64_t)now - (int64_t)MIMI_SESSION_RETAIN_DAYS * 86400;
+        for (int i = 0; i < n; i++) {
+            if (files[i].seq > 0 && files[i].newest_ts > 0 && files[i].newest_ts < cutoff &&
+                gc_remove(&files[i], &reclaimed)) {
+                removed++;
+            }
+        }
+    }
+
+    /* Utilization pressure, oldest archives first */
+    size_t total = 0, used = 0;
+    if (storage_fs_info(&total, &used) == ESP_OK && total > 0) {
+        size_t before = reclaimed;
+        used -= used > reclaimed ? reclaimed : used;
+        qsort(files, n, sizeof(gc_file_t), gc_by_age);
+        for (int i = 0; i < n && (uint64_t)used * 100 > (uint64_t)total * MIMI_SESSION_GC_HIGH_WATER; i++) {
+            if (files[i].seq > 0 && gc_remove(&files[i], &reclaimed)) {
+                removed++;
+                used -= used > files[i].bytes ? files[i].bytes : used;
+            }
+        }
+        if (reclaimed > before) {
+            ESP_LOGW(TAG, "SPIFFS above %d%%, dropped %u bytes of oldest archives",
+                     MIMI_SESSION_GC_HIGH_WATER, (unsigned)(reclaimed - before));
+        }
+    }
+
+    int archives = 0;
+    size_t archive_bytes = 0;
+    for (int i = 0; i < n; i++) {
+        if (files[i].seq > 0) {
+            archives++;
+            archive_bytes += files[i].bytes;
+        }
+    }
+
+    s_gc_runs++;
+    s_files_removed += removed;
+    s_bytes_reclaimed += reclaimed;
+    s_gc_last_reclaimed = reclaimed;
+    s_gc_archives = archives;
+    s_gc_archive_bytes = archive_bytes;
+    xSemaphoreGive(s_seg_lock);
+    free(files);
+
+    if (removed > 0) {
+        ESP_LOGI(TAG, "GC removed %d archived segments, reclaimed %u bytes (%d archives, %u bytes kept)",
+                 removed, (unsigned)reclaimed, archives, (unsigned)archive_bytes);
+    } else {
+        ESP_LOGD(TAG, "GC: nothing to reclaim (%d archives)", archives);
+    }
+    if (reclaimed_out) *reclaimed_out = reclaimed;
+    return ESP_OK;
+}
+
+esp_err_t session_gc_start(void)
+{
+    if (s_gc_task) return ESP_OK;
+
+    BaseType_t ok = xTaskCreate(session_gc_task, "session_gc",
+                                MIMI_SESSION_GC_STACK, NULL,
+                                MIMI_SESSION_GC_PRIO, &s_gc_task);
+    if (ok != pdPASS || !s_gc_task) {
+        ESP_LOGE(TAG, "Failed to create session GC task");
+        return ESP_FAIL;
+    }
+    ESP_LOGI(TAG, "Session GC started (every %ds when idle, keep %d archives/chat, %d days)",
+             MIMI_SESSION_GC_INTERVAL_MS / 1000, MIMI_SESSION_KEEP_SEGMENTS, MIMI_SESSION_RETAIN_DAYS);
+    return ESP_OK;
+}
+
+void session_gc_get_stats(session_gc_stats_t *out)
+{
+    xSemaphoreTake(s_seg_lock, portMAX_DELAY);
+    out->rotations = s_rotations;
+    out->gc_runs = s_gc_runs;
+    out->files_removed = s_files_removed;
+    out->bytes_reclaimed = s_bytes_reclaimed;
+    out->last_reclaimed = s_gc_last_reclaimed;
+    out->archives = s_gc_archives;
+    out->archive_bytes = s_gc_archive_bytes;
+    xSemaphoreGive(s_seg_lock);
+}
+
+const char *session_format_name(session_format_t fmt)
+{
+    switch (fmt) {
+    case SESSION_FORMAT_BIN:    return "bin";
+    case SESSION_FORMAT_BIN_LZ: return "lz";
+    default:                    return "jsonl";
+    }
+}
+
+session_format_t session_get_format(void)
+{
+    return s_format;
+}
+
+static esp_err_t save_setting(const char *key, uint8_t value)
+{
+    nvs_handle_t nvs;
+    esp_err_t err = nvs_open(MIMI_NVS_SESSION, NVS_READWRITE, &nvs);
+    if (err != ESP_OK) return err;
+    nvs_set_u8(nvs, key, value);
+    err = nvs_commit(nvs);
+    nvs_close(nvs);
+    return err;
+}
+
+esp_err_t session_set_format(session_format_t fmt)
+{
+    if (fmt > SESSION_FORMAT_BIN_LZ) return ESP_ERR_INVALID_ARG;
+
+    /* Pending batches are encoded in the old format */
+    xSemaphoreTake(s_seg_lock, portMAX_DELAY);
+    wb_flush_all();
+    s_format = fmt;
+    xSemaphoreGive(s_seg_lock);
+
+    esp_err_t err = save_setting(MIMI_NVS_KEY_SESSION_FORMAT, (uint8_t)fmt);
+    ESP_LOGI(TAG, "Session format set to %s", session_format_name(fmt));
+    return err;
+}
+
+size_t session_footprint(const char *chat_id)
+{
+    xSemaphoreTake(s_seg_lock, portMAX_DELAY);
+    wb_flush_chat(chat_id);
+    storage_dir_t *dir = open_session_dir();
+    if (!dir) {
+        xSemaphoreGive(s_seg_lock);
+        return 0;
+    }
+
+    size_t total = 0;
+    char id[96], path[96];
+    int seq;
+    seg_fmt_t fmt;
+    struct stat st;
+    const char *entry;
+    while ((entry = storage_readdir(dir)) != NULL) {
+        if (parse_segment_name(entry, id, sizeof(id), &seq, &fmt) &&
+            seq >= 0 && strcmp(id, chat_id) == 0) {
+            segment_path(chat_id, seq, fmt, path, sizeof(path));
+            if (stat(path, &st) == 0) total += (size_t)st.st_size;
+        }
+    }
+    storage_closedir(dir);
+    xSemaphoreGive(s_seg_lock);
+    return total;
+}
+
+esp_err_t session_migrate_all(int *migrated_out)
+{
+    seg_fmt_t to = current_fmt();
+    seg_fmt_t from = to == SEG_JSONL ? SEG_BIN : SEG_JSONL;
+    typedef char chat_id_t[96];
+    chat_id_t *ids = heap_caps_calloc(MIMI_SESSION_GC_MAX_FILES, sizeof(chat_id_t), MALLOC_CAP_SPIRAM);
+    char *buf = heap_caps_malloc(MIMI_LLM_STREAM_BUF_SIZE, MALLOC_CAP_SPIRAM);
+    if (!ids || !buf) {
+        free(ids);
+        free(buf);
+        return ESP_ERR_NO_MEM;
+    }
+
+    xSemaphoreTake(s_seg_lock, portMAX_DELAY);
+    wb_flush_all();
+    int n = 0;
+    storage_dir_t *dir = open_session_dir();
+    if (dir) {
+        int seq;
+        seg_fmt_t fmt;
+        const char *entry;
+        while (n < MIMI_SESSION_GC_MAX_FILES && (entry = storage_readdir(dir)) != NULL) {
+            if (parse_segment_name(entry, ids[n], sizeof(chat_id_t), &seq, &fmt) &&
+                seq == 0 && fmt == from) {
+                n++;
+            }
+        }
+        storage_closedir(dir);
+    }
+    xSemaphoreGive(s_seg_lock);
+
+    /* Report size and a cold history load on each side, as measured here */
+    int migrated = 0;
+    size_t total_before = 0, total_after = 0;
+    for (int i = 0; i < n; i++) {
+        char path[64];
+        struct stat st;
+        xSemaphoreTake(s_seg_lock, portMAX_DELAY);
+        segment_path(ids[i], 0, from, path, sizeof(path));
+        size_t before = stat(path, &st) == 0 ? (size_t)st.st_size : 0;
+        int64_t t0 = esp_timer_get_time();
+        history_from_file(ids[i], from, buf, MIMI_LLM_STREAM_BUF_SIZE, MIMI_AGENT_HISTORY_RECORDS);
+        int64_t t1 = esp_timer_get_time();
+        esp_err_t err = segment_convert(ids[i], from, to);
+        int64_t t2 = esp_timer_get_time();
+        history_from_file(ids[i], to, buf, MIMI_LLM_STREAM_BUF_SIZE, MIMI_AGENT_HISTORY_RECORDS);
+        int64_t t3 = esp_timer_get_time();
+        segment_path(ids[i], 0, to, path, sizeof(path));
+        size_t after = stat(path, &st) == 0 ? (size_t)st.st_size : 0;
+        xSemaphoreGive(s_seg_lock);
+
+        if (err != ESP_OK) continue;
+        migrated++;
+        total_before += before;
+        total_after += after;
+        ESP_LOGI(TAG, "  %s: %u -> %u bytes, history load %d -> %d us",
+                 ids[i], (unsigned)before, (unsigned)after, (int)(t1 - t0), (int)(t3 - t2));
+    }
+    free(ids);
+    free(buf);
+
+    ESP_LOGI(TAG, "Migrated %d/%d sessions to %s: %u -> %u bytes", migrated, n,
+             session_format_name(s_format), (unsigned)total_before, (unsigned)total_after);
+    if (migrated_out) *migrated_out = migrated;
+    return migrated == n ? ESP_OK : ESP_FAIL;
+}
+
+const char *session_sync_name(session_sync_t sync)
+{
+    switch (sync) {
+    case SESSION_SYNC_ALWAYS: return "always";
+    case SESSION_SYNC_TURN:   return "turn";
+    default:                  return "interval";
+    }
+}
+
+session_sync_t session_get_sync(void)
+{
+    return s_sync;
+}
+
+esp_err_t session_set_sync(session_sync_t sync)
+{
+    if (sync > SESSION_SYNC_INTERVAL) return ESP_ERR_INVALID_ARG;
+    if (!s_flush_task && sync != SESSION_SYNC_ALWAYS) return ESP_ERR_INVALID_STATE;
+
+    xSemaphoreTake(s_seg_lock, portMAX_DELAY);
+    wb_flush_all();
+    s_sync = sync;
+    xSemaphoreGive(s_seg_lock);
+
+    esp_err_t err = save_setting(MIMI_NVS_KEY_SESSION_SYNC, (uint8_t)sync);
+    ESP_LOGI(TAG, "Session sync set to %s", session_sync_name(sync));
+    return err;
+}
+
+esp_err_t session_commit(const char *chat_id)
+{
+    if (s_sync != SESSION_SYNC_TURN) return ESP_OK;
+    xSemaphoreTake(s_seg_lock, portMAX_DELAY);
+    bool ok = wb_flush_chat(chat_id);
+    xSemaphoreGive(s_seg_lock);
+    return ok ? ESP_OK : ESP_FAIL;
+}
+
+esp_err_t session_flush(void)
+{
+    xSemaphoreTake(s_seg_lock, portMAX_DELAY);
+    bool ok = wb_flush_all();
+    xSemaphoreGive(s_seg_lock);
+    return ok ? ESP_OK : ESP_FAIL;
+}
+
+void session_sync_get_stats(session_sync_stats_t *out)
+{
+    memset(out, 0, sizeof(*out));
+    xSemaphoreTake(s_seg_lock, portMAX_DELAY);
+    out->appends = s_wb_appends;
+    out->writes = s_wb_writes;
+    out->flushes = s_wb_flushes;
+    out->max_flush_us = s_wb_max_flush_us;
+    out->pending_bytes = s_wb_bytes;
+    for (int i = 0; i < MIMI_SESSION_WB_CHATS; i++) {
+        if (s_wb[i].used) out->pending_chats++;
+    }
+    xSemaphoreGive(s_seg_lock);
 }
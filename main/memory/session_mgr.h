@@ -2,16 +2,35 @@
 
 #include "esp_err.h"
 #include <stddef.h>
+#include <stdint.h>
+
+typedef enum {
+    SESSION_FORMAT_JSONL = 0,   /* one JSON object per line */
+    SESSION_FORMAT_BIN,         /* binary records, see session_codec.h */
+    SESSION_FORMAT_BIN_LZ,      /* binary records, content LZ-compressed when it shrinks */
+} session_format_t;
+
+typedef enum {
+    SESSION_SYNC_ALWAYS = 0,    /* every append is on flash when it returns */
+    SESSION_SYNC_TURN,          /* buffered until session_commit() ends the turn */
+    SESSION_SYNC_INTERVAL,      /* buffered across turns and chats, flushed every MIMI_SESSION_FLUSH_MS */
+} session_sync_t;
 
 /**
- * Initialize session manager.
+ * Initialize session manager and load the storage format saved in NVS.
  */
 esp_err_t session_mgr_init(void);
 
 /**
- * Append a message to a session file (JSONL format).
+ * Append a message to a session file.
+ * Unless sync is SESSION_SYNC_ALWAYS the record is buffered in PSRAM and
+ * written with the rest of its batch; it is visible to
+ * session_get_history_json() immediately either way.
+ * The file rolls over at MIMI_SESSION_SEGMENT_BYTES / _MSGS: the newest
+ * MIMI_SESSION_CARRY_MSGS records move to a fresh file and the rest is
+ * archived as tg_<id>.<seq>.jsonl until GC removes it.
  * @param chat_id   Session identifier (e.g., "12345")
- * @param role      "user" or "assistant"
+ * @param role      "user", "assistant" or "tool" (an agent tool digest)
  * @param content   Message text
  */
 esp_err_t session_append(const char *chat_id, const char *role, const char *content);
@@ -21,6 +40,11 @@ esp_err_t session_append(const char *chat_id, const char *role, const char *cont
  * Returns the last max_msgs messages as:
  * [{"role":"user","content":"..."},{"role":"assistant","content":"..."},...]
  *
+ * Served from the PSRAM history cache when the chat is hot. Otherwise only
+ * the tail of the file is read. Records are copied verbatim minus their
+ * "ts" field. If the buffer is too small, the oldest messages are dropped,
+ * so the output is always a valid array.
+ *
  * @param chat_id   Session identifier
  * @param buf       Output buffer (caller allocates)
  * @param size      Buffer size
@@ -29,7 +53,7 @@ esp_err_t session_append(const char *chat_id, const char *role, const char *cont
 esp_err_t session_get_history_json(const char *chat_id, char *buf, size_t size, int max_msgs);
 
 /**
- * Clear a session (delete the file).
+ * Clear a session (delete the file, its archives and its cached history).
  */
 esp_err_t session_clear(const char *chat_id);
 
@@ -37,3 +61,113 @@ esp_err_t session_clear(const char *chat_id);
  * List all session files (prints to log).
  */
 void session_list(void);
+
+typedef struct {
+    uint32_t hits;
+    uint32_t misses;
+    uint32_t evictions;
+    size_t bytes;       /* record bytes held in PSRAM */
+    int entries;        /* chats currently cached */
+} session_cache_stats_t;
+
+/**
+ * Drop every cached history (files are untouched).
+ */
+void session_cache_flush(void);
+
+/**
+ * Snapshot the history cache counters.
+ */
+void session_cache_get_stats(session_cache_stats_t *out);
+
+typedef struct {
+    uint32_t rotations;         /* segments rolled since boot */
+    uint32_t gc_runs;
+    uint32_t files_removed;     /* archives deleted by GC or dropped at rotation */
+    uint64_t bytes_reclaimed;
+    size_t last_reclaimed;      /* bytes freed by the latest GC pass */
+    int archives;               /* archived segments left after that pass */
+    size_t archive_bytes;
+} session_gc_stats_t;
+
+/**
+ * Run one GC pass now: enforce MIMI_SESSION_KEEP_SEGMENTS,
+ * MIMI_SESSION_RETAIN_DAYS and MIMI_SESSION_GC_HIGH_WATER on archived
+ * segments. Active segments are never removed.
+ * @param reclaimed_out  bytes freed by this pass (may be NULL)
+ */
+esp_err_t session_gc_run(size_t *reclaimed_out);
+
+/**
+ * Start the background GC task, which runs a pass every
+ * MIMI_SESSION_GC_INTERVAL_MS once no message has been appended for
+ * MIMI_SESSION_GC_IDLE_MS.
+ */
+esp_err_t session_gc_start(void);
+
+/**
+ * Snapshot rotation and GC counters.
+ */
+void session_gc_get_stats(session_gc_stats_t *out);
+
+/** "jsonl", "bin" or "lz". */
+const char *session_format_name(session_format_t fmt);
+
+session_format_t session_get_format(void);
+
+/**
+ * Write new records in fmt from now on and save it to NVS. A chat whose
+ * active segment is in the other file format is converted the next time it
+ * is read or appended to; archives stay as written.
+ */
+esp_err_t session_set_format(session_format_t fmt);
+
+/**
+ * Convert every active segment to the current format now, logging each
+ * chat's size and cold history load time before and after.
+ * @param migrated_out  sessions converted (may be NULL)
+ */
+esp_err_t session_migrate_all(int *migrated_out);
+
+/**
+ * Bytes a chat occupies on flash: active segment plus archives.
+ */
+size_t session_footprint(const char *chat_id);
+
+/** "always", "turn" or "interval". */
+const char *session_sync_name(session_sync_t sync);
+
+session_sync_t session_get_sync(void);
+
+/**
+ * Choose when appended records reach flash and save it to NVS. Anything
+ * still buffered is written first. A power cut loses at most one turn per
+ * chat in SESSION_SYNC_TURN and MIMI_SESSION_FLUSH_MS of appends in
+ * SESSION_SYNC_INTERVAL; esp_restart() flushes first.
+ */
+esp_err_t session_set_sync(session_sync_t sync);
+
+/**
+ * End of an agent turn: writes the chat's buffered records when sync is
+ * SESSION_SYNC_TURN, otherwise does nothing.
+ */
+esp_err_t session_commit(const char *chat_id);
+
+/**
+ * Write every buffered record now.
+ */
+esp_err_t session_flush(void);
+
+typedef struct {
+    uint32_t appends;           /* records appended since boot */
+    uint32_t writes;            /* segment writes (one open/write/close each) */
+    uint32_t flushes;           /* batches written */
+    int64_t max_flush_us;       /* slowest batch */
+    size_t pending_bytes;
+    int pending_chats;
+} session_sync_stats_t;
+
+/**
+ * Snapshot the write-behind counters.
+ */
+void session_sync_get_stats(session_sync_stats_t *out);
@@ -6,21 +6,27 @@
 #include "esp_event.h"
 #include "esp_system.h"
 #include "esp_heap_caps.h"
-#include "esp_spiffs.h"
 #include "nvs_flash.h"
 
 #include "mimi_config.h"
 #include "bus/message_bus.h"
+#include "bus/outbound.h"
 #include "wifi/wifi_manager.h"
 #include "channels/telegram/telegram_bot.h"
 #include "channels/feishu/feishu_bot.h"
 #include "llm/llm_proxy.h"
 #include "agent/agent_loop.h"
 #include "memory/memory_store.h"
+#include "memory/memory_index.h"
 #include "memory/session_mgr.h"
+#include "storage/storage_cache.h"
+#include "storage/storage_fs.h"
+#include "storage/storage_log.h"
+#include "storage/storage_stats.h"
 #include "gateway/ws_server.h"
 #include "cli/serial_cli.h"
 #include "proxy/http_proxy.h"
+#include "proxy/http_vcr.h"
 #include "tools/tool_registry.h"
 #include "cron/cron_service.h"
 #include "heartbeat/heartbeat.h"
@@ -39,66 +45,30 @@ static esp_err_t init_nvs(void)
     return ret;
 }
 
-static esp_err_t init_spiffs(void)
+static esp_err_t system_send(const char *chat_id, const char *text)
 {
-    esp_vfs_spiffs_conf_t conf = {
-        .base_path = MIMI_SPIFFS_BASE,
-        .partition_label = NULL,
-        .max_files = 10,
-        .format_if_mount_failed = true,
-    };
-
-    esp_err_t ret = esp_vfs_spiffs_register(&conf);
-    if (ret != ESP_OK) {
-        ESP_LOGE(TAG, "SPIFFS mount failed: %s", esp_err_to_name(ret));
-        return ret;
-    }
-
-    size_t total = 0, used = 0;
-    esp_spiffs_info(NULL, &total, &used);
-    ESP_LOGI(TAG, "SPIFFS: total=%d, used=%d", (int)total, (int)used);
-
+    ESP_LOGI(TAG, "System message [%s]: %.128s", chat_id, text);
     return ESP_OK;
 }
 
-/* Outbound dispatch task: reads from outbound queue and routes to channels */
-static void outbound_dispatch_task(void *arg)
+/* Outbound channels: each gets its own workers behind the outbound queue */
+static esp_err_t register_outbound_channels(void)
 {
-    ESP_LOGI(TAG, "Outbound dispatch started");
-
-    while (1) {
-        mimi_msg_t msg;
-        if (message_bus_pop_outbound(&msg, UINT32_MAX) != ESP_OK) continue;
-
-        ESP_LOGI(TAG, "Dispatching response to %s:%s", msg.channel, msg.chat_id);
-
-        if (strcmp(msg.channel, MIMI_CHAN_TELEGRAM) == 0) {
-            esp_err_t send_err = telegram_send_message(msg.chat_id, msg.content);
-            if (send_err != ESP_OK) {
-                ESP_LOGE(TAG, "Telegram send failed for %s: %s", msg.chat_id, esp_err_to_name(send_err));
-            } else {
-                ESP_LOGI(TAG, "Telegram send success for %s (%d bytes)", msg.chat_id, (int)strlen(msg.content));
-            }
-        } else if (strcmp(msg.channel, MIMI_CHAN_FEISHU) == 0) {
-            esp_err_t send_err = feishu_send_message(msg.chat_id, msg.content);
-            if (send_err != ESP_OK) {
-                ESP_LOGE(TAG, "Feishu send failed for %s: %s", msg.chat_id, esp_err_to_name(send_err));
-            } else {
-                ESP_LOGI(TAG, "Feishu send success for %s (%d bytes)", msg.chat_id, (int)strlen(msg.content));
-            }
-        } else if (strcmp(msg.channel, MIMI_CHAN_WEBSOCKET) == 0) {
-            esp_err_t ws_err = ws_server_send(msg.chat_id, msg.content);
-            if (ws_err != ESP_OK) {
-                ESP_LOGW(TAG, "WS send failed for %s: %s", msg.chat_id, esp_err_to_name(ws_err));
-            }
-        } else if (strcmp(msg.channel, MIMI_CHAN_SYSTEM) == 0) {
-            ESP_LOGI(TAG, "System message [%s]: %.128s", msg.chat_id, msg.content);
-        } else {
-            ESP_LOGW(TAG, "Unknown channel: %s", msg.channel);
-        }
-
-        free(msg.content);
+    static const outbound_channel_t channels[] = {
+        /* Chat apps: bursts merge up to one message's length, one request */
+        { MIMI_CHAN_TELEGRAM, telegram_send_message, MIMI_TG_SEND_WORKERS, MIMI_TG_SEND_STACK,
+          MIMI_TG_MAX_MSG_LEN },
+        { MIMI_CHAN_FEISHU, feishu_send_message, MIMI_FEISHU_SEND_WORKERS, MIMI_FEISHU_SEND_STACK,
+          MIMI_FEISHU_MAX_MSG_LEN },
+        /* WebSocket clients expect a response per message: never merged */
+        { MIMI_CHAN_WEBSOCKET, ws_server_send, 1, MIMI_OUTBOUND_LOCAL_STACK, 0 },
+        { MIMI_CHAN_SYSTEM, system_send, 1, MIMI_OUTBOUND_LOCAL_STACK, 0 },
+    };
+    for (size_t i = 0; i < sizeof(channels) / sizeof(channels[0]); i++) {
+        esp_err_t err = outbound_register(&channels[i]);
+        if (err != ESP_OK) return err;
     }
+    return ESP_OK;
 }
 
 void app_main(void)
@@ -119,15 +89,22 @@ void app_main(void)
     /* Phase 1: Core infrastructure */
     ESP_ERROR_CHECK(init_nvs());
     ESP_ERROR_CHECK(esp_event_loop_create_default());
-    ESP_ERROR_CHECK(init_spiffs());
+    ESP_ERROR_CHECK(storage_stats_init());
+    ESP_ERROR_CHECK(storage_fs_mount(MIMI_FS_BACKEND_DEFAULT));
+    ESP_ERROR_CHECK(storage_cache_init());
+    ESP_ERROR_CHECK(storage_log_init());
+    storage_stats_sample_space(true);
 
     /* Initialize subsystems */
     ESP_ERROR_CHECK(message_bus_init());
+    ESP_ERROR_CHECK(register_outbound_channels());
     ESP_ERROR_CHECK(memory_store_init());
     ESP_ERROR_CHECK(skill_loader_init());
+    ESP_ERROR_CHECK(memory_index_init());
     ESP_ERROR_CHECK(session_mgr_init());
     ESP_ERROR_CHECK(wifi_manager_init());
     ESP_ERROR_CHECK(http_proxy_init());
+    ESP_ERROR_CHECK(http_vcr_init());
     ESP_ERROR_CHECK(telegram_bot_init());
     ESP_ERROR_CHECK(feishu_bot_init());
     ESP_ERROR_CHECK(llm_proxy_init());
@@ -139,6 +116,10 @@ void app_main(void)
     /* Start Serial CLI first (works without WiFi) */
     ESP_ERROR_CHECK(serial_cli_init());
 
+    /* Session archive GC and note rollups only touch flash, so they run offline too */
+    session_gc_start();
+    memory_rollup_start();
+
     /* Start WiFi */
     esp_err_t wifi_err = wifi_manager_start();
     if (wifi_err == ESP_OK) {
@@ -148,12 +129,8 @@ void app_main(void)
         if (wifi_manager_wait_connected(30000) == ESP_OK) {
             ESP_LOGI(TAG, "WiFi connected: %s", wifi_manager_get_ip());
 
-            /* Outbound dispatch task should start first to avoid dropping early replies. */
-            ESP_ERROR_CHECK((xTaskCreatePinnedToCore(
-                outbound_dispatch_task, "outbound",
-                MIMI_OUTBOUND_STACK, NULL,
-                MIMI_OUTBOUND_PRIO, NULL, MIMI_OUTBOUND_CORE) == pdPASS)
-                ? ESP_OK : ESP_FAIL);
+            /* Outbound dispatch should start first to avoid dropping early replies. */
+            ESP_ERROR_CHECK(outbound_start());
 
             /* Start network-dependent services */
             ESP_ERROR_CHECK(agent_loop_start());
@@ -58,6 +58,8 @@
 #define MIMI_TG_POLL_STACK           (12 * 1024)
 #define MIMI_TG_POLL_PRIO            5
 #define MIMI_TG_POLL_CORE            0
+#define MIMI_TG_SEND_WORKERS         2             /* concurrent sendMessage calls, by chat */
+#define MIMI_TG_SEND_STACK           (12 * 1024)
 #define MIMI_TG_CARD_SHOW_MS         3000
 #define MIMI_TG_CARD_BODY_SCALE      3
 
@@ -66,6 +68,8 @@
 #define MIMI_FEISHU_POLL_STACK           (12 * 1024)
 #define MIMI_FEISHU_POLL_PRIO            5
 #define MIMI_FEISHU_POLL_CORE            0
+#define MIMI_FEISHU_SEND_WORKERS         1        /* the tenant token refresh is not locked */
+#define MIMI_FEISHU_SEND_STACK           (12 * 1024)
 #define MIMI_FEISHU_WEBHOOK_PORT         18790
 #define MIMI_FEISHU_WEBHOOK_PATH         "/feishu/events"
 #define MIMI_FEISHU_WEBHOOK_MAX_BODY     (16 * 1024)
@@ -78,6 +82,16 @@
 #define MIMI_AGENT_MAX_TOOL_ITER     10
 #define MIMI_MAX_TOOL_CALLS          4
 #define MIMI_AGENT_SEND_WORKING_STATUS 1
+#ifndef MIMI_AGENT_TOOL_DIGEST
+#define MIMI_AGENT_TOOL_DIGEST       1             /* keep tool calls in the session for follow-ups */
+#endif
+#define MIMI_AGENT_DIGEST_BYTES      2048          /* digest cap per turn */
+#define MIMI_AGENT_DIGEST_RESULT_BYTES 768         /* per tool result */
+#define MIMI_AGENT_DIGEST_ARG_BYTES  160           /* per string argument */
+/* Session records loaded per turn: MIMI_AGENT_MAX_HISTORY user/assistant
+   messages plus room for one digest per turn among them */
+#define MIMI_AGENT_HISTORY_RECORDS   (MIMI_AGENT_MAX_HISTORY + \
+                                      (MIMI_AGENT_TOOL_DIGEST ? MIMI_AGENT_MAX_HISTORY / 2 : 0))
 
 /* Timezone (POSIX TZ format) */
 #define MIMI_TIMEZONE                "PST8PDT,M3.2.0,M11.1.0"
@@ -94,13 +108,31 @@
 #define MIMI_LLM_LOG_PREVIEW_BYTES   160
 
 /* Message Bus */
-#define MIMI_BUS_QUEUE_LEN           16
-#define MIMI_OUTBOUND_STACK          (12 * 1024)
-#define MIMI_OUTBOUND_PRIO           5
+#define MIMI_BUS_INBOUND_LEN         32            /* ring slots in PSRAM, power of two */
+#define MIMI_BUS_OUTBOUND_LEN        32
+#define MIMI_BUS_INBOUND_POLICY      BUS_POLICY_BLOCK  /* when full; bus_stats -i/-o at runtime */
+#define MIMI_BUS_OUTBOUND_POLICY     BUS_POLICY_BLOCK
+#define MIMI_BUS_PUSH_TIMEOUT_MS     1000
+#define MIMI_BUS_SPILL_MAX_BYTES     (64 * 1024)   /* per queue; past this a spilling push fails */
+#define MIMI_BUS_SPILL_INBOUND       MIMI_SPIFFS_BASE "/bus_in.spill"
+#define MIMI_BUS_SPILL_OUTBOUND      MIMI_SPIFFS_BASE "/bus_out.spill"
+#define MIMI_BUS_CHATS               128           /* chat-id table slots (PSRAM; refcounts internal), first is "" */
+#define MIMI_BUS_CHANNELS            16            /* channel ids, built-in ones included */
+#define MIMI_OUTBOUND_STACK          (4 * 1024)    /* router; sends run on channel workers */
+#define MIMI_OUTBOUND_PRIO           5             /* router and workers */
 #define MIMI_OUTBOUND_CORE           0
+#define MIMI_OUTBOUND_CHANNELS       8             /* registered outbound channels */
+#define MIMI_OUTBOUND_MAX_WORKERS    4             /* per channel */
+#define MIMI_OUTBOUND_WORKER_QUEUE   8             /* messages waiting per worker */
+#define MIMI_OUTBOUND_HELD           32            /* per channel, behind full workers (PSRAM) */
+#define MIMI_OUTBOUND_RETRY_MS       20            /* router re-offers held messages this often */
+#define MIMI_OUTBOUND_COALESCE_MS    50            /* hold for later texts to the same chat */
+#define MIMI_OUTBOUND_LOCAL_STACK    (6 * 1024)    /* workers for websocket and system */
 
 /* Memory / SPIFFS */
-#define MIMI_SPIFFS_BASE             "/spiffs"
+#ifndef MIMI_SPIFFS_BASE
+#define MIMI_SPIFFS_BASE             "/spiffs"     /* host build mounts a local dir */
+#endif
 #define MIMI_SPIFFS_CONFIG_DIR       MIMI_SPIFFS_BASE "/config"
 #define MIMI_SPIFFS_MEMORY_DIR       MIMI_SPIFFS_BASE "/memory"
 #define MIMI_SPIFFS_SESSION_DIR      MIMI_SPIFFS_BASE "/sessions"
@@ -108,7 +140,94 @@
 #define MIMI_SOUL_FILE               MIMI_SPIFFS_CONFIG_DIR "/SOUL.md"
 #define MIMI_USER_FILE               MIMI_SPIFFS_CONFIG_DIR "/USER.md"
 #define MIMI_CONTEXT_BUF_SIZE        (16 * 1024)
+#define MIMI_CONTEXT_MEMORY_BUDGET   (3 * 1024)    /* ranked memory excerpts per prompt */
+#define MIMI_INDEX_TOP_K             6             /* paragraphs injected per turn */
+#define MIMI_INDEX_TOP_K_MAX         16
+#define MIMI_INDEX_CHUNK_BYTES       512           /* longer paragraphs split at line ends */
+#define MIMI_INDEX_QUERY_TERMS       32
+#define MIMI_INDEX_BM25_K1           1.2f
+#define MIMI_INDEX_BM25_B            0.75f
+#define MIMI_VEC_DIM                 256           /* int8 lanes per paragraph vector */
+#define MIMI_VEC_FILE                MIMI_SPIFFS_MEMORY_DIR "/vectors.bin"
+#define MIMI_VEC_BACKEND_DEFAULT     MEMORY_VEC_LOCAL  /* until set via CLI / NVS */
+#define MIMI_VEC_MIN_COSINE_LOCAL    0.2f          /* weaker vector matches are ignored */
+#define MIMI_VEC_MIN_COSINE_REMOTE   0.3f
+#define MIMI_VEC_CANDIDATES          12            /* vector hits fused with BM25 */
+#define MIMI_VEC_RRF_K               60            /* reciprocal rank fusion constant */
+#define MIMI_VEC_EMBED_BATCH         8             /* paragraphs per remote embedding pass */
+#define MIMI_VEC_EMBED_INTERVAL_MS   (5 * 1000)
+#define MIMI_VEC_EMBED_STACK         (8 * 1024)
+#define MIMI_VEC_EMBED_PRIO          2
+#define MIMI_EMBED_DEFAULT_URL       "https://api.openai.com/v1/embeddings"
+#define MIMI_EMBED_DEFAULT_MODEL     "text-embedding-3-small"
+#define MIMI_NOTES_ROLLUP_DIR        MIMI_SPIFFS_BASE "/rollups"
+#define MIMI_NOTES_RECENT_BUDGET     (3 * 1024)    /* recent notes block per prompt */
+#define MIMI_NOTES_FULL_DAYS         1             /* lookback defaults, until set via CLI / NVS */
+#define MIMI_NOTES_SUMMARY_DAYS      7
+#define MIMI_NOTES_ROLLUP_WEEKS      4
+#define MIMI_NOTES_ROLLUP_MONTHS     1
+#define MIMI_NOTES_FULL_PCT          35            /* budget share of verbatim days ... */
+#define MIMI_NOTES_SUMMARY_PCT       30            /* ... per-day summaries ... */
+#define MIMI_NOTES_WEEK_PCT          23            /* ... weekly rollups; months get the rest */
+#define MIMI_NOTES_SUMMARY_LINES     2             /* entries kept per summarized day */
+#define MIMI_NOTES_WEEK_LINES        2             /* entries kept per weekly rollup */
+#define MIMI_NOTES_MONTH_LINES       4             /* entries kept per monthly rollup */
+#define MIMI_NOTES_LINE_BYTES        80            /* an entry's first sentence, cut at a word */
+#define MIMI_NOTES_DAY_READ_BYTES    (4 * 1024)    /* read per daily note */
+#define MIMI_NOTES_ROLLUP_BYTES      1024
+#define MIMI_NOTES_ROLLUP_STACK      (6 * 1024)
+#define MIMI_NOTES_ROLLUP_PRIO       2
 #define MIMI_SESSION_MAX_MSGS        20
+#define MIMI_SESSION_SCAN_BLOCK      1024          /* reverse tail scan read size */
+#define MIMI_SESSION_FORMAT_DEFAULT  SESSION_FORMAT_JSONL  /* until set via CLI / NVS */
+#define MIMI_SESSION_CACHE_ENTRIES   16            /* hot chats kept in PSRAM */
+#define MIMI_SESSION_CACHE_BYTES     (256 * 1024)
+#define MIMI_SESSION_CACHE_DEPTH     MIMI_AGENT_HISTORY_RECORDS
+#define MIMI_SESSION_SEGMENT_BYTES   (32 * 1024)   /* roll the active file at this size */
+#define MIMI_SESSION_SEGMENT_MSGS    400           /* ... or at this many records */
+#define MIMI_SESSION_CARRY_MSGS      MIMI_AGENT_HISTORY_RECORDS  /* tail copied into the new segment */
+#define MIMI_SESSION_KEEP_SEGMENTS   2             /* archived segments per chat, 0 = drop */
+#define MIMI_SESSION_RETAIN_DAYS     30            /* archives older than this are removed */
+#define MIMI_SESSION_GC_HIGH_WATER   80            /* % SPIFFS used before oldest archives go */
+#define MIMI_SESSION_GC_MAX_FILES    128           /* archives examined per GC pass */
+#define MIMI_SESSION_GC_INTERVAL_MS  (10 * 60 * 1000)
+#define MIMI_SESSION_GC_IDLE_MS      (2 * 60 * 1000)  /* no appends for this long = idle */
+#define MIMI_SESSION_GC_STACK        (6 * 1024)
+#define MIMI_SESSION_GC_PRIO         2
+#define MIMI_SESSION_SYNC_DEFAULT    SESSION_SYNC_INTERVAL  /* until set via CLI / NVS */
+#define MIMI_SESSION_FLUSH_MS        1000          /* group-commit window */
+#define MIMI_SESSION_WB_CHATS        8             /* chats with a batch pending */
+#define MIMI_SESSION_WB_BYTES        (16 * 1024)   /* buffered bytes before a forced flush */
+#define MIMI_SESSION_FLUSH_STACK     (6 * 1024)
+#define MIMI_SESSION_FLUSH_PRIO      3
+#define MIMI_WAL_FILE                MIMI_SPIFFS_BASE "/wal.log"
+#define MIMI_WAL_MAX_FILES           16            /* files with a logged rewrite pending */
+#define MIMI_WAL_PENDING_BYTES       (64 * 1024)   /* PSRAM held for them; larger writes go through */
+#define MIMI_WAL_PATH_MAX            96
+#define MIMI_WAL_CHECKPOINT_BYTES    (16 * 1024)   /* log size that wakes the checkpoint */
+#define MIMI_WAL_CHECKPOINT_MS       (10 * 60 * 1000)  /* ... else at most this often */
+#define MIMI_WAL_CHECKPOINT_STACK    (4 * 1024)
+#define MIMI_WAL_CHECKPOINT_PRIO     2
+#define MIMI_FS_PARTITION            "spiffs"      /* data partition label, either backend */
+#ifndef MIMI_FS_BACKEND_DEFAULT
+#define MIMI_FS_BACKEND_DEFAULT      STORAGE_FS_SPIFFS  /* formats a blank partition; MIMI_FS=littlefs */
+#endif
+#define MIMI_FS_MAX_OPEN_FILES       10            /* SPIFFS only */
+#define MIMI_FS_DIR_CACHE_DIRS       8             /* directories whose file names are kept in PSRAM */
+#define MIMI_FS_DIR_PATH_MAX         64
+#define MIMI_FS_MIGRATE_MAX_FILES    512           /* fs_migrate stages every file in PSRAM */
+#define MIMI_FS_MIGRATE_MAX_BYTES    (3 * 1024 * 1024)
+#define MIMI_FS_CACHE_BYTES          (96 * 1024)   /* PSRAM read cache for small files */
+#define MIMI_FS_CACHE_FILE_MAX       (16 * 1024)   /* larger files are read from flash */
+#define MIMI_FS_CACHE_FILES          32            /* paths tracked, with hit counts */
+#define MIMI_FS_STATS                1             /* count flash I/O per path class (fs_stats) */
+#define MIMI_FS_STALL_US             (80 * 1000)   /* single operations slower than this are logged */
+#define MIMI_FS_STALL_LOG            8             /* ... and the latest kept with their paths */
+#define MIMI_FS_SPACE_SAMPLE_MS      (10 * 60 * 1000)  /* partition use sampled at most this often */
+#define MIMI_FS_SPACE_SAMPLES        36            /* ... keeping six hours of trend */
+
+/* HTTP record/replay */
+#define MIMI_VCR_DEFAULT_FILE        MIMI_SPIFFS_BASE "/vcr/cassette.jsonl"
 
 /* Cron / Heartbeat */
 #define MIMI_CRON_FILE               MIMI_SPIFFS_BASE "/cron.json"
@@ -118,11 +237,31 @@
 #define MIMI_HEARTBEAT_INTERVAL_MS   (30 * 60 * 1000)
 
 /* Skills */
-#define MIMI_SKILLS_PREFIX           MIMI_SPIFFS_BASE "/skills/"
+#define MIMI_SKILLS_DIR              MIMI_SPIFFS_BASE "/skills"
+#define MIMI_SKILLS_PREFIX           MIMI_SKILLS_DIR "/"
+#define MIMI_SKILLS_INDEX_FILE       MIMI_SPIFFS_BASE "/skills.json"  /* catalog, rebuilt on write */
+#define MIMI_SKILLS_MAX              64            /* skills in the catalog */
+#define MIMI_SKILLS_SUMMARY_BYTES    (4 * 1024)    /* rendered prompt summary */
+#define MIMI_SKILLS_PARSE_BYTES      (4 * 1024)    /* read per skill for title, description, triggers */
+#define MIMI_SKILLS_KEYWORDS         8             /* trigger keywords kept per skill */
+
+/* File tools */
+#define MIMI_EDIT_WINDOW             (4 * 1024)    /* edit_file streams the file through this */
+#define MIMI_EDIT_MAX_OPS            16            /* find/replace pairs per edit_file call */
+#define MIMI_EDIT_INLINE_MAX         (32 * 1024)   /* smaller results go through the write-ahead log */
+#define MIMI_LINE_INDEX_FILES        8             /* files read_file keeps a line index for */
+#define MIMI_LINE_INDEX_STRIDE       32            /* lines between indexed offsets */
+#define MIMI_SEARCH_WINDOW           (4 * 1024)    /* search_files reads files through this */
+#define MIMI_SEARCH_PATTERN_MAX      128           /* bytes; at most 255 (Horspool shifts are bytes) */
+#define MIMI_SEARCH_CONTEXT_MAX      3             /* context lines around each match */
+#define MIMI_SEARCH_MATCHES_DEFAULT  30            /* matches shown when max_matches is not given */
+#define MIMI_SEARCH_LINE_MAX         160           /* longer lines are clipped around the match */
 
 /* WebSocket Gateway */
 #define MIMI_WS_PORT                 18789
+#ifndef MIMI_WS_MAX_CLIENTS
 #define MIMI_WS_MAX_CLIENTS          4
+#endif
 
 /* Serial CLI */
 #define MIMI_CLI_STACK               (4 * 1024)
@@ -136,6 +275,10 @@
 #define MIMI_NVS_LLM                 "llm_config"
 #define MIMI_NVS_PROXY               "proxy_config"
 #define MIMI_NVS_SEARCH              "search_config"
+#define MIMI_NVS_VCR                 "vcr_config"
+#define MIMI_NVS_SESSION             "session_cfg"
+#define MIMI_NVS_EMBED               "embed_config"
+#define MIMI_NVS_NOTES               "notes_cfg"
 
 /* NVS Keys */
 #define MIMI_NVS_KEY_SSID            "ssid"
@@ -149,3 +292,14 @@
 #define MIMI_NVS_KEY_PROVIDER        "provider"
 #define MIMI_NVS_KEY_PROXY_HOST      "host"
 #define MIMI_NVS_KEY_PROXY_PORT      "port"
+#define MIMI_NVS_KEY_VCR_MODE        "mode"
+#define MIMI_NVS_KEY_VCR_FILE        "file"
+#define MIMI_NVS_KEY_VCR_PACE        "pace"
+#define MIMI_NVS_KEY_SESSION_FORMAT  "format"
+#define MIMI_NVS_KEY_SESSION_SYNC    "sync"
+#define MIMI_NVS_KEY_EMBED_BACKEND   "backend"
+#define MIMI_NVS_KEY_EMBED_URL       "url"
+#define MIMI_NVS_KEY_NOTES_FULL      "full"
+#define MIMI_NVS_KEY_NOTES_SUMMARY   "summary"
+#define MIMI_NVS_KEY_NOTES_WEEKS     "weeks"
+#define MIMI_NVS_KEY_NOTES_MONTHS    "months"
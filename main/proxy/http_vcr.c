@@ -0,0 +1,363 @@
+#include "http_vcr.h"
+#include "mimi_config.h"
+#include "storage/storage_fs.h"
+
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <sys/stat.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "esp_log.h"
+#include "esp_heap_caps.h"
+#include "esp_timer.h"
+#include "nvs.h"
+#include "cJSON.h"
+
+static const char *TAG = "vcr";
+
+#define VCR_CHANNEL_LEN 12
+#define VCR_KEY_LEN     48
+
+typedef struct {
+    char channel[VCR_CHANNEL_LEN];
+    char key[VCR_KEY_LEN];
+    uint32_t req_hash;
+    uint32_t latency_ms;
+    uint32_t line_off;      /* offset of the NUL-terminated line in s_tape */
+    int status;
+    bool used;
+} vcr_entry_t;
+
+static SemaphoreHandle_t s_lock = NULL;
+static http_vcr_mode_t s_mode = HTTP_VCR_OFF;
+static char s_path[96] = MIMI_VCR_DEFAULT_FILE;
+static int s_pace_pct = 100;
+
+/* Replay state: whole cassette in PSRAM plus a parsed index */
+static char *s_tape = NULL;
+static vcr_entry_t *s_entries = NULL;
+static size_t s_entry_count = 0;
+
+/* Counters */
+static uint32_t s_served = 0;
+static uint32_t s_misses = 0;
+static uint32_t s_mismatches = 0;
+static uint32_t s_recorded = 0;
+static int64_t s_record_start_us = 0;
+
+static uint32_t fnv1a32(const char *data, size_t len)
+{
+    uint32_t h = 2166136261u;
+    for (size_t i = 0; i < len; i++) {
+        h ^= (uint8_t)data[i];
+        h *= 16777619u;
+    }
+    return h;
+}
+
+/* Keys identify the endpoint, not its query: "getUpdates?offset=9" -> "getUpdates" */
+static void normalize_key(char *dst, const char *key)
+{
+    size_t n = strcspn(key ? key : "", "?");
+    if (n >= VCR_KEY_LEN) n = VCR_KEY_LEN - 1;
+    memcpy(dst, key, n);
+    dst[n] = '\0';
+}
+
+static const char *mode_name(http_vcr_mode_t mode)
+{
+    switch (mode) {
+        case HTTP_VCR_RECORD: return "record";
+        case HTTP_VCR_REPLAY: return "replay";
+        default:              return "off";
+    }
+}
+
+/* ── Cassette loading ─────────────────────────────────────────── */
+
+static void unload_tape(void)
+{
+    free(s_tape);
+    free(s_entries);
+    s_tape = NULL;
+    s_entries = NULL;
+    s_entry_count = 0;
+}
+
+static esp_err_t load_tape(const char *path)
+{
+    struct stat st;
+    if (stat(path, &st) != 0 || st.st_size <= 0) {
+        ESP_LOGE(TAG, "Cassette %s missing or empty", path);
+        return ESP_ERR_NOT_FOUND;
+    }
+
+    FILE *f = storage_open(path, "r");
+    if (!f) return ESP_FAIL;
+
+    size_t size = (size_t)st.st_size;
+    char *tape = heap_caps_malloc(size + 1, MALLOC_CAP_SPIRAM);
+    if (!tape) {
+        fclose(f);
+        return ESP_ERR_NO_MEM;
+    }
+    size_t n = fread(tape, 1, size, f);
+    fclose(f);
+    tape[n] = '\0';
+
+    size_t lines = 0;
+    for (size_t i = 0; i < n; i++) {
+        if (tape[i] == '\n') lines++;
+    }
+    vcr_entry_t *entries = heap_caps_calloc(lines + 1, sizeof(vcr_entry_t), MALLOC_CAP_SPIRAM);
+    if (!entries) {
+        free(tape);
+        return ESP_ERR_NO_MEM;
+    }
+
+    size_t count = 0;
+    char *line = tape;
+    while (line < tape + n) {
+        char *nl = strchr(line, '\n');
+        if (nl) *nl = '\0';
+
+        cJSON *root = cJSON_Parse(line);
+        cJSON *ch = root ? cJSON_GetObjectItem(root, "ch") : NULL;
+        cJSON *key = root ? cJSON_GetObjectItem(root, "key") : NULL;
+        if (cJSON_IsString(ch) && cJSON_IsString(key)) {
+            vcr_entry_t *e = &entries[count++];
+            strncpy(e->channel, ch->valuestring, VCR_CHANNEL_LEN - 1);
+            normalize_key(e->key, key->valuestring);
+            cJSON *v;
+            if ((v = cJSON_GetObjectItem(root, "req_hash")) && cJSON_IsNumber(v)) {
+                e->req_hash = (uint32_t)v->valuedouble;
+            }
+            if ((v = cJSON_GetObjectItem(root, "lat_ms")) && cJSON_IsNumber(v)) {
+                e->latency_ms = (uint32_t)v->valuedouble;
+            }
+            if ((v = cJSON_GetObjectItem(root, "status")) && cJSON_IsNumber(v)) {
+                e->status = v->valueint;
+            }
+            e->line_off = (uint32_t)(line - tape);
+        } else if (line[0]) {
+            ESP_LOGW(TAG, "Skipping malformed cassette line at offset %u",
+                     (unsigned)(line - tape));
+        }
+        cJSON_Delete(root);
+
+        if (!nl) break;
+        line = nl + 1;
+    }
+
+    unload_tape();
+    s_tape = tape;
+    s_entries = entries;
+    s_entry_count = count;
+    ESP_LOGI(TAG, "Loaded %u exchanges from %s", (unsigned)count, path);
+    return ESP_OK;
+}
+
+/* ── Mode control ─────────────────────────────────────────────── */
+
+static esp_err_t apply_mode(http_vcr_mode_t mode, bool fresh_recording)
+{
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    unload_tape();
+    s_served = s_misses = s_mismatches = s_recorded = 0;
+
+    esp_err_t err = ESP_OK;
+    if (mode == HTTP_VCR_REPLAY) {
+        err = load_tape(s_path);
+    } else if (mode == HTTP_VCR_RECORD && fresh_recording) {
+        FILE *f = storage_open(s_path, "w");
+        if (f) {
+            fclose(f);
+        } else {
+            err = ESP_FAIL;
+        }
+    }
+    s_record_start_us = esp_timer_get_time();
+    s_mode = (err == ESP_OK) ? mode : HTTP_VCR_OFF;
+    xSemaphoreGive(s_lock);
+
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Cannot %s %s: %s", mode_name(mode), s_path, esp_err_to_name(err));
+    } else if (mode != HTTP_VCR_OFF) {
+        ESP_LOGW(TAG, "HTTP %s active: %s (pace %d%%)", mode_name(mode), s_path, s_pace_pct);
+    }
+    return err;
+}
+
+esp_err_t http_vcr_init(void)
+{
+    s_lock = xSemaphoreCreateMutex();
+    if (!s_lock) return ESP_ERR_NO_MEM;
+
+    uint8_t mode = HTTP_VCR_OFF;
+    nvs_handle_t nvs;
+    if (nvs_open(MIMI_NVS_VCR, NVS_READONLY, &nvs) == ESP_OK) {
+        nvs_get_u8(nvs, MIMI_NVS_KEY_VCR_MODE, &mode);
+        size_t len = sizeof(s_path);
+        char tmp[sizeof(s_path)] = {0};
+        if (nvs_get_str(nvs, MIMI_NVS_KEY_VCR_FILE, tmp, &len) == ESP_OK && tmp[0]) {
+            snprintf(s_path, sizeof(s_path), "%s", tmp);
+        }
+        uint16_t pace = 0;
+        if (nvs_get_u16(nvs, MIMI_NVS_KEY_VCR_PACE, &pace) == ESP_OK) {
+            s_pace_pct = pace;
+        }
+        nvs_close(nvs);
+    }
+
+    if (mode == HTTP_VCR_OFF || mode > HTTP_VCR_REPLAY) return ESP_OK;
+
+    /* A failed replay load leaves the device on the real network */
+    apply_mode((http_vcr_mode_t)mode, false);
+    return ESP_OK;
+}
+
+esp_err_t http_vcr_set_mode(http_vcr_mode_t mode, const char *path, int pace_pct)
+{
+    if (!s_lock) return ESP_ERR_INVALID_STATE;
+    if (path && path[0]) {
+        strncpy(s_path, path, sizeof(s_path) - 1);
+        s_path[sizeof(s_path) - 1] = '\0';
+    }
+    if (pace_pct >= 0) {
+        s_pace_pct = pace_pct;
+    }
+
+    esp_err_t err = apply_mode(mode, true);
+    if (err != ESP_OK) return err;
+
+    nvs_handle_t nvs;
+    err = nvs_open(MIMI_NVS_VCR, NVS_READWRITE, &nvs);
+    if (err != ESP_OK) return err;
+    nvs_set_u8(nvs, MIMI_NVS_KEY_VCR_MODE, (uint8_t)mode);
+    nvs_set_str(nvs, MIMI_NVS_KEY_VCR_FILE, s_path);
+    nvs_set_u16(nvs, MIMI_NVS_KEY_VCR_PACE, (uint16_t)s_pace_pct);
+    err = nvs_commit(nvs);
+    nvs_close(nvs);
+    return err;
+}
+
+http_vcr_mode_t http_vcr_get_mode(void)
+{
+    return s_mode;
+}
+
+bool http_vcr_replaying(void)
+{
+    return s_mode == HTTP_VCR_REPLAY;
+}
+
+/* ── Replay ───────────────────────────────────────────────────── */
+
+esp_err_t http_vcr_replay(const char *channel, const char *key,
+                          const char *req, size_t req_len, http_vcr_resp_t *out)
+{
+    memset(out, 0, sizeof(*out));
+    char nkey[VCR_KEY_LEN];
+    normalize_key(nkey, key);
+
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    vcr_entry_t *e = NULL;
+    for (size_t i = 0; i < s_entry_count; i++) {
+        if (!s_entries[i].used &&
+            strcmp(s_entries[i].channel, channel) == 0 &&
+            strcmp(s_entries[i].key, nkey) == 0) {
+            e = &s_entries[i];
+            break;
+        }
+    }
+    if (!e) {
+        s_misses++;
+        xSemaphoreGive(s_lock);
+        ESP_LOGW(TAG, "No recorded %s %s left", channel, nkey);
+        return ESP_ERR_NOT_FOUND;
+    }
+    e->used = true;
+    s_served++;
+    if (req && e->req_hash && fnv1a32(req, req_len) != e->req_hash) {
+        s_mismatches++;
+        ESP_LOGW(TAG, "%s %s request differs from recording", channel, nkey);
+    }
+
+    esp_err_t err = ESP_ERR_NO_MEM;
+    cJSON *root = cJSON_Parse(s_tape + e->line_off);
+    cJSON *resp = root ? cJSON_GetObjectItem(root, "resp") : NULL;
+    const char *body = cJSON_IsString(resp) ? resp->valuestring : "";
+    out->len = strlen(body);
+    out->body = heap_caps_malloc(out->len + 1, MALLOC_CAP_SPIRAM);
+    if (out->body) {
+        memcpy(out->body, body, out->len + 1);
+        out->status = e->status;
+        err = ESP_OK;
+    }
+    cJSON_Delete(root);
+    uint32_t delay_ms = (uint32_t)((uint64_t)e->latency_ms * s_pace_pct / 100);
+    xSemaphoreGive(s_lock);
+
+    if (delay_ms) {
+        vTaskDelay(pdMS_TO_TICKS(delay_ms));
+    }
+    return err;
+}
+
+/* ── Record ───────────────────────────────────────────────────── */
+
+void http_vcr_record(const char *channel, const char *key,
+                     const char *req, size_t req_len,
+                     int status, const char *body,
+                     int64_t start_us)
+{
+    if (s_mode != HTTP_VCR_RECORD) return;
+
+    int64_t now = esp_timer_get_time();
+    char nkey[VCR_KEY_LEN];
+    normalize_key(nkey, key);
+
+    cJSON *root = cJSON_CreateObject();
+    if (!root) return;
+    cJSON_AddNumberToObject(root, "t_ms", (double)((start_us - s_record_start_us) / 1000));
+    cJSON_AddStringToObject(root, "ch", channel);
+    cJSON_AddStringToObject(root, "key", nkey);
+    cJSON_AddNumberToObject(root, "req_len", (double)req_len);
+    cJSON_AddNumberToObject(root, "req_hash", req ? (double)fnv1a32(req, req_len) : 0);
+    cJSON_AddNumberToObject(root, "status", status);
+    cJSON_AddNumberToObject(root, "lat_ms", (double)((now - start_us) / 1000));
+    cJSON_AddStringToObject(root, "resp", body ? body : "");
+    char *line = cJSON_PrintUnformatted(root);
+    cJSON_Delete(root);
+    if (!line) return;
+
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    FILE *f = storage_open(s_path, "a");
+    if (f) {
+        fputs(line, f);
+        fputc('\n', f);
+        fclose(f);
+        s_recorded++;
+    } else {
+        ESP_LOGE(TAG, "Cannot append to %s", s_path);
+    }
+    xSemaphoreGive(s_lock);
+    free(line);
+}
+
+void http_vcr_print_status(void)
+{
+    printf("Mode:      %s\n", mode_name(s_mode));
+    printf("Cassette:  %s\n", s_path);
+    printf("Pace:      %d%%\n", s_pace_pct);
+    if (s_mode == HTTP_VCR_RECORD) {
+        printf("Recorded:  %u\n", (unsigned)s_recorded);
+    } else if (s_mode == HTTP_VCR_REPLAY) {
+        printf("Loaded:    %u\n", (unsigned)s_entry_count);
+        printf("Served:    %u\n", (unsigned)s_served);
+        printf("Misses:    %u\n", (unsigned)s_misses);
+        printf("Diverged:  %u\n", (unsigned)s_mismatches);
+    }
+}
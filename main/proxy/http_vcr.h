@@ -0,0 +1,68 @@
+#pragma once
+
+#include "esp_err.h"
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+ * Record/replay ("VCR") layer for upstream HTTP traffic.
+ *
+ * Record mode appends every LLM, Telegram, search and Feishu exchange to a
+ * JSON-lines cassette: channel, request key, request hash/length, status,
+ * latency and the full response body. Request bodies are only hashed so the
+ * cassette never holds API keys or prompts.
+ *
+ * Replay mode serves responses from the cassette without touching the
+ * network. Exchanges are consumed in recorded order per (channel, key), and
+ * each reply is delayed by its recorded latency scaled by pace_pct
+ * (100 = original timing, 10 = 10x faster, 0 = no delay).
+ */
+
+typedef enum {
+    HTTP_VCR_OFF = 0,
+    HTTP_VCR_RECORD,
+    HTTP_VCR_REPLAY,
+} http_vcr_mode_t;
+
+typedef struct {
+    char *body;         /* NUL-terminated, caller frees */
+    size_t len;
+    int status;         /* 0 if the call site does not track it */
+} http_vcr_resp_t;
+
+/**
+ * Initialize the VCR layer and apply the mode saved in NVS.
+ */
+esp_err_t http_vcr_init(void);
+
+/**
+ * Switch mode immediately and save it to NVS so it also applies at boot.
+ * @param path      cassette file (NULL = MIMI_VCR_DEFAULT_FILE)
+ * @param pace_pct  replay latency scale in percent (ignored when recording)
+ */
+esp_err_t http_vcr_set_mode(http_vcr_mode_t mode, const char *path, int pace_pct);
+
+http_vcr_mode_t http_vcr_get_mode(void);
+
+/** True while replaying; call sites must then use http_vcr_replay(). */
+bool http_vcr_replaying(void);
+
+/**
+ * Serve the next recorded response for (channel, key), after the paced delay.
+ * Returns ESP_ERR_NOT_FOUND when the cassette has no more matching entries.
+ */
+esp_err_t http_vcr_replay(const char *channel, const char *key,
+                          const char *req, size_t req_len, http_vcr_resp_t *out);
+
+/**
+ * Append one exchange to the cassette. No-op unless recording.
+ * @param start_us  esp_timer_get_time() taken before the request was sent
+ */
+void http_vcr_record(const char *channel, const char *key,
+                     const char *req, size_t req_len,
+                     int status, const char *body,
+                     int64_t start_us);
+
+/** Print mode, cassette and replay counters to stdout. */
+void http_vcr_print_status(void);
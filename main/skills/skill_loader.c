@@ -1,10 +1,19 @@
 #include "skills/skill_loader.h"
 #include "mimi_config.h"
+#include "storage/storage_fs.h"
+#include "storage/storage_log.h"
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
-#include <dirent.h>
+#include <ctype.h>
+#include <sys/stat.h>
 #include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_heap_caps.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "cJSON.h"
 
 static const char *TAG = "skills";
 
@@ -101,6 +110,339 @@ static const builtin_skill_t s_builtins[] = {
 
 #define NUM_BUILTINS (sizeof(s_builtins) / sizeof(s_builtins[0]))
 
+/*
+ * Skill catalog: one entry per skills/<name>.md, sorted by name, and the
+ * summary rendered from it. Both live in PSRAM and change only when a skill
+ * file is written (skill_loader_file_changed()) or found changed at boot,
+ * so building the prompt is a copy. The entries are persisted to
+ * MIMI_SKILLS_INDEX_FILE so boot only re-reads the files that differ.
+ */
+
+/* Guarded by s_lock */
+static SemaphoreHandle_t s_lock;
+static skill_info_t *s_skills;
+static int s_count;
+static char *s_summary;
+static size_t s_summary_len;
+
+/* ── Parsing ─────────────────────────────────────────────────── */
+
+/* Next line of text into out (without the newline); NULL at the end */
+static const char *next_line(const char *p, const char *end, char *out, size_t size)
+{
+    if (p >= end) return NULL;
+    const char *nl = memchr(p, '\n', end - p);
+    const char *stop = nl ? nl : end;
+    size_t len = stop - p;
+    if (len > 0 && p[len - 1] == '\r') len--;
+    size_t copy = len < size - 1 ? len : size - 1;
+    memcpy(out, p, copy);
+    out[copy] = '\0';
+    return nl ? nl + 1 : end;
+}
+
+static bool is_stopword(const char *w)
+{
+    static const char *const stop[] = {
+        "when", "what", "user", "users", "asks", "about", "also", "with", "that",
+        "this", "from", "into", "your", "they", "them", "their", "have", "will",
+        "would", "should", "something", "useful", "wants", "want", "need", "needs",
+        "like", "such", "using", "some", "other", "than", "then",
+    };
+    for (size_t i = 0; i < sizeof(stop) / sizeof(stop[0]); i++) {
+        if (strcmp(w, stop[i]) == 0) return true;
+    }
+    return false;
+}
+
+/* Add the words of line worth matching on to a space-separated list */
+static void collect_keywords(const char *line, char *out, size_t size, int *count)
+{
+    const char *p = line;
+    while (*p && *count < MIMI_SKILLS_KEYWORDS) {
+        while (*p && !isalnum((unsigned char)*p) && !((unsigned char)*p & 0x80)) p++;
+        char word[24];
+        size_t n = 0;
+        while (*p && (isalnum((unsigned char)*p) || ((unsigned char)*p & 0x80))) {
+            if (n < sizeof(word) - 1) word[n++] = (char)tolower((unsigned char)*p);
+            p++;
+        }
+        word[n] = '\0';
+        if (n < 4 || is_stopword(word)) continue;
+
+        /* Skip duplicates */
+        size_t off = strlen(out);
+        bool dup = false;
+        for (const char *k = out; *k && !dup;) {
+            const char *sp = strchr(k, ' ');
+            size_t klen = sp ? (size_t)(sp - k) : strlen(k);
+            dup = klen == n && memcmp(k, word, n) == 0;
+            k += klen + (sp ? 1 : 0);
+        }
+        if (dup || off + n + 2 > size) continue;
+        snprintf(out + off, size - off, "%s%s", off ? " " : "", word);
+        (*count)++;
+    }
+}
+
+/*
+ * Title from the first line ("# Title"), description from the lines up to
+ * the first blank line or section header, keywords from the "## When to
+ * use" section.
+ */
+static void parse_skill(const char *text, size_t len, skill_info_t *out)
+{
+    const char *p = text, *end = text + len;
+    char line[256];
+
+    out->title[0] = out->desc[0] = out->keywords[0] = '\0';
+    if ((p = next_line(p, end, line, sizeof(line))) == NULL) return;
+    const char *title = strncmp(line, "# ", 2) == 0 ? line + 2 : line;
+    size_t tlen = strnlen(title, sizeof(out->title) - 1);
+    memcpy(out->title, title, tlen);
+    out->title[tlen] = '\0';
+    while (tlen > 0 && out->title[tlen - 1] == ' ') out->title[--tlen] = '\0';
+
+    size_t off = 0;
+    bool in_desc = true, in_when = false;
+    int nkw = 0;
+    const char *next;
+    while ((next = next_line(p, end, line, sizeof(line))) != NULL) {
+        p = next;
+        bool header = line[0] == '#' && line[1] == '#';
+        if (in_desc) {
+            if (line[0] == '\0' && off == 0) continue;   /* leading blank lines */
+            if (line[0] == '\0' || header) {
+                in_desc = false;
+            } else {
+                off += snprintf(out->desc + off, sizeof(out->desc) - off, "%s%s",
+                                off ? " " : "", line);
+                if (off >= sizeof(out->desc)) off = sizeof(out->desc) - 1;
+                continue;
+            }
+        }
+        if (header) {
+            const char *h = line + 2;
+            while (*h == ' ') h++;
+            in_when = strncasecmp(h, "when to use", 11) == 0;
+            continue;
+        }
+        if (in_when) collect_keywords(line, out->keywords, sizeof(out->keywords), &nkw);
+    }
+    while (off > 0 && out->desc[off - 1] == ' ') out->desc[--off] = '\0';
+}
+
+/* Read and parse one skill file; false if it cannot be read */
+static bool load_skill(const char *name, skill_info_t *out)
+{
+    char path[96];
+    snprintf(path, sizeof(path), "%s%s", MIMI_SKILLS_PREFIX, name);
+    struct stat st;
+    if (storage_stat(path, &st) != 0) return false;
+    FILE *f = storage_fopen(path);
+    if (!f) return false;
+
+    char *text = heap_caps_malloc(MIMI_SKILLS_PARSE_BYTES, MALLOC_CAP_SPIRAM);
+    if (!text) {
+        fclose(f);
+        return false;
+    }
+    size_t n = fread(text, 1, MIMI_SKILLS_PARSE_BYTES, f);
+    fclose(f);
+
+    memset(out, 0, sizeof(*out));
+    snprintf(out->name, sizeof(out->name), "%s", name);
+    out->size = (uint32_t)st.st_size;
+    out->mtime = (int64_t)st.st_mtime;
+    parse_skill(text, n, out);
+    free(text);
+    return true;
+}
+
+/* ── Catalog ─────────────────────────────────────────────────── */
+
+static bool is_skill_name(const char *name)
+{
+    size_t len = strlen(name);
+    return len >= 4 && len < sizeof(((skill_info_t *)0)->name) &&
+           strcmp(name + len - 3, ".md") == 0 && !strchr(name, '/');
+}
+
+static int find_skill(const char *name, bool *found)
+{
+    int lo = 0, hi = s_count;
+    while (lo < hi) {
+        int mid = (lo + hi) / 2;
+        int c = strcmp(s_skills[mid].name, name);
+        if (c == 0) {
+            *found = true;
+            return mid;
+        }
+        if (c < 0) lo = mid + 1;
+        else hi = mid;
+    }
+    *found = false;
+    return lo;
+}
+
+static void put_skill(const skill_info_t *info)
+{
+    bool found;
+    int i = find_skill(info->name, &found);
+    if (!found) {
+        if (s_count >= MIMI_SKILLS_MAX) {
+            ESP_LOGW(TAG, "Catalog full, %s not listed", info->name);
+            return;
+        }
+        memmove(&s_skills[i + 1], &s_skills[i], (s_count - i) * sizeof(skill_info_t));
+        s_count++;
+    }
+    s_skills[i] = *info;
+}
+
+static void drop_skill(const char *name)
+{
+    bool found;
+    int i = find_skill(name, &found);
+    if (!found) return;
+    memmove(&s_skills[i], &s_skills[i + 1], (s_count - i - 1) * sizeof(skill_info_t));
+    s_count--;
+}
+
+static void render_summary(void)
+{
+    size_t off = 0;
+    for (int i = 0; i < s_count; i++) {
+        const skill_info_t *k = &s_skills[i];
+        int n = snprintf(s_summary + off, MIMI_SKILLS_SUMMARY_BYTES - off,
+                         "- **%s**: %s (read with: read_file %s%s)\n",
+                         k->title, k->desc, MIMI_SKILLS_PREFIX, k->name);
+        /* Whole lines only */
+        if (n < 0 || off + n >= MIMI_SKILLS_SUMMARY_BYTES) break;
+        off += n;
+    }
+    s_summary[off] = '\0';
+    s_summary_len = off;
+}
+
+static void save_catalog(void)
+{
+    cJSON *root = cJSON_CreateObject();
+    cJSON *arr = cJSON_CreateArray();
+    for (int i = 0; i < s_count; i++) {
+        const skill_info_t *k = &s_skills[i];
+        cJSON *item = cJSON_CreateObject();
+        cJSON_AddStringToObject(item, "name", k->name);
+        cJSON_AddStringToObject(item, "title", k->title);
+        cJSON_AddStringToObject(item, "desc", k->desc);
+        cJSON_AddStringToObject(item, "keywords", k->keywords);
+        cJSON_AddNumberToObject(item, "size", k->size);
+        cJSON_AddNumberToObject(item, "mtime", (double)k->mtime);
+        cJSON_AddItemToArray(arr, item);
+    }
+    cJSON_AddItemToObject(root, "skills", arr);
+    char *json = cJSON_PrintUnformatted(root);
+    cJSON_Delete(root);
+    if (!json) return;
+    if (storage_write_file(MIMI_SKILLS_INDEX_FILE, json, strlen(json)) != ESP_OK) {
+        ESP_LOGW(TAG, "Cannot save %s", MIMI_SKILLS_INDEX_FILE);
+    }
+    free(json);
+}
+
+static void copy_str(cJSON *item, const char *key, char *out, size_t size)
+{
+    const char *v = cJSON_GetStringValue(cJSON_GetObjectItem(item, key));
+    snprintf(out, size, "%s", v ? v : "");
+}
+
+static void load_catalog(void)
+{
+    FILE *f = storage_fopen(MIMI_SKILLS_INDEX_FILE);
+    if (!f) return;
+    fseek(f, 0, SEEK_END);
+    long len = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    char *buf = len > 0 ? heap_caps_malloc(len + 1, MALLOC_CAP_SPIRAM) : NULL;
+    size_t n = buf ? fread(buf, 1, len, f) : 0;
+    fclose(f);
+    if (!buf) return;
+    buf[n] = '\0';
+
+    cJSON *root = cJSON_Parse(buf);
+    free(buf);
+    cJSON *item;
+    cJSON_ArrayForEach(item, cJSON_GetObjectItem(root, "skills")) {
+        skill_info_t k = {0};
+        copy_str(item, "name", k.name, sizeof(k.name));
+        if (!is_skill_name(k.name)) continue;
+        copy_str(item, "title", k.title, sizeof(k.title));
+        copy_str(item, "desc", k.desc, sizeof(k.desc));
+        copy_str(item, "keywords", k.keywords, sizeof(k.keywords));
+        cJSON *size = cJSON_GetObjectItem(item, "size");
+        cJSON *mtime = cJSON_GetObjectItem(item, "mtime");
+        k.size = cJSON_IsNumber(size) ? (uint32_t)size->valuedouble : 0;
+        k.mtime = cJSON_IsNumber(mtime) ? (int64_t)mtime->valuedouble : 0;
+        put_skill(&k);
+    }
+    cJSON_Delete(root);
+}
+
+/*
+ * Bring the catalog in line with the skills directory: entries whose file
+ * is gone are dropped, and files that are new or differ in size or mtime
+ * (all of them if force) are read. Returns the number of files read, or -1
+ * if the directory cannot be listed.
+ */
+static int reconcile(bool force, bool *changed)
+{
+    storage_dir_t *dir = storage_opendir(MIMI_SKILLS_DIR);
+    if (!dir) return -1;
+
+    bool *seen = calloc(MIMI_SKILLS_MAX, sizeof(bool));
+    if (!seen) {
+        storage_closedir(dir);
+        return -1;
+    }
+
+    int read = 0;
+    const char *name;
+    while ((name = storage_readdir(dir)) != NULL) {
+        if (!is_skill_name(name)) continue;
+        char path[96];
+        struct stat st;
+        bool found;
+        snprintf(path, sizeof(path), "%s%s", MIMI_SKILLS_PREFIX, name);
+        int i = find_skill(name, &found);
+        if (!force && found && storage_stat(path, &st) == 0 &&
+            s_skills[i].size == (uint32_t)st.st_size && s_skills[i].mtime == (int64_t)st.st_mtime) {
+            seen[i] = true;
+            continue;
+        }
+
+        skill_info_t k;
+        if (!load_skill(name, &k)) continue;
+        /* An insertion shifts the entries after it */
+        if (!found && s_count < MIMI_SKILLS_MAX) {
+            memmove(&seen[i + 1], &seen[i], (s_count - i) * sizeof(bool));
+        }
+        put_skill(&k);
+        i = find_skill(name, &found);
+        if (found) seen[i] = true;
+        read++;
+        *changed = true;
+    }
+    storage_closedir(dir);
+
+    for (int i = s_count - 1; i >= 0; i--) {
+        if (seen[i]) continue;
+        drop_skill(s_skills[i].name);
+        *changed = true;
+    }
+    free(seen);
+    return read;
+}
+
 /* ── Install built-in skills if missing ──────────────────────── */
 
 static void install_builtin(const builtin_skill_t *skill)
@@ -109,7 +451,7 @@ static void install_builtin(const builtin_skill_t *skill)
     snprintf(path, sizeof(path), "%s%s.md", MIMI_SKILLS_PREFIX, skill->filename);
 
     /* Check if already exists */
-    FILE *f = fopen(path, "r");
+    FILE *f = storage_open(path, "r");
     if (f) {
         fclose(f);
         ESP_LOGD(TAG, "Skill exists: %s", path);
@@ -117,7 +459,7 @@ static void install_builtin(const builtin_skill_t *skill)
     }
 
     /* Write built-in skill */
-    f = fopen(path, "w");
+    f = storage_open(path, "w");
     if (!f) {
         ESP_LOGE(TAG, "Cannot write skill: %s", path);
         return;
@@ -128,135 +470,98 @@ static void install_builtin(const builtin_skill_t *skill)
     ESP_LOGI(TAG, "Installed built-in skill: %s", path);
 }
 
+/* ── Public API ──────────────────────────────────────────────── */
+
 esp_err_t skill_loader_init(void)
 {
     ESP_LOGI(TAG, "Initializing skills system");
 
+    if (!s_lock) s_lock = xSemaphoreCreateMutex();
+    if (!s_skills) s_skills = heap_caps_calloc(MIMI_SKILLS_MAX, sizeof(skill_info_t), MALLOC_CAP_SPIRAM);
+    if (!s_summary) s_summary = heap_caps_calloc(1, MIMI_SKILLS_SUMMARY_BYTES, MALLOC_CAP_SPIRAM);
+    if (!s_lock || !s_skills || !s_summary) return ESP_ERR_NO_MEM;
+
     for (size_t i = 0; i < NUM_BUILTINS; i++) {
         install_builtin(&s_builtins[i]);
     }
 
-    ESP_LOGI(TAG, "Skills system ready (%d built-in)", (int)NUM_BUILTINS);
+    int64_t t0 = esp_timer_get_time();
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    s_count = 0;
+    load_catalog();
+    bool changed = false;
+    int read = reconcile(false, &changed);
+    if (changed) save_catalog();
+    render_summary();
+    int count = s_count;
+    xSemaphoreGive(s_lock);
+
+    ESP_LOGI(TAG, "Skills system ready (%d built-in, %d in catalog, %d re-read in %d ms)",
+             (int)NUM_BUILTINS, count, read < 0 ? 0 : read,
+             (int)((esp_timer_get_time() - t0) / 1000));
     return ESP_OK;
 }
 
-/* ── Build skills summary for system prompt ──────────────────── */
-
-/**
- * Parse first line as title: expects "# Title"
- * Returns pointer past "# " or the line itself if no prefix.
- */
-static const char *extract_title(const char *line, size_t len, char *out, size_t out_size)
+esp_err_t skill_loader_rescan(void)
 {
-    const char *start = line;
-    if (len >= 2 && line[0] == '#' && line[1] == ' ') {
-        start = line + 2;
-        len -= 2;
-    }
-
-    /* Trim trailing whitespace/newline */
-    while (len > 0 && (start[len - 1] == '\n' || start[len - 1] == '\r' || start[len - 1] == ' ')) {
-        len--;
-    }
-
-    size_t copy = len < out_size - 1 ? len : out_size - 1;
-    memcpy(out, start, copy);
-    out[copy] = '\0';
-    return out;
+    if (!s_lock) return ESP_ERR_INVALID_STATE;
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    bool changed = false;
+    int read = reconcile(true, &changed);
+    if (changed) save_catalog();
+    render_summary();
+    xSemaphoreGive(s_lock);
+    return read < 0 ? ESP_FAIL : ESP_OK;
 }
 
-/**
- * Extract description: text between the first line and the first blank line.
- */
-static void extract_description(FILE *f, char *out, size_t out_size)
+void skill_loader_file_changed(const char *path)
 {
-    size_t off = 0;
-    char line[256];
-
-    while (fgets(line, sizeof(line), f) && off < out_size - 1) {
-        size_t len = strlen(line);
-
-        /* Stop at blank line or section header */
-        if (len == 0 || (len == 1 && line[0] == '\n') ||
-            (len >= 2 && line[0] == '#' && line[1] == '#')) {
-            break;
-        }
-
-        /* Skip leading blank lines */
-        if (off == 0 && line[0] == '\n') continue;
-
-        /* Trim trailing newline for concatenation */
-        if (line[len - 1] == '\n') {
-            line[len - 1] = ' ';
-        }
-
-        size_t copy = len < out_size - off - 1 ? len : out_size - off - 1;
-        memcpy(out + off, line, copy);
-        off += copy;
+    size_t prefix_len = strlen(MIMI_SKILLS_PREFIX);
+    if (!s_lock || !path || strncmp(path, MIMI_SKILLS_PREFIX, prefix_len) != 0) return;
+    const char *name = path + prefix_len;
+    if (!is_skill_name(name)) return;
+
+    skill_info_t k;
+    bool ok = load_skill(name, &k);
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    if (ok) {
+        put_skill(&k);
+    } else {
+        drop_skill(name);
     }
-
-    /* Trim trailing space */
-    while (off > 0 && out[off - 1] == ' ') off--;
-    out[off] = '\0';
+    save_catalog();
+    render_summary();
+    xSemaphoreGive(s_lock);
+    ESP_LOGI(TAG, "Catalog updated for %s", name);
 }
 
 size_t skill_loader_build_summary(char *buf, size_t size)
 {
-    DIR *dir = opendir(MIMI_SPIFFS_BASE);
-    if (!dir) {
-        ESP_LOGW(TAG, "Cannot open SPIFFS for skill enumeration");
-        buf[0] = '\0';
+    if (!s_lock || size == 0) {
+        if (size) buf[0] = '\0';
         return 0;
     }
 
-    size_t off = 0;
-    struct dirent *ent;
-    /* SPIFFS readdir returns filenames relative to the mount point (e.g. "skills/weather.md").
-       We match entries that start with "skills/" and end with ".md". */
-    const char *skills_subdir = "skills/";
-    const size_t subdir_len = strlen(skills_subdir);
-
-    while ((ent = readdir(dir)) != NULL && off < size - 1) {
-        const char *name = ent->d_name;
-
-        /* Match files under skills/ with .md extension */
-        if (strncmp(name, skills_subdir, subdir_len) != 0) continue;
-
-        size_t name_len = strlen(name);
-        if (name_len < subdir_len + 4) continue;  /* at least "skills/x.md" */
-        if (strcmp(name + name_len - 3, ".md") != 0) continue;
-
-        /* Build full path */
-        char full_path[296];
-        snprintf(full_path, sizeof(full_path), "%s/%s", MIMI_SPIFFS_BASE, name);
-
-        FILE *f = fopen(full_path, "r");
-        if (!f) continue;
-
-        /* Read first line for title */
-        char first_line[128];
-        if (!fgets(first_line, sizeof(first_line), f)) {
-            fclose(f);
-            continue;
-        }
-
-        char title[64];
-        extract_title(first_line, strlen(first_line), title, sizeof(title));
-
-        /* Read description (until blank line) */
-        char desc[256];
-        extract_description(f, desc, sizeof(desc));
-        fclose(f);
-
-        /* Append to summary */
-        off += snprintf(buf + off, size - off,
-            "- **%s**: %s (read with: read_file %s)\n",
-            title, desc, full_path);
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    size_t len = s_summary_len;
+    if (len >= size) {
+        /* Cut at the last whole line that fits */
+        len = size - 1;
+        while (len > 0 && s_summary[len - 1] != '\n') len--;
     }
+    memcpy(buf, s_summary, len);
+    xSemaphoreGive(s_lock);
 
-    closedir(dir);
+    buf[len] = '\0';
+    return len;
+}
 
-    buf[off] = '\0';
-    ESP_LOGI(TAG, "Skills summary: %d bytes", (int)off);
-    return off;
+bool skill_loader_get(size_t i, skill_info_t *out)
+{
+    if (!s_lock) return false;
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    bool ok = i < (size_t)s_count;
+    if (ok) *out = s_skills[i];
+    xSemaphoreGive(s_lock);
+    return ok;
 }
@@ -1,20 +1,49 @@
 #pragma once
 
 #include "esp_err.h"
+#include <stdbool.h>
 #include <stddef.h>
+#include <stdint.h>
+
+/**
+ * A skill as the catalog knows it: parsed once when its file is written,
+ * not on every prompt.
+ */
+typedef struct {
+    char name[48];          /* file name under MIMI_SKILLS_PREFIX, e.g. "weather.md" */
+    char title[64];         /* first line, without "# " */
+    char desc[256];         /* text up to the first blank line */
+    char keywords[128];     /* words from "## When to use", space separated */
+    uint32_t size;
+    int64_t mtime;
+} skill_info_t;
 
 /**
  * Initialize skills system.
- * Installs built-in skill files to SPIFFS if they don't already exist.
+ * Installs built-in skill files to SPIFFS if they don't already exist,
+ * loads the catalog from MIMI_SKILLS_INDEX_FILE and re-reads the skill
+ * files whose size or mtime it does not match.
  */
 esp_err_t skill_loader_init(void);
 
 /**
  * Build a summary of all available skills for the system prompt.
- * Lists each skill with its title and description.
+ * Lists each skill with its title and description, from the catalog.
  *
  * @param buf   Output buffer
  * @param size  Buffer size
  * @return Number of bytes written (0 if no skills found)
  */
 size_t skill_loader_build_summary(char *buf, size_t size);
+
+/**
+ * Update the catalog after path was written; no-op for paths that are not
+ * skill files. A path that no longer exists leaves the catalog.
+ */
+void skill_loader_file_changed(const char *path);
+
+/** Re-read every skill file and rewrite the catalog. */
+esp_err_t skill_loader_rescan(void);
+
+/** Copy catalog entry i (sorted by name); false past the end. */
+bool skill_loader_get(size_t i, skill_info_t *out);
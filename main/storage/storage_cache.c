@@ -0,0 +1,509 @@
+/* fopencookie() */
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#include "storage_cache.h"
+#include "storage_stats.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include "esp_log.h"
+#include "esp_heap_caps.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+
+static const char *TAG = "storage_cache";
+
+#define CACHE_VERSION_BUCKETS 64
+
+typedef enum {
+    ENTRY_EMPTY = 0,            /* tracked for its counts only */
+    ENTRY_DATA,
+    ENTRY_MISSING,              /* the file does not exist */
+} entry_state_t;
+
+typedef struct {
+    char path[MIMI_WAL_PATH_MAX];   /* "" = slot free */
+    entry_state_t state;
+    char *data;                     /* PSRAM */
+    size_t len;
+    bool has_st;
+    struct stat st;
+    uint32_t stamp;                 /* last read, for eviction */
+    uint32_t hits, misses;
+} cache_entry_t;
+
+/* Everything below is guarded by s_lock */
+static SemaphoreHandle_t s_lock;
+static cache_entry_t s_entries[MIMI_FS_CACHE_FILES];
+static size_t s_bytes;
+static uint32_t s_clock;
+static uint32_t s_gen;          /* bumped by every write, so a load racing one is not kept */
+static uint32_t s_versions[CACHE_VERSION_BUCKETS];  /* per path hash, see storage_cache_version() */
+static uint32_t s_hits, s_misses, s_bypassed, s_invalidations, s_evictions;
+
+static uint32_t *version_of(const char *path)
+{
+    uint32_t h = 2166136261u;
+    for (const char *p = path; *p; p++) h = (h ^ (uint8_t)*p) * 16777619u;
+    return &s_versions[h % CACHE_VERSION_BUCKETS];
+}
+
+static cache_entry_t *find_entry(const char *path)
+{
+    for (int i = 0; i < MIMI_FS_CACHE_FILES; i++) {
+        if (s_entries[i].path[0] && strcmp(s_entries[i].path, path) == 0) return &s_entries[i];
+    }
+    return NULL;
+}
+
+static void drop_entry(cache_entry_t *e)
+{
+    if (e->state == ENTRY_DATA) {
+        s_bytes -= e->len;
+        heap_caps_free(e->data);
+    }
+    e->state = ENTRY_EMPTY;
+    e->data = NULL;
+    e->len = 0;
+    e->has_st = false;
+}
+
+/* Entry for path, taking over the least recently read slot if needed */
+static cache_entry_t *claim_entry(const char *path)
+{
+    if (strlen(path) >= MIMI_WAL_PATH_MAX) return NULL;
+    cache_entry_t *e = find_entry(path);
+    if (e) return e;
+
+    cache_entry_t *victim = &s_entries[0];
+    for (int i = 0; i < MIMI_FS_CACHE_FILES; i++) {
+        if (!s_entries[i].path[0]) {
+            victim = &s_entries[i];
+            break;
+        }
+        if (s_entries[i].stamp < victim->stamp) victim = &s_entries[i];
+    }
+    drop_entry(victim);
+    memset(victim, 0, sizeof(*victim));
+    strcpy(victim->path, path);
+    victim->stamp = ++s_clock;
+    return victim;
+}
+
+/* Evict the least recently read content until len more bytes fit */
+static void make_room(size_t len, const cache_entry_t *keep)
+{
+    while (s_bytes + len > MIMI_FS_CACHE_BYTES) {
+        cache_entry_t *victim = NULL;
+        for (int i = 0; i < MIMI_FS_CACHE_FILES; i++) {
+            cache_entry_t *e = &s_entries[i];
+            if (e == keep || e->state != ENTRY_DATA) continue;
+            if (!victim || e->stamp < victim->stamp) victim = e;
+        }
+        if (!victim) return;
+        drop_entry(victim);
+        s_evictions++;
+    }
+}
+
+static void store(cache_entry_t *e, char *data, size_t len, const struct stat *st)
+{
+    drop_entry(e);
+    make_room(len, e);
+    e->state = ENTRY_DATA;
+    e->data = data;
+    e->len = len;
+    e->has_st = st != NULL;
+    if (st) e->st = *st;
+    s_bytes += len;
+}
+
+esp_err_t storage_cache_init(void)
+{
+    if (s_lock) return ESP_OK;
+    s_lock = xSemaphoreCreateMutex();
+    if (!s_lock) return ESP_ERR_NO_MEM;
+    ESP_LOGI(TAG, "Read cache: %d KB for files up to %d KB",
+             MIMI_FS_CACHE_BYTES / 1024, MIMI_FS_CACHE_FILE_MAX / 1024);
+    return ESP_OK;
+}
+
+/* ── Snapshot streams ────────────────────────────────────────── */
+
+typedef struct {
+    char *data;
+    size_t len;
+    size_t pos;
+} snapshot_t;
+
+#if defined(__GLIBC__)
+typedef __off64_t cookie_off_t;
+#elif defined(__LARGE64_FILES)
+typedef _off64_t cookie_off_t;
+#else
+typedef off_t cookie_off_t;
+#endif
+
+static ssize_t snap_read(void *cookie, char *buf, size_t size)
+{
+    snapshot_t *s = cookie;
+    size_t n = s->len - s->pos;
+    if (n > size) n = size;
+    memcpy(buf, s->data + s->pos, n);
+    s->pos += n;
+    return (ssize_t)n;
+}
+
+static int snap_seek(void *cookie, cookie_off_t *offset, int whence)
+{
+    snapshot_t *s = cookie;
+    cookie_off_t base = whence == SEEK_SET ? 0 : whence == SEEK_CUR ? (cookie_off_t)s->pos
+                                                                    : (cookie_off_t)s->len;
+    cookie_off_t pos = base + *offset;
+    if (pos < 0 || pos > (cookie_off_t)s->len) return -1;
+    s->pos = (size_t)pos;
+    *offset = pos;
+    return 0;
+}
+
+static int snap_close(void *cookie)
+{
+    snapshot_t *s = cookie;
+    heap_caps_free(s->data);
+    free(s);
+    return 0;
+}
+
+FILE *storage_cache_snapshot(char *data, size_t len)
+{
+    snapshot_t *s = calloc(1, sizeof(*s));
+    if (!s) {
+        heap_caps_free(data);
+        return NULL;
+    }
+    s->data = data;
+    s->len = len;
+
+    cookie_io_functions_t io = {
+        .read = snap_read,
+        .seek = snap_seek,
+        .close = snap_close,
+    };
+    FILE *f = fopencookie(s, "r", io);
+    if (!f) snap_close(s);
+    return f;
+}
+
+static char *copy_psram(const char *data, size_t len)
+{
+    char *copy = heap_caps_malloc(len ? len : 1, MALLOC_CAP_SPIRAM);
+    if (copy && len) memcpy(copy, data, len);
+    return copy;
+}
+
+/* ── Reads ───────────────────────────────────────────────────── */
+
+/* Whole file behind f into PSRAM, or NULL with f at its start if it is too big */
+static char *load_file(FILE *f, size_t *len)
+{
+    struct stat st;
+    if (fstat(fileno(f), &st) != 0 || st.st_size < 0 || st.st_size > MIMI_FS_CACHE_FILE_MAX) {
+        return NULL;
+    }
+    char *buf = heap_caps_malloc(st.st_size ? (size_t)st.st_size : 1, MALLOC_CAP_SPIRAM);
+    if (!buf) return NULL;
+    size_t n = fread(buf, 1, (size_t)st.st_size, f);
+    if (ferror(f)) {
+        heap_caps_free(buf);
+        clearerr(f);
+        rewind(f);
+        return NULL;
+    }
+    *len = n;
+    return buf;
+}
+
+FILE *storage_cache_open(const char *path)
+{
+    if (!s_lock) return storage_stats_open(path, "r");
+
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    cache_entry_t *e = find_entry(path);
+    if (e && e->state != ENTRY_EMPTY) {
+        e->hits++;
+        e->stamp = ++s_clock;
+        s_hits++;
+        if (e->state == ENTRY_MISSING) {
+            xSemaphoreGive(s_lock);
+            errno = ENOENT;
+            return NULL;
+        }
+        char *copy = copy_psram(e->data, e->len);
+        size_t len = e->len;
+        xSemaphoreGive(s_lock);
+        return copy ? storage_cache_snapshot(copy, len) : NULL;
+    }
+    e = claim_entry(path);
+    if (e) {
+        e->misses++;
+        e->stamp = ++s_clock;
+    }
+    s_misses++;
+    uint32_t gen = s_gen;
+    xSemaphoreGive(s_lock);
+
+    /* Flash read outside the lock; a write meanwhile bumps s_gen */
+    int64_t t0 = esp_timer_get_time();
+    FILE *f = fopen(path, "r");
+    storage_stats_record(path, STORAGE_OP_OPEN, 0, esp_timer_get_time() - t0);
+    if (!f) {
+        int err = errno;
+        if (err == ENOENT) {
+            xSemaphoreTake(s_lock, portMAX_DELAY);
+            e = gen == s_gen ? claim_entry(path) : NULL;
+            if (e) {
+                drop_entry(e);
+                e->state = ENTRY_MISSING;
+            }
+            xSemaphoreGive(s_lock);
+        }
+        errno = err;
+        return NULL;
+    }
+
+    struct stat st;
+    size_t len = 0;
+    t0 = esp_timer_get_time();
+    char *data = e ? load_file(f, &len) : NULL;
+    if (!data) {
+        xSemaphoreTake(s_lock, portMAX_DELAY);
+        s_bypassed++;
+        xSemaphoreGive(s_lock);
+        return storage_stats_wrap(f, path, "r");
+    }
+    storage_stats_record(path, STORAGE_OP_READ, len, esp_timer_get_time() - t0);
+    bool has_st = fstat(fileno(f), &st) == 0;
+    t0 = esp_timer_get_time();
+    fclose(f);
+    storage_stats_record(path, STORAGE_OP_CLOSE, 0, esp_timer_get_time() - t0);
+
+    char *copy = copy_psram(data, len);
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    e = gen == s_gen ? claim_entry(path) : NULL;
+    if (e && copy) {
+        store(e, copy, len, has_st ? &st : NULL);
+        copy = NULL;
+    }
+    xSemaphoreGive(s_lock);
+    heap_caps_free(copy);
+    return storage_cache_snapshot(data, len);
+}
+
+int storage_cache_stat(const char *path, struct stat *st)
+{
+    if (!s_lock) return stat(path, st);
+
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    cache_entry_t *e = find_entry(path);
+    if (e && (e->state == ENTRY_MISSING || (e->state == ENTRY_DATA && e->has_st))) {
+        e->hits++;
+        s_hits++;
+        bool missing = e->state == ENTRY_MISSING;
+        if (!missing) *st = e->st;
+        xSemaphoreGive(s_lock);
+        if (missing) {
+            errno = ENOENT;
+            return -1;
+        }
+        return 0;
+    }
+    uint32_t gen = s_gen;
+    xSemaphoreGive(s_lock);
+
+    int rc = stat(path, st);
+    if (rc == 0) {
+        /* Content put by a checkpoint arrives without its metadata */
+        xSemaphoreTake(s_lock, portMAX_DELAY);
+        e = gen == s_gen ? find_entry(path) : NULL;
+        if (e && e->state == ENTRY_DATA && (size_t)st->st_size == e->len) {
+            e->st = *st;
+            e->has_st = true;
+        }
+        xSemaphoreGive(s_lock);
+    }
+    return rc;
+}
+
+/* ── Writes ──────────────────────────────────────────────────── */
+
+void storage_cache_put(const char *path, char *data, size_t len)
+{
+    if (!s_lock || len > MIMI_FS_CACHE_FILE_MAX) {
+        heap_caps_free(data);
+        return;
+    }
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    s_gen++;
+    (*version_of(path))++;
+    cache_entry_t *e = claim_entry(path);
+    if (e) {
+        store(e, data, len, NULL);
+        data = NULL;
+    }
+    xSemaphoreGive(s_lock);
+    heap_caps_free(data);
+}
+
+void storage_cache_invalidate(const char *path)
+{
+    if (!s_lock) return;
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    s_gen++;
+    (*version_of(path))++;
+    cache_entry_t *e = find_entry(path);
+    if (e && e->state != ENTRY_EMPTY) {
+        drop_entry(e);
+        s_invalidations++;
+    }
+    xSemaphoreGive(s_lock);
+}
+
+/*
+ * A stream open for writing: reads between its open and its close may see
+ * part of the new content, so the entry is dropped at both ends.
+ */
+typedef struct {
+    FILE *f;
+    char path[MIMI_WAL_PATH_MAX];
+} writer_t;
+
+static ssize_t writer_read(void *cookie, char *buf, size_t size)
+{
+    writer_t *w = cookie;
+    size_t n = fread(buf, 1, size, w->f);
+    return n == 0 && ferror(w->f) ? -1 : (ssize_t)n;
+}
+
+static ssize_t writer_write(void *cookie, const char *buf, size_t size)
+{
+    writer_t *w = cookie;
+    size_t n = fwrite(buf, 1, size, w->f);
+    return n == 0 && size ? -1 : (ssize_t)n;
+}
+
+static int writer_seek(void *cookie, cookie_off_t *offset, int whence)
+{
+    writer_t *w = cookie;
+    if (fseek(w->f, (long)*offset, whence) != 0) return -1;
+    long pos = ftell(w->f);
+    if (pos < 0) return -1;
+    *offset = pos;
+    return 0;
+}
+
+static int writer_close(void *cookie)
+{
+    writer_t *w = cookie;
+    int rc = fclose(w->f);
+    storage_cache_invalidate(w->path);
+    free(w);
+    return rc;
+}
+
+FILE *storage_cache_writer(FILE *f, const char *path)
+{
+    if (!s_lock || !f) return f;
+    storage_cache_invalidate(path);
+    if (strlen(path) >= MIMI_WAL_PATH_MAX) return f;
+
+    writer_t *w = calloc(1, sizeof(*w));
+    if (!w) return f;
+    w->f = f;
+    strcpy(w->path, path);
+
+    cookie_io_functions_t io = {
+        .read = writer_read,
+        .write = writer_write,
+        .seek = writer_seek,
+        .close = writer_close,
+    };
+    FILE *out = fopencookie(w, "r+", io);
+    if (!out) {
+        free(w);
+        return f;
+    }
+    return out;
+}
+
+uint32_t storage_cache_version(const char *path)
+{
+    if (!s_lock) return 0;
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    uint32_t v = *version_of(path);
+    xSemaphoreGive(s_lock);
+    return v;
+}
+
+void storage_cache_reset(void)
+{
+    if (!s_lock) return;
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    s_gen++;
+    for (int i = 0; i < CACHE_VERSION_BUCKETS; i++) s_versions[i]++;
+    for (int i = 0; i < MIMI_FS_CACHE_FILES; i++) drop_entry(&s_entries[i]);
+    xSemaphoreGive(s_lock);
+}
+
+/* ── Stats ───────────────────────────────────────────────────── */
+
+void storage_cache_get_stats(storage_cache_stats_t *out)
+{
+    memset(out, 0, sizeof(*out));
+    if (!s_lock) return;
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    out->hits = s_hits;
+    out->misses = s_misses;
+    out->bypassed = s_bypassed;
+    out->invalidations = s_invalidations;
+    out->evictions = s_evictions;
+    for (int i = 0; i < MIMI_FS_CACHE_FILES; i++) {
+        if (s_entries[i].state != ENTRY_EMPTY) out->files++;
+    }
+    out->bytes = s_bytes;
+    xSemaphoreGive(s_lock);
+}
+
+bool storage_cache_get_file(size_t i, storage_cache_file_t *out)
+{
+    if (!s_lock) return false;
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    const cache_entry_t *found = NULL;
+    for (int j = 0; j < MIMI_FS_CACHE_FILES && !found; j++) {
+        const cache_entry_t *e = &s_entries[j];
+        if (!e->path[0]) continue;
+        /* Rank by recency: i entries read more recently than this one */
+        size_t newer = 0;
+        for (int k = 0; k < MIMI_FS_CACHE_FILES; k++) {
+            if (s_entries[k].path[0] && s_entries[k].stamp > e->stamp) newer++;
+        }
+        if (newer == i) found = e;
+    }
+    if (found) {
+        memset(out, 0, sizeof(*out));
+        strcpy(out->path, found->path);
+        out->hits = found->hits;
+        out->misses = found->misses;
+        out->len = found->len;
+        out->held = found->state != ENTRY_EMPTY;
+        out->missing = found->state == ENTRY_MISSING;
+    }
+    xSemaphoreGive(s_lock);
+    return found != NULL;
+}
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <sys/stat.h>
+#include "esp_err.h"
+#include "mimi_config.h"
+
+/**
+ * Read cache for small files under MIMI_SPIFFS_BASE.
+ *
+ * SOUL.md, USER.md, MEMORY.md, HEARTBEAT.md, cron.json and today's note
+ * are read several times per turn. storage_fopen() serves them from whole
+ * copies in PSRAM, up to MIMI_FS_CACHE_BYTES, evicting the least recently
+ * read. Entries stay current because every write goes through storage_fs
+ * (storage_open/remove/rename) or the write-ahead log: a file opened for
+ * writing is dropped when opened and again when closed, and a checkpoint
+ * hands the version it wrote to the cache.
+ */
+
+typedef struct {
+    uint32_t hits;              /* reads and stats served from PSRAM */
+    uint32_t misses;            /* reads that went to flash */
+    uint32_t bypassed;          /* ... of files over MIMI_FS_CACHE_FILE_MAX */
+    uint32_t invalidations;     /* entries dropped by writes */
+    uint32_t evictions;         /* entries dropped for space */
+    uint32_t files;             /* entries held */
+    size_t bytes;
+} storage_cache_stats_t;
+
+typedef struct {
+    char path[MIMI_WAL_PATH_MAX];
+    uint32_t hits;
+    uint32_t misses;
+    size_t len;
+    bool held;                  /* content (or absence) currently cached */
+    bool missing;               /* ... and the file does not exist */
+} storage_cache_file_t;
+
+esp_err_t storage_cache_init(void);
+
+/** fopen(path, "r"), served from the cache when it holds path. */
+FILE *storage_cache_open(const char *path);
+
+/** stat(path), served from the cache when it holds path. */
+int storage_cache_stat(const char *path, struct stat *st);
+
+/**
+ * Stream over len bytes of PSRAM at data, read-only; data is freed by
+ * fclose().
+ */
+FILE *storage_cache_snapshot(char *data, size_t len);
+
+/** Cache data as the content of path, just written; takes ownership of data. */
+void storage_cache_put(const char *path, char *data, size_t len);
+
+/**
+ * Called by storage_open() for a file opened for writing: drops path now
+ * and returns a stream that drops it again when closed.
+ */
+FILE *storage_cache_writer(FILE *f, const char *path);
+
+/** Drop path after a remove or rename. */
+void storage_cache_invalidate(const char *path);
+
+/**
+ * Number that changes whenever path is written, removed or renamed, for
+ * callers that keep something derived from a file (paths share counters,
+ * so it may also change when another file is written).
+ */
+uint32_t storage_cache_version(const char *path);
+
+/** Drop every entry; hit counts are kept. */
+void storage_cache_reset(void);
+
+void storage_cache_get_stats(storage_cache_stats_t *out);
+
+/** Copy tracked path i, most recently read first; false past the end. */
+bool storage_cache_get_file(size_t i, storage_cache_file_t *out);
@@ -0,0 +1,661 @@
+#include "storage_fs.h"
+#include "storage_cache.h"
+#include "storage_stats.h"
+#include "mimi_config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_heap_caps.h"
+#include "esp_spiffs.h"
+#include "esp_littlefs.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+
+static const char *TAG = "storage_fs";
+
+/*
+ * Names of the files directly in one directory, back to back and
+ * NUL-terminated, in PSRAM. Entries stay valid until evicted: every create,
+ * remove and rename under MIMI_SPIFFS_BASE goes through this module.
+ */
+typedef struct {
+    char dir[MIMI_FS_DIR_PATH_MAX];  /* "" = slot free */
+    char *names;
+    size_t used;
+    size_t cap;
+    uint32_t count;
+    uint32_t stamp;                  /* last use, for eviction */
+} dir_cache_t;
+
+struct storage_dir {
+    char *names;
+    size_t len;
+    size_t pos;
+};
+
+/* Everything below is guarded by s_lock */
+static SemaphoreHandle_t s_lock;
+static storage_fs_backend_t s_backend = STORAGE_FS_SPIFFS;
+static dir_cache_t s_dirs[MIMI_FS_DIR_CACHE_DIRS];
+static uint32_t s_clock;
+static uint32_t s_lists, s_hits, s_scans, s_last_scan_us;
+static uint64_t s_entries_scanned;
+
+static bool take_lock(void)
+{
+    if (!s_lock) s_lock = xSemaphoreCreateMutex();
+    if (!s_lock) return false;
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    return true;
+}
+
+/* ── Mounting ────────────────────────────────────────────────── */
+
+static esp_err_t mount(storage_fs_backend_t backend, bool format)
+{
+    if (backend == STORAGE_FS_LITTLEFS) {
+        esp_vfs_littlefs_conf_t conf = {
+            .base_path = MIMI_SPIFFS_BASE,
+            .partition_label = MIMI_FS_PARTITION,
+            .format_if_mount_failed = format,
+        };
+        return esp_vfs_littlefs_register(&conf);
+    }
+    esp_vfs_spiffs_conf_t conf = {
+        .base_path = MIMI_SPIFFS_BASE,
+        .partition_label = MIMI_FS_PARTITION,
+        .max_files = MIMI_FS_MAX_OPEN_FILES,
+        .format_if_mount_failed = format,
+    };
+    return esp_vfs_spiffs_register(&conf);
+}
+
+static void unmount(storage_fs_backend_t backend)
+{
+    if (backend == STORAGE_FS_LITTLEFS) {
+        esp_vfs_littlefs_unregister(MIMI_FS_PARTITION);
+    } else {
+        esp_vfs_spiffs_unregister(MIMI_FS_PARTITION);
+    }
+}
+
+/* Mount backend on a partition that may hold the other one, then wipe it */
+static esp_err_t format_as(storage_fs_backend_t backend)
+{
+    esp_err_t err = mount(backend, true);
+    if (err != ESP_OK) return err;
+    err = backend == STORAGE_FS_LITTLEFS ? esp_littlefs_format(MIMI_FS_PARTITION)
+                                         : esp_spiffs_format(MIMI_FS_PARTITION);
+    if (err != ESP_OK) unmount(backend);
+    return err;
+}
+
+static void make_dirs(void)
+{
+    static const char *const dirs[] = {
+        MIMI_SPIFFS_CONFIG_DIR, MIMI_SPIFFS_MEMORY_DIR, MIMI_SPIFFS_SESSION_DIR,
+        MIMI_SKILLS_DIR, MIMI_NOTES_ROLLUP_DIR,
+    };
+    if (s_backend != STORAGE_FS_LITTLEFS) return;
+    for (size_t i = 0; i < sizeof(dirs) / sizeof(dirs[0]); i++) {
+        if (mkdir(dirs[i], 0755) != 0 && errno != EEXIST) {
+            ESP_LOGW(TAG, "Cannot create %s: %d", dirs[i], errno);
+        }
+    }
+}
+
+const char *storage_fs_backend_name(storage_fs_backend_t backend)
+{
+    return backend == STORAGE_FS_LITTLEFS ? "littlefs" : "spiffs";
+}
+
+bool storage_fs_parse_backend(const char *name, storage_fs_backend_t *out)
+{
+    if (!name) return false;
+    if (strcmp(name, "spiffs") == 0) {
+        *out = STORAGE_FS_SPIFFS;
+    } else if (strcmp(name, "littlefs") == 0) {
+        *out = STORAGE_FS_LITTLEFS;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+storage_fs_backend_t storage_fs_backend(void)
+{
+    return s_backend;
+}
+
+esp_err_t storage_fs_info(size_t *total, size_t *used)
+{
+    if (s_backend == STORAGE_FS_LITTLEFS) {
+        return esp_littlefs_info(MIMI_FS_PARTITION, total, used);
+    }
+    return esp_spiffs_info(MIMI_FS_PARTITION, total, used);
+}
+
+esp_err_t storage_fs_mount(storage_fs_backend_t preferred)
+{
+    if (!s_lock) s_lock = xSemaphoreCreateMutex();
+    if (!s_lock) return ESP_ERR_NO_MEM;
+
+    storage_fs_backend_t other = preferred == STORAGE_FS_LITTLEFS ? STORAGE_FS_SPIFFS
+                                                                  : STORAGE_FS_LITTLEFS;
+    storage_fs_backend_t backend = preferred;
+    esp_err_t err = mount(preferred, false);
+    if (err != ESP_OK) {
+        backend = other;
+        err = mount(other, false);
+    }
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "No filesystem found, formatting as %s", storage_fs_backend_name(preferred));
+        backend = preferred;
+        err = mount(preferred, true);
+    }
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Mount failed: %s", esp_err_to_name(err));
+        return err;
+    }
+    s_backend = backend;
+    make_dirs();
+
+    size_t total = 0, used = 0;
+    storage_fs_info(&total, &used);
+    ESP_LOGI(TAG, "%s: total=%d, used=%d", storage_fs_backend_name(backend), (int)total, (int)used);
+    return ESP_OK;
+}
+
+/* ── Directory cache ─────────────────────────────────────────── */
+
+/* Split path into its directory and leaf name; false if it has no '/' */
+static bool split_path(const char *path, char *dir, size_t size, const char **leaf)
+{
+    const char *slash = strrchr(path, '/');
+    if (!slash || (size_t)(slash - path) >= size) return false;
+    memcpy(dir, path, slash - path);
+    dir[slash - path] = '\0';
+    *leaf = slash + 1;
+    return true;
+}
+
+static dir_cache_t *find_dir(const char *dir)
+{
+    for (int i = 0; i < MIMI_FS_DIR_CACHE_DIRS; i++) {
+        if (s_dirs[i].dir[0] && strcmp(s_dirs[i].dir, dir) == 0) return &s_dirs[i];
+    }
+    return NULL;
+}
+
+static void drop_dir(dir_cache_t *c)
+{
+    heap_caps_free(c->names);
+    memset(c, 0, sizeof(*c));
+}
+
+static char *find_name(dir_cache_t *c, const char *name)
+{
+    for (size_t off = 0; off < c->used;) {
+        char *n = c->names + off;
+        if (strcmp(n, name) == 0) return n;
+        off += strlen(n) + 1;
+    }
+    return NULL;
+}
+
+static bool add_name(dir_cache_t *c, const char *name)
+{
+    size_t len = strlen(name) + 1;
+    if (c->used + len > c->cap) {
+        size_t cap = c->cap ? c->cap * 2 : 512;
+        while (cap < c->used + len) cap *= 2;
+        char *n = heap_caps_realloc(c->names, cap, MALLOC_CAP_SPIRAM);
+        if (!n) return false;
+        c->names = n;
+        c->cap = cap;
+    }
+    memcpy(c->names + c->used, name, len);
+    c->used += len;
+    c->count++;
+    return true;
+}
+
+static void remove_name(dir_cache_t *c, char *n)
+{
+    size_t len = strlen(n) + 1;
+    size_t tail = c->used - (size_t)(n - c->names) - len;
+    memmove(n, n + len, tail);
+    c->used -= len;
+    c->count--;
+}
+
+/* Keep a cached directory in step with a file created in it */
+static void note_created(const char *path)
+{
+    char dir[MIMI_FS_DIR_PATH_MAX];
+    const char *leaf;
+    if (!split_path(path, dir, sizeof(dir), &leaf)) return;
+    dir_cache_t *c = find_dir(dir);
+    if (!c || find_name(c, leaf)) return;
+    /* Out of memory: forget the directory rather than serve it incomplete */
+    if (!add_name(c, leaf)) drop_dir(c);
+}
+
+static void note_removed(const char *path)
+{
+    char dir[MIMI_FS_DIR_PATH_MAX];
+    const char *leaf;
+    if (!split_path(path, dir, sizeof(dir), &leaf)) return;
+    dir_cache_t *c = find_dir(dir);
+    char *n = c ? find_name(c, leaf) : NULL;
+    if (n) remove_name(c, n);
+}
+
+static bool is_dir(const char *path, const struct dirent *e)
+{
+    if (e->d_type == DT_DIR) return true;
+    if (e->d_type != DT_UNKNOWN) return false;
+    struct stat st;
+    return stat(path, &st) == 0 && S_ISDIR(st.st_mode);
+}
+
+/*
+ * Read dir's file names into c. SPIFFS lists every file on the partition
+ * with its embedded slashes, so the scan walks all of them and keeps the
+ * ones one level below dir; LittleFS reads the directory itself.
+ */
+static esp_err_t scan_dir(dir_cache_t *c, const char *dir)
+{
+    int64_t t0 = esp_timer_get_time();
+    uint64_t visited = 0;
+    esp_err_t err = ESP_OK;
+
+    if (s_backend == STORAGE_FS_LITTLEFS) {
+        DIR *d = opendir(dir);
+        struct dirent *e;
+        while (d && (e = readdir(d)) != NULL) {
+            visited++;
+            if (e->d_name[0] == '.') continue;
+            char path[MIMI_FS_DIR_PATH_MAX + 256];
+            snprintf(path, sizeof(path), "%s/%s", dir, e->d_name);
+            if (is_dir(path, e)) continue;
+            if (!add_name(c, e->d_name)) {
+                err = ESP_ERR_NO_MEM;
+                break;
+            }
+        }
+        if (d) closedir(d);
+    } else {
+        const char *rel = "";
+        size_t base_len = strlen(MIMI_SPIFFS_BASE);
+        if (strncmp(dir, MIMI_SPIFFS_BASE, base_len) == 0 && dir[base_len] == '/') {
+            rel = dir + base_len + 1;
+        }
+        size_t rel_len = strlen(rel);
+
+        DIR *d = opendir(MIMI_SPIFFS_BASE);
+        if (!d) return ESP_FAIL;
+        struct dirent *e;
+        while ((e = readdir(d)) != NULL) {
+            visited++;
+            const char *name = e->d_name;
+            if (rel_len) {
+                if (strncmp(name, rel, rel_len) != 0 || name[rel_len] != '/') continue;
+                name += rel_len + 1;
+            }
+            if (!name[0] || strchr(name, '/')) continue;
+            if (!add_name(c, name)) {
+                err = ESP_ERR_NO_MEM;
+                break;
+            }
+        }
+        closedir(d);
+    }
+
+    s_scans++;
+    s_entries_scanned += visited;
+    s_last_scan_us = (uint32_t)(esp_timer_get_time() - t0);
+    char entry[MIMI_FS_DIR_PATH_MAX + 1];
+    snprintf(entry, sizeof(entry), "%s/", dir);
+    storage_stats_record(entry, STORAGE_OP_META, 0, s_last_scan_us);
+    return err;
+}
+
+static dir_cache_t *load_dir(const char *dir)
+{
+    dir_cache_t *c = find_dir(dir);
+    if (c) {
+        s_hits++;
+        c->stamp = ++s_clock;
+        return c;
+    }
+    if (strlen(dir) >= MIMI_FS_DIR_PATH_MAX) return NULL;
+
+    /* Free slot, else the least recently listed directory */
+    c = &s_dirs[0];
+    for (int i = 0; i < MIMI_FS_DIR_CACHE_DIRS; i++) {
+        if (!s_dirs[i].dir[0]) {
+            c = &s_dirs[i];
+            break;
+        }
+        if (s_dirs[i].stamp < c->stamp) c = &s_dirs[i];
+    }
+    drop_dir(c);
+    if (scan_dir(c, dir) != ESP_OK) {
+        drop_dir(c);
+        return NULL;
+    }
+    snprintf(c->dir, sizeof(c->dir), "%s", dir);
+    c->stamp = ++s_clock;
+    return c;
+}
+
+storage_dir_t *storage_opendir(const char *dir)
+{
+    storage_dir_t *d = heap_caps_calloc(1, sizeof(*d), MALLOC_CAP_SPIRAM);
+    if (!d || !take_lock()) {
+        heap_caps_free(d);
+        return NULL;
+    }
+    s_lists++;
+
+    dir_cache_t *c = load_dir(dir);
+    if (c && c->used) {
+        d->names = heap_caps_malloc(c->used, MALLOC_CAP_SPIRAM);
+        if (d->names) {
+            memcpy(d->names, c->names, c->used);
+            d->len = c->used;
+        }
+    }
+    xSemaphoreGive(s_lock);
+
+    if (!c || (c->used && !d->names)) {
+        heap_caps_free(d);
+        return NULL;
+    }
+    return d;
+}
+
+const char *storage_readdir(storage_dir_t *d)
+{
+    if (!d || d->pos >= d->len) return NULL;
+    const char *name = d->names + d->pos;
+    d->pos += strlen(name) + 1;
+    return name;
+}
+
+void storage_closedir(storage_dir_t *d)
+{
+    if (!d) return;
+    heap_caps_free(d->names);
+    heap_caps_free(d);
+}
+
+void storage_fs_cache_reset(void)
+{
+    if (!take_lock()) return;
+    for (int i = 0; i < MIMI_FS_DIR_CACHE_DIRS; i++) drop_dir(&s_dirs[i]);
+    xSemaphoreGive(s_lock);
+}
+
+void storage_fs_get_stats(storage_fs_stats_t *out)
+{
+    memset(out, 0, sizeof(*out));
+    if (!take_lock()) return;
+    out->lists = s_lists;
+    out->hits = s_hits;
+    out->scans = s_scans;
+    out->entries_scanned = s_entries_scanned;
+    out->last_scan_us = s_last_scan_us;
+    for (int i = 0; i < MIMI_FS_DIR_CACHE_DIRS; i++) {
+        if (!s_dirs[i].dir[0]) continue;
+        out->cached_dirs++;
+        out->cached_names += s_dirs[i].count;
+        out->cached_bytes += s_dirs[i].cap;
+    }
+    xSemaphoreGive(s_lock);
+}
+
+/* ── Walk ────────────────────────────────────────────────────── */
+
+static bool walk_tree(const char *dir, const char *prefix, storage_walk_cb_t cb, void *arg)
+{
+    DIR *d = opendir(dir);
+    if (!d) return true;
+    bool more = true;
+    struct dirent *e;
+    while (more && (e = readdir(d)) != NULL) {
+        if (e->d_name[0] == '.') continue;
+        char path[MIMI_FS_DIR_PATH_MAX + 256];
+        snprintf(path, sizeof(path), "%s/%s", dir, e->d_name);
+        size_t len = strlen(path);
+        if (is_dir(path, e)) {
+            /* Only descend where the prefix can still match */
+            size_t n = prefix ? strlen(prefix) : 0;
+            if (!prefix || strncmp(path, prefix, len < n ? len : n) == 0) {
+                more = walk_tree(path, prefix, cb, arg);
+            }
+        } else if (!prefix || strncmp(path, prefix, strlen(prefix)) == 0) {
+            more = cb(path, arg);
+        }
+    }
+    closedir(d);
+    return more;
+}
+
+esp_err_t storage_walk(const char *prefix, storage_walk_cb_t cb, void *arg)
+{
+    if (s_backend == STORAGE_FS_LITTLEFS) {
+        struct stat st;
+        if (stat(MIMI_SPIFFS_BASE, &st) != 0) return ESP_FAIL;
+        walk_tree(MIMI_SPIFFS_BASE, prefix, cb, arg);
+        return ESP_OK;
+    }
+
+    DIR *d = opendir(MIMI_SPIFFS_BASE);
+    if (!d) return ESP_FAIL;
+    struct dirent *e;
+    while ((e = readdir(d)) != NULL) {
+        char path[MIMI_FS_DIR_PATH_MAX + 256];
+        snprintf(path, sizeof(path), "%s/%s", MIMI_SPIFFS_BASE, e->d_name);
+        if (prefix && strncmp(path, prefix, strlen(prefix)) != 0) continue;
+        if (!cb(path, arg)) break;
+    }
+    closedir(d);
+    return ESP_OK;
+}
+
+/* ── Files ───────────────────────────────────────────────────── */
+
+static void make_parents(const char *path)
+{
+    size_t base_len = strlen(MIMI_SPIFFS_BASE);
+    if (strncmp(path, MIMI_SPIFFS_BASE, base_len) != 0 || path[base_len] != '/') return;
+    char dir[MIMI_FS_DIR_PATH_MAX + 256];
+    snprintf(dir, sizeof(dir), "%s", path);
+    for (char *p = dir + base_len + 1; *p; p++) {
+        if (*p != '/') continue;
+        *p = '\0';
+        if (mkdir(dir, 0755) != 0 && errno != EEXIST) return;
+        *p = '/';
+    }
+}
+
+FILE *storage_open(const char *path, const char *mode)
+{
+    FILE *f = storage_stats_open(path, mode);
+    if (!f && s_backend == STORAGE_FS_LITTLEFS && mode[0] != 'r') {
+        make_parents(path);
+        f = storage_stats_open(path, mode);
+    }
+    if (!f || (mode[0] == 'r' && !strchr(mode, '+'))) return f;
+    if (mode[0] != 'r' && take_lock()) {
+        note_created(path);
+        xSemaphoreGive(s_lock);
+    }
+    FILE *out = storage_cache_writer(f, path);
+    /* The writer's stream buffers; a second buffer under it only copies */
+    if (out != f) setvbuf(f, NULL, _IONBF, 0);
+    return out;
+}
+
+int storage_remove(const char *path)
+{
+    int64_t t0 = esp_timer_get_time();
+    int rc = remove(path);
+    storage_stats_record(path, STORAGE_OP_META, 0, esp_timer_get_time() - t0);
+    storage_cache_invalidate(path);
+    if (rc == 0 && take_lock()) {
+        note_removed(path);
+        xSemaphoreGive(s_lock);
+    }
+    return rc;
+}
+
+int storage_rename(const char *from, const char *to)
+{
+    int64_t t0 = esp_timer_get_time();
+    int rc = rename(from, to);
+    storage_stats_record(to, STORAGE_OP_META, 0, esp_timer_get_time() - t0);
+    storage_cache_invalidate(from);
+    storage_cache_invalidate(to);
+    if (rc == 0 && take_lock()) {
+        note_removed(from);
+        note_created(to);
+        xSemaphoreGive(s_lock);
+    }
+    return rc;
+}
+
+/* ── Migration ───────────────────────────────────────────────── */
+
+typedef struct {
+    char *path;
+    char *data;
+    size_t len;
+} mig_file_t;
+
+typedef struct {
+    mig_file_t *files;
+    int count;
+    size_t bytes;
+    esp_err_t err;
+} mig_set_t;
+
+static bool stage_file(const char *path, void *arg)
+{
+    mig_set_t *set = arg;
+    if (set->count >= MIMI_FS_MIGRATE_MAX_FILES) {
+        set->err = ESP_ERR_NO_MEM;
+        return false;
+    }
+
+    FILE *f = storage_open(path, "rb");
+    if (!f) {
+        set->err = ESP_FAIL;
+        return false;
+    }
+    struct stat st;
+    size_t len = stat(path, &st) == 0 ? (size_t)st.st_size : 0;
+    char *data = NULL;
+    if (set->bytes + len > MIMI_FS_MIGRATE_MAX_BYTES ||
+        (len && !(data = heap_caps_malloc(len, MALLOC_CAP_SPIRAM))) ||
+        fread(data, 1, len, f) != len) {
+        fclose(f);
+        heap_caps_free(data);
+        ESP_LOGE(TAG, "Cannot stage %s (%d bytes)", path, (int)len);
+        set->err = ESP_ERR_NO_MEM;
+        return false;
+    }
+    fclose(f);
+
+    mig_file_t *m = &set->files[set->count];
+    m->path = heap_caps_malloc(strlen(path) + 1, MALLOC_CAP_SPIRAM);
+    if (!m->path) {
+        heap_caps_free(data);
+        set->err = ESP_ERR_NO_MEM;
+        return false;
+    }
+    strcpy(m->path, path);
+    m->data = data;
+    m->len = len;
+    set->count++;
+    set->bytes += len;
+    return true;
+}
+
+static esp_err_t restore_files(const mig_set_t *set)
+{
+    for (int i = 0; i < set->count; i++) {
+        const mig_file_t *m = &set->files[i];
+        FILE *f = storage_open(m->path, "wb");
+        if (!f) {
+            ESP_LOGE(TAG, "Cannot write %s", m->path);
+            return ESP_FAIL;
+        }
+        size_t n = m->len ? fwrite(m->data, 1, m->len, f) : 0;
+        if (fclose(f) != 0 || n != m->len) {
+            ESP_LOGE(TAG, "Short write to %s", m->path);
+            return ESP_FAIL;
+        }
+    }
+    return ESP_OK;
+}
+
+/* Reformat as backend and copy the staged files in */
+static esp_err_t rebuild(storage_fs_backend_t backend, const mig_set_t *set)
+{
+    esp_err_t err = format_as(backend);
+    if (err != ESP_OK) return err;
+    s_backend = backend;
+    storage_fs_cache_reset();
+    storage_cache_reset();
+    make_dirs();
+    return restore_files(set);
+}
+
+esp_err_t storage_fs_migrate(storage_fs_backend_t target, int *files_out, size_t *bytes_out)
+{
+    storage_fs_backend_t from = s_backend;
+    if (target == from) return ESP_ERR_INVALID_STATE;
+
+    mig_set_t set = {
+        .files = heap_caps_calloc(MIMI_FS_MIGRATE_MAX_FILES, sizeof(mig_file_t), MALLOC_CAP_SPIRAM),
+    };
+    if (!set.files) return ESP_ERR_NO_MEM;
+
+    int64_t t0 = esp_timer_get_time();
+    esp_err_t err = storage_walk(NULL, stage_file, &set);
+    if (err == ESP_OK) err = set.err;
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Staging failed after %d files: %s", set.count, esp_err_to_name(err));
+    } else {
+        unmount(from);
+        err = rebuild(target, &set);
+        if (err != ESP_OK) {
+            ESP_LOGE(TAG, "Migration to %s failed (%s), restoring %s",
+                     storage_fs_backend_name(target), esp_err_to_name(err),
+                     storage_fs_backend_name(from));
+            unmount(target);
+            if (rebuild(from, &set) != ESP_OK) ESP_LOGE(TAG, "Restore failed");
+        } else {
+            ESP_LOGI(TAG, "Migrated %d files, %d bytes to %s in %d ms", set.count, (int)set.bytes,
+                     storage_fs_backend_name(target), (int)((esp_timer_get_time() - t0) / 1000));
+        }
+    }
+
+    if (files_out) *files_out = set.count;
+    if (bytes_out) *bytes_out = set.bytes;
+    for (int i = 0; i < set.count; i++) {
+        heap_caps_free(set.files[i].path);
+        heap_caps_free(set.files[i].data);
+    }
+    heap_caps_free(set.files);
+    return err;
+}
@@ -0,0 +1,97 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include "esp_err.h"
+
+/**
+ * Filesystem under MIMI_SPIFFS_BASE.
+ *
+ * The data partition holds either SPIFFS, which is flat ("skills/x.md" is
+ * one object and readdir() of the mount point lists every file), or
+ * LittleFS, which has real directories. Firmware code lists, creates,
+ * removes and renames files through this module so it works on both, and
+ * directory listings are served from an in-RAM cache of file names that
+ * those calls keep current.
+ */
+
+typedef enum {
+    STORAGE_FS_SPIFFS = 0,
+    STORAGE_FS_LITTLEFS,
+} storage_fs_backend_t;
+
+typedef struct {
+    uint32_t lists;             /* storage_opendir() calls */
+    uint32_t hits;              /* ... served from the cache */
+    uint32_t scans;             /* ... that read the filesystem */
+    uint64_t entries_scanned;   /* directory entries those scans visited */
+    uint32_t last_scan_us;
+    uint32_t cached_dirs;
+    uint32_t cached_names;
+    size_t cached_bytes;
+} storage_fs_stats_t;
+
+typedef struct storage_dir storage_dir_t;
+
+/**
+ * Mount the data partition at MIMI_SPIFFS_BASE. Tries the preferred backend,
+ * then the other one, so a partition flashed or migrated to either format
+ * mounts as it is; formats with the preferred backend only if neither
+ * mounts.
+ */
+esp_err_t storage_fs_mount(storage_fs_backend_t preferred);
+
+/** Backend currently mounted. */
+storage_fs_backend_t storage_fs_backend(void);
+
+const char *storage_fs_backend_name(storage_fs_backend_t backend);
+
+/** Parse "spiffs" / "littlefs". */
+bool storage_fs_parse_backend(const char *name, storage_fs_backend_t *out);
+
+/** Partition size and use, as esp_spiffs_info() reports them. */
+esp_err_t storage_fs_info(size_t *total, size_t *used);
+
+/**
+ * List the regular files directly in dir (an absolute path under
+ * MIMI_SPIFFS_BASE). storage_readdir() returns their names without the
+ * directory, in no particular order, and NULL at the end. The listing is a
+ * snapshot: files created or removed while it is open are not reflected.
+ */
+storage_dir_t *storage_opendir(const char *dir);
+const char *storage_readdir(storage_dir_t *d);
+void storage_closedir(storage_dir_t *d);
+
+/**
+ * Call cb with the absolute path of every file under MIMI_SPIFFS_BASE that
+ * starts with prefix (NULL = all), until it returns false. Not cached.
+ */
+typedef bool (*storage_walk_cb_t)(const char *path, void *arg);
+esp_err_t storage_walk(const char *prefix, storage_walk_cb_t cb, void *arg);
+
+/**
+ * fopen() for files under MIMI_SPIFFS_BASE. Creating a file makes its
+ * parent directories on LittleFS and adds it to the directory cache; a
+ * file opened for writing leaves the read cache (storage_cache.h).
+ */
+FILE *storage_open(const char *path, const char *mode);
+
+/** remove() / rename() that keep the directory and read caches current. */
+int storage_remove(const char *path);
+int storage_rename(const char *from, const char *to);
+
+/** Drop the directory cache; the next listing of each directory scans. */
+void storage_fs_cache_reset(void);
+
+void storage_fs_get_stats(storage_fs_stats_t *out);
+
+/**
+ * Copy every file into PSRAM, reformat the partition as target and write
+ * them back. The caller checkpoints the write-ahead log and flushes
+ * buffered session appends first, and restarts afterwards so every module
+ * reopens its files. If the copy-back fails the partition is restored to
+ * the old backend from the same PSRAM copy.
+ */
+esp_err_t storage_fs_migrate(storage_fs_backend_t target, int *files_out, size_t *bytes_out);
@@ -0,0 +1,623 @@
+#include "storage_log.h"
+#include "storage_cache.h"
+#include "storage_stats.h"
+#include "storage_fs.h"
+#include "mimi_config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_system.h"
+#include "esp_heap_caps.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+
+static const char *TAG = "storage";
+
+/*
+ * Log record: header, path, then the bytes that changed. A new version is
+ * keep_head bytes from the start of the previous one, data_len new bytes,
+ * and keep_tail bytes from the end of the previous one, so an edit of one
+ * line in MEMORY.md logs that line, not the file. The previous version is
+ * the pending one, or the file on flash for a path's first record since a
+ * checkpoint; base_check identifies it, so replay skips records whose base
+ * a checkpoint has already replaced. check covers the header fields
+ * before it, the path and the data, so a record torn by a reset fails it
+ * and ends the replay.
+ */
+typedef struct __attribute__((packed)) {
+    uint32_t magic;
+    uint32_t seq;
+    uint16_t path_len;
+    uint16_t reserved;
+    uint32_t keep_head;
+    uint32_t keep_tail;
+    uint32_t data_len;
+    uint32_t base_check;
+    uint32_t check;
+} wal_hdr_t;
+
+#define WAL_MAGIC 0x4C41574Du   /* "MWAL" */
+#define FNV_BASIS 2166136261u
+
+/* Latest logged version of a file that has not reached it yet */
+typedef struct {
+    char path[MIMI_WAL_PATH_MAX];
+    char *data;                  /* PSRAM */
+    size_t len;
+    uint32_t check;              /* fnv1a32 of data, the next record's base_check */
+} wal_pending_t;
+
+/* Everything below is guarded by s_lock */
+static SemaphoreHandle_t s_lock;
+static SemaphoreHandle_t s_wake;
+static TaskHandle_t s_task;
+static wal_pending_t s_pending[MIMI_WAL_MAX_FILES];
+static int s_pending_count;
+static size_t s_pending_bytes;
+static size_t s_log_bytes;
+static uint32_t s_seq;
+
+static uint32_t s_writes, s_coalesced, s_checkpoints, s_files_written, s_replayed;
+static uint32_t s_max_write_us, s_last_checkpoint_us;
+static uint64_t s_bytes_in, s_bytes_logged;
+
+static uint32_t fnv1a32(uint32_t h, const void *data, size_t len)
+{
+    const uint8_t *p = data;
+    for (size_t i = 0; i < len; i++) {
+        h ^= p[i];
+        h *= 16777619u;
+    }
+    return h;
+}
+
+static uint32_t record_check(const wal_hdr_t *hdr, const char *path, const void *data)
+{
+    uint32_t h = fnv1a32(FNV_BASIS, hdr, offsetof(wal_hdr_t, check));
+    h = fnv1a32(h, path, hdr->path_len);
+    return fnv1a32(h, data, hdr->data_len);
+}
+
+static wal_pending_t *find_pending(const char *path)
+{
+    for (int i = 0; i < s_pending_count; i++) {
+        if (strcmp(s_pending[i].path, path) == 0) return &s_pending[i];
+    }
+    return NULL;
+}
+
+/* ── Flash files ─────────────────────────────────────────────── */
+
+static void tmp_path(const char *path, char *buf, size_t size)
+{
+    snprintf(buf, size, "%s.tmp", path);
+}
+
+/*
+ * LittleFS renames over the old file atomically; SPIFFS rename() will not
+ * replace an existing file, and if a reset falls between the remove and
+ * the rename, replay or recover_tmp() finishes it.
+ */
+static esp_err_t move_into_place(const char *tmp, const char *path)
+{
+    if (storage_fs_backend() != STORAGE_FS_LITTLEFS) storage_remove(path);
+    if (storage_rename(tmp, path) != 0) {
+        ESP_LOGE(TAG, "Cannot rename %s", tmp);
+        return ESP_FAIL;
+    }
+    return ESP_OK;
+}
+
+/* Replace path through a temporary file, so a reset leaves the old or the
+   new content */
+static esp_err_t write_whole(const char *path, const void *data, size_t len)
+{
+    char tmp[MIMI_WAL_PATH_MAX + 8];
+    tmp_path(path, tmp, sizeof(tmp));
+
+    FILE *f = storage_open(tmp, "w");
+    if (!f) {
+        ESP_LOGE(TAG, "Cannot write %s", tmp);
+        return ESP_FAIL;
+    }
+    size_t n = len ? fwrite(data, 1, len, f) : 0;
+    if (fclose(f) != 0 || n != len) {
+        ESP_LOGE(TAG, "Short write to %s (%d of %d bytes)", tmp, (int)n, (int)len);
+        storage_remove(tmp);
+        return ESP_FAIL;
+    }
+    if (move_into_place(tmp, path) != ESP_OK) return ESP_FAIL;
+    s_files_written++;
+    return ESP_OK;
+}
+
+/* Whole content of path on flash into PSRAM; a missing file is empty */
+static esp_err_t read_flash(const char *path, char **out, size_t *len)
+{
+    *out = NULL;
+    *len = 0;
+    FILE *f = storage_cache_open(path);
+    if (!f) return ESP_OK;
+
+    fseek(f, 0, SEEK_END);
+    long size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    if (size < 0 || size > MIMI_WAL_PENDING_BYTES) {
+        fclose(f);
+        return ESP_ERR_INVALID_SIZE;
+    }
+    char *buf = heap_caps_malloc(size ? (size_t)size : 1, MALLOC_CAP_SPIRAM);
+    if (!buf) {
+        fclose(f);
+        return ESP_ERR_NO_MEM;
+    }
+    size_t n = fread(buf, 1, (size_t)size, f);
+    fclose(f);
+    *out = buf;
+    *len = n;
+    return ESP_OK;
+}
+
+/* ── Checkpoint ──────────────────────────────────────────────── */
+
+static esp_err_t checkpoint_locked(void)
+{
+    if (s_pending_count == 0 && s_log_bytes == 0) return ESP_OK;
+
+    int64_t t0 = esp_timer_get_time();
+    int kept = 0;
+    for (int i = 0; i < s_pending_count; i++) {
+        wal_pending_t *p = &s_pending[i];
+        if (write_whole(p->path, p->data, p->len) != ESP_OK) {
+            s_pending[kept++] = *p;
+            continue;
+        }
+        s_pending_bytes -= p->len;
+        /* The version just written is what the next read would load */
+        storage_cache_put(p->path, p->data, p->len);
+    }
+    s_pending_count = kept;
+
+    /* A file that failed keeps its records: the next checkpoint or the
+       next boot's replay retries it */
+    if (kept > 0) return ESP_FAIL;
+
+    storage_remove(MIMI_WAL_FILE);
+    s_log_bytes = 0;
+    s_checkpoints++;
+    s_last_checkpoint_us = (uint32_t)(esp_timer_get_time() - t0);
+    return ESP_OK;
+}
+
+esp_err_t storage_checkpoint(void)
+{
+    if (!s_lock) return ESP_ERR_INVALID_STATE;
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    esp_err_t err = checkpoint_locked();
+    xSemaphoreGive(s_lock);
+    return err;
+}
+
+esp_err_t storage_sync_file(const char *path)
+{
+    if (!s_lock) return ESP_OK;
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    esp_err_t err = find_pending(path) ? checkpoint_locked() : ESP_OK;
+    xSemaphoreGive(s_lock);
+    return err;
+}
+
+/* ── Streamed replacements ───────────────────────────────────── */
+
+FILE *storage_open_replacement(const char *path)
+{
+    char tmp[MIMI_WAL_PATH_MAX + 8];
+    tmp_path(path, tmp, sizeof(tmp));
+    return storage_open(tmp, "w");
+}
+
+esp_err_t storage_commit_replacement(const char *path, FILE *f)
+{
+    char tmp[MIMI_WAL_PATH_MAX + 8];
+    tmp_path(path, tmp, sizeof(tmp));
+    if (fclose(f) != 0) {
+        ESP_LOGE(TAG, "Short write to %s", tmp);
+        storage_remove(tmp);
+        return ESP_FAIL;
+    }
+
+    if (s_lock) xSemaphoreTake(s_lock, portMAX_DELAY);
+    /* Logged versions of path go out first, so neither the next
+       checkpoint nor a replay can put one back over the replacement */
+    esp_err_t err = s_lock && find_pending(path) ? checkpoint_locked() : ESP_OK;
+    if (err == ESP_OK) err = move_into_place(tmp, path);
+    if (err == ESP_OK) s_files_written++;
+    if (s_lock) xSemaphoreGive(s_lock);
+
+    if (err != ESP_OK) storage_remove(tmp);
+    return err;
+}
+
+void storage_discard_replacement(const char *path, FILE *f)
+{
+    char tmp[MIMI_WAL_PATH_MAX + 8];
+    tmp_path(path, tmp, sizeof(tmp));
+    fclose(f);
+    storage_remove(tmp);
+}
+
+static void checkpoint_task(void *arg)
+{
+    (void)arg;
+    while (1) {
+        /* Woken when the log outgrows MIMI_WAL_CHECKPOINT_BYTES; otherwise
+           the log is durable, so the timer only bounds replay work */
+        xSemaphoreTake(s_wake, pdMS_TO_TICKS(MIMI_WAL_CHECKPOINT_MS));
+        storage_checkpoint();
+        storage_stats_sample_space(false);
+    }
+}
+
+static void storage_shutdown(void)
+{
+    storage_checkpoint();
+}
+
+/* ── Writes ──────────────────────────────────────────────────── */
+
+static esp_err_t append_record(wal_hdr_t *hdr, const char *path, const char *data)
+{
+    hdr->magic = WAL_MAGIC;
+    hdr->seq = ++s_seq;
+    hdr->path_len = (uint16_t)strlen(path);
+    hdr->check = record_check(hdr, path, data);
+
+    FILE *f = storage_open(MIMI_WAL_FILE, "a");
+    if (!f) return ESP_FAIL;
+    bool ok = fwrite(hdr, sizeof(*hdr), 1, f) == 1 &&
+              fwrite(path, 1, hdr->path_len, f) == hdr->path_len &&
+              (hdr->data_len == 0 || fwrite(data, 1, hdr->data_len, f) == hdr->data_len);
+    if (fclose(f) != 0) ok = false;
+    if (!ok) return ESP_FAIL;
+
+    size_t bytes = sizeof(*hdr) + hdr->path_len + hdr->data_len;
+    s_log_bytes += bytes;
+    s_bytes_logged += bytes;
+    return ESP_OK;
+}
+
+/* Header for the change from base to data: common prefix and suffix kept */
+static void diff(const char *base, size_t base_len, const char *data, size_t len,
+                 wal_hdr_t *hdr)
+{
+    size_t max = base_len < len ? base_len : len;
+    size_t head = 0;
+    while (head < max && base[head] == data[head]) head++;
+    size_t tail = 0;
+    while (tail < max - head && base[base_len - 1 - tail] == data[len - 1 - tail]) tail++;
+
+    memset(hdr, 0, sizeof(*hdr));
+    hdr->keep_head = (uint32_t)head;
+    hdr->keep_tail = (uint32_t)tail;
+    hdr->data_len = (uint32_t)(len - head - tail);
+}
+
+esp_err_t storage_write_file(const char *path, const void *data, size_t len)
+{
+    if (!path || (!data && len)) return ESP_ERR_INVALID_ARG;
+    if (!s_lock) return write_whole(path, data, len);
+
+    bool direct = strlen(path) >= MIMI_WAL_PATH_MAX || len > MIMI_WAL_PENDING_BYTES;
+    char *copy = direct ? NULL : heap_caps_malloc(len ? len : 1, MALLOC_CAP_SPIRAM);
+    if (!direct && !copy) return ESP_ERR_NO_MEM;
+    if (copy && len) memcpy(copy, data, len);
+    uint32_t check = copy ? fnv1a32(FNV_BASIS, copy, len) : 0;
+
+    int64_t t0 = esp_timer_get_time();
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+
+    /* The version this one replaces */
+    wal_pending_t *p = find_pending(path);
+    char *flash = NULL;
+    size_t flash_len = 0;
+    if (!direct && !p) {
+        if (s_pending_count == MIMI_WAL_MAX_FILES ||
+            s_pending_bytes + len > MIMI_WAL_PENDING_BYTES) {
+            checkpoint_locked();
+        }
+        if (s_pending_count == MIMI_WAL_MAX_FILES ||
+            read_flash(path, &flash, &flash_len) != ESP_OK) {
+            direct = true;
+        }
+    }
+
+    if (direct) {
+        /* Too big to hold in PSRAM: write through, after anything logged
+           for the same path so replay cannot undo it */
+        esp_err_t err = p ? checkpoint_locked() : ESP_OK;
+        if (err == ESP_OK) err = write_whole(path, data, len);
+        xSemaphoreGive(s_lock);
+        heap_caps_free(copy);
+        return err;
+    }
+
+    const char *base = p ? p->data : flash;
+    size_t base_len = p ? p->len : flash_len;
+    wal_hdr_t hdr;
+    diff(base, base_len, copy, len, &hdr);
+    hdr.base_check = p ? p->check : fnv1a32(FNV_BASIS, flash, flash_len);
+    esp_err_t err = append_record(&hdr, path, copy + hdr.keep_head);
+    heap_caps_free(flash);
+    if (err != ESP_OK) {
+        xSemaphoreGive(s_lock);
+        heap_caps_free(copy);
+        ESP_LOGE(TAG, "Cannot append to %s", MIMI_WAL_FILE);
+        return ESP_FAIL;
+    }
+    s_writes++;
+    s_bytes_in += len;
+
+    if (p) {
+        s_pending_bytes -= p->len;
+        heap_caps_free(p->data);
+        s_coalesced++;
+    } else {
+        p = &s_pending[s_pending_count++];
+        snprintf(p->path, sizeof(p->path), "%s", path);
+
+        /* New files get an empty placeholder so directory listings see
+           them before the checkpoint */
+        struct stat st;
+        if (stat(path, &st) != 0) {
+            FILE *f = storage_open(path, "w");
+            if (f) fclose(f);
+        }
+    }
+    p->data = copy;
+    p->len = len;
+    p->check = check;
+    s_pending_bytes += len;
+    /* Shadowed by the pending copy until the checkpoint hands it over */
+    storage_cache_invalidate(path);
+
+    bool full = s_log_bytes >= MIMI_WAL_CHECKPOINT_BYTES;
+    uint32_t us = (uint32_t)(esp_timer_get_time() - t0);
+    if (us > s_max_write_us) s_max_write_us = us;
+    xSemaphoreGive(s_lock);
+
+    if (full && s_wake) xSemaphoreGive(s_wake);
+    return ESP_OK;
+}
+
+/* ── Reads ───────────────────────────────────────────────────── */
+
+FILE *storage_fopen(const char *path)
+{
+    if (!s_lock) return storage_cache_open(path);
+
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    wal_pending_t *p = find_pending(path);
+    if (!p) {
+        xSemaphoreGive(s_lock);
+        return storage_cache_open(path);
+    }
+
+    /* Readers get a private copy, so a rewrite or checkpoint while the
+       stream is open cannot change what they see */
+    char *copy = heap_caps_malloc(p->len ? p->len : 1, MALLOC_CAP_SPIRAM);
+    size_t len = p->len;
+    if (copy) memcpy(copy, p->data, len);
+    xSemaphoreGive(s_lock);
+    return copy ? storage_cache_snapshot(copy, len) : NULL;
+}
+
+int storage_stat(const char *path, struct stat *st)
+{
+    if (!s_lock) return storage_cache_stat(path, st);
+
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    wal_pending_t *p = find_pending(path);
+    if (!p) {
+        xSemaphoreGive(s_lock);
+        return storage_cache_stat(path, st);
+    }
+    size_t len = p->len;
+    xSemaphoreGive(s_lock);
+
+    if (storage_cache_stat(path, st) != 0) {
+        memset(st, 0, sizeof(*st));
+        st->st_mode = S_IFREG | 0644;
+    }
+    st->st_size = (off_t)len;
+    return 0;
+}
+
+/* ── Init / replay ───────────────────────────────────────────── */
+
+/* Apply one record to the pending table, as storage_write_file() did */
+static void replay_record(const wal_hdr_t *hdr, const char *path, const char *data)
+{
+    wal_pending_t *p = find_pending(path);
+    char *flash = NULL;
+    size_t flash_len = 0;
+    if (!p) {
+        /* Reset between write_whole()'s remove and rename */
+        char tmp[MIMI_WAL_PATH_MAX + 8];
+        struct stat st;
+        tmp_path(path, tmp, sizeof(tmp));
+        if (stat(path, &st) != 0 && stat(tmp, &st) == 0) storage_rename(tmp, path);
+        if (read_flash(path, &flash, &flash_len) != ESP_OK) return;
+    }
+
+    const char *base = p ? p->data : flash;
+    size_t base_len = p ? p->len : flash_len;
+    uint32_t base_check = p ? p->check : fnv1a32(FNV_BASIS, flash, flash_len);
+    if (base_check != hdr->base_check || (size_t)hdr->keep_head + hdr->keep_tail > base_len) {
+        /* A checkpoint already wrote this or a later version */
+        heap_caps_free(flash);
+        return;
+    }
+
+    size_t len = (size_t)hdr->keep_head + hdr->data_len + hdr->keep_tail;
+    char *next = heap_caps_malloc(len ? len : 1, MALLOC_CAP_SPIRAM);
+    if (!next) {
+        heap_caps_free(flash);
+        return;
+    }
+    if (hdr->keep_head) memcpy(next, base, hdr->keep_head);
+    if (hdr->data_len) memcpy(next + hdr->keep_head, data, hdr->data_len);
+    if (hdr->keep_tail) {
+        memcpy(next + hdr->keep_head + hdr->data_len, base + base_len - hdr->keep_tail,
+               hdr->keep_tail);
+    }
+    heap_caps_free(flash);
+
+    if (!p && s_pending_count == MIMI_WAL_MAX_FILES) {
+        /* Later records for this path chain off the file itself */
+        write_whole(path, next, len);
+        heap_caps_free(next);
+        s_replayed++;
+        return;
+    }
+    if (p) {
+        s_pending_bytes -= p->len;
+        heap_caps_free(p->data);
+    } else {
+        p = &s_pending[s_pending_count++];
+        snprintf(p->path, sizeof(p->path), "%s", path);
+    }
+    p->data = next;
+    p->len = len;
+    p->check = fnv1a32(FNV_BASIS, next, len);
+    s_pending_bytes += len;
+    s_replayed++;
+}
+
+/*
+ * A reset between move_into_place()'s remove and rename leaves <path>.tmp
+ * and no path; finish the rename. Any other leftover .tmp was still being
+ * written and is dropped. Session segments recover their own.
+ */
+static bool recover_one(const char *tmp, void *arg)
+{
+    int *recovered = arg;
+    size_t len = strlen(tmp);
+    if (len <= 4 || strcmp(tmp + len - 4, ".tmp") != 0 ||
+        strncmp(tmp, MIMI_SPIFFS_SESSION_DIR "/", strlen(MIMI_SPIFFS_SESSION_DIR) + 1) == 0) {
+        return true;
+    }
+    char path[MIMI_WAL_PATH_MAX + 8];
+    snprintf(path, sizeof(path), "%.*s", (int)(len - 4), tmp);
+    struct stat st;
+    if (stat(path, &st) == 0) {
+        storage_remove(tmp);
+    } else if (storage_rename(tmp, path) == 0) {
+        (*recovered)++;
+    }
+    return true;
+}
+
+static void recover_tmp(void)
+{
+    int recovered = 0;
+    storage_walk(NULL, recover_one, &recovered);
+    if (recovered) ESP_LOGW(TAG, "Finished %d interrupted replacement(s)", recovered);
+}
+
+/* Rebuild the pending table from the log, then checkpoint it */
+static void replay(void)
+{
+    FILE *f = storage_open(MIMI_WAL_FILE, "r");
+    if (!f) return;
+
+    char path[MIMI_WAL_PATH_MAX];
+    char *data = NULL;
+    size_t cap = 0;
+    wal_hdr_t hdr;
+    while (fread(&hdr, sizeof(hdr), 1, f) == 1) {
+        if (hdr.magic != WAL_MAGIC || hdr.path_len == 0 || hdr.path_len >= sizeof(path) ||
+            hdr.data_len > MIMI_WAL_PENDING_BYTES) {
+            break;
+        }
+        if (hdr.data_len + 1 > cap) {
+            heap_caps_free(data);
+            cap = hdr.data_len + 1;
+            data = heap_caps_malloc(cap, MALLOC_CAP_SPIRAM);
+            if (!data) break;
+        }
+        if (fread(path, 1, hdr.path_len, f) != hdr.path_len ||
+            fread(data, 1, hdr.data_len, f) != hdr.data_len) {
+            break;
+        }
+        path[hdr.path_len] = '\0';
+        if (record_check(&hdr, path, data) != hdr.check) break;
+
+        replay_record(&hdr, path, data);
+        if (hdr.seq > s_seq) s_seq = hdr.seq;
+    }
+    heap_caps_free(data);
+    fclose(f);
+
+    /* Files that fail keep the log for the next boot */
+    struct stat st;
+    s_log_bytes = stat(MIMI_WAL_FILE, &st) == 0 ? (size_t)st.st_size : 0;
+    if (s_replayed) ESP_LOGW(TAG, "Replayed %d logged write(s)", (int)s_replayed);
+    checkpoint_locked();
+}
+
+esp_err_t storage_log_init(void)
+{
+    if (s_lock) return ESP_OK;
+
+    s_lock = xSemaphoreCreateMutex();
+    s_wake = xSemaphoreCreateBinary();
+    if (!s_lock || !s_wake) return ESP_ERR_NO_MEM;
+
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    replay();
+    recover_tmp();
+    xSemaphoreGive(s_lock);
+
+    BaseType_t ok = xTaskCreate(checkpoint_task, "wal_ckpt",
+                                MIMI_WAL_CHECKPOINT_STACK, NULL,
+                                MIMI_WAL_CHECKPOINT_PRIO, &s_task);
+    if (ok != pdPASS || !s_task) {
+        /* Writes still land: on the table or size limits, at shutdown
+           and on every sync */
+        ESP_LOGE(TAG, "Failed to create checkpoint task");
+        s_task = NULL;
+    }
+    esp_register_shutdown_handler(storage_shutdown);
+
+    ESP_LOGI(TAG, "Write-ahead log ready (%d files / %d KB pending, checkpoint every %d s)",
+             MIMI_WAL_MAX_FILES, MIMI_WAL_PENDING_BYTES / 1024, MIMI_WAL_CHECKPOINT_MS / 1000);
+    return ESP_OK;
+}
+
+void storage_log_get_stats(storage_log_stats_t *out)
+{
+    memset(out, 0, sizeof(*out));
+    if (!s_lock) return;
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    out->writes = s_writes;
+    out->coalesced = s_coalesced;
+    out->checkpoints = s_checkpoints;
+    out->files_written = s_files_written;
+    out->replayed = s_replayed;
+    out->pending_files = (uint32_t)s_pending_count;
+    out->pending_bytes = s_pending_bytes;
+    out->log_bytes = s_log_bytes;
+    out->bytes_in = s_bytes_in;
+    out->bytes_logged = s_bytes_logged;
+    out->max_write_us = s_max_write_us;
+    out->last_checkpoint_us = s_last_checkpoint_us;
+    xSemaphoreGive(s_lock);
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include "esp_err.h"
+#include <stdio.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/stat.h>
+
+/*
+ * Write-ahead log for whole-file rewrites: MEMORY.md, cron.json and the
+ * files the agent writes through its tools. A rewrite appends the bytes
+ * that changed to MIMI_WAL_FILE and becomes the file's content at once; a
+ * background checkpoint later copies the latest version of each file into
+ * place and empties the log. A file rewritten several times between
+ * checkpoints reaches flash once, and a reset mid-write leaves the old or
+ * the new content, never a truncated file.
+ *
+ * Until its checkpoint the new content lives only in the log and in PSRAM,
+ * so code that reads such files must use storage_fopen()/storage_stat().
+ */
+
+/** Replay the log left by a reset into the files, then start checkpointing. */
+esp_err_t storage_log_init(void);
+
+/**
+ * Replace the content of path, atomically. New files are written through
+ * at once so that directory listings see them.
+ */
+esp_err_t storage_write_file(const char *path, const void *data, size_t len);
+
+/** fopen(path, "r") that sees content still waiting in the log. */
+FILE *storage_fopen(const char *path);
+
+/** stat() that reports the size of content still waiting in the log. */
+int storage_stat(const char *path, struct stat *st);
+
+/**
+ * Checkpoint before writing path some other way (append, remove), so a
+ * replay cannot bring back an older version over it.
+ */
+esp_err_t storage_sync_file(const char *path);
+
+/**
+ * Replace a file with content streamed to "<path>.tmp", for files too large
+ * to pass to storage_write_file() in one buffer. The replacement becomes
+ * path atomically at storage_commit_replacement(), which closes f; a reset
+ * before then leaves the old content.
+ */
+FILE *storage_open_replacement(const char *path);
+esp_err_t storage_commit_replacement(const char *path, FILE *f);
+void storage_discard_replacement(const char *path, FILE *f);
+
+/** Copy every pending file into place and empty the log. */
+esp_err_t storage_checkpoint(void);
+
+typedef struct {
+    uint32_t writes;          /* storage_write_file() calls */
+    uint32_t coalesced;       /* versions replaced before reaching their file */
+    uint32_t checkpoints;
+    uint32_t files_written;   /* by checkpoints and write-through */
+    uint32_t replayed;        /* records recovered at boot */
+    uint32_t pending_files;
+    size_t   pending_bytes;
+    size_t   log_bytes;
+    uint64_t bytes_in;        /* file content passed to storage_write_file() */
+    uint64_t bytes_logged;    /* log records written for it */
+    uint32_t max_write_us;
+    uint32_t last_checkpoint_us;
+} storage_log_stats_t;
+
+void storage_log_get_stats(storage_log_stats_t *out);
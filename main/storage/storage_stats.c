@@ -0,0 +1,343 @@
+/* fopencookie() */
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#include "storage_stats.h"
+#include "storage_fs.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#if CONFIG_SPI_FLASH_ENABLE_COUNTERS
+#include "esp_spi_flash_counters.h"
+#endif
+
+static const char *TAG = "storage_stats";
+
+/* Everything below is guarded by s_lock */
+static SemaphoreHandle_t s_lock;
+static storage_op_stats_t s_ops[STORAGE_CLASS_COUNT][STORAGE_OP_COUNT];
+static storage_stall_t s_stalls[MIMI_FS_STALL_LOG];
+static uint32_t s_stall_count;      /* ever logged; s_stalls holds the latest */
+static storage_space_sample_t s_space[MIMI_FS_SPACE_SAMPLES];
+static uint32_t s_space_count;
+
+esp_err_t storage_stats_init(void)
+{
+    if (s_lock) return ESP_OK;
+    s_lock = xSemaphoreCreateMutex();
+    return s_lock ? ESP_OK : ESP_ERR_NO_MEM;
+}
+
+/* ── Classes ─────────────────────────────────────────────────── */
+
+/* Matched as prefixes, so a ".tmp" sibling counts with its target */
+static const struct {
+    const char *prefix;
+    storage_class_t cls;
+} s_prefixes[] = {
+    { MIMI_SPIFFS_SESSION_DIR "/", STORAGE_CLASS_SESSIONS },
+    { MIMI_SPIFFS_MEMORY_DIR "/",  STORAGE_CLASS_MEMORY },
+    { MIMI_NOTES_ROLLUP_DIR "/",   STORAGE_CLASS_MEMORY },
+    { MIMI_SKILLS_PREFIX,          STORAGE_CLASS_SKILLS },
+    { MIMI_SKILLS_INDEX_FILE,      STORAGE_CLASS_SKILLS },
+    { MIMI_CRON_FILE,              STORAGE_CLASS_CRON },
+    { MIMI_HEARTBEAT_FILE,         STORAGE_CLASS_CRON },
+    { MIMI_SPIFFS_CONFIG_DIR "/",  STORAGE_CLASS_CONFIG },
+    { MIMI_WAL_FILE,               STORAGE_CLASS_WAL },
+};
+
+storage_class_t storage_class_of(const char *path)
+{
+    if (!path) return STORAGE_CLASS_OTHER;
+    for (size_t i = 0; i < sizeof(s_prefixes) / sizeof(s_prefixes[0]); i++) {
+        if (strncmp(path, s_prefixes[i].prefix, strlen(s_prefixes[i].prefix)) == 0) {
+            return s_prefixes[i].cls;
+        }
+    }
+    return STORAGE_CLASS_OTHER;
+}
+
+const char *storage_class_name(storage_class_t cls)
+{
+    static const char *names[STORAGE_CLASS_COUNT] = {
+        "sessions", "memory", "skills", "cron", "config", "wal", "other",
+    };
+    return cls < STORAGE_CLASS_COUNT ? names[cls] : "?";
+}
+
+const char *storage_op_name(storage_op_t op)
+{
+    static const char *names[STORAGE_OP_COUNT] = { "open", "read", "write", "close", "meta" };
+    return op < STORAGE_OP_COUNT ? names[op] : "?";
+}
+
+/* ── Recording ───────────────────────────────────────────────── */
+
+uint32_t storage_stats_bucket_us(int i)
+{
+    return i < STORAGE_STATS_BUCKETS - 1 ? 64u << (2 * i) : 0;
+}
+
+static uint32_t clamp_us(int64_t us)
+{
+    return us < 0 ? 0 : us > UINT32_MAX ? UINT32_MAX : (uint32_t)us;
+}
+
+static void tally(storage_op_stats_t *s, size_t bytes, uint32_t us)
+{
+    int b = 0;
+    while (b < STORAGE_STATS_BUCKETS - 1 && us >= storage_stats_bucket_us(b)) b++;
+    s->count++;
+    s->bytes += bytes;
+    s->total_us += us;
+    if (us > s->max_us) s->max_us = us;
+    s->hist[b]++;
+}
+
+static void merge(storage_op_stats_t *dst, const storage_op_stats_t *src)
+{
+    dst->count += src->count;
+    dst->bytes += src->bytes;
+    dst->total_us += src->total_us;
+    if (src->max_us > dst->max_us) dst->max_us = src->max_us;
+    for (int b = 0; b < STORAGE_STATS_BUCKETS; b++) dst->hist[b] += src->hist[b];
+}
+
+static void note_stall(const char *path, storage_op_t op, size_t bytes, uint32_t us)
+{
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    storage_stall_t *e = &s_stalls[s_stall_count++ % MIMI_FS_STALL_LOG];
+    snprintf(e->path, sizeof(e->path), "%s", path ? path : "");
+    e->op = op;
+    e->us = us;
+    e->at_ms = esp_timer_get_time() / 1000;
+    xSemaphoreGive(s_lock);
+
+    ESP_LOGW(TAG, "Slow %s of %s: %u ms (%u bytes)", storage_op_name(op),
+             path ? path : "?", (unsigned)(us / 1000), (unsigned)bytes);
+}
+
+void storage_stats_record(const char *path, storage_op_t op, size_t bytes, int64_t us)
+{
+    if (!s_lock || op >= STORAGE_OP_COUNT) return;
+    uint32_t t = clamp_us(us);
+    storage_class_t cls = storage_class_of(path);
+
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    tally(&s_ops[cls][op], bytes, t);
+    xSemaphoreGive(s_lock);
+    if (t >= MIMI_FS_STALL_US) note_stall(path, op, bytes, t);
+}
+
+/* ── Counted streams ─────────────────────────────────────────── */
+
+/*
+ * A stream over another one, timing each call it makes. The stdio buffer
+ * sits in this stream; the one underneath is unbuffered when we opened it,
+ * so every read or write counted here is one VFS call. Reads and writes
+ * are tallied in the stream and added to the totals when it closes.
+ */
+typedef struct {
+    FILE *f;
+    storage_class_t cls;
+    storage_op_stats_t reads, writes;
+    char path[MIMI_WAL_PATH_MAX];
+} counted_t;
+
+#if defined(__GLIBC__)
+typedef __off64_t cookie_off_t;
+#elif defined(__LARGE64_FILES)
+typedef _off64_t cookie_off_t;
+#else
+typedef off_t cookie_off_t;
+#endif
+
+static ssize_t counted_read(void *cookie, char *buf, size_t size)
+{
+    counted_t *c = cookie;
+    int64_t t0 = esp_timer_get_time();
+    size_t n = fread(buf, 1, size, c->f);
+    uint32_t us = clamp_us(esp_timer_get_time() - t0);
+    tally(&c->reads, n, us);
+    if (us >= MIMI_FS_STALL_US) note_stall(c->path, STORAGE_OP_READ, n, us);
+    return n == 0 && ferror(c->f) ? -1 : (ssize_t)n;
+}
+
+static ssize_t counted_write(void *cookie, const char *buf, size_t size)
+{
+    counted_t *c = cookie;
+    int64_t t0 = esp_timer_get_time();
+    size_t n = fwrite(buf, 1, size, c->f);
+    uint32_t us = clamp_us(esp_timer_get_time() - t0);
+    tally(&c->writes, n, us);
+    if (us >= MIMI_FS_STALL_US) note_stall(c->path, STORAGE_OP_WRITE, n, us);
+    return n == 0 && size ? -1 : (ssize_t)n;
+}
+
+static int counted_seek(void *cookie, cookie_off_t *offset, int whence)
+{
+    counted_t *c = cookie;
+    if (fseek(c->f, (long)*offset, whence) != 0) return -1;
+    if (whence == SEEK_SET) return 0;
+    long pos = ftell(c->f);
+    if (pos < 0) return -1;
+    *offset = pos;
+    return 0;
+}
+
+static int counted_close(void *cookie)
+{
+    counted_t *c = cookie;
+    int64_t t0 = esp_timer_get_time();
+    int rc = fclose(c->f);
+    uint32_t us = clamp_us(esp_timer_get_time() - t0);
+
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    merge(&s_ops[c->cls][STORAGE_OP_READ], &c->reads);
+    merge(&s_ops[c->cls][STORAGE_OP_WRITE], &c->writes);
+    tally(&s_ops[c->cls][STORAGE_OP_CLOSE], 0, us);
+    xSemaphoreGive(s_lock);
+    if (us >= MIMI_FS_STALL_US) note_stall(c->path, STORAGE_OP_CLOSE, 0, us);
+    free(c);
+    return rc;
+}
+
+FILE *storage_stats_wrap(FILE *f, const char *path, const char *mode)
+{
+    if (!MIMI_FS_STATS || !s_lock || !f) return f;
+
+    counted_t *c = calloc(1, sizeof(*c));
+    if (!c) return f;
+    c->f = f;
+    c->cls = storage_class_of(path);
+    snprintf(c->path, sizeof(c->path), "%s", path);
+
+    cookie_io_functions_t io = {
+        .read = counted_read,
+        .write = counted_write,
+        .seek = counted_seek,
+        .close = counted_close,
+    };
+    /* Only the access matters to the cookie stream: "rb+" becomes "r+" */
+    char access[3] = { mode[0], strchr(mode, '+') ? '+' : '\0', '\0' };
+    FILE *out = fopencookie(c, access, io);
+    if (!out) {
+        free(c);
+        return f;
+    }
+    return out;
+}
+
+FILE *storage_stats_open(const char *path, const char *mode)
+{
+    if (!MIMI_FS_STATS || !s_lock) return fopen(path, mode);
+
+    int64_t t0 = esp_timer_get_time();
+    FILE *f = fopen(path, mode);
+    storage_stats_record(path, STORAGE_OP_OPEN, 0, esp_timer_get_time() - t0);
+    if (!f) return NULL;
+    setvbuf(f, NULL, _IONBF, 0);
+    return storage_stats_wrap(f, path, mode);
+}
+
+/* ── Free space and flash counters ───────────────────────────── */
+
+void storage_stats_sample_space(bool force)
+{
+    if (!s_lock) return;
+    int64_t now = esp_timer_get_time() / 1000;
+
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    bool due = force || s_space_count == 0 ||
+               now - s_space[(s_space_count - 1) % MIMI_FS_SPACE_SAMPLES].at_ms >= MIMI_FS_SPACE_SAMPLE_MS;
+    xSemaphoreGive(s_lock);
+    if (!due) return;
+
+    size_t total = 0, used = 0;
+    if (storage_fs_info(&total, &used) != ESP_OK) return;
+
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    s_space[s_space_count++ % MIMI_FS_SPACE_SAMPLES] = (storage_space_sample_t){
+        .at_ms = now, .total = total, .used = used,
+    };
+    xSemaphoreGive(s_lock);
+}
+
+esp_err_t storage_stats_flash_counters(storage_flash_counters_t *out)
+{
+    memset(out, 0, sizeof(*out));
+#if CONFIG_SPI_FLASH_ENABLE_COUNTERS
+    const esp_flash_counters_t *c = esp_flash_get_counters();
+    out->reads = c->read.count;
+    out->read_bytes = c->read.bytes;
+    out->read_us = c->read.time;
+    out->writes = c->write.count;
+    out->write_bytes = c->write.bytes;
+    out->write_us = c->write.time;
+    out->erases = c->erase.count;
+    out->erase_bytes = c->erase.bytes;
+    out->erase_us = c->erase.time;
+    return ESP_OK;
+#else
+    return ESP_ERR_NOT_SUPPORTED;
+#endif
+}
+
+/* ── Queries ─────────────────────────────────────────────────── */
+
+void storage_stats_get(storage_class_t cls, storage_op_t op, storage_op_stats_t *out)
+{
+    memset(out, 0, sizeof(*out));
+    if (!s_lock || cls >= STORAGE_CLASS_COUNT || op >= STORAGE_OP_COUNT) return;
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    *out = s_ops[cls][op];
+    xSemaphoreGive(s_lock);
+}
+
+uint32_t storage_stats_stall_count(void)
+{
+    if (!s_lock) return 0;
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    uint32_t n = s_stall_count;
+    xSemaphoreGive(s_lock);
+    return n;
+}
+
+bool storage_stats_get_stall(size_t i, storage_stall_t *out)
+{
+    if (!s_lock) return false;
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    bool ok = i < MIMI_FS_STALL_LOG && i < s_stall_count;
+    if (ok) *out = s_stalls[(s_stall_count - 1 - i) % MIMI_FS_STALL_LOG];
+    xSemaphoreGive(s_lock);
+    return ok;
+}
+
+bool storage_stats_get_space(size_t i, storage_space_sample_t *out)
+{
+    if (!s_lock) return false;
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    bool ok = i < MIMI_FS_SPACE_SAMPLES && i < s_space_count;
+    if (ok) *out = s_space[(s_space_count - 1 - i) % MIMI_FS_SPACE_SAMPLES];
+    xSemaphoreGive(s_lock);
+    return ok;
+}
+
+void storage_stats_reset(void)
+{
+    if (!s_lock) return;
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    memset(s_ops, 0, sizeof(s_ops));
+    memset(s_stalls, 0, sizeof(s_stalls));
+    s_stall_count = 0;
+    xSemaphoreGive(s_lock);
+#if CONFIG_SPI_FLASH_ENABLE_COUNTERS
+    esp_flash_reset_counters();
+#endif
+}
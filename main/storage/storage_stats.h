@@ -0,0 +1,111 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include "esp_err.h"
+#include "mimi_config.h"
+
+/**
+ * Flash I/O statistics.
+ *
+ * storage_open() opens every file through storage_stats_open(), whose
+ * stream times each read and write it passes to the VFS (the underlying
+ * FILE is unbuffered, so one counted call is one VFS call), and the open
+ * and close around them; a stream's reads and writes reach the totals
+ * when it closes. storage_remove/rename and directory scans are counted
+ * as metadata operations. Everything is kept per path class, with
+ * a latency histogram per class and operation; single operations over
+ * MIMI_FS_STALL_US are also logged with their path. Free space is sampled
+ * every MIMI_FS_SPACE_SAMPLE_MS, and the chip's flash counters are read
+ * when CONFIG_SPI_FLASH_ENABLE_COUNTERS is set.
+ */
+
+typedef enum {
+    STORAGE_CLASS_SESSIONS = 0,
+    STORAGE_CLASS_MEMORY,       /* memory/, rollups/ */
+    STORAGE_CLASS_SKILLS,       /* skills/, skills.json */
+    STORAGE_CLASS_CRON,         /* cron.json, HEARTBEAT.md */
+    STORAGE_CLASS_CONFIG,       /* config/ */
+    STORAGE_CLASS_WAL,          /* wal.log */
+    STORAGE_CLASS_OTHER,
+    STORAGE_CLASS_COUNT,
+} storage_class_t;
+
+typedef enum {
+    STORAGE_OP_OPEN = 0,
+    STORAGE_OP_READ,
+    STORAGE_OP_WRITE,
+    STORAGE_OP_CLOSE,
+    STORAGE_OP_META,            /* remove, rename, directory scan */
+    STORAGE_OP_COUNT,
+} storage_op_t;
+
+/* Latency buckets: < 64 us, then x4 up to >= 256 ms */
+#define STORAGE_STATS_BUCKETS 8
+
+typedef struct {
+    uint32_t count;
+    uint64_t bytes;
+    uint64_t total_us;
+    uint32_t max_us;
+    uint32_t hist[STORAGE_STATS_BUCKETS];
+} storage_op_stats_t;
+
+typedef struct {
+    char path[MIMI_WAL_PATH_MAX];
+    storage_op_t op;
+    uint32_t us;
+    int64_t at_ms;              /* since boot */
+} storage_stall_t;
+
+typedef struct {
+    int64_t at_ms;              /* since boot */
+    size_t total;
+    size_t used;
+} storage_space_sample_t;
+
+typedef struct {
+    uint32_t reads, writes, erases;
+    uint64_t read_bytes, write_bytes, erase_bytes;
+    uint64_t read_us, write_us, erase_us;
+} storage_flash_counters_t;
+
+esp_err_t storage_stats_init(void);
+
+storage_class_t storage_class_of(const char *path);
+const char *storage_class_name(storage_class_t cls);
+const char *storage_op_name(storage_op_t op);
+
+/** Upper bound of latency bucket i in microseconds (0 for the last, open-ended one). */
+uint32_t storage_stats_bucket_us(int i);
+
+/** fopen() that counts the stream's I/O against path's class. */
+FILE *storage_stats_open(const char *path, const char *mode);
+
+/** Count the stream's I/O from here on; f was opened on path outside this module. */
+FILE *storage_stats_wrap(FILE *f, const char *path, const char *mode);
+
+/** Count one operation on path that took us and moved bytes. */
+void storage_stats_record(const char *path, storage_op_t op, size_t bytes, int64_t us);
+
+void storage_stats_get(storage_class_t cls, storage_op_t op, storage_op_stats_t *out);
+
+/** Operations that have taken MIMI_FS_STALL_US or more since the last reset. */
+uint32_t storage_stats_stall_count(void);
+
+/** Copy stall i, most recent first; false past the end. */
+bool storage_stats_get_stall(size_t i, storage_stall_t *out);
+
+/** Sample partition use if MIMI_FS_SPACE_SAMPLE_MS has passed since the last sample (or force). */
+void storage_stats_sample_space(bool force);
+
+/** Copy free-space sample i, most recent first; false past the end. */
+bool storage_stats_get_space(size_t i, storage_space_sample_t *out);
+
+/** Chip-wide flash counters; ESP_ERR_NOT_SUPPORTED unless CONFIG_SPI_FLASH_ENABLE_COUNTERS. */
+esp_err_t storage_stats_flash_counters(storage_flash_counters_t *out);
+
+/** Zero the counters, histograms and stall log; space samples are kept. */
+void storage_stats_reset(void);
@@ -0,0 +1,142 @@
+/* memmem() */
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#include "tools/file_edit.h"
+#include "mimi_config.h"
+
+#include <string.h>
+#include "esp_heap_caps.h"
+
+/*
+ * The file passes through a window of MIMI_EDIT_WINDOW bytes plus the
+ * longest pattern. A match starting before len - longest + 1 lies wholly
+ * inside the window, so every op can be decided there; the bytes before
+ * the earliest decided match go to the sink and the rest slides down when
+ * the window is refilled.
+ */
+
+#define POS_UNKNOWN (-2)
+#define POS_NONE    (-1)
+
+typedef struct {
+    size_t find_len;
+    size_t after_len;
+    uint64_t from;      /* file offset matches may start at, once after is seen */
+    long pos;           /* next occurrence in the window, of after until it is seen */
+    bool done;
+} op_state_t;
+
+static long search(const char *buf, size_t len, size_t from, const char *pat, size_t plen)
+{
+    if (from > len || plen > len - from) return POS_NONE;
+    const char *p = memmem(buf + from, len - from, pat, plen);
+    return p ? (long)(p - buf) : POS_NONE;
+}
+
+esp_err_t file_edit_run(FILE *in, file_edit_op_t *ops, int n_ops,
+                        file_edit_sink_t sink, void *arg)
+{
+    if (n_ops <= 0 || n_ops > MIMI_EDIT_MAX_OPS) return ESP_ERR_INVALID_ARG;
+
+    op_state_t st[MIMI_EDIT_MAX_OPS];
+    size_t longest = 1;
+    for (int i = 0; i < n_ops; i++) {
+        if (!ops[i].find || !ops[i].find[0] || !ops[i].replace) return ESP_ERR_INVALID_ARG;
+        bool anchored = ops[i].after && ops[i].after[0];
+        st[i] = (op_state_t){
+            .find_len = strlen(ops[i].find),
+            .after_len = anchored ? strlen(ops[i].after) : 0,
+            .pos = POS_UNKNOWN,
+        };
+        ops[i].count = 0;
+        ops[i].anchor_found = !anchored;
+        if (st[i].find_len > longest) longest = st[i].find_len;
+        if (st[i].after_len > longest) longest = st[i].after_len;
+    }
+
+    size_t cap = MIMI_EDIT_WINDOW + longest;
+    char *buf = heap_caps_malloc(cap, MALLOC_CAP_SPIRAM);
+    if (!buf) return ESP_ERR_NO_MEM;
+
+    esp_err_t err = ESP_OK;
+    size_t len = 0, cur = 0;
+    uint64_t base = 0;          /* file offset of buf[0] */
+    bool eof = false, refill = true;
+
+    while (err == ESP_OK) {
+        if (refill) {
+            if (cur) {
+                memmove(buf, buf + cur, len - cur);
+                len -= cur;
+                base += cur;
+                cur = 0;
+            }
+            while (len < cap) {
+                size_t n = fread(buf + len, 1, cap - len, in);
+                if (n == 0) {
+                    if (ferror(in)) err = ESP_FAIL;
+                    eof = true;
+                    break;
+                }
+                len += n;
+            }
+            for (int i = 0; i < n_ops; i++) st[i].pos = POS_UNKNOWN;
+            refill = false;
+            if (err != ESP_OK) break;
+        }
+        size_t limit = eof ? len : (len + 1 > longest ? len + 1 - longest : 0);
+
+        /* Earliest decided event; a sighting of after goes before a match
+           at the same place, and the first listed op before later ones */
+        int best = -1;
+        bool best_anchor = false;
+        for (int i = 0; i < n_ops; i++) {
+            op_state_t *s = &st[i];
+            if (s->done) continue;
+            bool anchor = !ops[i].anchor_found;
+            if (s->pos == POS_UNKNOWN || (s->pos >= 0 && (size_t)s->pos < cur)) {
+                if (anchor) {
+                    s->pos = search(buf, len, cur, ops[i].after, s->after_len);
+                } else {
+                    size_t from = s->from > base + cur ? (size_t)(s->from - base) : cur;
+                    s->pos = search(buf, len, from, ops[i].find, s->find_len);
+                }
+            }
+            if (s->pos < 0 || (size_t)s->pos >= limit) continue;
+            if (best < 0 || s->pos < st[best].pos || (s->pos == st[best].pos && anchor && !best_anchor)) {
+                best = i;
+                best_anchor = anchor;
+            }
+        }
+
+        if (best < 0) {
+            if (limit > cur && !sink(buf + cur, limit - cur, arg)) err = ESP_FAIL;
+            cur = limit > cur ? limit : cur;
+            if (eof) break;
+            refill = true;
+            continue;
+        }
+
+        op_state_t *s = &st[best];
+        size_t at = (size_t)s->pos;
+        if (best_anchor) {
+            ops[best].anchor_found = true;
+            s->from = base + at + s->after_len;
+            s->pos = POS_UNKNOWN;
+            continue;
+        }
+        if ((at > cur && !sink(buf + cur, at - cur, arg)) ||
+            (ops[best].replace[0] && !sink(ops[best].replace, strlen(ops[best].replace), arg))) {
+            err = ESP_FAIL;
+            break;
+        }
+        cur = at + s->find_len;
+        ops[best].count++;
+        if (!ops[best].all) s->done = true;
+    }
+
+    heap_caps_free(buf);
+    return err;
+}
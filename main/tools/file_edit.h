@@ -0,0 +1,34 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include "esp_err.h"
+
+/**
+ * One find/replace of an edit_file call. Matches are found in the original
+ * text, never in replacements, and do not overlap; where several ops match
+ * at the same place the first listed wins.
+ */
+typedef struct {
+    const char *find;
+    const char *replace;
+    const char *after;      /* only match past the first occurrence of this, or NULL */
+    bool all;               /* every match instead of the first */
+    uint32_t count;         /* out: matches replaced */
+    bool anchor_found;      /* out: after was seen (true when after is NULL) */
+} file_edit_op_t;
+
+/** Receives the edited text in order; false stops the edit. */
+typedef bool (*file_edit_sink_t)(const char *data, size_t len, void *arg);
+
+/**
+ * Apply ops to the text read from in, in one pass, holding at most
+ * MIMI_EDIT_WINDOW bytes plus the longest find or after string. The result
+ * goes to sink whether or not every op matched; check each op's count.
+ *
+ * @return ESP_OK, ESP_ERR_NO_MEM, or ESP_FAIL if in fails or sink stops
+ */
+esp_err_t file_edit_run(FILE *in, file_edit_op_t *ops, int n_ops,
+                        file_edit_sink_t sink, void *arg);
@@ -0,0 +1,185 @@
+#include "tools/line_index.h"
+#include "mimi_config.h"
+#include "storage/storage_cache.h"
+#include "storage/storage_log.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+#include <sys/stat.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "esp_log.h"
+#include "esp_heap_caps.h"
+
+static const char *TAG = "line_index";
+
+#define SCAN_CHUNK 1024
+
+typedef struct {
+    char path[MIMI_WAL_PATH_MAX];
+    uint32_t version;               /* storage_cache_version() the index was built at */
+    size_t size;
+    time_t mtime;
+    uint32_t lines;
+    uint32_t *marks;                /* PSRAM: offset of line 1 + k * stride */
+    uint32_t n_marks;
+    uint32_t cap_marks;
+    uint32_t stamp;                 /* last used, for eviction */
+} index_entry_t;
+
+static index_entry_t s_entries[MIMI_LINE_INDEX_FILES];
+static uint32_t s_clock;
+static SemaphoreHandle_t s_lock;
+
+esp_err_t line_index_init(void)
+{
+    if (s_lock) return ESP_OK;
+    s_lock = xSemaphoreCreateMutex();
+    return s_lock ? ESP_OK : ESP_ERR_NO_MEM;
+}
+
+static bool add_mark(index_entry_t *e, size_t offset)
+{
+    if (e->n_marks == e->cap_marks) {
+        uint32_t cap = e->cap_marks ? e->cap_marks * 2 : 16;
+        uint32_t *m = heap_caps_realloc(e->marks, cap * sizeof(*m), MALLOC_CAP_SPIRAM);
+        if (!m) return false;
+        e->marks = m;
+        e->cap_marks = cap;
+    }
+    e->marks[e->n_marks++] = (uint32_t)offset;
+    return true;
+}
+
+/* One pass over the file: count lines and mark every stride-th */
+static esp_err_t build(index_entry_t *e, const char *path)
+{
+    FILE *f = storage_fopen(path);
+    if (!f) return ESP_ERR_NOT_FOUND;
+
+    char *buf = heap_caps_malloc(SCAN_CHUNK, MALLOC_CAP_SPIRAM);
+    if (!buf) {
+        fclose(f);
+        return ESP_ERR_NO_MEM;
+    }
+
+    esp_err_t err = ESP_OK;
+    size_t base = 0;
+    uint32_t newlines = 0;
+    char last = '\n';
+    e->n_marks = 0;
+    if (!add_mark(e, 0)) err = ESP_ERR_NO_MEM;
+
+    size_t n;
+    while (err == ESP_OK && (n = fread(buf, 1, SCAN_CHUNK, f)) > 0) {
+        for (const char *p = buf, *end = buf + n;
+             (p = memchr(p, '\n', end - p)) != NULL; p++) {
+            if (++newlines % MIMI_LINE_INDEX_STRIDE == 0 &&
+                !add_mark(e, base + (p - buf) + 1)) {
+                err = ESP_ERR_NO_MEM;
+                break;
+            }
+        }
+        last = buf[n - 1];
+        base += n;
+    }
+    if (err == ESP_OK && ferror(f)) err = ESP_FAIL;
+    heap_caps_free(buf);
+    fclose(f);
+    if (err != ESP_OK) return err;
+
+    e->size = base;
+    e->lines = newlines + (last != '\n');
+    ESP_LOGD(TAG, "Indexed %s: %u bytes, %u lines, %u marks",
+             path, (unsigned)e->size, (unsigned)e->lines, (unsigned)e->n_marks);
+    return ESP_OK;
+}
+
+static void drop(index_entry_t *e)
+{
+    heap_caps_free(e->marks);
+    memset(e, 0, sizeof(*e));
+}
+
+/* Index of path, current as of now; called with s_lock held */
+static esp_err_t get_index(const char *path, index_entry_t **out)
+{
+    if (strlen(path) >= MIMI_WAL_PATH_MAX) return ESP_ERR_INVALID_ARG;
+
+    /* Read the version first, so a write racing the build shows up next time */
+    uint32_t version = storage_cache_version(path);
+    struct stat st;
+    if (storage_stat(path, &st) != 0) return ESP_ERR_NOT_FOUND;
+
+    index_entry_t *e = NULL, *victim = &s_entries[0];
+    for (int i = 0; i < MIMI_LINE_INDEX_FILES; i++) {
+        if (strcmp(s_entries[i].path, path) == 0) {
+            e = &s_entries[i];
+            break;
+        }
+        if (s_entries[i].stamp < victim->stamp) victim = &s_entries[i];
+    }
+
+    if (!e || e->version != version || e->size != (size_t)st.st_size ||
+        e->mtime != st.st_mtime) {
+        if (!e) {
+            drop(victim);
+            e = victim;
+            strcpy(e->path, path);
+        }
+        esp_err_t err = build(e, path);
+        if (err != ESP_OK) {
+            drop(e);
+            return err;
+        }
+        e->version = version;
+        e->mtime = st.st_mtime;
+    }
+    e->stamp = ++s_clock;
+    *out = e;
+    return ESP_OK;
+}
+
+static esp_err_t lookup(const char *path, bool by_line, size_t want, line_index_pos_t *out)
+{
+    if (!s_lock) return ESP_ERR_INVALID_STATE;
+
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    index_entry_t *e;
+    esp_err_t err = get_index(path, &e);
+    if (err == ESP_OK) {
+        uint32_t k;
+        if (by_line) {
+            k = want > 0 ? (uint32_t)((want - 1) / MIMI_LINE_INDEX_STRIDE) : 0;
+            if (k >= e->n_marks) k = e->n_marks - 1;
+        } else {
+            /* Last mark at or before want */
+            uint32_t lo = 0, hi = e->n_marks;
+            while (hi - lo > 1) {
+                uint32_t mid = lo + (hi - lo) / 2;
+                if (e->marks[mid] <= want) lo = mid;
+                else hi = mid;
+            }
+            k = lo;
+        }
+        *out = (line_index_pos_t){
+            .size = e->size,
+            .lines = e->lines,
+            .line = k * MIMI_LINE_INDEX_STRIDE + 1,
+            .offset = e->marks[k],
+        };
+    }
+    xSemaphoreGive(s_lock);
+    return err;
+}
+
+esp_err_t line_index_from_line(const char *path, uint32_t line, line_index_pos_t *out)
+{
+    return lookup(path, true, line, out);
+}
+
+esp_err_t line_index_from_offset(const char *path, size_t offset, line_index_pos_t *out)
+{
+    return lookup(path, false, offset, out);
+}
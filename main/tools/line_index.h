@@ -0,0 +1,35 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+
+/**
+ * Sparse line index for paging read_file.
+ *
+ * For up to MIMI_LINE_INDEX_FILES recently paged files it keeps the size,
+ * the line count and the byte offset of every MIMI_LINE_INDEX_STRIDE-th
+ * line, built in one streamed pass and rebuilt once the file changes
+ * (storage_cache_version(), size or mtime). A page then starts from the
+ * nearest mark and reads forward at most a stride's worth of lines.
+ */
+
+typedef struct {
+    size_t size;        /* of the file */
+    uint32_t lines;     /* in the file; a last line without '\n' counts */
+    uint32_t line;      /* indexed line (1-based) at or before the one asked for */
+    size_t offset;      /* ... and the offset it starts at */
+} line_index_pos_t;
+
+esp_err_t line_index_init(void);
+
+/**
+ * Nearest indexed line at or before line (1-based). Asking for line 1 only
+ * fills size and lines.
+ *
+ * @return ESP_OK, ESP_ERR_NOT_FOUND, ESP_ERR_NO_MEM or ESP_FAIL on a read error
+ */
+esp_err_t line_index_from_line(const char *path, uint32_t line, line_index_pos_t *out);
+
+/** Nearest indexed line starting at or before byte offset. */
+esp_err_t line_index_from_offset(const char *path, size_t offset, line_index_pos_t *out);
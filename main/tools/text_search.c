@@ -0,0 +1,308 @@
+/* memrchr() */
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#include "tools/text_search.h"
+
+#include <string.h>
+#include "esp_heap_caps.h"
+
+/*
+ * Word-at-a-time helpers. ONES has 0x01 in every byte; zero_bytes() sets
+ * the top bit of exactly the bytes of v that are zero (no carries cross
+ * bytes, so there are no false hits), and on a little-endian CPU the
+ * lowest set bit is the first such byte in memory.
+ */
+
+typedef uintptr_t word_t;
+
+#define WORD_BYTES sizeof(word_t)
+#define ONES       ((word_t)-1 / 0xFF)
+#define LOW7       (ONES * 0x7F)
+
+static inline word_t zero_bytes(word_t v)
+{
+    return ~(((v & LOW7) + LOW7) | v | LOW7);
+}
+
+static inline uint8_t fold(uint8_t c)
+{
+    return (c >= 'A' && c <= 'Z') ? (uint8_t)(c | 0x20) : c;
+}
+
+static inline bool is_word(uint8_t c)
+{
+    return c == '_' || c >= 0x80 || (c >= '0' && c <= '9') || (fold(c) >= 'a' && fold(c) <= 'z');
+}
+
+/*
+ * First c in s[from, end), or end. With fold_case, c is a lower-case
+ * letter and its upper-case form (c ^ 0x20) matches too: OR-ing 0x20 into
+ * every byte maps both onto c and nothing else onto it.
+ */
+static size_t find_byte(const uint8_t *s, size_t from, size_t end, uint8_t c, bool fold_case)
+{
+    uint8_t or_mask = fold_case ? 0x20 : 0;
+    size_t i = from;
+    while (i < end && ((uintptr_t)(s + i) & (WORD_BYTES - 1))) {
+        if ((s[i] | or_mask) == c) return i;
+        i++;
+    }
+    word_t pat = ONES * c, mask = ONES * or_mask;
+    for (; i + WORD_BYTES <= end; i += WORD_BYTES) {
+        word_t v;
+        memcpy(&v, s + i, WORD_BYTES);
+        word_t z = zero_bytes((v | mask) ^ pat);
+        if (z) return i + (size_t)(__builtin_ctzll((unsigned long long)z) >> 3);
+    }
+    for (; i < end; i++) {
+        if ((s[i] | or_mask) == c) return i;
+    }
+    return end;
+}
+
+size_t text_search_count(const char *buf, size_t len, char c)
+{
+    const uint8_t *s = (const uint8_t *)buf;
+    size_t i = 0, n = 0;
+    while (i < len && ((uintptr_t)(s + i) & (WORD_BYTES - 1))) n += s[i++] == (uint8_t)c;
+    word_t pat = ONES * (uint8_t)c;
+    for (; i + WORD_BYTES <= len; i += WORD_BYTES) {
+        word_t v;
+        memcpy(&v, s + i, WORD_BYTES);
+        n += (size_t)__builtin_popcountll((unsigned long long)zero_bytes(v ^ pat));
+    }
+    for (; i < len; i++) n += s[i] == (uint8_t)c;
+    return n;
+}
+
+esp_err_t text_search_compile(text_search_t *ts, const char *pattern,
+                              bool ignore_case, bool whole_word)
+{
+    size_t len = pattern ? strlen(pattern) : 0;
+    if (len == 0 || memchr(pattern, '\n', len)) return ESP_ERR_INVALID_ARG;
+    if (len > MIMI_SEARCH_PATTERN_MAX) return ESP_ERR_INVALID_SIZE;
+
+    ts->len = len;
+    ts->ignore_case = ignore_case;
+    ts->whole_word = whole_word;
+    for (size_t i = 0; i < len; i++) {
+        ts->pat[i] = ignore_case ? fold((uint8_t)pattern[i]) : (uint8_t)pattern[i];
+    }
+    memset(ts->shift, (int)len, sizeof(ts->shift));
+    for (size_t i = 0; i + 1 < len; i++) ts->shift[ts->pat[i]] = (uint8_t)(len - 1 - i);
+    return ESP_OK;
+}
+
+static bool equal_at(const text_search_t *ts, const uint8_t *s)
+{
+    if (!ts->ignore_case) return memcmp(s, ts->pat, ts->len) == 0;
+    for (size_t i = 0; i < ts->len; i++) {
+        if (fold(s[i]) != ts->pat[i]) return false;
+    }
+    return true;
+}
+
+static long find_short(const text_search_t *ts, const uint8_t *s, size_t len, size_t from)
+{
+    uint8_t first = ts->pat[0];
+    bool fold_case = ts->ignore_case && first >= 'a' && first <= 'z';
+    size_t last = len - ts->len;        /* final start a match can have */
+    for (size_t i = from; i <= last; i++) {
+        i = find_byte(s, i, last + 1, first, fold_case);
+        if (i > last) break;
+        if (equal_at(ts, s + i)) return (long)i;
+    }
+    return -1;
+}
+
+static long find_horspool(const text_search_t *ts, const uint8_t *s, size_t len, size_t from)
+{
+    size_t m = ts->len;
+    uint8_t tail = ts->pat[m - 1];
+    if (!ts->ignore_case) {
+        /* Skip loop first: most windows end in a byte that is not tail */
+        for (size_t i = from; i + m <= len; i += ts->shift[tail]) {
+            uint8_t c;
+            while ((c = s[i + m - 1]) != tail) {
+                i += ts->shift[c];
+                if (i + m > len) return -1;
+            }
+            if (s[i] == ts->pat[0] && memcmp(s + i, ts->pat, m - 1) == 0) return (long)i;
+        }
+        return -1;
+    }
+    for (size_t i = from; i + m <= len;) {
+        uint8_t c = fold(s[i + m - 1]);
+        if (c == tail && equal_at(ts, s + i)) return (long)i;
+        i += ts->shift[c];
+    }
+    return -1;
+}
+
+long text_search_find(const text_search_t *ts, const char *buf, size_t len, size_t from)
+{
+    const uint8_t *s = (const uint8_t *)buf;
+    while (from + ts->len <= len) {
+        long at = ts->len < 3 ? find_short(ts, s, len, from) : find_horspool(ts, s, len, from);
+        if (at < 0) return -1;
+        size_t end = (size_t)at + ts->len;
+        if (!ts->whole_word ||
+            ((at == 0 || !is_word(s[at - 1])) && (end == len || !is_word(s[end])))) {
+            return at;
+        }
+        from = (size_t)at + 1;
+    }
+    return -1;
+}
+
+/* ── Streaming ───────────────────────────────────────────────── */
+
+/*
+ * The file passes through a buffer of whole lines: each refill searches up
+ * to the last '\n' read and carries the partial line after it. Up to
+ * context lines before the carried part stay in the buffer too (at most
+ * half a window), so a match early in the next refill can show them.
+ */
+
+#define SEARCH_CAP (MIMI_SEARCH_WINDOW + MIMI_SEARCH_WINDOW / 2)
+#define BINARY_PROBE 512
+
+typedef struct {
+    const char *buf;
+    uint32_t line;          /* number of the line at pos */
+    size_t pos;             /* searched up to here, always a line start but in long lines */
+    size_t shown;           /* lines before this were reported or dropped */
+    int after;              /* context lines still owed to the last match */
+    bool stop;
+} stream_t;
+
+/* Start of the line before the one starting at b, no earlier than lo */
+static size_t prev_line(const char *buf, size_t lo, size_t b)
+{
+    const char *nl = b - 1 > lo ? memrchr(buf + lo, '\n', b - 1 - lo) : NULL;
+    return nl ? (size_t)(nl - buf) + 1 : lo;
+}
+
+/* End of the line at p (its '\n', or end) */
+static size_t line_end(const char *buf, size_t p, size_t end)
+{
+    const char *nl = memchr(buf + p, '\n', end - p);
+    return nl ? (size_t)(nl - buf) : end;
+}
+
+/* Report the line at pos and step past it */
+static void emit_line(stream_t *st, size_t end, long match,
+                      text_search_line_cb_t cb, void *arg)
+{
+    size_t le = line_end(st->buf, st->pos, end);
+    if (!cb(st->line, st->buf + st->pos, le - st->pos, match, arg)) st->stop = true;
+    if (le < end) {
+        st->pos = le + 1;
+        st->line++;
+    } else {
+        st->pos = end;
+    }
+    st->shown = st->pos;
+}
+
+static void search_region(stream_t *st, const text_search_t *ts, size_t end, int context,
+                          text_search_line_cb_t cb, void *arg)
+{
+    while (st->pos < end && !st->stop) {
+        long m = text_search_find(ts, st->buf, end, st->pos);
+        size_t ls = end;
+        if (m >= 0) {
+            const char *nl = memrchr(st->buf + st->pos, '\n', (size_t)m - st->pos);
+            ls = nl ? (size_t)(nl - st->buf) + 1 : st->pos;
+        }
+
+        while (st->after > 0 && st->pos < ls && !st->stop) {
+            st->after--;
+            emit_line(st, end, -1, cb, arg);
+        }
+        if (st->stop) return;
+        st->line += (uint32_t)text_search_count(st->buf + st->pos, ls - st->pos, '\n');
+        st->pos = ls;
+        if (m < 0) return;
+
+        size_t b = ls;
+        int k = 0;
+        while (k < context && b > st->shown) {
+            b = prev_line(st->buf, st->shown, b);
+            k++;
+        }
+        uint32_t line = st->line;
+        st->line -= (uint32_t)k;
+        st->pos = b;
+        while (st->pos < ls && !st->stop) emit_line(st, ls, -1, cb, arg);
+        st->pos = ls;
+        st->line = line;
+        if (st->stop) return;
+        emit_line(st, end, m - (long)ls, cb, arg);
+        st->after = context;
+    }
+}
+
+esp_err_t text_search_file(const text_search_t *ts, FILE *f, int context,
+                           text_search_line_cb_t cb, void *arg)
+{
+    if (context < 0) context = 0;
+    if (context > MIMI_SEARCH_CONTEXT_MAX) context = MIMI_SEARCH_CONTEXT_MAX;
+
+    char *buf = heap_caps_malloc(SEARCH_CAP, MALLOC_CAP_SPIRAM);
+    if (!buf) return ESP_ERR_NO_MEM;
+
+    stream_t st = { .buf = buf, .line = 1 };
+    esp_err_t err = ESP_OK;
+    size_t len = 0;
+    bool eof = false, first = true;
+
+    while (err == ESP_OK && !st.stop) {
+        while (!eof && len < SEARCH_CAP) {
+            size_t n = fread(buf + len, 1, SEARCH_CAP - len, f);
+            if (n == 0) {
+                if (ferror(f)) err = ESP_FAIL;
+                eof = true;
+            }
+            len += n;
+        }
+        if (err != ESP_OK) break;
+        if (first) {
+            first = false;
+            if (memchr(buf, '\0', len < BINARY_PROBE ? len : BINARY_PROBE)) {
+                err = ESP_ERR_NOT_SUPPORTED;
+                break;
+            }
+        }
+
+        /* Whole lines only, unless one fills the buffer */
+        size_t end = len;
+        bool cut = false;
+        if (!eof) {
+            const char *nl = memrchr(buf + st.pos, '\n', len - st.pos);
+            if (nl) end = (size_t)(nl - buf) + 1;
+            else cut = true;
+        }
+        search_region(&st, ts, end, context, cb, arg);
+        if (eof || st.stop) break;
+
+        /* Keep the context lines before the carried part, then slide */
+        size_t keep = end;
+        if (!cut) {
+            for (int k = 0; k < context && keep > st.shown; k++) {
+                size_t b = prev_line(buf, st.shown, keep);
+                if (end - b > MIMI_SEARCH_WINDOW / 2) break;
+                keep = b;
+            }
+        }
+        memmove(buf, buf + keep, len - keep);
+        len -= keep;
+        st.pos -= keep;
+        st.shown = st.shown > keep ? st.shown - keep : 0;
+    }
+
+    heap_caps_free(buf);
+    return err;
+}
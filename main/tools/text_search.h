@@ -0,0 +1,55 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include "esp_err.h"
+#include "mimi_config.h"
+
+/**
+ * Substring search for search_files.
+ *
+ * Patterns of three bytes or more use Boyer-Moore-Horspool; shorter ones
+ * scan a machine word at a time for their first byte. Both fold ASCII case
+ * when asked, and whole-word matches are checked at each hit.
+ */
+
+typedef struct {
+    uint8_t pat[MIMI_SEARCH_PATTERN_MAX];   /* folded when ignore_case */
+    size_t len;
+    bool ignore_case;
+    bool whole_word;
+    uint8_t shift[256];                     /* Horspool shift per (folded) byte */
+} text_search_t;
+
+/**
+ * @return ESP_ERR_INVALID_ARG for an empty pattern or one holding a newline,
+ *         ESP_ERR_INVALID_SIZE past MIMI_SEARCH_PATTERN_MAX bytes
+ */
+esp_err_t text_search_compile(text_search_t *ts, const char *pattern,
+                              bool ignore_case, bool whole_word);
+
+/** Offset of the first match in buf[from, len), or -1. */
+long text_search_find(const text_search_t *ts, const char *buf, size_t len, size_t from);
+
+/** Number of c bytes in buf[0, len), counted a word at a time. */
+size_t text_search_count(const char *buf, size_t len, char c);
+
+/**
+ * Receives a line to report, numbered from 1, without its '\n'. match is
+ * the offset of the first match in it, or -1 for a context line. A line
+ * longer than MIMI_SEARCH_WINDOW arrives in pieces. false stops the search.
+ */
+typedef bool (*text_search_line_cb_t)(uint32_t line, const char *text, size_t len,
+                                      long match, void *arg);
+
+/**
+ * Search the text read from f, passing each matching line to cb with up
+ * to context lines before and after it, in order and each line once.
+ *
+ * @return ESP_OK, ESP_ERR_NOT_SUPPORTED if the start of f holds a NUL byte
+ *         (not text), ESP_ERR_NO_MEM, or ESP_FAIL on a read error
+ */
+esp_err_t text_search_file(const text_search_t *ts, FILE *f, int context,
+                           text_search_line_cb_t cb, void *arg);
@@ -1,13 +1,27 @@
+/* memrchr() */
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
 #include "tools/tool_files.h"
+#include "tools/file_edit.h"
+#include "tools/line_index.h"
+#include "tools/text_search.h"
 #include "mimi_config.h"
+#include "memory/memory_index.h"
+#include "memory/memory_store.h"
+#include "skills/skill_loader.h"
+#include "storage/storage_fs.h"
+#include "storage/storage_log.h"
 
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <stdarg.h>
 #include <stdbool.h>
-#include <dirent.h>
 #include <sys/stat.h>
 #include "esp_log.h"
+#include "esp_heap_caps.h"
 #include "cJSON.h"
 
 static const char *TAG = "tool_files";
@@ -32,6 +46,42 @@ static bool validate_path(const char *path)
 
 /* ── read_file ─────────────────────────────────────────────── */
 
+/* Room kept at the front of the output for the header line */
+#define READ_HEADER_MAX (MIMI_WAL_PATH_MAX + 128)
+
+/* Optional non-negative integer field; false if present but not one */
+static bool get_count(cJSON *root, const char *key, long min, long *out, bool *given)
+{
+    cJSON *item = cJSON_GetObjectItem(root, key);
+    *given = item != NULL;
+    if (!item) return true;
+    if (!cJSON_IsNumber(item) || item->valuedouble < min || item->valuedouble > (double)INT32_MAX) {
+        return false;
+    }
+    *out = (long)item->valuedouble;
+    return true;
+}
+
+/*
+ * Read up to limit bytes from f into buf, stopping after max_lines newlines
+ * (0 for no limit). *newlines gets the count seen.
+ */
+static size_t read_lines(FILE *f, char *buf, size_t limit, uint32_t max_lines, uint32_t *newlines)
+{
+    size_t n = 0;
+    *newlines = 0;
+    while (n < limit) {
+        size_t got = fread(buf + n, 1, limit - n, f);
+        if (got == 0) break;
+        for (const char *p = buf + n, *end = buf + n + got;
+             (p = memchr(p, '\n', end - p)) != NULL; p++) {
+            if (++*newlines == max_lines) return (size_t)(p - buf) + 1;
+        }
+        n += got;
+    }
+    return n;
+}
+
 esp_err_t tool_read_file_execute(const char *input_json, char *output, size_t output_size)
 {
     cJSON *root = cJSON_Parse(input_json);
@@ -47,21 +97,138 @@ esp_err_t tool_read_file_execute(const char *input_json, char *output, size_t ou
         return ESP_ERR_INVALID_ARG;
     }
 
-    FILE *f = fopen(path, "r");
+    long offset = 0, length = 0, start_line = 1, line_count = 0;
+    bool has_offset, has_length, has_start, has_count;
+    if (!get_count(root, "offset", 0, &offset, &has_offset) ||
+        !get_count(root, "length", 1, &length, &has_length) ||
+        !get_count(root, "start_line", 1, &start_line, &has_start) ||
+        !get_count(root, "line_count", 1, &line_count, &has_count)) {
+        snprintf(output, output_size,
+                 "Error: offset must be >= 0; length, start_line and line_count must be >= 1");
+        cJSON_Delete(root);
+        return ESP_ERR_INVALID_ARG;
+    }
+    bool by_line = has_start || has_count;
+    if (by_line && (has_offset || has_length)) {
+        snprintf(output, output_size,
+                 "Error: give offset/length or start_line/line_count, not both");
+        cJSON_Delete(root);
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    if (output_size <= READ_HEADER_MAX + 1) {
+        snprintf(output, output_size, "Error: output buffer too small");
+        cJSON_Delete(root);
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    line_index_pos_t pos;
+    esp_err_t err = by_line ? line_index_from_line(path, (uint32_t)start_line, &pos)
+                            : line_index_from_offset(path, (size_t)offset, &pos);
+    FILE *f = err == ESP_OK ? storage_fopen(path) : NULL;
     if (!f) {
-        snprintf(output, output_size, "Error: file not found: %s", path);
+        if (err == ESP_OK || err == ESP_ERR_NOT_FOUND) {
+            snprintf(output, output_size, "Error: file not found: %s", path);
+            err = ESP_ERR_NOT_FOUND;
+        } else {
+            snprintf(output, output_size, "Error: failed to index %s (%s)", path, esp_err_to_name(err));
+        }
         cJSON_Delete(root);
-        return ESP_ERR_NOT_FOUND;
+        return err;
     }
 
-    size_t max_read = output_size - 1;
-    if (max_read > MAX_FILE_SIZE) max_read = MAX_FILE_SIZE;
+    if (by_line ? (uint32_t)start_line > pos.lines && start_line > 1
+                : (size_t)offset > pos.size || ((size_t)offset == pos.size && offset > 0)) {
+        if (by_line) {
+            snprintf(output, output_size, "Error: start_line %ld is past the end of %s (%u lines)",
+                     start_line, path, (unsigned)pos.lines);
+        } else {
+            snprintf(output, output_size, "Error: offset %ld is past the end of %s (%u bytes)",
+                     offset, path, (unsigned)pos.size);
+        }
+        fclose(f);
+        cJSON_Delete(root);
+        return ESP_ERR_INVALID_ARG;
+    }
 
-    size_t n = fread(output, 1, max_read, f);
-    output[n] = '\0';
+    /* From the indexed mark, walk forward to the line or byte asked for;
+       the output buffer is scratch until the page is read */
+    char *page = output + READ_HEADER_MAX;
+    size_t room = output_size - READ_HEADER_MAX - 1;
+    if (room > MAX_FILE_SIZE) room = MAX_FILE_SIZE;
+
+    size_t from = pos.offset;
+    uint32_t first = pos.line;
+    if (fseek(f, (long)from, SEEK_SET) != 0) {
+        snprintf(output, output_size, "Error: seek failed in %s", path);
+        fclose(f);
+        cJSON_Delete(root);
+        return ESP_FAIL;
+    }
+    if (by_line) {
+        while (first < (uint32_t)start_line) {
+            uint32_t nl;
+            size_t n = read_lines(f, page, room, (uint32_t)start_line - first, &nl);
+            if (n == 0) break;
+            from += n;
+            first += nl;
+        }
+        fseek(f, (long)from, SEEK_SET);
+    } else {
+        while (from < (size_t)offset) {
+            size_t want = (size_t)offset - from;
+            uint32_t nl;
+            size_t n = read_lines(f, page, want < room ? want : room, 0, &nl);
+            if (n == 0) break;
+            from += n;
+            first += nl;
+        }
+    }
+
+    /* The page: whole lines when paging by line or with no range given */
+    size_t limit = room;
+    if (has_length && (size_t)length < limit) limit = (size_t)length;
+    uint32_t nl;
+    size_t n = read_lines(f, page, limit, by_line ? (uint32_t)line_count : 0, &nl);
+    bool more = from + n < pos.size;
+    if (more && !has_length && n > 0 && page[n - 1] != '\n') {
+        const char *cut = memrchr(page, '\n', n);
+        if (cut) n = (size_t)(cut - page) + 1;
+    }
     fclose(f);
+    more = from + n < pos.size;
+
+    /* Line of the last byte shown: newlines before it, past the first */
+    uint32_t last = first;
+    for (const char *p = page, *end = page + (n ? n - 1 : 0);
+         (p = memchr(p, '\n', end - p)) != NULL; p++) {
+        last++;
+    }
 
-    ESP_LOGI(TAG, "read_file: %s (%d bytes)", path, (int)n);
+    char header[READ_HEADER_MAX];
+    int hlen;
+    if (n == 0) {
+        hlen = snprintf(header, sizeof(header), "[%s: %u bytes, %u lines]\n",
+                        path, (unsigned)pos.size, (unsigned)pos.lines);
+    } else {
+        char next[48] = "";
+        if (more && page[n - 1] == '\n' && !has_length) {
+            snprintf(next, sizeof(next), "; next: start_line=%u", (unsigned)last + 1);
+        } else if (more) {
+            snprintf(next, sizeof(next), "; next: offset=%u", (unsigned)(from + n));
+        }
+        hlen = snprintf(header, sizeof(header),
+                        "[%s: %u bytes, %u lines; showing lines %u-%u, bytes %u-%u%s]\n",
+                        path, (unsigned)pos.size, (unsigned)pos.lines, (unsigned)first,
+                        (unsigned)last, (unsigned)from, (unsigned)(from + n - 1), next);
+    }
+    if (hlen < 0 || hlen >= (int)sizeof(header)) hlen = sizeof(header) - 1;
+    memcpy(output, header, hlen);
+    memmove(output + hlen, page, n);
+    output[hlen + n] = '\0';
+
+    ESP_LOGI(TAG, "read_file: %s bytes %u-%u of %u", path,
+             (unsigned)from, (unsigned)(from + n), (unsigned)pos.size);
     cJSON_Delete(root);
     return ESP_OK;
 }
@@ -90,31 +257,76 @@ esp_err_t tool_write_file_execute(const char *input_json, char *output, size_t o
         return ESP_ERR_INVALID_ARG;
     }
 
-    FILE *f = fopen(path, "w");
-    if (!f) {
-        snprintf(output, output_size, "Error: cannot open file for writing: %s", path);
-        cJSON_Delete(root);
-        return ESP_FAIL;
-    }
-
     size_t len = strlen(content);
-    size_t written = fwrite(content, 1, len, f);
-    fclose(f);
-
-    if (written != len) {
-        snprintf(output, output_size, "Error: wrote %d of %d bytes to %s", (int)written, (int)len, path);
+    if (storage_write_file(path, content, len) != ESP_OK) {
+        snprintf(output, output_size, "Error: cannot write file: %s", path);
         cJSON_Delete(root);
         return ESP_FAIL;
     }
 
-    snprintf(output, output_size, "OK: wrote %d bytes to %s", (int)written, path);
-    ESP_LOGI(TAG, "write_file: %s (%d bytes)", path, (int)written);
+    memory_index_update_file(path);
+    memory_notes_changed(path);
+    skill_loader_file_changed(path);
+    snprintf(output, output_size, "OK: wrote %d bytes to %s", (int)len, path);
+    ESP_LOGI(TAG, "write_file: %s (%d bytes)", path, (int)len);
     cJSON_Delete(root);
     return ESP_OK;
 }
 
 /* ── edit_file ─────────────────────────────────────────────── */
 
+/* Edited text: in PSRAM while it fits MIMI_EDIT_INLINE_MAX, so it goes
+   through the write-ahead log; past that, streamed to a replacement file */
+typedef struct {
+    const char *path;
+    char *buf;
+    size_t len;
+    size_t cap;
+    FILE *f;
+    size_t total;
+} edit_out_t;
+
+static bool edit_sink(const char *data, size_t len, void *arg)
+{
+    edit_out_t *o = arg;
+    o->total += len;
+    if (!o->f && o->len + len > MIMI_EDIT_INLINE_MAX) {
+        o->f = storage_open_replacement(o->path);
+        if (!o->f) return false;
+        if (o->len && fwrite(o->buf, 1, o->len, o->f) != o->len) return false;
+        heap_caps_free(o->buf);
+        o->buf = NULL;
+        o->len = o->cap = 0;
+    }
+    if (o->f) return fwrite(data, 1, len, o->f) == len;
+
+    if (o->len + len > o->cap) {
+        size_t cap = o->cap ? o->cap * 2 : 4096;
+        while (cap < o->len + len) cap *= 2;
+        if (cap > MIMI_EDIT_INLINE_MAX) cap = MIMI_EDIT_INLINE_MAX;
+        char *grown = heap_caps_realloc(o->buf, cap, MALLOC_CAP_SPIRAM);
+        if (!grown) return false;
+        o->buf = grown;
+        o->cap = cap;
+    }
+    memcpy(o->buf + o->len, data, len);
+    o->len += len;
+    return true;
+}
+
+/* One op from {old_string, new_string, replace_all, after}; NULL if malformed */
+static const char *parse_edit(const cJSON *obj, file_edit_op_t *op)
+{
+    memset(op, 0, sizeof(*op));
+    op->find = cJSON_GetStringValue(cJSON_GetObjectItem(obj, "old_string"));
+    op->replace = cJSON_GetStringValue(cJSON_GetObjectItem(obj, "new_string"));
+    op->after = cJSON_GetStringValue(cJSON_GetObjectItem(obj, "after"));
+    op->all = cJSON_IsTrue(cJSON_GetObjectItem(obj, "replace_all"));
+    if (!op->find || !op->replace) return "missing 'old_string' or 'new_string' field";
+    if (!op->find[0]) return "'old_string' must not be empty";
+    return NULL;
+}
+
 esp_err_t tool_edit_file_execute(const char *input_json, char *output, size_t output_size)
 {
     cJSON *root = cJSON_Parse(input_json);
@@ -124,100 +336,130 @@ esp_err_t tool_edit_file_execute(const char *input_json, char *output, size_t ou
     }
 
     const char *path = cJSON_GetStringValue(cJSON_GetObjectItem(root, "path"));
-    const char *old_str = cJSON_GetStringValue(cJSON_GetObjectItem(root, "old_string"));
-    const char *new_str = cJSON_GetStringValue(cJSON_GetObjectItem(root, "new_string"));
-
     if (!validate_path(path)) {
         snprintf(output, output_size, "Error: path must start with %s/ and must not contain '..'", MIMI_SPIFFS_BASE);
         cJSON_Delete(root);
         return ESP_ERR_INVALID_ARG;
     }
-    if (!old_str || !new_str) {
-        snprintf(output, output_size, "Error: missing 'old_string' or 'new_string' field");
+
+    /* Either an edits array or a single old_string/new_string pair */
+    file_edit_op_t ops[MIMI_EDIT_MAX_OPS];
+    int n_ops = 0;
+    const char *bad = NULL;
+    cJSON *edits = cJSON_GetObjectItem(root, "edits");
+    if (cJSON_IsArray(edits)) {
+        int n = cJSON_GetArraySize(edits);
+        if (n == 0 || n > MIMI_EDIT_MAX_OPS) {
+            snprintf(output, output_size, "Error: 'edits' must hold 1 to %d edits", MIMI_EDIT_MAX_OPS);
+            cJSON_Delete(root);
+            return ESP_ERR_INVALID_ARG;
+        }
+        cJSON *item;
+        cJSON_ArrayForEach(item, edits) {
+            bad = parse_edit(item, &ops[n_ops]);
+            if (bad) break;
+            n_ops++;
+        }
+    } else {
+        bad = parse_edit(root, &ops[0]);
+        n_ops = 1;
+    }
+    if (bad) {
+        if (cJSON_IsArray(edits)) {
+            snprintf(output, output_size, "Error: edit %d: %s", n_ops + 1, bad);
+        } else {
+            snprintf(output, output_size, "Error: %s", bad);
+        }
         cJSON_Delete(root);
         return ESP_ERR_INVALID_ARG;
     }
 
-    /* Read existing file */
-    FILE *f = fopen(path, "r");
+    FILE *f = storage_fopen(path);
     if (!f) {
         snprintf(output, output_size, "Error: file not found: %s", path);
         cJSON_Delete(root);
         return ESP_ERR_NOT_FOUND;
     }
+    struct stat st;
+    long old_size = storage_stat(path, &st) == 0 ? (long)st.st_size : -1;
 
-    fseek(f, 0, SEEK_END);
-    long file_size = ftell(f);
-    fseek(f, 0, SEEK_SET);
+    edit_out_t out = { .path = path };
+    esp_err_t err = file_edit_run(f, ops, n_ops, edit_sink, &out);
+    fclose(f);
 
-    if (file_size <= 0 || file_size > MAX_FILE_SIZE) {
-        snprintf(output, output_size, "Error: file too large or empty (%ld bytes)", file_size);
-        fclose(f);
-        cJSON_Delete(root);
-        return ESP_ERR_INVALID_SIZE;
+    /* All or nothing: one edit that matched nothing leaves the file as it was */
+    int missed = -1;
+    for (int i = 0; i < n_ops && missed < 0; i++) {
+        if (ops[i].count == 0) missed = i;
     }
-
-    /* Allocate buffer for the result (old content + possible expansion) */
-    size_t old_len = strlen(old_str);
-    size_t new_len = strlen(new_str);
-    size_t max_result = file_size + (new_len > old_len ? new_len - old_len : 0) + 1;
-    char *buf = malloc(file_size + 1);
-    char *result = malloc(max_result);
-    if (!buf || !result) {
-        free(buf);
-        free(result);
-        fclose(f);
-        snprintf(output, output_size, "Error: out of memory");
+    if (err != ESP_OK || missed >= 0) {
+        if (out.f) storage_discard_replacement(path, out.f);
+        heap_caps_free(out.buf);
+        if (err != ESP_OK) {
+            snprintf(output, output_size, "Error: cannot edit %s (%s)", path, esp_err_to_name(err));
+        } else {
+            const file_edit_op_t *m = &ops[missed];
+            char which[24] = "";
+            if (n_ops > 1) snprintf(which, sizeof(which), "edit %d: ", missed + 1);
+            if (!m->anchor_found) {
+                snprintf(output, output_size, "Error: %s'after' text not found in %s; file unchanged",
+                         which, path);
+            } else {
+                snprintf(output, output_size, "Error: %sold_string not found in %s%s; file unchanged",
+                         which, path, m->after ? " after the anchor" : "");
+            }
+            err = ESP_ERR_NOT_FOUND;
+        }
         cJSON_Delete(root);
-        return ESP_ERR_NO_MEM;
+        return err;
     }
 
-    size_t n = fread(buf, 1, file_size, f);
-    buf[n] = '\0';
-    fclose(f);
-
-    /* Find and replace first occurrence */
-    char *pos = strstr(buf, old_str);
-    if (!pos) {
-        snprintf(output, output_size, "Error: old_string not found in %s", path);
-        free(buf);
-        free(result);
-        cJSON_Delete(root);
-        return ESP_ERR_NOT_FOUND;
+    if (out.f) {
+        err = storage_commit_replacement(path, out.f);
+    } else {
+        err = storage_write_file(path, out.buf ? out.buf : "", out.len);
+        heap_caps_free(out.buf);
     }
-
-    size_t prefix_len = pos - buf;
-    memcpy(result, buf, prefix_len);
-    memcpy(result + prefix_len, new_str, new_len);
-    size_t suffix_start = prefix_len + old_len;
-    size_t suffix_len = n - suffix_start;
-    memcpy(result + prefix_len + new_len, buf + suffix_start, suffix_len);
-    size_t total = prefix_len + new_len + suffix_len;
-    result[total] = '\0';
-
-    free(buf);
-
-    /* Write back */
-    f = fopen(path, "w");
-    if (!f) {
-        snprintf(output, output_size, "Error: cannot open file for writing: %s", path);
-        free(result);
+    if (err != ESP_OK) {
+        snprintf(output, output_size, "Error: cannot write file: %s", path);
         cJSON_Delete(root);
         return ESP_FAIL;
     }
-
-    fwrite(result, 1, total, f);
-    fclose(f);
-    free(result);
-
-    snprintf(output, output_size, "OK: edited %s (replaced %d bytes with %d bytes)", path, (int)old_len, (int)new_len);
-    ESP_LOGI(TAG, "edit_file: %s", path);
+    memory_index_update_file(path);
+    memory_notes_changed(path);
+    skill_loader_file_changed(path);
+
+    int replaced = 0;
+    for (int i = 0; i < n_ops; i++) replaced += (int)ops[i].count;
+    int off = snprintf(output, output_size, "OK: edited %s (%d replacement%s, %ld -> %d bytes)",
+                       path, replaced, replaced == 1 ? "" : "s", old_size, (int)out.total);
+    for (int i = 0; n_ops > 1 && i < n_ops && off > 0 && (size_t)off < output_size; i++) {
+        off += snprintf(output + off, output_size - off, "%s edit %d: %d",
+                        i ? ";" : ":", i + 1, (int)ops[i].count);
+    }
+    ESP_LOGI(TAG, "edit_file: %s (%d edits, %d replacements, %s)", path, n_ops, replaced,
+             out.f ? "streamed" : "logged");
     cJSON_Delete(root);
     return ESP_OK;
 }
 
 /* ── list_dir ──────────────────────────────────────────────── */
 
+typedef struct {
+    char *out;
+    size_t size;
+    size_t off;
+    int count;
+} list_out_t;
+
+static bool list_one(const char *path, void *arg)
+{
+    list_out_t *lo = arg;
+    lo->off += snprintf(lo->out + lo->off, lo->size - lo->off, "%s\n", path);
+    lo->count++;
+    return lo->off < lo->size - 1;
+}
+
 esp_err_t tool_list_dir_execute(const char *input_json, char *output, size_t output_size)
 {
     cJSON *root = cJSON_Parse(input_json);
@@ -229,37 +471,200 @@ esp_err_t tool_list_dir_execute(const char *input_json, char *output, size_t out
         }
     }
 
-    DIR *dir = opendir(MIMI_SPIFFS_BASE);
-    if (!dir) {
+    list_out_t lo = { .out = output, .size = output_size };
+    output[0] = '\0';
+    if (storage_walk(prefix, list_one, &lo) != ESP_OK) {
         snprintf(output, output_size, "Error: cannot open %s directory", MIMI_SPIFFS_BASE);
         cJSON_Delete(root);
         return ESP_FAIL;
     }
+    int count = lo.count;
 
-    size_t off = 0;
-    struct dirent *ent;
-    int count = 0;
+    if (count == 0) {
+        snprintf(output, output_size, "(no files found)");
+    }
+
+    ESP_LOGI(TAG, "list_dir: %d files (prefix=%s)", count, prefix ? prefix : "(none)");
+    cJSON_Delete(root);
+    return ESP_OK;
+}
+
+/* ── search_files ──────────────────────────────────────────── */
+
+/* Room kept at the end of the output for the summary line */
+#define SEARCH_FOOTER_MAX 160
+
+typedef struct {
+    const text_search_t *ts;
+    int context;
+    char *out;
+    size_t size;            /* usable for matches, before the summary */
+    size_t off;
+    const char *path;       /* file being searched */
+    bool named;             /* path written for this file */
+    uint32_t last_line;     /* last line written, to mark gaps with "--" */
+    int max_matches;
+    int matches;
+    int files;
+    int files_matched;
+    bool truncated;
+} search_out_t;
+
+static bool search_append(search_out_t *so, const char *fmt, ...) __attribute__((format(printf, 2, 3)));
+
+static bool search_append(search_out_t *so, const char *fmt, ...)
+{
+    va_list ap;
+    va_start(ap, fmt);
+    int n = vsnprintf(so->out + so->off, so->size - so->off, fmt, ap);
+    va_end(ap);
+    if (n < 0 || (size_t)n >= so->size - so->off) {
+        so->out[so->off] = '\0';
+        so->truncated = true;
+        return false;
+    }
+    so->off += n;
+    return true;
+}
 
-    while ((ent = readdir(dir)) != NULL && off < output_size - 1) {
-        /* Build full path: SPIFFS entries are just filenames with embedded slashes */
-        char full_path[512];
-        snprintf(full_path, sizeof(full_path), "%s/%s", MIMI_SPIFFS_BASE, ent->d_name);
+static bool search_line(uint32_t line, const char *text, size_t len, long match, void *arg)
+{
+    search_out_t *so = arg;
+    if (match >= 0 && so->matches >= so->max_matches) {
+        so->truncated = true;
+        return false;
+    }
+
+    size_t saved = so->off;
+    bool ok = true;
+    if (!so->named) {
+        ok = search_append(so, "%s%s\n", so->files_matched ? "\n" : "", so->path);
+    } else if (line > so->last_line + 1) {
+        ok = search_append(so, "--\n");
+    }
 
-        if (prefix && strncmp(full_path, prefix, strlen(prefix)) != 0) {
-            continue;
+    /* Clip long lines, keeping the match in view */
+    size_t from = 0, show = len;
+    if (len > MIMI_SEARCH_LINE_MAX) {
+        show = MIMI_SEARCH_LINE_MAX;
+        if (match > MIMI_SEARCH_LINE_MAX / 4) {
+            from = (size_t)match - MIMI_SEARCH_LINE_MAX / 4;
+            if (from > len - show) from = len - show;
         }
+    }
+    if (ok) {
+        ok = search_append(so, "%u%c%s%.*s%s\n", (unsigned)line, match >= 0 ? ':' : '-',
+                           from ? "..." : "", (int)show, text + from,
+                           from + show < len ? "..." : "");
+    }
+    if (!ok) {
+        so->off = saved;
+        so->out[so->off] = '\0';
+        return false;
+    }
+    if (!so->named) {
+        so->named = true;
+        so->files_matched++;
+    }
+    so->last_line = line;
+    if (match >= 0) so->matches++;
+    return true;
+}
 
-        off += snprintf(output + off, output_size - off, "%s\n", full_path);
-        count++;
+static bool search_one(const char *path, void *arg)
+{
+    search_out_t *so = arg;
+    size_t len = strlen(path);
+    if (strcmp(path, MIMI_WAL_FILE) == 0 || (len > 4 && strcmp(path + len - 4, ".tmp") == 0)) {
+        return true;
     }
+    FILE *f = storage_fopen(path);
+    if (!f) return true;
 
-    closedir(dir);
+    so->path = path;
+    so->named = false;
+    so->last_line = 0;
+    esp_err_t err = text_search_file(so->ts, f, so->context, search_line, so);
+    fclose(f);
+    if (err == ESP_OK) so->files++;
+    else if (err != ESP_ERR_NOT_SUPPORTED) ESP_LOGW(TAG, "search_files: %s: %s", path, esp_err_to_name(err));
+    return !so->truncated;
+}
 
-    if (count == 0) {
-        snprintf(output, output_size, "(no files found)");
+esp_err_t tool_search_files_execute(const char *input_json, char *output, size_t output_size)
+{
+    cJSON *root = cJSON_Parse(input_json);
+    if (!root) {
+        snprintf(output, output_size, "Error: invalid JSON input");
+        return ESP_ERR_INVALID_ARG;
     }
 
-    ESP_LOGI(TAG, "list_dir: %d files (prefix=%s)", count, prefix ? prefix : "(none)");
+    const char *pattern = cJSON_GetStringValue(cJSON_GetObjectItem(root, "pattern"));
+    const char *prefix = cJSON_GetStringValue(cJSON_GetObjectItem(root, "prefix"));
+    if (!prefix || !prefix[0]) prefix = MIMI_SPIFFS_BASE "/";
+    if (!validate_path(prefix)) {
+        snprintf(output, output_size, "Error: prefix must start with %s/ and must not contain '..'", MIMI_SPIFFS_BASE);
+        cJSON_Delete(root);
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    text_search_t *ts = heap_caps_malloc(sizeof(*ts), MALLOC_CAP_SPIRAM);
+    if (!ts) {
+        snprintf(output, output_size, "Error: out of memory");
+        cJSON_Delete(root);
+        return ESP_ERR_NO_MEM;
+    }
+    esp_err_t err = text_search_compile(ts, pattern,
+                                        cJSON_IsTrue(cJSON_GetObjectItem(root, "ignore_case")),
+                                        cJSON_IsTrue(cJSON_GetObjectItem(root, "whole_word")));
+    if (err != ESP_OK) {
+        snprintf(output, output_size, "Error: pattern must be 1-%d bytes on one line", MIMI_SEARCH_PATTERN_MAX);
+        heap_caps_free(ts);
+        cJSON_Delete(root);
+        return err;
+    }
+
+    long context = 0, max_matches = MIMI_SEARCH_MATCHES_DEFAULT;
+    bool given;
+    if (!get_count(root, "context", 0, &context, &given) ||
+        !get_count(root, "max_matches", 1, &max_matches, &given)) {
+        snprintf(output, output_size, "Error: context must be >= 0 and max_matches >= 1");
+        heap_caps_free(ts);
+        cJSON_Delete(root);
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (context > MIMI_SEARCH_CONTEXT_MAX) context = MIMI_SEARCH_CONTEXT_MAX;
+
+    output[0] = '\0';
+    search_out_t so = {
+        .ts = ts,
+        .context = (int)context,
+        .out = output,
+        .size = output_size > SEARCH_FOOTER_MAX ? output_size - SEARCH_FOOTER_MAX : 1,
+        .max_matches = (int)max_matches,
+    };
+    if (storage_walk(prefix, search_one, &so) != ESP_OK) {
+        snprintf(output, output_size, "Error: cannot open %s directory", MIMI_SPIFFS_BASE);
+        heap_caps_free(ts);
+        cJSON_Delete(root);
+        return ESP_FAIL;
+    }
+
+    /* The summary goes in the room kept for it */
+    size_t off = so.off;
+    if (so.truncated) {
+        snprintf(output + off, output_size - off,
+                 "%s[stopped after %d matches in %d files; narrow the prefix or pattern, "
+                 "or read_file around a line]",
+                 off ? "\n" : "", so.matches, so.files_matched);
+    } else {
+        snprintf(output + off, output_size - off, "%s[%d matches in %d of %d files]",
+                 off ? "\n" : "", so.matches, so.files_matched, so.files);
+    }
+
+    ESP_LOGI(TAG, "search_files: \"%s\" under %s: %d matches in %d of %d files%s",
+             pattern, prefix, so.matches, so.files_matched, so.files, so.truncated ? " (truncated)" : "");
+    heap_caps_free(ts);
     cJSON_Delete(root);
     return ESP_OK;
 }
@@ -26,3 +26,11 @@ esp_err_t tool_edit_file_execute(const char *input_json, char *output, size_t ou
  * Input JSON: {"prefix": "<MIMI_SPIFFS_BASE>/..."} (prefix is optional)
  */
 esp_err_t tool_list_dir_execute(const char *input_json, char *output, size_t output_size);
+
+/**
+ * Search text files on SPIFFS for a literal string; returns matching lines
+ * with line numbers and optional context, grep-style, up to max_matches.
+ * Input JSON: {"pattern": "...", "prefix": "<MIMI_SPIFFS_BASE>/...", "ignore_case": false,
+ *              "whole_word": false, "context": 0, "max_matches": 30} (all but pattern optional)
+ */
+esp_err_t tool_search_files_execute(const char *input_json, char *output, size_t output_size);
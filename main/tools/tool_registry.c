@@ -4,6 +4,7 @@
 #include "tools/tool_get_time.h"
 #include "tools/tool_files.h"
 #include "tools/tool_cron.h"
+#include "tools/line_index.h"
 
 #include <string.h>
 #include "esp_log.h"
@@ -57,6 +58,7 @@ esp_err_t tool_registry_init(void)
 
     /* Register web_search */
     tool_web_search_init();
+    line_index_init();
 
     mimi_tool_t ws = {
         .name = "web_search",
@@ -84,10 +86,16 @@ esp_err_t tool_registry_init(void)
     /* Register read_file */
     mimi_tool_t rf = {
         .name = "read_file",
-        .description = "Read a file from SPIFFS storage. Path must start with " MIMI_SPIFFS_BASE "/.",
+        .description = "Read a file from SPIFFS storage. Path must start with " MIMI_SPIFFS_BASE "/. "
+                       "The first line gives the file's size and line count and the range shown; "
+                       "page through large files with start_line/line_count or offset/length.",
         .input_schema_json =
             "{\"type\":\"object\","
-            "\"properties\":{\"path\":{\"type\":\"string\",\"description\":\"Absolute path starting with " MIMI_SPIFFS_BASE "/\"}},"
+            "\"properties\":{\"path\":{\"type\":\"string\",\"description\":\"Absolute path starting with " MIMI_SPIFFS_BASE "/\"},"
+            "\"start_line\":{\"type\":\"integer\",\"description\":\"First line to read, from 1\"},"
+            "\"line_count\":{\"type\":\"integer\",\"description\":\"Lines to read (default: as many as fit)\"},"
+            "\"offset\":{\"type\":\"integer\",\"description\":\"First byte to read, from 0 (instead of start_line)\"},"
+            "\"length\":{\"type\":\"integer\",\"description\":\"Bytes to read (default: as many as fit)\"}},"
             "\"required\":[\"path\"]}",
         .execute = tool_read_file_execute,
     };
@@ -109,13 +117,23 @@ esp_err_t tool_registry_init(void)
     /* Register edit_file */
     mimi_tool_t ef = {
         .name = "edit_file",
-        .description = "Find and replace text in a file on SPIFFS. Replaces first occurrence of old_string with new_string.",
+        .description = "Find and replace text in a file on SPIFFS. Replaces the first occurrence of old_string "
+                       "with new_string, or every one with replace_all; after restricts the match to text "
+                       "following an anchor such as a heading. Pass several edits at once in edits; all "
+                       "apply or none do.",
         .input_schema_json =
             "{\"type\":\"object\","
             "\"properties\":{\"path\":{\"type\":\"string\",\"description\":\"Absolute path starting with " MIMI_SPIFFS_BASE "/\"},"
             "\"old_string\":{\"type\":\"string\",\"description\":\"Text to find\"},"
-            "\"new_string\":{\"type\":\"string\",\"description\":\"Replacement text\"}},"
-            "\"required\":[\"path\",\"old_string\",\"new_string\"]}",
+            "\"new_string\":{\"type\":\"string\",\"description\":\"Replacement text\"},"
+            "\"replace_all\":{\"type\":\"boolean\",\"description\":\"Replace every occurrence (default false)\"},"
+            "\"after\":{\"type\":\"string\",\"description\":\"Only match after the first occurrence of this text\"},"
+            "\"edits\":{\"type\":\"array\",\"description\":\"Several edits applied in one pass, instead of old_string/new_string\","
+            "\"items\":{\"type\":\"object\",\"properties\":{"
+            "\"old_string\":{\"type\":\"string\"},\"new_string\":{\"type\":\"string\"},"
+            "\"replace_all\":{\"type\":\"boolean\"},\"after\":{\"type\":\"string\"}},"
+            "\"required\":[\"old_string\",\"new_string\"]}}},"
+            "\"required\":[\"path\"]}",
         .execute = tool_edit_file_execute,
     };
     register_tool(&ef);
@@ -132,6 +150,26 @@ esp_err_t tool_registry_init(void)
     };
     register_tool(&ld);
 
+    /* Register search_files */
+    mimi_tool_t sf = {
+        .name = "search_files",
+        .description = "Search text files on SPIFFS storage for a string and return the matching lines "
+                       "as path, then line:text (context lines as line-text). Use it to find something "
+                       "in memory, notes or skills before reading whole files.",
+        .input_schema_json =
+            "{\"type\":\"object\","
+            "\"properties\":{"
+            "\"pattern\":{\"type\":\"string\",\"description\":\"Text to find (literal, one line)\"},"
+            "\"prefix\":{\"type\":\"string\",\"description\":\"Only search paths starting with this, e.g. " MIMI_SPIFFS_BASE "/memory/ (default: all files)\"},"
+            "\"ignore_case\":{\"type\":\"boolean\",\"description\":\"Match regardless of ASCII case\"},"
+            "\"whole_word\":{\"type\":\"boolean\",\"description\":\"Only match where the pattern is not part of a longer word\"},"
+            "\"context\":{\"type\":\"integer\",\"description\":\"Lines to show before and after each match, 0-3\"},"
+            "\"max_matches\":{\"type\":\"integer\",\"description\":\"Stop after this many matches (default 30)\"}},"
+            "\"required\":[\"pattern\"]}",
+        .execute = tool_search_files_execute,
+    };
+    register_tool(&sf);
+
     /* Register cron_add */
     mimi_tool_t ca = {
         .name = "cron_add",
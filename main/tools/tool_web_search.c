@@ -1,6 +1,7 @@
 #include "tool_web_search.h"
 #include "mimi_config.h"
 #include "proxy/http_proxy.h"
+#include "proxy/http_vcr.h"
 
 #include <string.h>
 #include <stdlib.h>
@@ -8,6 +9,7 @@
 #include "esp_http_client.h"
 #include "esp_crt_bundle.h"
 #include "esp_heap_caps.h"
+#include "esp_timer.h"
 #include "nvs.h"
 #include "cJSON.h"
 
@@ -66,12 +68,12 @@ esp_err_t tool_web_search_init(void)
         char tmp[128] = {0};
         size_t len = sizeof(tmp);
         if (nvs_get_str(nvs, MIMI_NVS_KEY_API_KEY, tmp, &len) == ESP_OK && tmp[0]) {
-            strncpy(s_brave_key, tmp, sizeof(s_brave_key) - 1);
+            snprintf(s_brave_key, sizeof(s_brave_key), "%s", tmp);
         }
         memset(tmp, 0, sizeof(tmp));
         len = sizeof(tmp);
         if (nvs_get_str(nvs, MIMI_NVS_KEY_TAVILY_KEY, tmp, &len) == ESP_OK && tmp[0]) {
-            strncpy(s_tavily_key, tmp, sizeof(s_tavily_key) - 1);
+            snprintf(s_tavily_key, sizeof(s_tavily_key), "%s", tmp);
         }
         nvs_close(nvs);
     }
@@ -411,6 +413,50 @@ static esp_err_t tavily_search_via_proxy(const char *query, search_buf_t *sb)
     return ESP_OK;
 }
 
+/* ── Shared HTTP dispatch ─────────────────────────────────────── */
+
+static esp_err_t search_http_call(const char *query, const char *encoded_query, search_buf_t *sb)
+{
+    const char *key = (s_provider == SEARCH_PROVIDER_TAVILY) ? "tavily" : "brave";
+
+    if (http_vcr_replaying()) {
+        http_vcr_resp_t vr;
+        esp_err_t err = http_vcr_replay("search", key, query, strlen(query), &vr);
+        if (err != ESP_OK) return err;
+        size_t n = vr.len < sb->cap - 1 ? vr.len : sb->cap - 1;
+        memcpy(sb->data, vr.body, n);
+        sb->data[n] = '\0';
+        sb->len = n;
+        free(vr.body);
+        return ESP_OK;
+    }
+
+    int64_t start_us = esp_timer_get_time();
+    esp_err_t err;
+    if (s_provider == SEARCH_PROVIDER_TAVILY) {
+        if (http_proxy_is_enabled()) {
+            err = tavily_search_via_proxy(query, sb);
+        } else {
+            err = tavily_search_direct(query, sb);
+        }
+    } else {
+        char path[384];
+        snprintf(path, sizeof(path),
+                 "/res/v1/web/search?q=%s&count=%d", encoded_query, SEARCH_RESULT_COUNT);
+        if (http_proxy_is_enabled()) {
+            err = brave_search_via_proxy(path, sb);
+        } else {
+            char url[512];
+            snprintf(url, sizeof(url), "https://api.search.brave.com%s", path);
+            err = brave_search_direct(url, sb);
+        }
+    }
+    if (err == ESP_OK) {
+        http_vcr_record("search", key, query, strlen(query), 200, sb->data, start_us);
+    }
+    return err;
+}
+
 /* ── Execute ──────────────────────────────────────────────────── */
 
 esp_err_t tool_web_search_execute(const char *input_json, char *output, size_t output_size)
@@ -454,26 +500,7 @@ esp_err_t tool_web_search_execute(const char *input_json, char *output, size_t o
     sb.cap = SEARCH_BUF_SIZE;
 
     /* Make HTTP request */
-    esp_err_t err;
-    if (s_provider == SEARCH_PROVIDER_TAVILY) {
-        if (http_proxy_is_enabled()) {
-            err = tavily_search_via_proxy(query_copy, &sb);
-        } else {
-            err = tavily_search_direct(query_copy, &sb);
-        }
-    } else {
-        char path[384];
-        snprintf(path, sizeof(path),
-                 "/res/v1/web/search?q=%s&count=%d", encoded_query, SEARCH_RESULT_COUNT);
-        if (http_proxy_is_enabled()) {
-            err = brave_search_via_proxy(path, &sb);
-        } else {
-            char url[512];
-            snprintf(url, sizeof(url), "https://api.search.brave.com%s", path);
-            err = brave_search_direct(url, &sb);
-        }
-    }
-
+    esp_err_t err = search_http_call(query_copy, encoded_query, &sb);
     if (err != ESP_OK) {
         free(sb.data);
         snprintf(output, output_size, "Error: Search request failed");
@@ -0,0 +1,424 @@
+#!/usr/bin/env python3
+"""Concurrent-chat load generator for the MimiClaw WebSocket gateway.
+
+Opens --sessions WebSocket connections to ws_server (device or Linux host
+build), each with its own chat_id, and plays scripted conversations at a
+configurable arrival rate. Reports per-message end-to-end latency
+percentiles, messages left unanswered after --reply-timeout, connections the
+server refused, and server heap over time sampled with the gateway's
+{"type":"stats"} request. The server side also reports how many messages
+the inbound bus dropped (it gives up after 1 s when full), which tells real
+drops apart from replies that were merely slower than the timeout.
+
+  scripts/ws_loadgen.py --host 192.168.1.50 --sessions 4 --messages 100 --rate 2
+  scripts/ws_loadgen.py --sessions 16 --mode closed --think-ms 500 --json out.json
+
+Arrival models:
+  open    messages arrive at --rate per second (Poisson by default) and are
+          dealt round-robin to sessions, whether or not earlier replies came
+  closed  every session sends its next turn --think-ms after its previous
+          reply (or reply timeout); --rate is ignored
+
+Script file (--script): JSON {"conversations": [["turn 1", "turn 2"], ...]}.
+Session i plays conversation i % N, looping when it runs out of turns.
+Only the standard library is used, so it runs anywhere Python 3.8+ does.
+"""
+
+import argparse
+import asyncio
+import base64
+import collections
+import hashlib
+import json
+import os
+import random
+import struct
+import sys
+import time
+
+WORKING_PREFIX = "\U0001F431mimi is working"
+WS_GUID = "258EAFA5-E914-47DA-95CA-C5AB0DC85B11"
+
+DEFAULT_SCRIPT = [
+    ["hi there", "what can you do?", "thanks!"],
+    ["remember that my favourite colour is teal", "what is my favourite colour?"],
+    ["please search the web for esp32-s3 psram bandwidth", "summarise that in one line"],
+    ["what time is it?", "and what day of the week?"],
+]
+
+
+def percentile(sorted_vals, p):
+    if not sorted_vals:
+        return 0.0
+    k = (len(sorted_vals) - 1) * p / 100.0
+    lo = int(k)
+    hi = min(lo + 1, len(sorted_vals) - 1)
+    return sorted_vals[lo] + (sorted_vals[hi] - sorted_vals[lo]) * (k - lo)
+
+
+# ── Minimal RFC 6455 client ─────────────────────────────────────
+
+
+class WsClosed(Exception):
+    pass
+
+
+class WsConn:
+    def __init__(self, reader, writer):
+        self.reader = reader
+        self.writer = writer
+        self.lock = asyncio.Lock()
+
+    @classmethod
+    async def connect(cls, host, port, timeout):
+        reader, writer = await asyncio.wait_for(asyncio.open_connection(host, port), timeout)
+        key = base64.b64encode(os.urandom(16)).decode()
+        writer.write((
+            f"GET / HTTP/1.1\r\nHost: {host}:{port}\r\n"
+            "Upgrade: websocket\r\nConnection: Upgrade\r\n"
+            f"Sec-WebSocket-Key: {key}\r\nSec-WebSocket-Version: 13\r\n\r\n").encode())
+        await writer.drain()
+        head = await asyncio.wait_for(reader.readuntil(b"\r\n\r\n"), timeout)
+        lines = head.decode(errors="replace").split("\r\n")
+        if " 101 " not in lines[0] + " ":
+            writer.close()
+            raise WsClosed(lines[0])
+        expect = base64.b64encode(hashlib.sha1((key + WS_GUID).encode()).digest()).decode()
+        accept = [l.split(":", 1)[1].strip() for l in lines if l.lower().startswith("sec-websocket-accept:")]
+        if accept and accept[0] != expect:
+            writer.close()
+            raise WsClosed("bad Sec-WebSocket-Accept")
+        return cls(reader, writer)
+
+    async def _send_frame(self, opcode, payload):
+        mask = os.urandom(4)
+        n = len(payload)
+        if n < 126:
+            head = struct.pack("!BB", 0x80 | opcode, 0x80 | n)
+        elif n < 65536:
+            head = struct.pack("!BBH", 0x80 | opcode, 0x80 | 126, n)
+        else:
+            head = struct.pack("!BBQ", 0x80 | opcode, 0x80 | 127, n)
+        body = bytes(b ^ mask[i & 3] for i, b in enumerate(payload))
+        async with self.lock:
+            self.writer.write(head + mask + body)
+            await self.writer.drain()
+
+    async def send_json(self, obj):
+        await self._send_frame(0x1, json.dumps(obj).encode())
+
+    async def recv_text(self):
+        """Next text message, or raises WsClosed."""
+        buf = b""
+        while True:
+            try:
+                b0, b1 = await self.reader.readexactly(2)
+                n = b1 & 0x7F
+                if n == 126:
+                    n = struct.unpack("!H", await self.reader.readexactly(2))[0]
+                elif n == 127:
+                    n = struct.unpack("!Q", await self.reader.readexactly(8))[0]
+                mask = await self.reader.readexactly(4) if b1 & 0x80 else None
+                payload = await self.reader.readexactly(n)
+            except (asyncio.IncompleteReadError, ConnectionError) as e:
+                raise WsClosed(str(e))
+            if mask:
+                payload = bytes(b ^ mask[i & 3] for i, b in enumerate(payload))
+            opcode = b0 & 0x0F
+            if opcode == 0x8:
+                raise WsClosed("close frame")
+            if opcode == 0x9:
+                await self._send_frame(0xA, payload)
+                continue
+            if opcode in (0x1, 0x0):
+                buf += payload
+                if b0 & 0x80:
+                    return buf.decode(errors="replace")
+
+    def close(self):
+        try:
+            self.writer.close()
+        except Exception:
+            pass
+
+
+# ── Load model ──────────────────────────────────────────────────
+
+
+class Session:
+    def __init__(self, idx, args, conversation):
+        self.idx = idx
+        self.chat_id = f"{args.chat_prefix}{idx}"
+        self.conversation = conversation
+        self.turn = 0
+        self.conn = None
+        self.alive = False
+        self.pending = collections.deque()   # [t_sent, timed_out]
+        self.reply_event = asyncio.Event()
+
+    def next_text(self):
+        text = self.conversation[self.turn % len(self.conversation)]
+        self.turn += 1
+        return text
+
+
+class LoadGen:
+    def __init__(self, args, script):
+        self.args = args
+        self.sessions = [Session(i, args, script[i % len(script)]) for i in range(args.sessions)]
+        self.t0 = time.monotonic()
+        self.latencies = []
+        self.sent = 0
+        self.send_failed = 0
+        self.replied = 0
+        self.late = 0
+        self.timed_out = 0
+        self.status_msgs = 0
+        self.connect_failed = 0
+        self.disconnected = 0
+        self.mem = []
+        self.last_send = self.t0
+        self.done_sending = False
+
+    def now_ms(self):
+        return (time.monotonic() - self.t0) * 1000.0
+
+    async def connect_all(self):
+        for s in self.sessions:
+            try:
+                s.conn = await WsConn.connect(self.args.host, self.args.port, self.args.connect_timeout)
+                s.alive = True
+                asyncio.ensure_future(self.reader(s))
+            except (OSError, asyncio.TimeoutError, asyncio.IncompleteReadError, WsClosed) as e:
+                self.connect_failed += 1
+                if self.args.verbose:
+                    print(f"session {s.idx}: connect failed: {e}", file=sys.stderr)
+            if self.args.connect_stagger_ms:
+                await asyncio.sleep(self.args.connect_stagger_ms / 1000.0)
+        # The server may accept the TCP connection and then close it when full
+        await asyncio.sleep(0.3)
+
+    async def reader(self, s):
+        try:
+            while True:
+                msg = json.loads(await s.conn.recv_text())
+                mtype = msg.get("type")
+                if mtype == "stats":
+                    msg["t_ms"] = round(self.now_ms())
+                    self.mem.append(msg)
+                    continue
+                if mtype != "response":
+                    continue
+                if msg.get("content", "").startswith(WORKING_PREFIX):
+                    self.status_msgs += 1
+                    continue
+                if not s.pending:
+                    continue
+                t_sent, timed_out = s.pending.popleft()
+                if timed_out:
+                    self.timed_out -= 1
+                    self.late += 1
+                self.latencies.append((time.monotonic() - t_sent) * 1000.0)
+                self.replied += 1
+                s.reply_event.set()
+        except (WsClosed, ValueError) as e:
+            if s.alive:
+                s.alive = False
+                self.disconnected += 1
+                if self.args.verbose:
+                    print(f"session {s.idx}: closed: {e}", file=sys.stderr)
+                s.reply_event.set()
+
+    async def send(self, s):
+        if not s.alive:
+            self.send_failed += 1
+            return False
+        entry = [time.monotonic(), False]
+        s.pending.append(entry)
+        try:
+            await s.conn.send_json({"type": "message", "chat_id": s.chat_id, "content": s.next_text()})
+        except (ConnectionError, OSError):
+            s.pending.remove(entry)
+            self.send_failed += 1
+            return False
+        self.sent += 1
+        self.last_send = time.monotonic()
+        asyncio.ensure_future(self.expire(s, entry))
+        return True
+
+    async def expire(self, s, entry):
+        await asyncio.sleep(self.args.reply_timeout)
+        if entry in s.pending and not entry[1]:
+            entry[1] = True
+            self.timed_out += 1
+            s.reply_event.set()
+
+    async def run_open(self):
+        a = self.args
+        live = [s for s in self.sessions if s.alive]
+        if not live:
+            return
+        for i in range(a.messages):
+            if a.rate > 0:
+                gap = random.expovariate(a.rate) if a.arrival == "poisson" else 1.0 / a.rate
+                await asyncio.sleep(gap)
+            await self.send(live[i % len(live)])
+
+    async def run_closed(self):
+        a = self.args
+        live = [s for s in self.sessions if s.alive]
+        if not live:
+            return
+        budget = [a.messages // len(live) + (1 if i < a.messages % len(live) else 0)
+                  for i in range(len(live))]
+
+        async def loop(s, n):
+            for _ in range(n):
+                s.reply_event.clear()
+                if not await self.send(s):
+                    return
+                await s.reply_event.wait()
+                if a.think_ms:
+                    await asyncio.sleep(a.think_ms / 1000.0)
+
+        await asyncio.gather(*(loop(s, n) for s, n in zip(live, budget)))
+
+    async def sample_memory(self):
+        while True:
+            probe = next((s for s in self.sessions if s.alive), None)
+            if probe:
+                try:
+                    await probe.conn.send_json({"type": "stats"})
+                except (ConnectionError, OSError):
+                    pass
+            await asyncio.sleep(self.args.stats_interval)
+
+    async def final_sample(self):
+        probe = next((s for s in self.sessions if s.alive), None)
+        if not probe:
+            return
+        n = len(self.mem)
+        try:
+            await probe.conn.send_json({"type": "stats"})
+        except (ConnectionError, OSError):
+            return
+        for _ in range(20):
+            if len(self.mem) > n:
+                return
+            await asyncio.sleep(0.1)
+
+    def outstanding(self):
+        return sum(1 for s in self.sessions for e in s.pending if not e[1])
+
+    async def run(self):
+        await self.connect_all()
+        sampler = asyncio.ensure_future(self.sample_memory()) if self.args.stats_interval > 0 else None
+        if self.args.mode == "open":
+            await self.run_open()
+        else:
+            await self.run_closed()
+        self.done_sending = True
+        while self.outstanding() and time.monotonic() - self.last_send < self.args.reply_timeout + 1:
+            await asyncio.sleep(0.1)
+        t_end = time.monotonic()
+        if sampler:
+            sampler.cancel()
+            await self.final_sample()
+        for s in self.sessions:
+            if s.conn:
+                s.conn.close()
+        return self.summary(t_end)
+
+    def summary(self, t_end):
+        lat = sorted(self.latencies)
+        elapsed = max(t_end - self.t0, 1e-9)
+        connected = sum(1 for s in self.sessions if s.conn)
+        out = {
+            "sessions": self.args.sessions,
+            "connected": connected - self.disconnected,
+            "connect_failed": self.connect_failed,
+            "disconnected": self.disconnected,
+            "sent": self.sent,
+            "send_failed": self.send_failed,
+            "replied": self.replied,
+            "late_replies": self.late,
+            "unanswered": self.sent - self.replied,
+            "status_msgs": self.status_msgs,
+            "elapsed_s": round(elapsed, 3),
+            "throughput_msgs_per_s": round(self.replied / elapsed, 2),
+            "latency_ms": {
+                "p50": round(percentile(lat, 50), 1),
+                "p90": round(percentile(lat, 90), 1),
+                "p99": round(percentile(lat, 99), 1),
+                "max": round(lat[-1], 1) if lat else 0.0,
+            },
+        }
+        if self.mem:
+            first, last = self.mem[0], self.mem[-1]
+            out["server"] = {
+                "samples": len(self.mem),
+                "max_clients": last.get("max_clients"),
+                "bus_dropped": last.get("dropped", 0) - first.get("dropped", 0),
+                "internal_free_min": min(m.get("internal_free", 0) for m in self.mem),
+                "internal_free_last": last.get("internal_free"),
+                "psram_free_min": min(m.get("psram_free", 0) for m in self.mem),
+                "psram_free_last": last.get("psram_free"),
+            }
+        return out
+
+
+def load_script(path):
+    if not path:
+        return DEFAULT_SCRIPT
+    with open(path) as f:
+        convs = json.load(f).get("conversations", [])
+    convs = [c for c in convs if c]
+    if not convs:
+        sys.exit(f"{path}: no conversations")
+    return convs
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__.split("\n\n")[0])
+    ap.add_argument("--host", default="127.0.0.1")
+    ap.add_argument("--port", type=int, default=18789)
+    ap.add_argument("--sessions", type=int, default=4, help="concurrent WebSocket sessions")
+    ap.add_argument("--messages", type=int, default=100, help="total messages to send")
+    ap.add_argument("--mode", choices=("open", "closed"), default="open")
+    ap.add_argument("--rate", type=float, default=2.0, help="open mode: messages/s (0 = burst)")
+    ap.add_argument("--arrival", choices=("poisson", "fixed"), default="poisson")
+    ap.add_argument("--think-ms", type=int, default=0, help="closed mode: pause after each reply")
+    ap.add_argument("--script", help="JSON conversation script")
+    ap.add_argument("--chat-prefix", default="load_", help="chat_id prefix")
+    ap.add_argument("--reply-timeout", type=float, default=60.0,
+                    help="seconds before an unanswered message counts as dropped")
+    ap.add_argument("--connect-timeout", type=float, default=5.0)
+    ap.add_argument("--connect-stagger-ms", type=int, default=20)
+    ap.add_argument("--stats-interval", type=float, default=1.0,
+                    help="server stats sampling period in seconds (0 = off)")
+    ap.add_argument("--seed", type=int, help="random seed for Poisson arrivals")
+    ap.add_argument("--json", help="also write the summary to this file")
+    ap.add_argument("--mem-csv", help="write server heap samples to this CSV file")
+    ap.add_argument("--verbose", action="store_true")
+    args = ap.parse_args()
+
+    if args.seed is not None:
+        random.seed(args.seed)
+    gen = LoadGen(args, load_script(args.script))
+    result = asyncio.run(gen.run())
+
+    print(json.dumps(result, indent=2))
+    if args.json:
+        with open(args.json, "w") as f:
+            json.dump(result, f, indent=2)
+    if args.mem_csv and gen.mem:
+        cols = ["t_ms", "internal_free", "internal_largest", "psram_free", "clients", "rx_msgs", "dropped"]
+        with open(args.mem_csv, "w") as f:
+            f.write(",".join(cols) + "\n")
+            for m in gen.mem:
+                f.write(",".join(str(m.get(c, "")) for c in cols) + "\n")
+    return 0 if gen.connect_failed < args.sessions else 2
+
+
+if __name__ == "__main__":
+    sys.exit(main())